@@ -13,6 +13,7 @@ namespace TextureSubPlugin {
         public IntPtr data_ptr;
         public Int32 level;
         public Int32 format;
+        public UInt64 ticket;
     };
 
     [StructLayout(LayoutKind.Sequential)]
@@ -27,6 +28,10 @@ namespace TextureSubPlugin {
         public IntPtr data_ptr;
         public Int32 level;
         public Int32 format;
+        // optional pointer to a SourceDescriptor (IntPtr.Zero if data_ptr
+        // already holds data in the texture format)
+        public IntPtr source;
+        public UInt64 ticket;
     };
 
     [StructLayout(LayoutKind.Sequential)]
@@ -36,30 +41,1041 @@ namespace TextureSubPlugin {
         public UInt32 height;
         public UInt32 depth;
         public Int32 format;
+        public UInt64 ticket;
     };
 
     [StructLayout(LayoutKind.Sequential)]
     public struct DestroyTexture3DParams {
         public UInt32 texture_id;
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TextureSubImage3DByIDParams {
+        public UInt32 texture_id;
+        public Int32 xoffset;
+        public Int32 yoffset;
+        public Int32 zoffset;
+        public Int32 width;
+        public Int32 height;
+        public Int32 depth;
+        public IntPtr data_ptr;
+        public Int32 level;
+        public Int32 format;
+        public IntPtr source;
+        public UploadFlags flags;
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TextureSubImage3DBitpackedParams {
+        public UInt32 texture_id;
+        public Int32 xoffset;
+        public Int32 yoffset;
+        public Int32 zoffset;
+        public Int32 width;
+        public Int32 height;
+        public Int32 depth;
+        // texels encoded with BrickCodec.Bitpack (see API.EncodeBitpackedData)
+        public IntPtr words;
+        public UInt32 bits;
+        public UInt32 min;
+        // UR8 or UR16
+        public Format format;
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct UploadBrickStatisticsTextureParams {
+        public UInt32 texture_id;
+        public UInt32 stats_texture_id;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ReadbackTexture3DParams {
+        public UInt32 texture_id;
+        public UInt32 readback_id;
+        public Int32 xoffset;
+        public Int32 yoffset;
+        public Int32 zoffset;
+        public Int32 width;
+        public Int32 height;
+        public Int32 depth;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TextureCopyRegion {
+        public UInt32 src_texture_id;
+        public UInt32 dst_texture_id;
+        public Int32 src_x;
+        public Int32 src_y;
+        public Int32 src_z;
+        public Int32 dst_x;
+        public Int32 dst_y;
+        public Int32 dst_z;
+        public UInt32 width;
+        public UInt32 height;
+        public UInt32 depth;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct BrickMove {
+        public Int32 src_x;
+        public Int32 src_y;
+        public Int32 src_z;
+        public Int32 dst_x;
+        public Int32 dst_y;
+        public Int32 dst_z;
+        public UInt32 width;
+        public UInt32 height;
+        public UInt32 depth;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct CopyTexture3DRegionsParams {
+        // pointer to an array of count TextureCopyRegion
+        public IntPtr regions;
+        public UInt32 count;
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct DefragmentTexture3DParams {
+        public UInt32 texture_id;
+        // pointer to an array of count BrickMove
+        public IntPtr moves;
+        public UInt32 count;
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct BenchmarkUploadPathsParams {
+        // extent of the benchmarked bricks
+        public UInt32 width;
+        public UInt32 height;
+        public UInt32 depth;
+        public Format format;
+        // number of bricks uploaded through each path
+        public UInt32 count;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct CreateBufferParams {
+        public UInt32 buffer_id;
+        public UInt64 size;
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct DestroyBufferParams {
+        public UInt32 buffer_id;
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct BufferSubDataParams {
+        public UInt32 buffer_id;
+        public UInt64 offset;
+        public UInt64 size;
+        public IntPtr data_ptr;
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct UnregisterHostMemoryParams {
+        public UInt32 memory_id;
+        // completes once the memory can be released
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TextureBox {
+        public Int32 x;
+        public Int32 y;
+        public Int32 z;
+        public UInt32 width;
+        public UInt32 height;
+        public UInt32 depth;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ComputeGradientsParams {
+        public UInt32 src_texture_id;
+        // created on first use with the extent of the source
+        public UInt32 dst_texture_id;
+        // URGBA8 or URG16
+        public Format dst_format;
+        // scale applied to the gradient magnitude in RGBA8 outputs (0 for 1)
+        public float magnitude_scale;
+        // pointer to an array of count TextureBox in upload coordinates (IntPtr.Zero for the whole volume)
+        public IntPtr boxes;
+        public UInt32 count;
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct UpdatePlaybackParams {
+        public UInt32 playback_id;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct DestroyPlaybackParams {
+        public UInt32 playback_id;
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct UpdateProgressiveParams {
+        public UInt32 volume_id;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct DestroyProgressiveParams {
+        public UInt32 volume_id;
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ExecuteCommandStreamParams {
+        // stream written by CommandStreamBuilder.CopyTo (8 byte aligned). Like the data its commands
+        // reference, it only has to stay valid until the event was executed
+        public IntPtr stream;
+        public UInt64 size;
+        public UInt64 ticket;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct SliceSource {
+        // first row of the region in this depth slice
+        public IntPtr data_ptr;
+        // bytes between the starts of consecutive rows (0 if rows are tightly packed)
+        public UInt64 row_pitch;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TextureSubImage3DSlicesParams {
+        public UInt32 texture_id;
+        public Int32 xoffset;
+        public Int32 yoffset;
+        public Int32 zoffset;
+        public Int32 width;
+        public Int32 height;
+        public Int32 depth;
+        // array of depth SliceSources (front to back). The array and the slices only have to stay
+        // valid until the event was executed
+        public IntPtr slices;
+        public Int32 format;
+        // combination of UploadFlags
+        public UInt32 flags;
+        public UInt64 ticket;
     };
 
     public enum Event : Int32 {
         TextureSubImage2D = 0,
         TextureSubImage3D = 1,
         CreateTexture3D = 2,
-        DestroyTexture3D = 3
+        DestroyTexture3D = 3,
+        TextureSubImage3DByID = 4,
+        UploadBrickStatisticsTexture = 5,
+        ReadbackTexture3D = 6,
+        ProcessReadbacks = 7,
+        CopyTexture3DRegions = 8,
+        DefragmentTexture3D = 9,
+        BenchmarkUploadPaths = 10,
+        CreateBuffer = 11,
+        DestroyBuffer = 12,
+        BufferSubData = 13,
+        UnregisterHostMemory = 14,
+        ComputeGradients = 15,
+        TextureSubImage3DBitpacked = 16,
+        UpdatePlayback = 17,
+        DestroyPlayback = 18,
+        ExecuteCommandStream = 19,
+        TextureSubImage3DSlices = 20,
+        UpdateProgressive = 21,
+        DestroyProgressive = 22
     };
 
     public enum Format : Int32 {
         UR8 = 0,
-        UR16 = 1
+        UR16 = 1,
+        URG8 = 2,
+        URG16 = 3,
+        URGBA8 = 4,
+        URGBA16 = 5,
+        SFloatR16 = 6,
+        SFloatR32 = 7,
+        SNormR8 = 8
     }
 
+    public enum SourceEncoding : UInt32 {
+        Native = 0,
+        Float32 = 1,
+        Packed12Bit = 2,
+        UInt16BigEndian = 3,
+        Planar = 4
+    }
+
+    [Flags]
+    public enum UploadFlags : UInt32 {
+        None = 0,
+        DetectConstant = 1 << 0,
+        Constant = 1 << 1
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct SourceDescriptor {
+        public SourceEncoding encoding;
+        public float window_center;
+        public float window_width;
+        // optional strides (in texels) of a region within a larger volume:
+        // texels per row and rows per slice (0 if tightly packed). Only
+        // supported for SourceEncoding.Native
+        public UInt32 row_length;
+        public UInt32 image_height;
+    };
+
+    [Flags]
+    public enum BudgetFallback : UInt32 {
+        None = 0,
+        ReducePrecision = 1 << 0,
+        Downsample = 1 << 1,
+        Reject = 1 << 2
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct MemoryBudgetPolicy {
+        public BudgetFallback fallback_flags;
+        public UInt32 max_downsample_levels;
+        public float budget_fraction;
+        public UInt16 window_min;
+        public UInt16 window_max;
+    };
+
+    public enum HostImageCopyMode : UInt32 {
+        // default: host copies are written immediately and race with frames in
+        // flight that still sample the region
+        Never = 0,
+        Auto = 1,
+        Always = 2
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct HostImageCopyPolicy {
+        public HostImageCopyMode mode;
+        public UInt32 reserved;
+        // largest region that is written from the CPU in HostImageCopyMode.Auto
+        // (unless the texture memory is host visible)
+        public UInt64 max_region_bytes;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct UploadBenchmark {
+        public ReadbackStatus status;
+        public UInt32 host_image_copy_supported;
+        public UInt32 brick_count;
+        public UInt32 reserved;
+        public UInt64 brick_bytes;
+        // averages per brick in nanoseconds
+        public double host_copy_ns;
+        public double staging_cpu_ns;
+        public double staging_gpu_ns;
+        // copying a brick into staging memory with memcpy vs. the stream copy engine
+        public double memcpy_ns;
+        public double stream_copy_ns;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct MemoryHeapBudget {
+        public UInt64 heap_size;
+        public UInt64 budget;
+        public UInt64 usage;
+        public UInt64 plugin_usage;
+        public UInt32 device_local;
+        public UInt32 from_budget_extension;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct Texture3DInfo {
+        public UInt32 width;
+        public UInt32 height;
+        public UInt32 depth;
+        public Int32 format;
+        public UInt32 downsample_level;
+        public UInt64 size_in_bytes;
+        public UInt32 tile_count_x;
+        public UInt32 tile_count_y;
+        public UInt32 tile_count_z;
+        public UInt32 tile_stride_x;
+        public UInt32 tile_stride_y;
+        public UInt32 tile_stride_z;
+        public UInt32 host_image_copy;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct BufferInfo {
+        public UInt64 size;
+        // GPU virtual address (0 if buffer device addresses are not supported)
+        public UInt64 device_address;
+        public UInt32 heap;
+        public UInt32 reserved;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct TileDescriptor {
+        public UInt32 origin_x;
+        public UInt32 origin_y;
+        public UInt32 origin_z;
+        public UInt32 index;
+        public UInt32 extent_x;
+        public UInt32 extent_y;
+        public UInt32 extent_z;
+        public UInt32 reserved;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct BrickStatisticsConfig {
+        public UInt32 brick_size_x;
+        public UInt32 brick_size_y;
+        public UInt32 brick_size_z;
+        public UInt32 histogram_bins;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct BrickStatistics {
+        public UInt32 min;
+        public UInt32 max;
+        public UInt64 voxel_count;
+    };
+
+    public enum BrickCodec : UInt32 {
+        None = 0,
+        Constant = 1,
+        Bitpack = 2
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct VolumeContainerOptions {
+        // edge length of the bricks in voxels (0 selects 64)
+        public UInt32 brick_size;
+        // number of LODs to store (0 to halve the volume until it fits a brick)
+        public UInt32 lod_count;
+        // non-zero to store constant bricks as a single texel and to bit pack
+        // bricks of UR8/UR16 volumes
+        public UInt32 compress;
+        public UInt32 reserved;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct VolumeContainerInfo {
+        public UInt32 width;
+        public UInt32 height;
+        public UInt32 depth;
+        public Int32 format;
+        public UInt32 brick_size;
+        public UInt32 lod_count;
+        public UInt32 brick_count;
+        public UInt32 alignment;
+        public UInt64 file_size;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct VolumeContainerLod {
+        public UInt32 width;
+        public UInt32 height;
+        public UInt32 depth;
+        public UInt32 brick_count_x;
+        public UInt32 brick_count_y;
+        public UInt32 brick_count_z;
+        public UInt32 first_brick;
+        public UInt32 reserved;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct VolumeContainerBrick {
+        public UInt64 offset;
+        public UInt32 stored_size;
+        public UInt32 raw_size;
+        public BrickCodec codec;
+        public UInt32 bits;
+        public UInt32 lod;
+        public UInt32 x;
+        public UInt32 y;
+        public UInt32 z;
+        public UInt32 width;
+        public UInt32 height;
+        public UInt32 depth;
+        // UR8/UR16 volumes only
+        public UInt32 min;
+        public UInt32 max;
+    };
+
+    [Flags]
+    public enum PlaybackFlags : UInt32 {
+        None = 0,
+        // only upload the bricks that differ from the ones the back texture holds
+        DeltaBricks = 1 << 0
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct PlaybackDesc {
+        public UInt32 width;
+        public UInt32 height;
+        public UInt32 depth;
+        public Format format;
+        public UInt32 timestep_count;
+        // number of textures the timesteps are uploaded into (2 or 3)
+        public UInt32 buffer_count;
+        // user assigned IDs of the textures; only the first buffer_count are used
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+        public UInt32[] texture_ids;
+        // edge length of the uploaded (and compared) bricks (0 for 64)
+        public UInt32 brick_size;
+        // number of timesteps kept in staging memory (0 for buffer_count)
+        public UInt32 prefetch_count;
+        public PlaybackFlags flags;
+        // maximum number of bytes uploaded per UpdatePlayback event (0 for no limit)
+        public UInt64 max_upload_bytes;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct PlaybackState {
+        // only valid if front_timestep is not API.PlaybackNoTimestep
+        public UInt32 front_texture_id;
+        public UInt32 front_timestep;
+        // incremented whenever the front texture changes
+        public UInt32 swap_count;
+        public UInt32 uploading_timestep;
+        public UInt32 prefetched_count;
+        public UInt32 reserved;
+        // bytes uploaded by the last UpdatePlayback event
+        public UInt64 uploaded_bytes;
+        public UInt64 skipped_bricks;
+    };
+
+    [Flags]
+    public enum ProgressiveFlags : UInt32 {
+        None = 0,
+        // average the voxels of each cell instead of sampling one (the first frame takes longer for
+        // larger volumes)
+        BoxFilter = 1 << 0
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ProgressiveDesc {
+        // full resolution volume; has to stay valid until front_level is 0 or the volume is destroyed
+        public IntPtr data_ptr;
+        public UInt32 width;
+        public UInt32 height;
+        public UInt32 depth;
+        public Format format;
+        // user assigned IDs of the two textures the levels are uploaded into
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 2)]
+        public UInt32[] texture_ids;
+        // level shown first (0 for the level at which the volume fits into a single brick)
+        public UInt32 coarse_level;
+        // edge length of the uploaded bricks (0 for 64)
+        public UInt32 brick_size;
+        public ProgressiveFlags flags;
+        // maximum number of bytes uploaded per UpdateProgressive event (0 for no limit)
+        public UInt64 max_upload_bytes;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct ProgressiveState {
+        // only valid if front_level is not API.ProgressiveNoLevel
+        public UInt32 front_texture_id;
+        // the front texture is reduced by 2^front_level along each axis (0 at full resolution)
+        public UInt32 front_level;
+        public UInt32 front_width;
+        public UInt32 front_height;
+        public UInt32 front_depth;
+        public UInt32 uploading_level;
+        public UInt32 uploaded_bricks;
+        public UInt32 brick_count;
+        // bytes uploaded by the last UpdateProgressive event
+        public UInt64 uploaded_bytes;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct LogCounters {
+        public UInt64 messages;
+        // lines forwarded to Unity's log (including the lines that report suppressed messages)
+        public UInt64 lines;
+        public UInt64 suppressed;
+        // messages lost because the log ring was full (included in suppressed)
+        public UInt64 dropped;
+    };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct LogMessageStats {
+        // name of the function that logs (Marshal.PtrToStringAnsi)
+        public IntPtr function;
+        // printf format of the message (Marshal.PtrToStringAnsi)
+        public IntPtr format;
+        // values of UnityEngine.LogType
+        public Int32 type;
+        public UInt32 reserved;
+        public UInt64 count;
+        public UInt64 suppressed;
+    };
+
+    public enum ReadbackStatus : UInt32 {
+        Unknown = 0,
+        Pending = 1,
+        Ready = 2,
+        Failed = 3
+    }
+
+    public enum TicketStatus : UInt32 {
+        Unknown = 0,
+        Pending = 1,
+        Complete = 2,
+        Failed = 3
+    }
+
+    // invoked on the render thread; data stays valid until ReleaseReadback
+    [UnmanagedFunctionPointer(CallingConvention.StdCall)]
+    public delegate void ReadbackCallback(UInt32 readback_id, IntPtr data, UInt64 size);
+
+    // invoked on the render thread with the tickets that retired (completed
+    // or failed) since the last call and the ticket up to which all tickets
+    // have retired
+    [UnmanagedFunctionPointer(CallingConvention.StdCall)]
+    public delegate void TicketCallback(IntPtr tickets, UInt32 count, UInt64 completed_ticket);
+
+    // invoked on the playback's prefetch thread; fills dst with the timestep's
+    // voxels and returns false if the timestep could not be loaded
+    [UnmanagedFunctionPointer(CallingConvention.StdCall)]
+    [return: MarshalAs(UnmanagedType.I1)]
+    public delegate bool PlaybackLoadCallback(UInt32 playback_id, UInt32 timestep, IntPtr dst, UInt64 size,
+        IntPtr user_data);
+
     public static class API {
+        public const UInt32 PlaybackNoTimestep = 0xFFFFFFFF;
+        public const UInt32 ProgressiveNoLevel = 0xFFFFFFFF;
+
         [DllImport("TextureSubPlugin")]
         public static extern IntPtr GetRenderEventFunc();
 
         [DllImport("TextureSubPlugin")]
         public static extern IntPtr RetrieveCreatedTexture3D(UInt32 texture_id);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern IntPtr RetrieveCreatedBuffer(UInt32 buffer_id);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool RegisterHostMemory(UInt32 memory_id, IntPtr ptr, UInt64 size);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool GetBufferInfo(UInt32 buffer_id, out BufferInfo info);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern IntPtr RetrieveCreatedTexture3DTile(UInt32 texture_id, UInt32 tile_index);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern UInt32 GetTextureTileDescriptors(UInt32 texture_id, [Out] TileDescriptor[] tiles, UInt32 max_tiles);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool GetTexture3DInfo(UInt32 texture_id, out Texture3DInfo info);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern UInt32 GetMemoryBudget([Out] MemoryHeapBudget[] heaps, UInt32 max_heaps);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern void SetMemoryBudgetPolicy(ref MemoryBudgetPolicy policy);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern void SetHostImageCopyPolicy(ref HostImageCopyPolicy policy);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern ReadbackStatus GetUploadBenchmark(out UploadBenchmark result);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool ConfigureBrickStatistics(UInt32 texture_id, ref BrickStatisticsConfig config);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern UInt32 GetBrickStatistics(UInt32 texture_id, [Out] BrickStatistics[] stats, UInt32 max_bricks,
+            [Out] UInt32[] histograms, UInt32 max_histogram_entries);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern UInt32 GetOccupancyBitmap(UInt32 texture_id, [Out] UInt32[] words, UInt32 max_words);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern ReadbackStatus GetReadback(UInt32 readback_id, out IntPtr data, out UInt64 size);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern void ReleaseReadback(UInt32 readback_id);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern void SetReadbackCallback(ReadbackCallback callback);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern void EnableTracing([MarshalAs(UnmanagedType.I1)] bool enabled);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool WriteTraceFile(string path);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern void GetLogCounters(out LogCounters counters);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern UInt32 GetLogMessageStats([Out] LogMessageStats[] stats, UInt32 max_stats);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool WriteVolumeContainerFile(string path, IntPtr data, UInt32 width, UInt32 height,
+            UInt32 depth, Format format, ref VolumeContainerOptions options);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool OpenVolumeContainer(UInt32 container_id, string path);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern void CloseVolumeContainer(UInt32 container_id);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool GetVolumeContainerInfo(UInt32 container_id, out VolumeContainerInfo info);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern UInt32 GetVolumeContainerLods(UInt32 container_id, [Out] VolumeContainerLod[] lods,
+            UInt32 max_lods);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern UInt32 GetVolumeContainerBricks(UInt32 container_id, UInt32 first_brick,
+            [Out] VolumeContainerBrick[] bricks, UInt32 max_bricks);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool DecodeVolumeContainerBrick(UInt32 container_id, UInt32 brick_index, IntPtr dst,
+            UInt64 dst_size);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool GetVolumeContainerMapping(UInt32 container_id, out IntPtr data, out UInt64 size);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool PrepareVolumeContainerUpload(UInt32 container_id, UInt32 brick_index,
+            UInt32 texture_id, Int32 xoffset, Int32 yoffset, Int32 zoffset, IntPtr scratch, UInt64 scratch_size,
+            out TextureSubImage3DByIDParams args);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool PrepareVolumeContainerBitpackedUpload(UInt32 container_id, UInt32 brick_index,
+            UInt32 texture_id, Int32 xoffset, Int32 yoffset, Int32 zoffset,
+            out TextureSubImage3DBitpackedParams args);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern UInt64 EncodeBitpackedData(IntPtr data, UInt64 count, Format format, IntPtr words,
+            UInt64 max_words, out UInt32 bits, out UInt32 min);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool DecodeBitpackedData(IntPtr words, UInt32 bits, UInt32 min, UInt64 count,
+            Format format, IntPtr dst);
+
+        // the callback delegate must be kept alive until the playback is destroyed
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool CreatePlayback(UInt32 playback_id, ref PlaybackDesc desc,
+            PlaybackLoadCallback callback, IntPtr user_data);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern void SeekPlayback(UInt32 playback_id, UInt32 timestep);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool GetPlaybackState(UInt32 playback_id, out PlaybackState state);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern IntPtr RetrievePlaybackTexture3D(UInt32 playback_id);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool CreateProgressiveVolume(UInt32 volume_id, ref ProgressiveDesc desc);
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool GetProgressiveState(UInt32 volume_id, out ProgressiveState state);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern IntPtr RetrieveProgressiveTexture3D(UInt32 volume_id);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern IntPtr GetParamRing(UInt32 size);
+
+        // the *Params structs of most events end with a ticket field: 0, or a
+        // ticket from AcquireTicket to track the completion of the event's
+        // work (see IsComplete, GetTicketStatus, GetCompletedTicket and
+        // SetTicketCallback)
+        [DllImport("TextureSubPlugin")]
+        public static extern UInt64 AcquireTicket();
+
+        [DllImport("TextureSubPlugin")]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool IsComplete(UInt64 ticket);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern TicketStatus GetTicketStatus(UInt64 ticket);
+
+        // retires a ticket that will not be passed to an executed event as
+        // failed, so that GetCompletedTicket advances past it
+        [DllImport("TextureSubPlugin")]
+        public static extern void ReleaseTicket(UInt64 ticket);
+
+        [DllImport("TextureSubPlugin")]
+        public static extern UInt64 GetCompletedTicket();
+
+        [DllImport("TextureSubPlugin")]
+        public static extern void SetTicketCallback(TicketCallback callback);
     };
+
+    public enum CommandType : UInt16 {
+        CreateTexture3D = 1,
+        DestroyTexture3D = 2,
+        TextureSubImage3D = 3,
+        CreateBuffer = 4,
+        DestroyBuffer = 5,
+        BufferSubData = 6
+    }
+
+    // Packs the operations of a frame into a command stream that a single ExecuteCommandStream event
+    // executes in order (see src/CommandStream.hpp for the layout). Consecutive uploads and buffer
+    // writes are grouped by resource so that they share their barriers. Data is either referenced
+    // (IntPtr overloads - it has to stay valid until the event was executed) or copied into the
+    // stream. Not thread safe
+    public class CommandStreamBuilder {
+        public const UInt32 Magic = 0x53435354;
+        public const UInt16 Version = 1;
+        private const int HeaderSize = 16;
+
+        private byte[] m_Data = new byte[4096];
+        private int m_Size;
+        private UInt32 m_CommandCount;
+
+        public CommandStreamBuilder() {
+            Reset();
+        }
+
+        // size of the stream in bytes
+        public int Size {
+            get { return m_Size; }
+        }
+
+        public UInt32 CommandCount {
+            get { return m_CommandCount; }
+        }
+
+        // starts a new stream (the capacity is kept)
+        public void Reset() {
+            m_Size = 0;
+            m_CommandCount = 0;
+            Write32(Magic);
+            Write16(Version);
+            Write16(0);
+            Write32(0);
+            Write32(0);
+        }
+
+        public void CreateTexture3D(UInt32 texture_id, UInt32 width, UInt32 height, UInt32 depth,
+            Format format) {
+            int end = BeginCommand(CommandType.CreateTexture3D, 32);
+            Write32(texture_id);
+            Write32(width);
+            Write32(height);
+            Write32(depth);
+            Write32((UInt32)format);
+            EndCommand(end);
+        }
+
+        public void DestroyTexture3D(UInt32 texture_id) {
+            int end = BeginCommand(CommandType.DestroyTexture3D, 16);
+            Write32(texture_id);
+            EndCommand(end);
+        }
+
+        // data is in the texture format (a single texel for UploadFlags.Constant)
+        public void TextureSubImage3D(UInt32 texture_id, Int32 xoffset, Int32 yoffset, Int32 zoffset,
+            Int32 width, Int32 height, Int32 depth, Format format, IntPtr data_ptr,
+            UploadFlags flags = UploadFlags.None) {
+            int end = BeginCommand(CommandType.TextureSubImage3D, 56);
+            WriteTextureSubImage3D(texture_id, xoffset, yoffset, zoffset, width, height, depth, format,
+                flags, (UInt64)data_ptr.ToInt64());
+            EndCommand(end);
+        }
+
+        // copies data_size bytes of data into the stream
+        public void TextureSubImage3D(UInt32 texture_id, Int32 xoffset, Int32 yoffset, Int32 zoffset,
+            Int32 width, Int32 height, Int32 depth, Format format, byte[] data, int data_offset,
+            int data_size, UploadFlags flags = UploadFlags.None) {
+            int end = BeginCommand(CommandType.TextureSubImage3D, 56 + data_size);
+            WriteTextureSubImage3D(texture_id, xoffset, yoffset, zoffset, width, height, depth, format,
+                flags, 0);
+            WriteBytes(data, data_offset, data_size);
+            EndCommand(end);
+        }
+
+        public void CreateBuffer(UInt32 buffer_id, UInt64 size) {
+            int end = BeginCommand(CommandType.CreateBuffer, 24);
+            Write32(buffer_id);
+            Write32(0);
+            Write64(size);
+            EndCommand(end);
+        }
+
+        public void DestroyBuffer(UInt32 buffer_id) {
+            int end = BeginCommand(CommandType.DestroyBuffer, 16);
+            Write32(buffer_id);
+            EndCommand(end);
+        }
+
+        public void BufferSubData(UInt32 buffer_id, UInt64 offset, UInt64 size, IntPtr data_ptr) {
+            int end = BeginCommand(CommandType.BufferSubData, 40);
+            WriteBufferSubData(buffer_id, offset, size, (UInt64)data_ptr.ToInt64());
+            EndCommand(end);
+        }
+
+        // copies data_size bytes of data into the stream
+        public void BufferSubData(UInt32 buffer_id, UInt64 offset, byte[] data, int data_offset,
+            int data_size) {
+            int end = BeginCommand(CommandType.BufferSubData, 40 + data_size);
+            WriteBufferSubData(buffer_id, offset, (UInt64)data_size, 0);
+            WriteBytes(data, data_offset, data_size);
+            EndCommand(end);
+        }
+
+        // copies the stream to destination, which has to hold Size bytes and be 8 byte aligned
+        // (e.g., memory from Marshal.AllocHGlobal or ParamRing.Allocate)
+        public void CopyTo(IntPtr destination) {
+            Marshal.Copy(m_Data, 0, destination, m_Size);
+        }
+
+        private void WriteTextureSubImage3D(UInt32 texture_id, Int32 xoffset, Int32 yoffset,
+            Int32 zoffset, Int32 width, Int32 height, Int32 depth, Format format, UploadFlags flags,
+            UInt64 data_ptr) {
+            Write32(texture_id);
+            Write32((UInt32)xoffset);
+            Write32((UInt32)yoffset);
+            Write32((UInt32)zoffset);
+            Write32((UInt32)width);
+            Write32((UInt32)height);
+            Write32((UInt32)depth);
+            Write32((UInt32)format);
+            Write32((UInt32)flags);
+            Write32(0);
+            Write64(data_ptr);
+        }
+
+        private void WriteBufferSubData(UInt32 buffer_id, UInt64 offset, UInt64 size, UInt64 data_ptr) {
+            Write32(buffer_id);
+            Write32(0);
+            Write64(offset);
+            Write64(size);
+            Write64(data_ptr);
+        }
+
+        // reserves a zeroed command of size bytes (rounded up to 8) and writes its header
+        // returns the end of the command
+        private int BeginCommand(CommandType type, int size) {
+            int aligned = (size + 7) & ~7;
+            if (m_Size + aligned > m_Data.Length)
+                Array.Resize(ref m_Data, Math.Max(m_Data.Length * 2, m_Size + aligned));
+            Array.Clear(m_Data, m_Size, aligned);
+            int end = m_Size + aligned;
+            Write16((UInt16)type);
+            Write16(0);
+            Write32((UInt32)aligned);
+            return end;
+        }
+
+        private void EndCommand(int end) {
+            m_Size = end;
+            ++m_CommandCount;
+            // command_count of the stream header
+            m_Data[8] = (byte)m_CommandCount;
+            m_Data[9] = (byte)(m_CommandCount >> 8);
+            m_Data[10] = (byte)(m_CommandCount >> 16);
+            m_Data[11] = (byte)(m_CommandCount >> 24);
+        }
+
+        private void Write16(UInt16 value) {
+            m_Data[m_Size++] = (byte)value;
+            m_Data[m_Size++] = (byte)(value >> 8);
+        }
+
+        private void Write32(UInt32 value) {
+            Write16((UInt16)value);
+            Write16((UInt16)(value >> 16));
+        }
+
+        private void Write64(UInt64 value) {
+            Write32((UInt32)value);
+            Write32((UInt32)(value >> 32));
+        }
+
+        private void WriteBytes(byte[] data, int offset, int size) {
+            Buffer.BlockCopy(data, offset, m_Data, m_Size, size);
+            m_Size += size;
+        }
+    }
+
+#if TEXTURESUBPLUGIN_UNSAFE
+    // Writes event parameters in place into the plugin's parameter ring instead
+    // of allocating and marshalling them per event. Requires "Allow 'unsafe'
+    // Code" and the TEXTURESUBPLUGIN_UNSAFE scripting define symbol. Not thread
+    // safe - use it from the thread that issues the plugin events
+    public static unsafe class ParamRing {
+        private const int RingHeaderSize = 64;
+        private const int SlotHeaderSize = 16;
+
+        private static byte* s_Data;
+        private static long* s_Consumed;
+        private static ulong s_Size;
+        private static ulong s_Position;
+
+        // the ring is allocated by the first call (later calls keep its size)
+        public static bool Initialize(UInt32 size = 1 << 20) {
+            byte* header = (byte*)API.GetParamRing(size);
+            if (header == null) return false;
+            s_Size = *(ulong*)header;
+            s_Consumed = (long*)(header + 8);
+            s_Data = header + RingHeaderSize;
+            s_Position = Math.Max(s_Position,
+                (ulong)System.Threading.Volatile.Read(ref *s_Consumed));
+            return true;
+        }
+
+        // returns IntPtr.Zero if the ring is full (i.e., the render thread has
+        // not consumed enough events yet) - fall back to Marshal.AllocHGlobal
+        public static IntPtr Allocate(int size) {
+            ulong slot = ((ulong)size + SlotHeaderSize + 15) & ~15ul;
+            if (s_Data == null || slot > s_Size) return IntPtr.Zero;
+            ulong start = s_Position;
+            ulong offset = start % s_Size;
+            // slots do not wrap around, the rest of the ring is skipped
+            if (offset + slot > s_Size) start += s_Size - offset;
+            ulong end = start + slot;
+            ulong consumed =
+                (ulong)System.Threading.Volatile.Read(ref *s_Consumed);
+            if (end - consumed > s_Size) return IntPtr.Zero;
+            byte* p = s_Data + start % s_Size;
+            *(ulong*)p = end;
+            s_Position = end;
+            return (IntPtr)(p + SlotHeaderSize);
+        }
+
+        public static IntPtr Write<T>(in T value) where T : unmanaged {
+            IntPtr p = Allocate(sizeof(T));
+            if (p != IntPtr.Zero) *(T*)p = value;
+            return p;
+        }
+    }
+#endif
 }
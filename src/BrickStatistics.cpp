@@ -0,0 +1,254 @@
+#include "BrickStatistics.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "ConversionKernels.hpp"
+
+// region data is processed in chunks that stay in L1 so that computing the
+// statistics does not cost another pass over memory
+static const size_t kChunkTexels = 4096;
+
+BrickStatisticsTable::BrickStatisticsTable(const BrickStatisticsConfig& config,
+                                           uint32_t width, uint32_t height,
+                                           uint32_t depth, Format format)
+    : m_Config(config), m_Format(format), m_Extent{width, height, depth} {
+  m_Config.brick_size_x = std::max(1u, m_Config.brick_size_x);
+  m_Config.brick_size_y = std::max(1u, m_Config.brick_size_y);
+  m_Config.brick_size_z = std::max(1u, m_Config.brick_size_z);
+  m_BrickCount[0] = (width + m_Config.brick_size_x - 1) / m_Config.brick_size_x;
+  m_BrickCount[1] =
+      (height + m_Config.brick_size_y - 1) / m_Config.brick_size_y;
+  m_BrickCount[2] = (depth + m_Config.brick_size_z - 1) / m_Config.brick_size_z;
+
+  const size_t brick_count =
+      static_cast<size_t>(m_BrickCount[0]) * m_BrickCount[1] * m_BrickCount[2];
+  m_Bricks.resize(brick_count, BrickStatistics{0, 0, 0});
+  m_Histograms.resize(brick_count * m_Config.histogram_bins, 0);
+}
+
+bool BrickStatisticsTable::CopyRegion(const void* src,
+                                      const SourceDescriptor* source,
+                                      void* dst, int32_t xoffset,
+                                      int32_t yoffset, int32_t zoffset,
+                                      uint32_t width, uint32_t height,
+                                      uint32_t depth) {
+  const uint32_t bins = m_Config.histogram_bins;
+  const uint32_t bs[3] = {m_Config.brick_size_x, m_Config.brick_size_y,
+                          m_Config.brick_size_z};
+  const int32_t offset[3] = {xoffset, yoffset, zoffset};
+  const uint32_t extent[3] = {width, height, depth};
+
+  // range of bricks touched by the region
+  uint32_t first[3], count[3];
+  for (int a = 0; a < 3; ++a) {
+    first[a] = offset[a] / bs[a];
+    count[a] = (offset[a] + extent[a] - 1) / bs[a] - first[a] + 1;
+  }
+
+  // statistics are accumulated locally and merged afterwards to keep the
+  // table's lock short
+  std::vector<Partial> partials(static_cast<size_t>(count[0]) * count[1] *
+                                    count[2],
+                                Partial{0xFFFFFFFF, 0, 0});
+  std::vector<uint32_t> histograms(partials.size() * bins, 0);
+
+  const bool convert = source && source->encoding != SOURCE_ENCODING_NATIVE;
+  const size_t texel_size = FormatTexelSize(m_Format);
+  const size_t total = static_cast<size_t>(width) * height * depth;
+  uint8_t scratch[kChunkTexels * 2];
+  for (size_t i = 0; i < total; i += kChunkTexels) {
+    const size_t n = std::min(kChunkTexels, total - i);
+    const uint8_t* texels;
+    if (convert) {
+      // chunks start at even texels, hence at byte boundaries of 12-bit data
+      if (!ConvertSource(*source, src, i, n, m_Format, scratch)) return false;
+      texels = scratch;
+    } else {
+      texels = static_cast<const uint8_t*>(src) + i * texel_size;
+    }
+    if (dst)
+      memcpy(static_cast<uint8_t*>(dst) + i * texel_size, texels,
+             n * texel_size);
+
+    // split the chunk into runs that lie within one row and one brick
+    for (size_t j = 0; j < n;) {
+      const size_t index = i + j;
+      const uint32_t x = static_cast<uint32_t>(index % width);
+      const uint32_t y = static_cast<uint32_t>((index / width) % height);
+      const uint32_t z = static_cast<uint32_t>(index / width / height);
+      const uint32_t gx = xoffset + x;
+      const uint32_t brick_end = (gx / bs[0] + 1) * bs[0];
+      const size_t run =
+          std::min<size_t>(std::min(brick_end - gx, width - x), n - j);
+
+      const size_t local =
+          ((static_cast<size_t>((zoffset + z) / bs[2] - first[2]) * count[1] +
+            ((yoffset + y) / bs[1] - first[1])) *
+               count[0] +
+           (gx / bs[0] - first[0]));
+      Partial& partial = partials[local];
+      AccumulateStatistics(texels + j * texel_size, run, m_Format,
+                           &partial.min, &partial.max,
+                           bins ? histograms.data() + local * bins : nullptr,
+                           bins);
+      partial.voxel_count += run;
+      j += run;
+    }
+  }
+
+  Merge(first, count, offset, extent, partials, histograms);
+  return true;
+}
+
+void BrickStatisticsTable::AccumulateConstant(uint32_t value, int32_t xoffset,
+                                              int32_t yoffset, int32_t zoffset,
+                                              uint32_t width, uint32_t height,
+                                              uint32_t depth) {
+  const uint32_t bins = m_Config.histogram_bins;
+  const uint32_t bs[3] = {m_Config.brick_size_x, m_Config.brick_size_y,
+                          m_Config.brick_size_z};
+  const int32_t offset[3] = {xoffset, yoffset, zoffset};
+  const uint32_t extent[3] = {width, height, depth};
+
+  uint32_t first[3], count[3];
+  for (int a = 0; a < 3; ++a) {
+    first[a] = offset[a] / bs[a];
+    count[a] = (offset[a] + extent[a] - 1) / bs[a] - first[a] + 1;
+  }
+
+  const uint32_t bin =
+      bins ? static_cast<uint32_t>(
+                 (static_cast<uint64_t>(value) * bins) >>
+                 (m_Format == R16_UINT ? 16 : 8))
+           : 0;
+  std::vector<Partial> partials(static_cast<size_t>(count[0]) * count[1] *
+                                count[2]);
+  std::vector<uint32_t> histograms(partials.size() * bins, 0);
+  for (uint32_t k = 0; k < count[2]; ++k)
+    for (uint32_t j = 0; j < count[1]; ++j)
+      for (uint32_t i = 0; i < count[0]; ++i) {
+        // number of region voxels inside of brick (i, j, k)
+        const uint32_t b[3] = {first[0] + i, first[1] + j, first[2] + k};
+        uint64_t voxels = 1;
+        for (int a = 0; a < 3; ++a) {
+          const int64_t lo = std::max<int64_t>(
+              static_cast<int64_t>(b[a]) * bs[a], offset[a]);
+          const int64_t hi =
+              std::min<int64_t>((static_cast<int64_t>(b[a]) + 1) * bs[a],
+                                static_cast<int64_t>(offset[a]) + extent[a]);
+          voxels *= static_cast<uint64_t>(hi - lo);
+        }
+        const size_t local =
+            (static_cast<size_t>(k) * count[1] + j) * count[0] + i;
+        partials[local] = Partial{value, value, voxels};
+        if (bins)
+          histograms[local * bins + bin] = static_cast<uint32_t>(voxels);
+      }
+  Merge(first, count, offset, extent, partials, histograms);
+}
+
+void BrickStatisticsTable::Merge(const uint32_t first[3],
+                                 const uint32_t count[3],
+                                 const int32_t offset[3],
+                                 const uint32_t extent[3],
+                                 const std::vector<Partial>& partials,
+                                 const std::vector<uint32_t>& histograms) {
+  const uint32_t bins = m_Config.histogram_bins;
+  const uint32_t bs[3] = {m_Config.brick_size_x, m_Config.brick_size_y,
+                          m_Config.brick_size_z};
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  for (uint32_t k = 0; k < count[2]; ++k)
+    for (uint32_t j = 0; j < count[1]; ++j)
+      for (uint32_t i = 0; i < count[0]; ++i) {
+        const uint32_t b[3] = {first[0] + i, first[1] + j, first[2] + k};
+        if (b[0] >= m_BrickCount[0] || b[1] >= m_BrickCount[1] ||
+            b[2] >= m_BrickCount[2])
+          continue;
+        const size_t local =
+            (static_cast<size_t>(k) * count[1] + j) * count[0] + i;
+        const size_t global =
+            (static_cast<size_t>(b[2]) * m_BrickCount[1] + b[1]) *
+                m_BrickCount[0] +
+            b[0];
+        const Partial& partial = partials[local];
+        if (partial.voxel_count == 0) continue;
+
+        // a brick is fully covered if the region contains its clamped extent
+        bool covered = true;
+        for (int a = 0; a < 3; ++a) {
+          const int64_t lo = static_cast<int64_t>(b[a]) * bs[a];
+          const int64_t hi =
+              std::min<int64_t>(lo + bs[a], static_cast<int64_t>(m_Extent[a]));
+          covered = covered && offset[a] <= lo &&
+                    static_cast<int64_t>(offset[a]) + extent[a] >= hi;
+        }
+
+        BrickStatistics& brick = m_Bricks[global];
+        uint32_t* histogram = m_Histograms.data() + global * bins;
+        if (covered || brick.voxel_count == 0) {
+          brick.min = partial.min;
+          brick.max = partial.max;
+          brick.voxel_count = partial.voxel_count;
+          if (bins)
+            memcpy(histogram, histograms.data() + local * bins,
+                   bins * sizeof(uint32_t));
+          continue;
+        }
+        brick.min = std::min(brick.min, partial.min);
+        brick.max = std::max(brick.max, partial.max);
+        brick.voxel_count += partial.voxel_count;
+        for (uint32_t h = 0; h < bins; ++h)
+          histogram[h] += histograms[local * bins + h];
+      }
+}
+
+uint32_t BrickStatisticsTable::Read(BrickStatistics* stats,
+                                    uint32_t max_bricks, uint32_t* histograms,
+                                    uint32_t max_histogram_entries) const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (stats) {
+    const size_t n = std::min<size_t>(max_bricks, m_Bricks.size());
+    memcpy(stats, m_Bricks.data(), n * sizeof(BrickStatistics));
+  }
+  if (histograms) {
+    const size_t n =
+        std::min<size_t>(max_histogram_entries, m_Histograms.size());
+    memcpy(histograms, m_Histograms.data(), n * sizeof(uint32_t));
+  }
+  return static_cast<uint32_t>(m_Bricks.size());
+}
+
+Format BrickStatisticsTable::GetMinMaxTexels(
+    std::vector<uint8_t>* texels) const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (m_Format == R16_UINT) {
+    texels->resize(m_Bricks.size() * 2 * sizeof(uint16_t));
+    uint16_t* dst = reinterpret_cast<uint16_t*>(texels->data());
+    for (const BrickStatistics& brick : m_Bricks) {
+      *dst++ = static_cast<uint16_t>(brick.min);
+      *dst++ = static_cast<uint16_t>(brick.max);
+    }
+    return RG16_UINT;
+  }
+  texels->resize(m_Bricks.size() * 2);
+  uint8_t* dst = texels->data();
+  for (const BrickStatistics& brick : m_Bricks) {
+    *dst++ = static_cast<uint8_t>(brick.min);
+    *dst++ = static_cast<uint8_t>(brick.max);
+  }
+  return RG8_UINT;
+}
+
+uint32_t BrickStatisticsTable::GetOccupancy(uint32_t* words,
+                                            uint32_t max_words) const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (words) {
+    const size_t n = std::min<size_t>(max_words, (m_Bricks.size() + 31) / 32);
+    memset(words, 0, n * sizeof(uint32_t));
+    for (size_t i = 0; i < std::min(m_Bricks.size(), n * 32); ++i)
+      if (m_Bricks[i].max != 0) words[i / 32] |= 1u << (i % 32);
+  }
+  return static_cast<uint32_t>(m_Bricks.size());
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <vector>
+
+#include "TextureSubPluginAPI.hpp"
+
+/// @brief Per-brick min/max/histogram table of a 3D texture. Statistics are
+/// accumulated while uploads are copied into staging memory and can be read
+/// from any thread
+class BrickStatisticsTable {
+ public:
+  BrickStatisticsTable(const BrickStatisticsConfig& config, uint32_t width,
+                       uint32_t height, uint32_t depth, Format format);
+
+  /// @brief Copies an uploaded region (optionally converting it from source)
+  /// into dst and accumulates the statistics of the bricks it intersects in
+  /// the same pass. Bricks that are fully covered by the region are reset
+  /// first so that re-uploading a brick does not count its voxels twice
+  /// @param[in] src region data (x-fastest)
+  /// @param[in] source encoding of src (nullptr if src is in format)
+  /// @param[out] dst destination of the (converted) data (may be nullptr to
+  /// only accumulate statistics)
+  /// @return false if the conversion is not supported
+  bool CopyRegion(const void* src, const SourceDescriptor* source, void* dst,
+                  int32_t xoffset, int32_t yoffset, int32_t zoffset,
+                  uint32_t width, uint32_t height, uint32_t depth);
+
+  /// @brief Accumulates the statistics of a region whose voxels all have the
+  /// given value (e.g., a constant brick whose upload was elided)
+  void AccumulateConstant(uint32_t value, int32_t xoffset, int32_t yoffset,
+                          int32_t zoffset, uint32_t width, uint32_t height,
+                          uint32_t depth);
+
+  /// @brief Bulk read (see TextureSubPluginAPI::GetBrickStatistics)
+  uint32_t Read(BrickStatistics* stats, uint32_t max_bricks,
+                uint32_t* histograms, uint32_t max_histogram_entries) const;
+
+  /// @brief Fills texels with interleaved (min, max) pairs, one per brick, in
+  /// the precision of the texture's format
+  /// @return the format of the min/max texture (RG8_UINT or RG16_UINT)
+  Format GetMinMaxTexels(std::vector<uint8_t>* texels) const;
+
+  /// @brief Fills a bitmap (32 bricks per word, x-fastest) in which a brick's
+  /// bit is set if it contains any non-zero voxel
+  /// @return number of bricks
+  uint32_t GetOccupancy(uint32_t* words, uint32_t max_words) const;
+
+  uint32_t BrickCountX() const { return m_BrickCount[0]; }
+  uint32_t BrickCountY() const { return m_BrickCount[1]; }
+  uint32_t BrickCountZ() const { return m_BrickCount[2]; }
+
+ private:
+  struct Partial {
+    uint32_t min;
+    uint32_t max;
+    uint64_t voxel_count;
+  };
+
+  // merges per-region partial statistics (for the bricks [first, first +
+  // count)) into the table
+  void Merge(const uint32_t first[3], const uint32_t count[3],
+             const int32_t offset[3], const uint32_t extent[3],
+             const std::vector<Partial>& partials,
+             const std::vector<uint32_t>& histograms);
+
+  BrickStatisticsConfig m_Config;
+  Format m_Format;
+  uint32_t m_Extent[3];
+  uint32_t m_BrickCount[3];
+
+  mutable std::mutex m_Mutex;
+  std::vector<BrickStatistics> m_Bricks;
+  std::vector<uint32_t> m_Histograms;
+};
@@ -0,0 +1,291 @@
+#include "CommandStream.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "PluginLog.hpp"
+#include "Tracing.hpp"
+
+// an upload or buffer write that waits for the end of its group
+struct PendingUpload {
+  uint32_t texture_id;
+  Format format;
+  TextureUploadRegion region;
+};
+
+struct PendingWrite {
+  uint32_t buffer_id;
+  BufferWriteRange range;
+};
+
+// a command's data is either referenced or follows the command inline
+static const void* CommandData(const uint8_t* command, size_t command_size,
+                               uint64_t data_ptr) {
+  if (data_ptr != 0)
+    return reinterpret_cast<const void*>(static_cast<uintptr_t>(data_ptr));
+  return command + command_size;
+}
+
+static bool IsValidFormatValue(int32_t format) {
+  return format >= 0 && format < FORMAT_COUNT;
+}
+
+// extent of a texture in upload coordinates, as far as the validation of a
+// stream knows it
+struct KnownExtent {
+  bool known;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+};
+typedef std::unordered_map<uint32_t, KnownExtent> KnownExtents;
+
+// textures created by the stream have their requested extent. Other textures
+// have the one the backend reports, unless the memory budget policy degraded
+// them (the backend checks their uploads)
+static const KnownExtent& LookupExtent(TextureSubPluginAPI* api,
+                                       KnownExtents* extents,
+                                       uint32_t texture_id) {
+  auto search = extents->find(texture_id);
+  if (search != extents->end()) return search->second;
+  KnownExtent extent = {};
+  Texture3DInfo info;
+  if (api->GetTexture3DInfo(texture_id, &info) && info.downsample_level == 0)
+    extent = {true, info.width, info.height, info.depth};
+  return (*extents)[texture_id] = extent;
+}
+
+// checks that a command's fields are consistent with its size and that
+// uploads lie within their texture (commands of unknown types are valid, they
+// are skipped). extents follows the textures created and destroyed by the
+// commands validated so far
+static bool ValidateCommand(TextureSubPluginAPI* api, const uint8_t* command,
+                            const CommandHeader& header,
+                            KnownExtents* extents) {
+  switch (header.type) {
+    case COMMAND_CREATE_TEXTURE_3D: {
+      CreateTexture3DCommand args;
+      if (header.size < sizeof(args)) return false;
+      memcpy(&args, command, sizeof(args));
+      (*extents)[args.texture_id] = {true, args.width, args.height,
+                                     args.depth};
+      return IsValidFormatValue(args.format);
+    }
+    case COMMAND_DESTROY_TEXTURE_3D: {
+      DestroyTexture3DCommand args;
+      if (header.size < sizeof(args)) return false;
+      memcpy(&args, command, sizeof(args));
+      (*extents)[args.texture_id] = KnownExtent{};
+      return true;
+    }
+    case COMMAND_TEXTURE_SUB_IMAGE_3D: {
+      TextureSubImage3DCommand args;
+      if (header.size < sizeof(args)) return false;
+      memcpy(&args, command, sizeof(args));
+      if (!IsValidFormatValue(args.format) || args.width <= 0 ||
+          args.height <= 0 || args.depth <= 0 || args.xoffset < 0 ||
+          args.yoffset < 0 || args.zoffset < 0)
+        return false;
+      const KnownExtent& extent = LookupExtent(api, extents, args.texture_id);
+      if (extent.known &&
+          (static_cast<int64_t>(args.xoffset) + args.width > extent.width ||
+           static_cast<int64_t>(args.yoffset) + args.height > extent.height ||
+           static_cast<int64_t>(args.zoffset) + args.depth > extent.depth))
+        return false;
+      if (args.data_ptr != 0) return true;
+      // texel_size * width * height * depth <= inline_size without
+      // overflowing
+      const uint64_t inline_size = header.size - sizeof(args);
+      const uint64_t texel_size =
+          FormatTexelSize(static_cast<Format>(args.format));
+      if (args.flags & UPLOAD_FLAG_CONSTANT) return texel_size <= inline_size;
+      return static_cast<uint64_t>(args.depth) <=
+             inline_size / texel_size / args.width / args.height;
+    }
+    case COMMAND_CREATE_BUFFER:
+      return header.size >= sizeof(CreateBufferCommand);
+    case COMMAND_DESTROY_BUFFER:
+      return header.size >= sizeof(DestroyBufferCommand);
+    case COMMAND_BUFFER_SUB_DATA: {
+      BufferSubDataCommand args;
+      if (header.size < sizeof(args)) return false;
+      memcpy(&args, command, sizeof(args));
+      return args.size != 0 &&
+             (args.data_ptr != 0 || args.size <= header.size - sizeof(args));
+    }
+    default:
+      return true;
+  }
+}
+
+// executes the pending uploads as one batch per texture and format and the
+// pending writes as one batch per buffer. Sorting is stable, so uploads to
+// the same texture (and writes to the same buffer) keep their order
+static void ExecuteGroup(TextureSubPluginAPI* api,
+                         std::vector<PendingUpload>* uploads,
+                         std::vector<PendingWrite>* writes) {
+  std::stable_sort(uploads->begin(), uploads->end(),
+                   [](const PendingUpload& a, const PendingUpload& b) {
+                     return a.texture_id < b.texture_id;
+                   });
+  std::vector<TextureUploadRegion> regions;
+  for (size_t first = 0, last = 0; first < uploads->size(); first = last) {
+    const PendingUpload& head = (*uploads)[first];
+    regions.clear();
+    for (last = first; last < uploads->size() &&
+                       (*uploads)[last].texture_id == head.texture_id &&
+                       (*uploads)[last].format == head.format;
+         ++last)
+      regions.push_back((*uploads)[last].region);
+    TraceScope trace("upload", "TextureSubImage3DBatch", "regions",
+                     regions.size());
+    api->TextureSubImage3DBatch(head.texture_id, regions.data(),
+                                static_cast<uint32_t>(regions.size()),
+                                head.format);
+  }
+  uploads->clear();
+
+  std::stable_sort(writes->begin(), writes->end(),
+                   [](const PendingWrite& a, const PendingWrite& b) {
+                     return a.buffer_id < b.buffer_id;
+                   });
+  std::vector<BufferWriteRange> ranges;
+  for (size_t first = 0, last = 0; first < writes->size(); first = last) {
+    const uint32_t buffer_id = (*writes)[first].buffer_id;
+    ranges.clear();
+    for (last = first;
+         last < writes->size() && (*writes)[last].buffer_id == buffer_id;
+         ++last)
+      ranges.push_back((*writes)[last].range);
+    TraceScope trace("upload", "BufferSubDataBatch", "ranges", ranges.size());
+    api->BufferSubDataBatch(buffer_id, ranges.data(),
+                            static_cast<uint32_t>(ranges.size()));
+  }
+  writes->clear();
+}
+
+uint32_t RunCommandStream(TextureSubPluginAPI* api, const void* stream,
+                          uint64_t size) {
+  const uint8_t* const bytes = static_cast<const uint8_t*>(stream);
+  CommandStreamHeader header;
+  if (bytes == nullptr || size < sizeof(header) ||
+      reinterpret_cast<uintptr_t>(bytes) % 8 != 0) {
+    PLUGIN_LOG_ERROR("invalid command stream (%llu bytes)",
+                     static_cast<unsigned long long>(size));
+    return 0;
+  }
+  memcpy(&header, bytes, sizeof(header));
+  if (header.magic != kCommandStreamMagic ||
+      header.version != kCommandStreamVersion) {
+    PLUGIN_LOG_ERROR("unsupported command stream (magic: 0x%08x, version: %u)",
+                     header.magic, header.version);
+    return 0;
+  }
+  // every command takes at least a CommandHeader
+  if (header.command_count > (size - sizeof(header)) / sizeof(CommandHeader)) {
+    PLUGIN_LOG_ERROR("%u commands exceed the command stream (%llu bytes)",
+                     header.command_count,
+                     static_cast<unsigned long long>(size));
+    return 0;
+  }
+
+  // the whole stream is validated before anything is executed
+  std::vector<const uint8_t*> commands;
+  commands.reserve(header.command_count);
+  KnownExtents extents;
+  uint64_t offset = sizeof(header);
+  for (uint32_t i = 0; i < header.command_count; ++i) {
+    CommandHeader command;
+    if (size - offset < sizeof(command)) {
+      PLUGIN_LOG_ERROR("command %u exceeds the command stream", i);
+      return 0;
+    }
+    memcpy(&command, bytes + offset, sizeof(command));
+    if (command.size < sizeof(command) || command.size % 8 != 0 ||
+        command.size > size - offset ||
+        !ValidateCommand(api, bytes + offset, command, &extents)) {
+      PLUGIN_LOG_ERROR("invalid command %u (type: %u, size: %u)", i,
+                       command.type, command.size);
+      return 0;
+    }
+    commands.push_back(bytes + offset);
+    offset += command.size;
+  }
+
+  std::vector<PendingUpload> uploads;
+  std::vector<PendingWrite> writes;
+  uint32_t executed = 0;
+  for (const uint8_t* command : commands) {
+    CommandHeader command_header;
+    memcpy(&command_header, command, sizeof(command_header));
+    switch (command_header.type) {
+      case COMMAND_TEXTURE_SUB_IMAGE_3D: {
+        TextureSubImage3DCommand args;
+        memcpy(&args, command, sizeof(args));
+        PendingUpload upload{};
+        upload.texture_id = args.texture_id;
+        upload.format = static_cast<Format>(args.format);
+        upload.region = {args.xoffset,
+                         args.yoffset,
+                         args.zoffset,
+                         args.width,
+                         args.height,
+                         args.depth,
+                         CommandData(command, sizeof(args), args.data_ptr),
+                         nullptr,
+                         args.flags};
+        uploads.push_back(upload);
+        break;
+      }
+      case COMMAND_BUFFER_SUB_DATA: {
+        BufferSubDataCommand args;
+        memcpy(&args, command, sizeof(args));
+        writes.push_back(
+            {args.buffer_id,
+             {args.offset, args.size,
+              CommandData(command, sizeof(args), args.data_ptr)}});
+        break;
+      }
+      // creates and destroys may affect the resources of pending uploads
+      case COMMAND_CREATE_TEXTURE_3D: {
+        CreateTexture3DCommand args;
+        memcpy(&args, command, sizeof(args));
+        ExecuteGroup(api, &uploads, &writes);
+        api->CreateTexture3D(args.texture_id, args.width, args.height,
+                             args.depth, static_cast<Format>(args.format));
+        break;
+      }
+      case COMMAND_DESTROY_TEXTURE_3D: {
+        DestroyTexture3DCommand args;
+        memcpy(&args, command, sizeof(args));
+        ExecuteGroup(api, &uploads, &writes);
+        api->DestroyTexture3D(args.texture_id);
+        break;
+      }
+      case COMMAND_CREATE_BUFFER: {
+        CreateBufferCommand args;
+        memcpy(&args, command, sizeof(args));
+        ExecuteGroup(api, &uploads, &writes);
+        api->CreateBuffer(args.buffer_id, args.size);
+        break;
+      }
+      case COMMAND_DESTROY_BUFFER: {
+        DestroyBufferCommand args;
+        memcpy(&args, command, sizeof(args));
+        ExecuteGroup(api, &uploads, &writes);
+        api->DestroyBuffer(args.buffer_id);
+        break;
+      }
+      default:
+        PLUGIN_LOG_WARNING("skipped command of unknown type %u",
+                           command_header.type);
+        continue;
+    }
+    ++executed;
+  }
+  ExecuteGroup(api, &uploads, &writes);
+  return executed;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "TextureSubPluginAPI.hpp"
+
+// A command stream packs the operations of a frame into the data of a single
+// render event (the ExecuteCommandStream event). It starts with a
+// CommandStreamHeader followed by command_count commands. Each command
+// starts with a CommandHeader whose size covers the command and its inline
+// data, rounded up to a multiple of 8 bytes, so that decoders can skip
+// commands they do not know. All fields are little-endian and naturally
+// aligned (the stream itself has to be 8 byte aligned)
+
+// 'TSCS'
+static const uint32_t kCommandStreamMagic = 0x53435354;
+
+/// @brief Version of the stream layout this plugin writes and decodes.
+/// Streams of other versions are rejected
+static const uint16_t kCommandStreamVersion = 1;
+
+enum CommandType {
+  COMMAND_CREATE_TEXTURE_3D = 1,
+  COMMAND_DESTROY_TEXTURE_3D = 2,
+  // data is in the texture format (no SourceDescriptor)
+  COMMAND_TEXTURE_SUB_IMAGE_3D = 3,
+  COMMAND_CREATE_BUFFER = 4,
+  COMMAND_DESTROY_BUFFER = 5,
+  COMMAND_BUFFER_SUB_DATA = 6
+};
+
+struct CommandStreamHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t command_count;
+  uint32_t reserved2;
+};
+
+struct CommandHeader {
+  // a CommandType
+  uint16_t type;
+  uint16_t reserved;
+  // size of the command including this header and its inline data
+  uint32_t size;
+};
+
+struct CreateTexture3DCommand {
+  CommandHeader header;
+  uint32_t texture_id;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  int32_t format;
+  uint32_t reserved;
+};
+
+struct DestroyTexture3DCommand {
+  CommandHeader header;
+  uint32_t texture_id;
+  uint32_t reserved;
+};
+
+struct TextureSubImage3DCommand {
+  CommandHeader header;
+  uint32_t texture_id;
+  int32_t xoffset;
+  int32_t yoffset;
+  int32_t zoffset;
+  int32_t width;
+  int32_t height;
+  int32_t depth;
+  int32_t format;
+  // combination of UploadFlags
+  uint32_t flags;
+  uint32_t reserved;
+  // pointer to the region's data, or 0 if the data follows the command
+  // inline (a single texel for UPLOAD_FLAG_CONSTANT)
+  uint64_t data_ptr;
+};
+
+struct CreateBufferCommand {
+  CommandHeader header;
+  uint32_t buffer_id;
+  uint32_t reserved;
+  uint64_t size;
+};
+
+struct DestroyBufferCommand {
+  CommandHeader header;
+  uint32_t buffer_id;
+  uint32_t reserved;
+};
+
+struct BufferSubDataCommand {
+  CommandHeader header;
+  uint32_t buffer_id;
+  uint32_t reserved;
+  uint64_t offset;
+  uint64_t size;
+  // pointer to size bytes, or 0 if the data follows the command inline
+  uint64_t data_ptr;
+};
+
+static_assert(sizeof(CommandStreamHeader) == 16, "C# writes 16 bytes");
+static_assert(sizeof(CreateTexture3DCommand) == 32, "C# writes 32 bytes");
+static_assert(sizeof(DestroyTexture3DCommand) == 16, "C# writes 16 bytes");
+static_assert(sizeof(TextureSubImage3DCommand) == 56, "C# writes 56 bytes");
+static_assert(sizeof(CreateBufferCommand) == 24, "C# writes 24 bytes");
+static_assert(sizeof(DestroyBufferCommand) == 16, "C# writes 16 bytes");
+static_assert(sizeof(BufferSubDataCommand) == 40, "C# writes 40 bytes");
+
+/// @brief Validates a command stream and executes its commands in order.
+/// Consecutive uploads (and buffer writes) are grouped by resource and
+/// handed to the API as batches, so that their barriers are shared; creates
+/// and destroys end a group. A stream that fails validation (including
+/// uploads with negative offsets or that exceed their texture) is rejected as
+/// a whole, commands of unknown types are skipped. Render thread only
+/// @return number of commands that were executed
+uint32_t RunCommandStream(TextureSubPluginAPI* api, const void* stream,
+                          uint64_t size);
@@ -0,0 +1,1071 @@
+#include "ConversionKernels.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "ThreadPool.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define KERNELS_TARGET_AVX2
+#else
+#define KERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if KERNELS_X86
+static bool DetectAVX2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int regs[4];
+  __cpuid(regs, 0);
+  if (regs[0] < 7) return false;
+  __cpuid(regs, 1);
+  // OSXSAVE and AVX, then check that the OS saves the YMM registers
+  if ((regs[2] & (1 << 27)) == 0 || (regs[2] & (1 << 28)) == 0) return false;
+  if ((_xgetbv(0) & 0x6) != 0x6) return false;
+  __cpuidex(regs, 7, 0);
+  return (regs[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static const bool s_HasAVX2 = DetectAVX2();
+#endif  // #if KERNELS_X86
+
+// scalar kernels - also used for the tails of the SIMD kernels
+
+template <typename Dst>
+static void ConvertFloatToUnormScalar(const float* src, size_t count,
+                                      float scale, float bias, float max_value,
+                                      Dst* dst) {
+  for (size_t i = 0; i < count; ++i) {
+    float v = src[i] * scale + bias;
+    // written so that NaNs end up as 0
+    v = v > 0.0f ? v : 0.0f;
+    v = v < max_value ? v : max_value;
+    dst[i] = static_cast<Dst>(lrintf(v));
+  }
+}
+
+static void Unpack12Scalar(const uint8_t* src, size_t count, bool to_8bit,
+                           void* dst) {
+  uint8_t* dst8 = static_cast<uint8_t*>(dst);
+  uint16_t* dst16 = static_cast<uint16_t*>(dst);
+  for (size_t i = 0; i < count; ++i) {
+    const uint8_t* p = src + (i >> 1) * 3;
+    const uint16_t v = (i & 1) ? (p[1] >> 4) | (p[2] << 4)
+                               : p[0] | ((p[1] & 0x0F) << 8);
+    if (to_8bit)
+      dst8[i] = static_cast<uint8_t>(v >> 4);
+    else
+      dst16[i] = v;
+  }
+}
+
+static void ConvertFloatToHalfScalar(const float* src, size_t count,
+                                     uint16_t* dst) {
+  for (size_t i = 0; i < count; ++i) dst[i] = FloatToHalf(src[i]);
+}
+
+static void ByteSwap16Scalar(const uint16_t* src, size_t count,
+                             uint16_t* dst) {
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = static_cast<uint16_t>((src[i] >> 8) | (src[i] << 8));
+}
+
+template <typename T>
+static void InterleaveScalar(const void* const* channels, size_t channel_count,
+                             size_t count, void* dst) {
+  T* out = static_cast<T*>(dst);
+  for (size_t c = 0; c < channel_count; ++c) {
+    const T* channel = static_cast<const T*>(channels[c]);
+    for (size_t i = 0; i < count; ++i) out[i * channel_count + c] = channel[i];
+  }
+}
+
+template <typename T>
+static void MinMaxScalar(const T* texels, size_t count, uint32_t* min,
+                         uint32_t* max) {
+  uint32_t lo = *min, hi = *max;
+  for (size_t i = 0; i < count; ++i) {
+    lo = texels[i] < lo ? texels[i] : lo;
+    hi = texels[i] > hi ? texels[i] : hi;
+  }
+  *min = lo;
+  *max = hi;
+}
+
+#if KERNELS_X86
+
+KERNELS_TARGET_AVX2
+static size_t MinMax8AVX2(const uint8_t* texels, size_t count, uint32_t* min,
+                          uint32_t* max) {
+  if (count < 32) return 0;
+  __m256i lo = _mm256_set1_epi8(static_cast<char>(0xFF));
+  __m256i hi = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(texels + i));
+    lo = _mm256_min_epu8(lo, v);
+    hi = _mm256_max_epu8(hi, v);
+  }
+  alignas(32) uint8_t lanes[64];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), lo);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes + 32), hi);
+  MinMaxScalar(lanes, 32, min, max);
+  uint32_t ignored = 0xFFFFFFFF;
+  MinMaxScalar(lanes + 32, 32, &ignored, max);
+  return i;
+}
+
+KERNELS_TARGET_AVX2
+static size_t MinMax16AVX2(const uint16_t* texels, size_t count,
+                           uint32_t* min, uint32_t* max) {
+  if (count < 16) return 0;
+  __m256i lo = _mm256_set1_epi16(static_cast<short>(0xFFFF));
+  __m256i hi = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(texels + i));
+    lo = _mm256_min_epu16(lo, v);
+    hi = _mm256_max_epu16(hi, v);
+  }
+  alignas(32) uint16_t lanes[32];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), lo);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes + 16), hi);
+  MinMaxScalar(lanes, 16, min, max);
+  uint32_t ignored = 0xFFFFFFFF;
+  MinMaxScalar(lanes + 16, 16, &ignored, max);
+  return i;
+}
+
+KERNELS_TARGET_AVX2
+static bool IsConstantAVX2(const uint8_t* data, size_t bytes,
+                           const uint8_t* pattern, size_t* done) {
+  const __m256i p =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern));
+  size_t i = 0;
+  for (; i + 128 <= bytes; i += 128) {
+    const __m256i* v = reinterpret_cast<const __m256i*>(data + i);
+    __m256i eq = _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(v), p),
+                         _mm256_cmpeq_epi8(_mm256_loadu_si256(v + 1), p)),
+        _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(v + 2), p),
+                         _mm256_cmpeq_epi8(_mm256_loadu_si256(v + 3), p)));
+    if (_mm256_movemask_epi8(eq) != -1) return false;
+  }
+  *done = i;
+  return true;
+}
+
+KERNELS_TARGET_AVX2
+static __m256i ConvertFloat8AVX2(const float* src, __m256 scale, __m256 bias,
+                                 __m256 max_value) {
+  __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src), scale), bias);
+  // max_ps returns the second operand for NaNs
+  v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), max_value);
+  return _mm256_cvtps_epi32(v);
+}
+
+KERNELS_TARGET_AVX2
+static size_t ConvertFloatToUnorm8AVX2(const float* src, size_t count,
+                                       float scale, float bias, uint8_t* dst) {
+  const __m256 s = _mm256_set1_ps(scale);
+  const __m256 b = _mm256_set1_ps(bias);
+  const __m256 m = _mm256_set1_ps(255.0f);
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32) {
+    __m256i a = ConvertFloat8AVX2(src + i, s, b, m);
+    __m256i c = ConvertFloat8AVX2(src + i + 8, s, b, m);
+    __m256i d = ConvertFloat8AVX2(src + i + 16, s, b, m);
+    __m256i e = ConvertFloat8AVX2(src + i + 24, s, b, m);
+    // packing works per 128-bit lane, hence the final permutation
+    __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a, c),
+                                         _mm256_packs_epi32(d, e));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        _mm256_permutevar8x32_epi32(packed, order));
+  }
+  return i;
+}
+
+KERNELS_TARGET_AVX2
+static size_t ConvertFloatToUnorm16AVX2(const float* src, size_t count,
+                                        float scale, float bias,
+                                        uint16_t* dst) {
+  const __m256 s = _mm256_set1_ps(scale);
+  const __m256 b = _mm256_set1_ps(bias);
+  const __m256 m = _mm256_set1_ps(65535.0f);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i a = ConvertFloat8AVX2(src + i, s, b, m);
+    __m256i c = ConvertFloat8AVX2(src + i + 8, s, b, m);
+    __m256i packed = _mm256_packus_epi32(a, c);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        _mm256_permute4x64_epi64(packed, 0xD8));
+  }
+  return i;
+}
+
+KERNELS_TARGET_AVX2
+static size_t Unpack12AVX2(const uint8_t* src, size_t count, bool to_8bit,
+                           void* dst) {
+  // each 128-bit lane turns 12 source bytes into 8 values: even values are
+  // the low 12 bits of bytes (3k, 3k+1), odd values the high 12 bits of bytes
+  // (3k+1, 3k+2)
+  const __m256i shuffle = _mm256_setr_epi8(
+      0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11,  //
+      0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+  const __m256i mask = _mm256_set1_epi16(0x0FFF);
+  size_t i = 0;
+  // the second lane's 16 byte load reads 4 bytes past the 24 bytes consumed
+  // per iteration, so keep enough voxels (>= 3) for the tail
+  for (; i + 20 <= count; i += 16) {
+    const uint8_t* p = src + (i >> 1) * 3;
+    __m256i bytes = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+    __m256i words = _mm256_shuffle_epi8(bytes, shuffle);
+    __m256i v = _mm256_blend_epi16(_mm256_and_si256(words, mask),
+                                   _mm256_srli_epi16(words, 4), 0xAA);
+    if (to_8bit) {
+      __m256i packed = _mm256_packus_epi16(_mm256_srli_epi16(v, 4), v);
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(static_cast<uint8_t*>(dst) + i),
+          _mm256_castsi256_si128(_mm256_permute4x64_epi64(packed, 0xD8)));
+    } else {
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i*>(static_cast<uint16_t*>(dst) + i), v);
+    }
+  }
+  return i;
+}
+
+KERNELS_TARGET_AVX2
+static size_t ByteSwap16AVX2(const uint16_t* src, size_t count,
+                             uint16_t* dst) {
+  const __m256i shuffle = _mm256_setr_epi8(
+      1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,  //
+      1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        _mm256_shuffle_epi8(v, shuffle));
+  }
+  return i;
+}
+
+// interleaves 2 or 4 planar channels of 8-bit values (32 texels per iteration).
+// The unpack instructions work within 128-bit lanes, hence the final permutes
+KERNELS_TARGET_AVX2
+static size_t Interleave8AVX2(const void* const* channels, size_t channel_count,
+                              size_t count, uint8_t* dst) {
+  const uint8_t* a = static_cast<const uint8_t*>(channels[0]);
+  const uint8_t* b = static_cast<const uint8_t*>(channels[1]);
+  size_t i = 0;
+  if (channel_count == 2) {
+    for (; i + 32 <= count; i += 32) {
+      __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+      __m256i lo = _mm256_unpacklo_epi8(va, vb);
+      __m256i hi = _mm256_unpackhi_epi8(va, vb);
+      __m256i* out = reinterpret_cast<__m256i*>(dst + i * 2);
+      _mm256_storeu_si256(out, _mm256_permute2x128_si256(lo, hi, 0x20));
+      _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    return i;
+  }
+
+  const uint8_t* c = static_cast<const uint8_t*>(channels[2]);
+  const uint8_t* d = static_cast<const uint8_t*>(channels[3]);
+  for (; i + 32 <= count; i += 32) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    __m256i vc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c + i));
+    __m256i vd = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d + i));
+    __m256i ab_lo = _mm256_unpacklo_epi8(va, vb);
+    __m256i ab_hi = _mm256_unpackhi_epi8(va, vb);
+    __m256i cd_lo = _mm256_unpacklo_epi8(vc, vd);
+    __m256i cd_hi = _mm256_unpackhi_epi8(vc, vd);
+    __m256i x0 = _mm256_unpacklo_epi16(ab_lo, cd_lo);
+    __m256i x1 = _mm256_unpackhi_epi16(ab_lo, cd_lo);
+    __m256i x2 = _mm256_unpacklo_epi16(ab_hi, cd_hi);
+    __m256i x3 = _mm256_unpackhi_epi16(ab_hi, cd_hi);
+    __m256i* out = reinterpret_cast<__m256i*>(dst + i * 4);
+    _mm256_storeu_si256(out, _mm256_permute2x128_si256(x0, x1, 0x20));
+    _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(x2, x3, 0x20));
+    _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(x0, x1, 0x31));
+    _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(x2, x3, 0x31));
+  }
+  return i;
+}
+
+// interleaves 2 or 4 planar channels of 16-bit values (16 texels per
+// iteration)
+KERNELS_TARGET_AVX2
+static size_t Interleave16AVX2(const void* const* channels,
+                               size_t channel_count, size_t count,
+                               uint16_t* dst) {
+  const uint16_t* a = static_cast<const uint16_t*>(channels[0]);
+  const uint16_t* b = static_cast<const uint16_t*>(channels[1]);
+  size_t i = 0;
+  if (channel_count == 2) {
+    for (; i + 16 <= count; i += 16) {
+      __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+      __m256i lo = _mm256_unpacklo_epi16(va, vb);
+      __m256i hi = _mm256_unpackhi_epi16(va, vb);
+      __m256i* out = reinterpret_cast<__m256i*>(dst + i * 2);
+      _mm256_storeu_si256(out, _mm256_permute2x128_si256(lo, hi, 0x20));
+      _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    return i;
+  }
+
+  const uint16_t* c = static_cast<const uint16_t*>(channels[2]);
+  const uint16_t* d = static_cast<const uint16_t*>(channels[3]);
+  for (; i + 16 <= count; i += 16) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    __m256i vc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c + i));
+    __m256i vd = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d + i));
+    __m256i ab_lo = _mm256_unpacklo_epi16(va, vb);
+    __m256i ab_hi = _mm256_unpackhi_epi16(va, vb);
+    __m256i cd_lo = _mm256_unpacklo_epi16(vc, vd);
+    __m256i cd_hi = _mm256_unpackhi_epi16(vc, vd);
+    __m256i x0 = _mm256_unpacklo_epi32(ab_lo, cd_lo);
+    __m256i x1 = _mm256_unpackhi_epi32(ab_lo, cd_lo);
+    __m256i x2 = _mm256_unpacklo_epi32(ab_hi, cd_hi);
+    __m256i x3 = _mm256_unpackhi_epi32(ab_hi, cd_hi);
+    __m256i* out = reinterpret_cast<__m256i*>(dst + i * 4);
+    _mm256_storeu_si256(out, _mm256_permute2x128_si256(x0, x1, 0x20));
+    _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(x2, x3, 0x20));
+    _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(x0, x1, 0x31));
+    _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(x2, x3, 0x31));
+  }
+  return i;
+}
+
+// copies with non-temporal stores (128 bytes per iteration) once dst is 32
+// byte aligned. Returns the number of bytes copied
+KERNELS_TARGET_AVX2
+static size_t StreamCopyAVX2(uint8_t* dst, const uint8_t* src, size_t size) {
+  const size_t head = (32 - reinterpret_cast<uintptr_t>(dst) % 32) % 32;
+  if (size < head + 128) return 0;
+  memcpy(dst, src, head);
+  size_t i = head;
+  for (; i + 128 <= size; i += 128) {
+    const __m256i* in = reinterpret_cast<const __m256i*>(src + i);
+    __m256i a = _mm256_loadu_si256(in);
+    __m256i b = _mm256_loadu_si256(in + 1);
+    __m256i c = _mm256_loadu_si256(in + 2);
+    __m256i d = _mm256_loadu_si256(in + 3);
+    __m256i* out = reinterpret_cast<__m256i*>(dst + i);
+    _mm256_stream_si256(out, a);
+    _mm256_stream_si256(out + 1, b);
+    _mm256_stream_si256(out + 2, c);
+    _mm256_stream_si256(out + 3, d);
+  }
+  // streaming stores are weakly ordered
+  _mm_sfence();
+  return i;
+}
+
+#elif KERNELS_NEON
+
+static size_t Interleave8NEON(const void* const* channels,
+                              size_t channel_count, size_t count,
+                              uint8_t* dst) {
+  const uint8_t* const* in = reinterpret_cast<const uint8_t* const*>(channels);
+  size_t i = 0;
+  if (channel_count == 2) {
+    for (; i + 16 <= count; i += 16)
+      vst2q_u8(dst + i * 2, uint8x16x2_t{{vld1q_u8(in[0] + i),
+                                          vld1q_u8(in[1] + i)}});
+    return i;
+  }
+  for (; i + 16 <= count; i += 16)
+    vst4q_u8(dst + i * 4,
+             uint8x16x4_t{{vld1q_u8(in[0] + i), vld1q_u8(in[1] + i),
+                           vld1q_u8(in[2] + i), vld1q_u8(in[3] + i)}});
+  return i;
+}
+
+static size_t Interleave16NEON(const void* const* channels,
+                               size_t channel_count, size_t count,
+                               uint16_t* dst) {
+  const uint16_t* const* in =
+      reinterpret_cast<const uint16_t* const*>(channels);
+  size_t i = 0;
+  if (channel_count == 2) {
+    for (; i + 8 <= count; i += 8)
+      vst2q_u16(dst + i * 2, uint16x8x2_t{{vld1q_u16(in[0] + i),
+                                           vld1q_u16(in[1] + i)}});
+    return i;
+  }
+  for (; i + 8 <= count; i += 8)
+    vst4q_u16(dst + i * 4,
+              uint16x8x4_t{{vld1q_u16(in[0] + i), vld1q_u16(in[1] + i),
+                            vld1q_u16(in[2] + i), vld1q_u16(in[3] + i)}});
+  return i;
+}
+
+static size_t ConvertFloatToHalfNEON(const float* src, size_t count,
+                                     uint16_t* dst) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+  return i;
+}
+
+static uint32x4_t ConvertFloat4NEON(const float* src, float32x4_t scale,
+                                    float32x4_t bias, float32x4_t max_value) {
+  float32x4_t v = vmlaq_f32(bias, vld1q_f32(src), scale);
+  // the "nm" variants return the number if one of the operands is a NaN
+  v = vminnmq_f32(vmaxnmq_f32(v, vdupq_n_f32(0.0f)), max_value);
+  return vcvtnq_u32_f32(v);
+}
+
+static size_t ConvertFloatToUnorm8NEON(const float* src, size_t count,
+                                       float scale, float bias, uint8_t* dst) {
+  const float32x4_t s = vdupq_n_f32(scale);
+  const float32x4_t b = vdupq_n_f32(bias);
+  const float32x4_t m = vdupq_n_f32(255.0f);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    uint16x8_t lo =
+        vcombine_u16(vmovn_u32(ConvertFloat4NEON(src + i, s, b, m)),
+                     vmovn_u32(ConvertFloat4NEON(src + i + 4, s, b, m)));
+    uint16x8_t hi =
+        vcombine_u16(vmovn_u32(ConvertFloat4NEON(src + i + 8, s, b, m)),
+                     vmovn_u32(ConvertFloat4NEON(src + i + 12, s, b, m)));
+    vst1q_u8(dst + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+  }
+  return i;
+}
+
+static size_t ConvertFloatToUnorm16NEON(const float* src, size_t count,
+                                        float scale, float bias,
+                                        uint16_t* dst) {
+  const float32x4_t s = vdupq_n_f32(scale);
+  const float32x4_t b = vdupq_n_f32(bias);
+  const float32x4_t m = vdupq_n_f32(65535.0f);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    vst1q_u16(dst + i,
+              vcombine_u16(vmovn_u32(ConvertFloat4NEON(src + i, s, b, m)),
+                           vmovn_u32(ConvertFloat4NEON(src + i + 4, s, b, m))));
+  }
+  return i;
+}
+
+static size_t Unpack12NEON(const uint8_t* src, size_t count, bool to_8bit,
+                           void* dst) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    // deinterleaves 8 byte triplets (b0, b1, b2)
+    uint8x8x3_t b = vld3_u8(src + (i >> 1) * 3);
+    uint16x8_t mid = vmovl_u8(b.val[1]);
+    uint16x8x2_t v;
+    v.val[0] = vorrq_u16(vmovl_u8(b.val[0]),
+                         vshlq_n_u16(vandq_u16(mid, vdupq_n_u16(0x0F)), 8));
+    v.val[1] =
+        vorrq_u16(vshrq_n_u16(mid, 4), vshlq_n_u16(vmovl_u8(b.val[2]), 4));
+    if (to_8bit) {
+      uint8x8x2_t v8;
+      v8.val[0] = vshrn_n_u16(v.val[0], 4);
+      v8.val[1] = vshrn_n_u16(v.val[1], 4);
+      vst2_u8(static_cast<uint8_t*>(dst) + i, v8);
+    } else {
+      vst2q_u16(static_cast<uint16_t*>(dst) + i, v);
+    }
+  }
+  return i;
+}
+
+static size_t ByteSwap16NEON(const uint16_t* src, size_t count,
+                             uint16_t* dst) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(src + i));
+    vst1q_u8(reinterpret_cast<uint8_t*>(dst + i), vrev16q_u8(v));
+  }
+  return i;
+}
+
+static bool IsConstantNEON(const uint8_t* data, size_t bytes,
+                           const uint8_t* pattern, size_t* done) {
+  const uint8x16_t p = vld1q_u8(pattern);
+  size_t i = 0;
+  for (; i + 64 <= bytes; i += 64) {
+    uint8x16_t eq = vandq_u8(
+        vandq_u8(vceqq_u8(vld1q_u8(data + i), p),
+                 vceqq_u8(vld1q_u8(data + i + 16), p)),
+        vandq_u8(vceqq_u8(vld1q_u8(data + i + 32), p),
+                 vceqq_u8(vld1q_u8(data + i + 48), p)));
+    if (vminvq_u8(eq) != 0xFF) return false;
+  }
+  *done = i;
+  return true;
+}
+
+static size_t MinMax8NEON(const uint8_t* texels, size_t count, uint32_t* min,
+                          uint32_t* max) {
+  if (count < 16) return 0;
+  uint8x16_t lo = vdupq_n_u8(0xFF);
+  uint8x16_t hi = vdupq_n_u8(0);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    uint8x16_t v = vld1q_u8(texels + i);
+    lo = vminq_u8(lo, v);
+    hi = vmaxq_u8(hi, v);
+  }
+  const uint32_t lo_value = vminvq_u8(lo), hi_value = vmaxvq_u8(hi);
+  *min = lo_value < *min ? lo_value : *min;
+  *max = hi_value > *max ? hi_value : *max;
+  return i;
+}
+
+static size_t MinMax16NEON(const uint16_t* texels, size_t count,
+                           uint32_t* min, uint32_t* max) {
+  if (count < 8) return 0;
+  uint16x8_t lo = vdupq_n_u16(0xFFFF);
+  uint16x8_t hi = vdupq_n_u16(0);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t v = vld1q_u16(texels + i);
+    lo = vminq_u16(lo, v);
+    hi = vmaxq_u16(hi, v);
+  }
+  const uint32_t lo_value = vminvq_u16(lo), hi_value = vmaxvq_u16(hi);
+  *min = lo_value < *min ? lo_value : *min;
+  *max = hi_value > *max ? hi_value : *max;
+  return i;
+}
+
+// copies 64 bytes per iteration with STNP, the non-temporal store pair (not
+// exposed by the NEON intrinsics). Returns the number of bytes copied
+static size_t StreamCopyNEON(uint8_t* dst, const uint8_t* src, size_t size) {
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    uint8x16_t a = vld1q_u8(src + i);
+    uint8x16_t b = vld1q_u8(src + i + 16);
+    uint8x16_t c = vld1q_u8(src + i + 32);
+    uint8x16_t d = vld1q_u8(src + i + 48);
+    __asm__ volatile(
+        "stnp %q[a], %q[b], [%[out]]\n"
+        "stnp %q[c], %q[d], [%[out], #32]"
+        :
+        : [a] "w"(a), [b] "w"(b), [c] "w"(c), [d] "w"(d), [out] "r"(dst + i)
+        : "memory");
+  }
+  return i;
+}
+
+#endif  // #if KERNELS_X86
+
+void ConvertFloatToUnorm8(const float* src, size_t count, float lo, float hi,
+                          uint8_t* dst) {
+  const float scale = hi > lo ? 255.0f / (hi - lo) : 0.0f;
+  const float bias = -lo * scale;
+  size_t done = 0;
+#if KERNELS_X86
+  if (s_HasAVX2) done = ConvertFloatToUnorm8AVX2(src, count, scale, bias, dst);
+#elif KERNELS_NEON
+  done = ConvertFloatToUnorm8NEON(src, count, scale, bias, dst);
+#endif
+  ConvertFloatToUnormScalar(src + done, count - done, scale, bias, 255.0f,
+                            dst + done);
+}
+
+void ConvertFloatToUnorm16(const float* src, size_t count, float lo, float hi,
+                           uint16_t* dst) {
+  const float scale = hi > lo ? 65535.0f / (hi - lo) : 0.0f;
+  const float bias = -lo * scale;
+  size_t done = 0;
+#if KERNELS_X86
+  if (s_HasAVX2)
+    done = ConvertFloatToUnorm16AVX2(src, count, scale, bias, dst);
+#elif KERNELS_NEON
+  done = ConvertFloatToUnorm16NEON(src, count, scale, bias, dst);
+#endif
+  ConvertFloatToUnormScalar(src + done, count - done, scale, bias, 65535.0f,
+                            dst + done);
+}
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  const uint32_t abs = bits & 0x7FFFFFFF;
+  if (abs >= 0x7F800000)  // infinity or NaN (keeping NaNs quiet)
+    return sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 : 0);
+  if (abs >= 0x477FF000) return sign | 0x7C00;  // rounds beyond 65504
+  if (abs < 0x38800000) {
+    // subnormal half: align the mantissa (with implicit bit) to 2^-24 units
+    if (abs < 0x33000000) return sign;
+    const uint32_t shift = 126 - (abs >> 23);
+    const uint32_t mantissa = (abs & 0x7FFFFF) | 0x800000;
+    uint32_t half = mantissa >> shift;
+    const uint32_t rest = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+    return sign | static_cast<uint16_t>(half);
+  }
+  // rebias the exponent and round the mantissa to nearest even. A carry out of
+  // the mantissa correctly increments the exponent
+  const uint32_t rebiased = abs - 0x38000000;
+  const uint32_t round = 0xFFF + ((rebiased >> 13) & 1);
+  return sign | static_cast<uint16_t>((rebiased + round) >> 13);
+}
+
+float HalfToFloat(uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  const uint32_t exponent = (value >> 10) & 0x1F;
+  uint32_t mantissa = value & 0x3FF;
+  uint32_t bits;
+  if (exponent == 0x1F) {
+    bits = sign | 0x7F800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // subnormal half: normalize
+    uint32_t e = 113;
+    while ((mantissa & 0x400) == 0) {
+      mantissa <<= 1;
+      --e;
+    }
+    bits = sign | (e << 23) | ((mantissa & 0x3FF) << 13);
+  }
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+void ConvertFloatToHalf(const float* src, size_t count, uint16_t* dst) {
+  size_t done = 0;
+#if KERNELS_NEON
+  done = ConvertFloatToHalfNEON(src, count, dst);
+#endif
+  ConvertFloatToHalfScalar(src + done, count - done, dst + done);
+}
+
+void Unpack12(const uint8_t* src, size_t count, bool to_8bit, void* dst) {
+  size_t done = 0;
+#if KERNELS_X86
+  if (s_HasAVX2) done = Unpack12AVX2(src, count, to_8bit, dst);
+#elif KERNELS_NEON
+  done = Unpack12NEON(src, count, to_8bit, dst);
+#endif
+  // done is always even, so the tail starts at a triplet boundary
+  const size_t texel_size = to_8bit ? 1 : 2;
+  Unpack12Scalar(src + (done >> 1) * 3, count - done, to_8bit,
+                 static_cast<uint8_t*>(dst) + done * texel_size);
+}
+
+void ByteSwap16(const uint16_t* src, size_t count, uint16_t* dst) {
+  size_t done = 0;
+#if KERNELS_X86
+  if (s_HasAVX2) done = ByteSwap16AVX2(src, count, dst);
+#elif KERNELS_NEON
+  done = ByteSwap16NEON(src, count, dst);
+#endif
+  ByteSwap16Scalar(src + done, count - done, dst + done);
+}
+
+void InterleaveChannels(const void* const* channels, size_t channel_count,
+                        size_t channel_size, size_t count, void* dst) {
+  if (channel_count == 1) {
+    memcpy(dst, channels[0], count * channel_size);
+    return;
+  }
+
+  // the scalar kernel handles the tails by offsetting the channel pointers
+  size_t done = 0;
+  if (channel_count == 2 || channel_count == 4) {
+#if KERNELS_X86
+    if (s_HasAVX2 && channel_size == 1)
+      done = Interleave8AVX2(channels, channel_count, count,
+                             static_cast<uint8_t*>(dst));
+    else if (s_HasAVX2 && channel_size == 2)
+      done = Interleave16AVX2(channels, channel_count, count,
+                              static_cast<uint16_t*>(dst));
+#elif KERNELS_NEON
+    if (channel_size == 1)
+      done = Interleave8NEON(channels, channel_count, count,
+                             static_cast<uint8_t*>(dst));
+    else if (channel_size == 2)
+      done = Interleave16NEON(channels, channel_count, count,
+                              static_cast<uint16_t*>(dst));
+#endif
+  }
+
+  const void* tails[4];
+  for (size_t c = 0; c < channel_count && c < 4; ++c)
+    tails[c] = static_cast<const uint8_t*>(channels[c]) + done * channel_size;
+  void* tail_dst =
+      static_cast<uint8_t*>(dst) + done * channel_count * channel_size;
+  if (channel_size == 1)
+    InterleaveScalar<uint8_t>(tails, channel_count, count - done, tail_dst);
+  else if (channel_size == 2)
+    InterleaveScalar<uint16_t>(tails, channel_count, count - done, tail_dst);
+}
+
+size_t SourceSizeInBytes(const SourceDescriptor& source, Format format,
+                         size_t count) {
+  switch (source.encoding) {
+    case SOURCE_ENCODING_FLOAT32:
+      return count * sizeof(float);
+    case SOURCE_ENCODING_PACKED_12BIT:
+      return (count * 3 + 1) / 2;
+    case SOURCE_ENCODING_UINT16_BIG_ENDIAN:
+      return count * sizeof(uint16_t);
+    case SOURCE_ENCODING_PLANAR:
+      // per channel
+      return count * GetFormatTraits(format).channel_size;
+    default:
+      return count * FormatTexelSize(format);
+  }
+}
+
+bool ConvertSource(const SourceDescriptor& source, const void* src,
+                   size_t first, size_t count, Format dst_format, void* dst) {
+  if (source.encoding == SOURCE_ENCODING_PLANAR) {
+    const uint32_t channel_count = FormatChannelCount(dst_format);
+    const size_t channel_size = GetFormatTraits(dst_format).channel_size;
+    if (channel_count == 0) return false;
+    const void* const* planes = static_cast<const void* const*>(src);
+    const void* channels[4];
+    for (uint32_t c = 0; c < channel_count; ++c)
+      channels[c] =
+          static_cast<const uint8_t*>(planes[c]) + first * channel_size;
+    InterleaveChannels(channels, channel_count, channel_size, count, dst);
+    return true;
+  }
+
+  src = static_cast<const uint8_t*>(src) +
+        SourceSizeInBytes(source, dst_format, first);
+  const float lo = source.window_center - source.window_width * 0.5f;
+  const float hi = source.window_center + source.window_width * 0.5f;
+  switch (source.encoding) {
+    case SOURCE_ENCODING_FLOAT32:
+      if (dst_format == R8_UINT) {
+        ConvertFloatToUnorm8(static_cast<const float*>(src), count, lo, hi,
+                             static_cast<uint8_t*>(dst));
+        return true;
+      }
+      if (dst_format == R16_UINT) {
+        ConvertFloatToUnorm16(static_cast<const float*>(src), count, lo, hi,
+                              static_cast<uint16_t*>(dst));
+        return true;
+      }
+      // float formats keep the values (the window only applies to UNORM)
+      if (dst_format == R16_SFLOAT) {
+        ConvertFloatToHalf(static_cast<const float*>(src), count,
+                           static_cast<uint16_t*>(dst));
+        return true;
+      }
+      if (dst_format == R32_SFLOAT) {
+        memcpy(dst, src, count * sizeof(float));
+        return true;
+      }
+      return false;
+    case SOURCE_ENCODING_PACKED_12BIT:
+      if (dst_format != R8_UINT && dst_format != R16_UINT) return false;
+      Unpack12(static_cast<const uint8_t*>(src), count, dst_format == R8_UINT,
+               dst);
+      return true;
+    case SOURCE_ENCODING_UINT16_BIG_ENDIAN:
+      if (dst_format != R16_UINT) return false;
+      ByteSwap16(static_cast<const uint16_t*>(src), count,
+                 static_cast<uint16_t*>(dst));
+      return true;
+    default:
+      return false;
+  }
+}
+
+void AccumulateStatistics(const void* texels, size_t count, Format format,
+                          uint32_t* min, uint32_t* max, uint32_t* histogram,
+                          uint32_t bins) {
+  if (format == R8_UINT) {
+    const uint8_t* data = static_cast<const uint8_t*>(texels);
+    size_t done = 0;
+#if KERNELS_X86
+    if (s_HasAVX2) done = MinMax8AVX2(data, count, min, max);
+#elif KERNELS_NEON
+    done = MinMax8NEON(data, count, min, max);
+#endif
+    MinMaxScalar(data + done, count - done, min, max);
+    if (histogram)
+      for (size_t i = 0; i < count; ++i) ++histogram[(data[i] * bins) >> 8];
+  } else if (format == R16_UINT) {
+    const uint16_t* data = static_cast<const uint16_t*>(texels);
+    size_t done = 0;
+#if KERNELS_X86
+    if (s_HasAVX2) done = MinMax16AVX2(data, count, min, max);
+#elif KERNELS_NEON
+    done = MinMax16NEON(data, count, min, max);
+#endif
+    MinMaxScalar(data + done, count - done, min, max);
+    if (histogram)
+      for (size_t i = 0; i < count; ++i)
+        ++histogram[(static_cast<uint64_t>(data[i]) * bins) >> 16];
+  }
+}
+
+bool IsConstant(const void* data, size_t count, size_t element_size) {
+  if (count == 0) return false;
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  const size_t size = count * element_size;
+
+  // the first element repeated over 32 bytes (element sizes divide 32)
+  uint8_t pattern[32];
+  for (size_t i = 0; i < sizeof(pattern); ++i)
+    pattern[i] = bytes[i % element_size];
+
+  size_t done = 0;
+#if KERNELS_X86
+  if (s_HasAVX2 && !IsConstantAVX2(bytes, size, pattern, &done)) return false;
+#elif KERNELS_NEON
+  if (!IsConstantNEON(bytes, size, pattern, &done)) return false;
+#endif
+  // blocks start at multiples of 32 bytes, hence at element boundaries
+  for (size_t i = done; i < size; ++i)
+    if (bytes[i] != pattern[i % sizeof(pattern)]) return false;
+  return true;
+}
+
+bool IsStridedSource(const SourceDescriptor* source, uint32_t width,
+                     uint32_t height) {
+  return source && ((source->row_length && source->row_length != width) ||
+                    (source->image_height && source->image_height != height));
+}
+
+void CopyStrided(const void* src, size_t texel_size, uint32_t width,
+                 uint32_t height, uint32_t depth, uint32_t row_length,
+                 uint32_t image_height, void* dst) {
+  const size_t row_size = width * texel_size;
+  const size_t row_pitch = (row_length ? row_length : width) * texel_size;
+  const size_t slice_pitch = (image_height ? image_height : height) * row_pitch;
+  const uint8_t* in = static_cast<const uint8_t*>(src);
+  uint8_t* out = static_cast<uint8_t*>(dst);
+  for (uint32_t z = 0; z < depth; ++z)
+    for (uint32_t y = 0; y < height; ++y, out += row_size)
+      memcpy(out, in + z * slice_pitch + y * row_pitch, row_size);
+}
+
+bool PackStridedSource(const SourceDescriptor* source, uint32_t width,
+                       uint32_t height, uint32_t depth, Format format,
+                       void** data_ptr, std::vector<uint8_t>* packed) {
+  if (!IsStridedSource(source, width, height)) return true;
+  if (source->encoding != SOURCE_ENCODING_NATIVE) return false;
+  const size_t texel_size = FormatTexelSize(format);
+  packed->resize(static_cast<size_t>(width) * height * depth * texel_size);
+  CopyStrided(*data_ptr, texel_size, width, height, depth, source->row_length,
+              source->image_height, packed->data());
+  *data_ptr = packed->data();
+  return true;
+}
+
+// stacks (and reduced regions, counting the bytes they read, and stream
+// copies) smaller than this are processed on the calling thread, the pool's
+// synchronization would cost more than it saves
+static const size_t kParallelGatherBytes = 8 << 20;
+
+bool IsValidSliceStack(const SliceSource* slices, size_t row_size,
+                       uint32_t height, uint32_t depth) {
+  if (slices == nullptr || row_size == 0 || height == 0 || depth == 0)
+    return false;
+  for (uint32_t z = 0; z < depth; ++z)
+    if (slices[z].data_ptr == nullptr ||
+        (slices[z].row_pitch != 0 && slices[z].row_pitch < row_size))
+      return false;
+  return true;
+}
+
+void GatherSlices(const SliceSource* slices, size_t row_size, uint32_t height,
+                  uint32_t depth, void* dst) {
+  const size_t slice_size = row_size * height;
+  auto gather = [=](uint32_t z) {
+    const uint8_t* in = static_cast<const uint8_t*>(slices[z].data_ptr);
+    uint8_t* out = static_cast<uint8_t*>(dst) + z * slice_size;
+    const size_t row_pitch = slices[z].row_pitch;
+    if (row_pitch == 0 || row_pitch == row_size) {
+      memcpy(out, in, slice_size);
+      return;
+    }
+    for (uint32_t y = 0; y < height; ++y, out += row_size)
+      memcpy(out, in + y * row_pitch, row_size);
+  };
+  if (slice_size * depth < kParallelGatherBytes) {
+    for (uint32_t z = 0; z < depth; ++z) gather(z);
+    return;
+  }
+  ParallelFor(depth, gather);
+}
+
+double LoadChannel(const uint8_t* p, const FormatTraits& traits) {
+  switch (traits.channel_type) {
+    case CHANNEL_TYPE_UNORM:
+      if (traits.channel_size == 1) return *p;
+      uint16_t u16;
+      memcpy(&u16, p, sizeof(u16));
+      return u16;
+    case CHANNEL_TYPE_SNORM:
+      return static_cast<int8_t>(*p);
+    case CHANNEL_TYPE_SFLOAT:
+      if (traits.channel_size == 2) {
+        uint16_t half;
+        memcpy(&half, p, sizeof(half));
+        return HalfToFloat(half);
+      }
+      float f;
+      memcpy(&f, p, sizeof(f));
+      return f;
+  }
+  return 0.0;
+}
+
+void StoreChannel(uint8_t* p, const FormatTraits& traits, double value) {
+  switch (traits.channel_type) {
+    case CHANNEL_TYPE_UNORM:
+      if (traits.channel_size == 1) {
+        *p = static_cast<uint8_t>(std::min(255.0, floor(value + 0.5)));
+      } else {
+        const uint16_t u16 =
+            static_cast<uint16_t>(std::min(65535.0, floor(value + 0.5)));
+        memcpy(p, &u16, sizeof(u16));
+      }
+      break;
+    case CHANNEL_TYPE_SNORM:
+      *p = static_cast<uint8_t>(static_cast<int8_t>(
+          std::max(-128.0, std::min(127.0, floor(value + 0.5)))));
+      break;
+    case CHANNEL_TYPE_SFLOAT:
+      if (traits.channel_size == 2) {
+        const uint16_t half = FloatToHalf(static_cast<float>(value));
+        memcpy(p, &half, sizeof(half));
+      } else {
+        const float f = static_cast<float>(value);
+        memcpy(p, &f, sizeof(f));
+      }
+      break;
+  }
+}
+
+void ReduceVolumeRegion(const void* volume, const uint32_t extent[3],
+                        Format format, uint32_t level, bool box_filter,
+                        const uint32_t offset[3], const uint32_t region[3],
+                        void* dst) {
+  const FormatTraits traits = GetFormatTraits(format);
+  const uint8_t* const src = static_cast<const uint8_t*>(volume);
+  const size_t row = static_cast<size_t>(extent[0]) * traits.texel_size;
+  const size_t slice = row * extent[1];
+  const uint32_t cell = 1u << level;
+  // source voxels [first, last) that a reduced coordinate covers along an axis
+  auto range = [cell, level](uint32_t coord, uint32_t size, uint32_t* first,
+                             uint32_t* last) {
+    *first = coord << level;
+    *last = std::min(*first + cell, size);
+  };
+  auto reduce = [&](uint32_t z) {
+    uint8_t* out = static_cast<uint8_t*>(dst) +
+                   static_cast<size_t>(z) * region[1] * region[0] *
+                       traits.texel_size;
+    uint32_t z0, z1;
+    range(offset[2] + z, extent[2], &z0, &z1);
+    for (uint32_t y = 0; y < region[1]; ++y) {
+      uint32_t y0, y1;
+      range(offset[1] + y, extent[1], &y0, &y1);
+      for (uint32_t x = 0; x < region[0]; ++x, out += traits.texel_size) {
+        uint32_t x0, x1;
+        range(offset[0] + x, extent[0], &x0, &x1);
+        if (!box_filter) {
+          // the voxel closest to the center of the cell
+          const size_t center = std::min(z0 + cell / 2, z1 - 1) * slice +
+                                std::min(y0 + cell / 2, y1 - 1) * row +
+                                std::min(x0 + cell / 2, x1 - 1) *
+                                    static_cast<size_t>(traits.texel_size);
+          memcpy(out, src + center, traits.texel_size);
+          continue;
+        }
+        const double count =
+            static_cast<double>(z1 - z0) * (y1 - y0) * (x1 - x0);
+        for (uint32_t c = 0; c < traits.channel_count; ++c) {
+          const uint8_t* channel = src + c * traits.channel_size;
+          double sum = 0.0;
+          for (uint32_t zz = z0; zz < z1; ++zz)
+            for (uint32_t yy = y0; yy < y1; ++yy)
+              for (uint32_t xx = x0; xx < x1; ++xx)
+                sum += LoadChannel(channel + zz * slice + yy * row +
+                                       xx * static_cast<size_t>(
+                                                traits.texel_size),
+                                   traits);
+          StoreChannel(out + c * traits.channel_size, traits, sum / count);
+        }
+      }
+    }
+  };
+  const double read_size =
+      ldexp(static_cast<double>(region[0]) * region[1] * region[2] *
+                traits.texel_size,
+            box_filter ? 3 * level : 0);
+  if (read_size < kParallelGatherBytes) {
+    for (uint32_t z = 0; z < region[2]; ++z) reduce(z);
+    return;
+  }
+  ParallelFor(region[2], reduce);
+}
+
+// copies that are too small to amortize the alignment head
+static const size_t kMinStreamCopyBytes = 4096;
+// minimum number of bytes per thread of a parallel stream copy
+static const size_t kStreamCopyChunkBytes = 1 << 20;
+
+static void StreamCopyRange(uint8_t* dst, const uint8_t* src, size_t size) {
+  size_t done = 0;
+  if (size >= kMinStreamCopyBytes) {
+#if KERNELS_X86
+    if (s_HasAVX2) done = StreamCopyAVX2(dst, src, size);
+#elif KERNELS_NEON
+    done = StreamCopyNEON(dst, src, size);
+#endif
+  }
+  memcpy(dst + done, src + done, size - done);
+}
+
+void StreamCopy(void* dst, const void* src, size_t size) {
+  uint8_t* const out = static_cast<uint8_t*>(dst);
+  const uint8_t* const in = static_cast<const uint8_t*>(src);
+  if (size < kParallelGatherBytes) {
+    StreamCopyRange(out, in, size);
+    return;
+  }
+  // one contiguous range per thread, a multiple of 64 bytes so that threads
+  // never share a cache line
+  const uint32_t count = static_cast<uint32_t>(std::min<size_t>(
+      ParallelThreadCount(), size / kStreamCopyChunkBytes));
+  const size_t range = (size / count + 63) & ~static_cast<size_t>(63);
+  ParallelFor(count, [=](uint32_t i) {
+    const size_t first = std::min(size, i * range);
+    const size_t last = i + 1 == count ? size : std::min(size, first + range);
+    StreamCopyRange(out + first, in + first, last - first);
+  });
+}
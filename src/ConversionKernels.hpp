@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "TextureSubPluginAPI.hpp"
+
+/// @brief Returns the number of bytes count voxels occupy in the given source
+/// encoding (format is used for SOURCE_ENCODING_NATIVE, planar sources return
+/// the size of a single channel)
+size_t SourceSizeInBytes(const SourceDescriptor& source, Format format,
+                         size_t count);
+
+/// @brief Converts count voxels from the source encoding into the texture
+/// format in a single pass over memory (uses AVX2/NEON kernels if available)
+/// @param[in] source source data encoding (and window for float sources)
+/// @param[in] src pointer to the source data (to the array of channel pointers
+/// for SOURCE_ENCODING_PLANAR)
+/// @param[in] first index of the first voxel to convert (must be even for
+/// packed 12-bit sources)
+/// @param[in] count number of voxels to convert
+/// @param[in] dst_format texture format to convert to
+/// @param[out] dst destination (typically mapped staging memory)
+/// @return false if the conversion is not supported
+bool ConvertSource(const SourceDescriptor& source, const void* src,
+                   size_t first, size_t count, Format dst_format, void* dst);
+
+/// @brief Maps [lo, hi] linearly to [0, 255] (clamped, rounded to nearest)
+void ConvertFloatToUnorm8(const float* src, size_t count, float lo, float hi,
+                          uint8_t* dst);
+
+/// @brief Maps [lo, hi] linearly to [0, 65535] (clamped, rounded to nearest)
+void ConvertFloatToUnorm16(const float* src, size_t count, float lo, float hi,
+                           uint16_t* dst);
+
+/// @brief Unpacks little-endian 12-bit values (two values per three bytes)
+/// into 16-bit values. If to_8bit is set, only the 8 most significant bits are
+/// kept
+void Unpack12(const uint8_t* src, size_t count, bool to_8bit, void* dst);
+
+/// @brief Converts floats to IEEE half floats (round to nearest even, values
+/// beyond the half range become infinity)
+void ConvertFloatToHalf(const float* src, size_t count, uint16_t* dst);
+
+/// @brief Converts a single float to an IEEE half float
+uint16_t FloatToHalf(float value);
+
+/// @brief Converts a single IEEE half float to a float
+float HalfToFloat(uint16_t value);
+
+/// @brief Interleaves count texels of channel_count planar channels of
+/// channel_size (1 or 2) bytes each
+void InterleaveChannels(const void* const* channels, size_t channel_count,
+                        size_t channel_size, size_t count, void* dst);
+
+/// @brief Swaps the bytes of each 16-bit value (big-endian <-> little-endian)
+void ByteSwap16(const uint16_t* src, size_t count, uint16_t* dst);
+
+/// @brief Updates min/max and histogram (bins entries spanning the format's
+/// value range, may be nullptr) with count single-channel texels
+void AccumulateStatistics(const void* texels, size_t count, Format format,
+                          uint32_t* min, uint32_t* max, uint32_t* histogram,
+                          uint32_t bins);
+
+/// @brief Returns true if source describes a region whose rows or slices are
+/// not tightly packed (see SourceDescriptor::row_length)
+bool IsStridedSource(const SourceDescriptor* source, uint32_t width,
+                     uint32_t height);
+
+/// @brief Copies a region with the given strides (in texels, see
+/// SourceDescriptor::row_length) into tightly packed memory
+void CopyStrided(const void* src, size_t texel_size, uint32_t width,
+                 uint32_t height, uint32_t depth, uint32_t row_length,
+                 uint32_t image_height, void* dst);
+
+/// @brief Packs a strided source region into packed and points data_ptr to
+/// it. Does nothing for regions that are tightly packed already
+/// @return false if the source is strided but not SOURCE_ENCODING_NATIVE
+bool PackStridedSource(const SourceDescriptor* source, uint32_t width,
+                       uint32_t height, uint32_t depth, Format format,
+                       void** data_ptr, std::vector<uint8_t>* packed);
+
+/// @brief Returns true if slices describes depth slices of at least height
+/// rows of row_size bytes each
+bool IsValidSliceStack(const SliceSource* slices, size_t row_size,
+                       uint32_t height, uint32_t depth);
+
+/// @brief Gathers depth slices of height rows of row_size bytes into tightly
+/// packed memory. Large stacks are copied in parallel across slices
+void GatherSlices(const SliceSource* slices, size_t row_size, uint32_t height,
+                  uint32_t depth, void* dst);
+
+/// @brief Loads a channel of a texel as a value in the format's range (e.g.,
+/// [0, 255] for 8-bit UNORM, [-128, 127] for SNORM)
+double LoadChannel(const uint8_t* p, const FormatTraits& traits);
+
+/// @brief Stores a value in the format's range into a channel of a texel
+/// (rounded and clamped for UNORM/SNORM)
+void StoreChannel(uint8_t* p, const FormatTraits& traits, double value);
+
+/// @brief Computes region texels (x-fastest, tightly packed) of a volume
+/// reduced by 2^level along each axis, starting at offset in reduced
+/// coordinates. Each texel either takes the source voxel closest to the
+/// center of its 2^level cell (reads region texels) or, if box_filter is
+/// set, averages the cell's voxels (reads 8^level times as many). Cells at
+/// the border only cover voxels inside of the volume. Large regions are
+/// reduced in parallel across slices
+void ReduceVolumeRegion(const void* volume, const uint32_t extent[3],
+                        Format format, uint32_t level, bool box_filter,
+                        const uint32_t offset[3], const uint32_t region[3],
+                        void* dst);
+
+/// @brief Copies size bytes into memory that is only written by the CPU,
+/// like mapped staging memory (which is usually write-combined). Uses
+/// non-temporal stores (AVX2/NEON if available), which do not pull dst into
+/// the cache, and splits copies of 8 MB or more across the thread pool
+void StreamCopy(void* dst, const void* src, size_t size);
+
+/// @brief Checks whether all count elements of element_size (1, 2 or 4) bytes
+/// are equal. Returns early on the first differing block, so non-constant data
+/// is usually rejected after the first few cache lines
+bool IsConstant(const void* data, size_t count, size_t element_size);
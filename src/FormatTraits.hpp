@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Encoding of the channels of a texture format
+enum ChannelType {
+  CHANNEL_TYPE_UNORM = 0,
+  CHANNEL_TYPE_SNORM = 1,
+  CHANNEL_TYPE_SFLOAT = 2
+};
+
+// All texture formats. A new format only has to be appended here (and to the
+// C# Format enum) - the position in the table is its value. Columns:
+// apply(name, channel count, channel size in bytes, channel type, VkFormat,
+//       DXGI_FORMAT, GL internal format, GL format, GL type)
+// The API specific columns are only expanded by the corresponding backends
+#define TEXTURE_FORMATS(apply)                                                 \
+  apply(R8_UINT, 1, 1, UNORM, VK_FORMAT_R8_UNORM, DXGI_FORMAT_R8_UNORM, GL_R8, \
+        GL_RED, GL_UNSIGNED_BYTE)                                              \
+  apply(R16_UINT, 1, 2, UNORM, VK_FORMAT_R16_UNORM, DXGI_FORMAT_R16_UNORM,     \
+        GL_R16, GL_RED, GL_UNSIGNED_SHORT)                                     \
+  apply(RG8_UINT, 2, 1, UNORM, VK_FORMAT_R8G8_UNORM, DXGI_FORMAT_R8G8_UNORM,   \
+        GL_RG8, GL_RG, GL_UNSIGNED_BYTE)                                       \
+  apply(RG16_UINT, 2, 2, UNORM, VK_FORMAT_R16G16_UNORM,                        \
+        DXGI_FORMAT_R16G16_UNORM, GL_RG16, GL_RG, GL_UNSIGNED_SHORT)           \
+  apply(RGBA8_UINT, 4, 1, UNORM, VK_FORMAT_R8G8B8A8_UNORM,                     \
+        DXGI_FORMAT_R8G8B8A8_UNORM, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE)       \
+  apply(RGBA16_UINT, 4, 2, UNORM, VK_FORMAT_R16G16B16A16_UNORM,                \
+        DXGI_FORMAT_R16G16B16A16_UNORM, GL_RGBA16, GL_RGBA,                    \
+        GL_UNSIGNED_SHORT)                                                     \
+  apply(R16_SFLOAT, 1, 2, SFLOAT, VK_FORMAT_R16_SFLOAT,                        \
+        DXGI_FORMAT_R16_FLOAT, GL_R16F, GL_RED, GL_HALF_FLOAT)                 \
+  apply(R32_SFLOAT, 1, 4, SFLOAT, VK_FORMAT_R32_SFLOAT,                        \
+        DXGI_FORMAT_R32_FLOAT, GL_R32F, GL_RED, GL_FLOAT)                      \
+  apply(R8_SNORM, 1, 1, SNORM, VK_FORMAT_R8_SNORM, DXGI_FORMAT_R8_SNORM,       \
+        GL_R8_SNORM, GL_RED, GL_BYTE)
+
+#define FORMAT_ENUM_ENTRY(name, ...) name,
+enum Format { TEXTURE_FORMATS(FORMAT_ENUM_ENTRY) FORMAT_COUNT };
+#undef FORMAT_ENUM_ENTRY
+
+struct FormatTraits {
+  uint32_t texel_size;
+  uint32_t channel_count;
+  uint32_t channel_size;
+  ChannelType channel_type;
+};
+
+#define FORMAT_TRAITS_ENTRY(name, channels, size, type, ...) \
+  {(channels) * (size), channels, size, CHANNEL_TYPE_##type},
+constexpr FormatTraits kFormatTraits[FORMAT_COUNT] = {
+    TEXTURE_FORMATS(FORMAT_TRAITS_ENTRY)};
+#undef FORMAT_TRAITS_ENTRY
+
+constexpr bool IsValidFormat(Format format) {
+  return static_cast<uint32_t>(format) < FORMAT_COUNT;
+}
+
+/// @brief Returns the traits of a format (all zero if the format is unknown)
+constexpr FormatTraits GetFormatTraits(Format format) {
+  return IsValidFormat(format) ? kFormatTraits[format]
+                               : FormatTraits{0, 0, 0, CHANNEL_TYPE_UNORM};
+}
+
+/// @brief Returns the size of a texel of the given format in bytes (0 if the
+/// format is unknown)
+constexpr size_t FormatTexelSize(Format format) {
+  return GetFormatTraits(format).texel_size;
+}
+
+/// @brief Returns the number of channels of the given format
+constexpr uint32_t FormatChannelCount(Format format) {
+  return GetFormatTraits(format).channel_count;
+}
+
+static_assert(FormatTexelSize(RGBA16_UINT) == 8, "inconsistent format table");
+static_assert(FormatTexelSize(static_cast<Format>(FORMAT_COUNT)) == 0,
+              "unknown formats have no traits");
@@ -0,0 +1,29 @@
+#pragma once
+
+/// @brief IDs of the events that are issued from C# using
+/// CommandBuffer.IssuePluginEventAndData (have to match TextureSubPlugin.cs)
+enum class Event : int {
+  TextureSubImage2D = 0,
+  TextureSubImage3D = 1,
+  CreateTexture3D = 2,
+  DestroyTexture3D = 3,
+  TextureSubImage3DByID = 4,
+  UploadBrickStatisticsTexture = 5,
+  ReadbackTexture3D = 6,
+  ProcessReadbacks = 7,
+  CopyTexture3DRegions = 8,
+  DefragmentTexture3D = 9,
+  BenchmarkUploadPaths = 10,
+  CreateBuffer = 11,
+  DestroyBuffer = 12,
+  BufferSubData = 13,
+  UnregisterHostMemory = 14,
+  ComputeGradients = 15,
+  TextureSubImage3DBitpacked = 16,
+  UpdatePlayback = 17,
+  DestroyPlayback = 18,
+  ExecuteCommandStream = 19,
+  TextureSubImage3DSlices = 20,
+  UpdateProgressive = 21,
+  DestroyProgressive = 22
+};
@@ -0,0 +1,233 @@
+#include "PluginLog.hpp"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Tracing.hpp"
+
+// messages that can wait for the flusher (~16 KB)
+static const uint32_t kLogRingCapacity = 64;
+
+// how often the flusher wakes up
+static const std::chrono::milliseconds kLogFlushInterval(100);
+
+// bounded multi-producer single-consumer ring. In lap L (position /
+// kLogRingCapacity) a slot's sequence is 2L while it is free and 2L + 1 once
+// a producer published its message, so the zero initialized ring is ready
+// without setup and producers claim positions with a single
+// compare-and-swap, never waiting for each other
+struct LogSlot {
+  std::atomic<uint64_t> sequence;
+  LogSite* site;
+  char text[kLogMessageSize];
+};
+
+static LogSlot s_Ring[kLogRingCapacity];
+static std::atomic<uint64_t> s_Head(0);
+static uint64_t s_Tail = 0;  // flusher only
+
+static std::atomic<LogSite*> s_Sites(nullptr);
+static std::atomic<uint64_t> s_Messages(0);
+static std::atomic<uint64_t> s_Lines(0);
+static std::atomic<uint64_t> s_Dropped(0);
+// error messages logged by the calling thread (including suppressed ones)
+static thread_local uint64_t s_ThreadErrors = 0;
+
+static IUnityLog* s_Log = nullptr;
+static std::mutex s_FlusherMutex;
+static std::condition_variable s_FlusherWakeup;
+static bool s_FlusherStop = false;
+static std::thread s_Flusher;
+
+static void RegisterSite(LogSite* site, const char* format) {
+  // every message of a site has the same format
+  site->format.store(format, std::memory_order_relaxed);
+  bool expected = false;
+  if (!site->registered.compare_exchange_strong(expected, true)) return;
+  LogSite* head = s_Sites.load(std::memory_order_relaxed);
+  do {
+    site->next.store(head, std::memory_order_relaxed);
+  } while (!s_Sites.compare_exchange_weak(head, site,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
+}
+
+// claims a slot, or returns nullptr if the ring is full
+static LogSlot* ClaimSlot(uint64_t* position) {
+  uint64_t head = s_Head.load(std::memory_order_relaxed);
+  for (;;) {
+    LogSlot* slot = &s_Ring[head % kLogRingCapacity];
+    const uint64_t free = 2 * (head / kLogRingCapacity);
+    const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    // the slot still holds a message of the previous lap
+    if (sequence < free) return nullptr;
+    if (sequence == free &&
+        s_Head.compare_exchange_weak(head, head + 1,
+                                     std::memory_order_relaxed)) {
+      *position = head;
+      return slot;
+    }
+    if (sequence > free) head = s_Head.load(std::memory_order_relaxed);
+  }
+}
+
+void PluginLog(LogSite* site, const char* format, ...) {
+  if (!site->registered.load(std::memory_order_acquire))
+    RegisterSite(site, format);
+  if (site->type == kUnityLogTypeError) ++s_ThreadErrors;
+  s_Messages.fetch_add(1, std::memory_order_relaxed);
+  site->count.fetch_add(1, std::memory_order_relaxed);
+
+  // a repeated message costs a few atomic operations
+  const int64_t now = TraceNow();
+  int64_t next_line = site->next_line.load(std::memory_order_relaxed);
+  if (now < next_line ||
+      !site->next_line.compare_exchange_strong(next_line, now + kLogInterval,
+                                               std::memory_order_relaxed)) {
+    site->suppressed.fetch_add(1, std::memory_order_relaxed);
+    site->pending.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  uint64_t position;
+  LogSlot* slot = ClaimSlot(&position);
+  if (!slot) {
+    site->suppressed.fetch_add(1, std::memory_order_relaxed);
+    site->pending.fetch_add(1, std::memory_order_relaxed);
+    s_Dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  slot->site = site;
+  int length = snprintf(slot->text, kLogMessageSize, "%s ", site->function);
+  va_list args;
+  va_start(args, format);
+  if (length >= 0 && static_cast<uint32_t>(length) < kLogMessageSize)
+    vsnprintf(slot->text + length, kLogMessageSize - length, format, args);
+  va_end(args);
+  // the messages suppressed since the last line are reported with this one
+  const uint64_t pending = site->pending.exchange(0, std::memory_order_relaxed);
+  length = static_cast<int>(strnlen(slot->text, kLogMessageSize - 1));
+  if (pending != 0)
+    snprintf(slot->text + length, kLogMessageSize - length,
+             " (%llu similar messages suppressed)",
+             static_cast<unsigned long long>(pending));
+  slot->sequence.store(2 * (position / kLogRingCapacity) + 1,
+                       std::memory_order_release);
+}
+
+uint64_t GetThreadErrorCount() { return s_ThreadErrors; }
+
+static void Emit(UnityLogType type, const char* text, const LogSite* site) {
+  s_Lines.fetch_add(1, std::memory_order_relaxed);
+  if (s_Log) s_Log->Log(type, text, site->file, site->line);
+}
+
+// forwards the published messages and reports the call sites whose
+// messages were suppressed since their last line once their interval ended
+// (or all of them if final)
+static void Flush(bool final) {
+  for (;;) {
+    LogSlot* slot = &s_Ring[s_Tail % kLogRingCapacity];
+    const uint64_t lap = s_Tail / kLogRingCapacity;
+    if (slot->sequence.load(std::memory_order_acquire) != 2 * lap + 1) break;
+    Emit(slot->site->type, slot->text, slot->site);
+    slot->sequence.store(2 * (lap + 1), std::memory_order_release);
+    ++s_Tail;
+  }
+
+  const int64_t now = TraceNow();
+  for (LogSite* site = s_Sites.load(std::memory_order_acquire); site;
+       site = site->next.load(std::memory_order_relaxed)) {
+    if (site->pending.load(std::memory_order_relaxed) == 0 ||
+        (!final && now < site->next_line.load(std::memory_order_relaxed)))
+      continue;
+    const uint64_t pending =
+        site->pending.exchange(0, std::memory_order_relaxed);
+    if (pending == 0) continue;
+    char text[kLogMessageSize];
+    snprintf(text, sizeof(text), "%s %llu similar messages suppressed: %s",
+             site->function, static_cast<unsigned long long>(pending),
+             site->format.load(std::memory_order_relaxed));
+    Emit(site->type, text, site);
+  }
+}
+
+static void FlusherLoop() {
+  std::unique_lock<std::mutex> lock(s_FlusherMutex);
+  while (!s_FlusherStop) {
+    s_FlusherWakeup.wait_for(lock, kLogFlushInterval);
+    Flush(false);
+  }
+}
+
+void StartPluginLog(IUnityLog* log) {
+  std::lock_guard<std::mutex> lock(s_FlusherMutex);
+  s_Log = log;
+  if (s_Flusher.joinable()) return;
+  s_FlusherStop = false;
+  s_Flusher = std::thread(FlusherLoop);
+}
+
+static void StopFlusher() {
+  {
+    std::lock_guard<std::mutex> lock(s_FlusherMutex);
+    s_FlusherStop = true;
+  }
+  s_FlusherWakeup.notify_all();
+  if (s_Flusher.joinable()) s_Flusher.join();
+}
+
+void StopPluginLog() {
+  StopFlusher();
+  std::lock_guard<std::mutex> lock(s_FlusherMutex);
+  Flush(true);
+  s_Log = nullptr;
+}
+
+// destroying a joinable std::thread terminates the process, so the flusher
+// is stopped at static destruction if StopPluginLog was not called (e.g., the
+// process exits without unloading the plugin). Unity's log may be gone by
+// then, hence the remaining messages are discarded. Defined after the state
+// the flusher uses so that it is destroyed first
+static struct FlusherGuard {
+  ~FlusherGuard() {
+    {
+      std::lock_guard<std::mutex> lock(s_FlusherMutex);
+      s_Log = nullptr;
+    }
+    StopFlusher();
+  }
+} s_FlusherGuard;
+
+LogCounters GetPluginLogCounters() {
+  LogCounters counters{};
+  counters.messages = s_Messages.load(std::memory_order_relaxed);
+  counters.lines = s_Lines.load(std::memory_order_relaxed);
+  counters.dropped = s_Dropped.load(std::memory_order_relaxed);
+  for (LogSite* site = s_Sites.load(std::memory_order_acquire); site;
+       site = site->next.load(std::memory_order_relaxed))
+    counters.suppressed += site->suppressed.load(std::memory_order_relaxed);
+  return counters;
+}
+
+uint32_t GetPluginLogMessageStats(LogMessageStats* stats, uint32_t max_stats) {
+  uint32_t count = 0;
+  for (LogSite* site = s_Sites.load(std::memory_order_acquire); site;
+       site = site->next.load(std::memory_order_relaxed), ++count) {
+    if (stats == nullptr || count >= max_stats) continue;
+    LogMessageStats& entry = stats[count];
+    entry.function = site->function;
+    entry.format = site->format.load(std::memory_order_relaxed);
+    entry.type = site->type;
+    entry.reserved = 0;
+    entry.count = site->count.load(std::memory_order_relaxed);
+    entry.suppressed = site->suppressed.load(std::memory_order_relaxed);
+  }
+  return count;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "IUnityLog.h"
+
+// Allocation-free logging. Messages are formatted into fixed-size slots of a
+// lock-free ring and forwarded to IUnityLog by a flusher thread, so logging
+// costs neither heap allocations nor calls into Unity on the thread that
+// logs. Every PLUGIN_LOG_* call site is a message ID of its own: it emits at
+// most one line per kLogInterval, the messages in between are only counted
+// and reported in a single line
+
+/// @brief Maximum length of a message (longer messages are truncated)
+static const uint32_t kLogMessageSize = 256;
+
+/// @brief Minimum time between two lines of the same call site
+static const int64_t kLogInterval = 1000000000;  // ns
+
+/// @brief A call site of PLUGIN_LOG_* (constant initialized, registered on
+/// its first message)
+struct LogSite {
+  constexpr LogSite(UnityLogType type, const char* function, const char* file,
+                    int line)
+      : type(type), function(function), file(file), line(line) {}
+
+  const UnityLogType type;
+  const char* const function;
+  const char* const file;
+  const int line;
+  std::atomic<const char*> format{nullptr};
+  std::atomic<LogSite*> next{nullptr};
+  std::atomic<bool> registered{false};
+  // messages logged, messages that were not emitted (rate limited or the
+  // ring was full) and messages not reported yet
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> suppressed{0};
+  std::atomic<uint64_t> pending{0};
+  // earliest time the next line may be emitted (see TraceNow)
+  std::atomic<int64_t> next_line{0};
+};
+
+struct LogCounters {
+  uint64_t messages;
+  // lines forwarded to IUnityLog (including the lines that report
+  // suppressed messages)
+  uint64_t lines;
+  uint64_t suppressed;
+  // messages lost because the ring was full (included in suppressed)
+  uint64_t dropped;
+};
+
+struct LogMessageStats {
+  const char* function;
+  // printf format of the message
+  const char* format;
+  UnityLogType type;
+  uint32_t reserved;
+  uint64_t count;
+  uint64_t suppressed;
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PLUGIN_LOG_PRINTF(FORMAT_INDEX_, FIRST_ARG_) \
+  __attribute__((format(printf, FORMAT_INDEX_, FIRST_ARG_)))
+#else
+#define PLUGIN_LOG_PRINTF(FORMAT_INDEX_, FIRST_ARG_)
+#endif
+
+/// @brief Logs a printf formatted message of a call site. Use the
+/// PLUGIN_LOG_* macros instead. Any thread
+void PluginLog(LogSite* site, const char* format, ...)
+    PLUGIN_LOG_PRINTF(2, 3);
+
+/// @brief Starts the flusher thread. Messages logged before are kept until
+/// it runs
+void StartPluginLog(IUnityLog* log);
+
+/// @brief Forwards the remaining messages and stops the flusher thread
+void StopPluginLog();
+
+/// @brief Any thread
+LogCounters GetPluginLogCounters();
+
+/// @brief Number of errors the calling thread has logged (including
+/// suppressed ones), e.g., to detect whether an operation failed
+uint64_t GetThreadErrorCount();
+
+/// @brief Fills stats with the call sites that logged (in no particular
+/// order)
+/// @return number of call sites that logged (may exceed max_stats)
+uint32_t GetPluginLogMessageStats(LogMessageStats* stats, uint32_t max_stats);
+
+// the message is prefixed with the name of the calling function
+#define PLUGIN_LOG_IMPL(TYPE_, ...)                                     \
+  do {                                                                  \
+    static LogSite s_log_site(TYPE_, __FUNCTION__, __FILE__, __LINE__); \
+    PluginLog(&s_log_site, __VA_ARGS__);                                \
+  } while (0)
+
+#define PLUGIN_LOG(...) PLUGIN_LOG_IMPL(kUnityLogTypeLog, __VA_ARGS__)
+#define PLUGIN_LOG_WARNING(...) \
+  PLUGIN_LOG_IMPL(kUnityLogTypeWarning, __VA_ARGS__)
+#define PLUGIN_LOG_ERROR(...) PLUGIN_LOG_IMPL(kUnityLogTypeError, __VA_ARGS__)
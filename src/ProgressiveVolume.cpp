@@ -0,0 +1,197 @@
+#include "ProgressiveVolume.hpp"
+
+#include <algorithm>
+
+#include "ConversionKernels.hpp"
+#include "Tracing.hpp"
+
+// Number of updates after which a retired front texture is destroyed or
+// written again (scripts may still bind it for a frame, see VolumePlayback)
+static const uint64_t kRetiredUpdates = 2;
+
+static uint32_t ReducedExtent(uint32_t extent, uint32_t level) {
+  return static_cast<uint32_t>(
+      ((static_cast<uint64_t>(extent) + (1ull << level) - 1) >> level));
+}
+
+ProgressiveVolume::ProgressiveVolume(const ProgressiveDesc& desc)
+    : m_Desc(desc) {
+  m_BrickSize = desc.brick_size ? desc.brick_size : 64;
+  // levels beyond the one that reduces the volume to a single voxel would
+  // all look the same
+  const uint32_t largest =
+      std::max(desc.width, std::max(desc.height, desc.depth));
+  uint32_t max_level = 0;
+  while (ReducedExtent(largest, max_level) > 1) ++max_level;
+  m_CoarseLevel = desc.coarse_level;
+  if (m_CoarseLevel == 0)
+    while (ReducedExtent(largest, m_CoarseLevel) > m_BrickSize) ++m_CoarseLevel;
+  m_CoarseLevel = std::min({m_CoarseLevel, max_level, kMaxProgressiveLevels});
+  m_Buffers[0].texture_id = desc.texture_ids[0];
+  m_Buffers[1].texture_id = desc.texture_ids[1];
+}
+
+bool ProgressiveVolume::IsValidDesc(const ProgressiveDesc& desc) {
+  return desc.data_ptr != nullptr && desc.width != 0 && desc.height != 0 &&
+         desc.depth != 0 && IsValidFormat(desc.format) &&
+         desc.coarse_level <= kMaxProgressiveLevels &&
+         desc.texture_ids[0] != desc.texture_ids[1];
+}
+
+void ProgressiveVolume::StartLevel(TextureSubPluginAPI* api, int back) {
+  Buffer& buffer = m_Buffers[back];
+  const uint32_t level =
+      m_Front < 0 ? m_CoarseLevel : m_Buffers[m_Front].level - 1;
+  const uint32_t extent[3] = {ReducedExtent(m_Desc.width, level),
+                              ReducedExtent(m_Desc.height, level),
+                              ReducedExtent(m_Desc.depth, level)};
+  // the texture of an earlier level is replaced by one of the new extent
+  if (buffer.level != kProgressiveNoLevel)
+    api->DestroyTexture3D(buffer.texture_id);
+  api->CreateTexture3D(buffer.texture_id, extent[0], extent[1], extent[2],
+                       m_Desc.format);
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  buffer.level = level;
+  std::copy(extent, extent + 3, buffer.extent);
+  buffer.retired_update = 0;
+  for (int i = 0; i < 3; ++i)
+    m_BrickCount[i] = (extent[i] + m_BrickSize - 1) / m_BrickSize;
+  m_Back = back;
+  m_NextBrick = 0;
+}
+
+void ProgressiveVolume::Update(TextureSubPluginAPI* api) {
+  int back = -1;
+  bool release = false;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    ++m_UpdateCount;
+    m_UploadedBytes = 0;
+    if (m_Back < 0) {
+      const int other = m_Front < 0 ? 0 : 1 - m_Front;
+      const Buffer& candidate = m_Buffers[other];
+      if (candidate.retired_update != 0 &&
+          m_UpdateCount < candidate.retired_update + kRetiredUpdates)
+        return;
+      // the coarser texture is no longer needed once the full resolution is
+      // shown
+      if (m_Front >= 0 && m_Buffers[m_Front].level == 0)
+        release = candidate.level != kProgressiveNoLevel;
+      else
+        back = other;
+    }
+  }
+  if (release) {
+    const int other = 1 - m_Front;
+    api->DestroyTexture3D(m_Buffers[other].texture_id);
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Buffers[other].level = kProgressiveNoLevel;
+    m_Buffers[other].retired_update = 0;
+    return;
+  }
+  if (m_Back < 0) {
+    if (back < 0) return;
+    StartLevel(api, back);
+  }
+
+  // the back texture is only written by the render thread
+  const Buffer& buffer = m_Buffers[m_Back];
+  TraceScope trace("progressive", "UploadLevel", "level", buffer.level);
+  const FormatTraits traits = GetFormatTraits(m_Desc.format);
+  const uint32_t volume_extent[3] = {m_Desc.width, m_Desc.height,
+                                     m_Desc.depth};
+  const uint32_t brick_count =
+      m_BrickCount[0] * m_BrickCount[1] * m_BrickCount[2];
+  // the full resolution is uploaded straight from the volume
+  SourceDescriptor source{};
+  source.encoding = SOURCE_ENCODING_NATIVE;
+  source.row_length = m_Desc.width;
+  source.image_height = m_Desc.height;
+  uint32_t next = m_NextBrick;
+  uint64_t uploaded = 0;
+  for (; next < brick_count; ++next) {
+    const uint32_t brick[3] = {next % m_BrickCount[0],
+                               next / m_BrickCount[0] % m_BrickCount[1],
+                               next / m_BrickCount[0] / m_BrickCount[1]};
+    uint32_t offset[3];
+    uint32_t region[3];
+    for (int i = 0; i < 3; ++i) {
+      offset[i] = brick[i] * m_BrickSize;
+      region[i] = std::min(m_BrickSize, buffer.extent[i] - offset[i]);
+    }
+    const uint64_t size =
+        static_cast<uint64_t>(traits.texel_size) * region[0] * region[1] *
+        region[2];
+    if (m_Desc.max_upload_bytes != 0 && uploaded > 0 &&
+        uploaded + size > m_Desc.max_upload_bytes)
+      break;
+    void* data_ptr;
+    const SourceDescriptor* brick_source = nullptr;
+    if (buffer.level == 0) {
+      data_ptr = const_cast<uint8_t*>(
+          static_cast<const uint8_t*>(m_Desc.data_ptr) +
+          ((static_cast<size_t>(offset[2]) * m_Desc.height + offset[1]) *
+               m_Desc.width +
+           offset[0]) *
+              traits.texel_size);
+      brick_source = &source;
+    } else {
+      m_Scratch.resize(size);
+      ReduceVolumeRegion(m_Desc.data_ptr, volume_extent, m_Desc.format,
+                         buffer.level,
+                         (m_Desc.flags & PROGRESSIVE_FLAG_BOX_FILTER) != 0,
+                         offset, region, m_Scratch.data());
+      data_ptr = m_Scratch.data();
+    }
+    api->TextureSubImage3DByID(
+        buffer.texture_id, static_cast<int32_t>(offset[0]),
+        static_cast<int32_t>(offset[1]), static_cast<int32_t>(offset[2]),
+        static_cast<int32_t>(region[0]), static_cast<int32_t>(region[1]),
+        static_cast<int32_t>(region[2]), data_ptr, 0, m_Desc.format,
+        brick_source, UPLOAD_FLAG_NONE);
+    uploaded += size;
+  }
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_UploadedBytes = uploaded;
+  m_NextBrick = next;
+  if (next == brick_count) {
+    if (m_Front >= 0) m_Buffers[m_Front].retired_update = m_UpdateCount;
+    m_Front = m_Back;
+    m_Back = -1;
+  }
+}
+
+void ProgressiveVolume::DestroyTextures(TextureSubPluginAPI* api) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  for (Buffer& buffer : m_Buffers) {
+    if (buffer.level == kProgressiveNoLevel) continue;
+    api->DestroyTexture3D(buffer.texture_id);
+    buffer.level = kProgressiveNoLevel;
+  }
+  m_Front = -1;
+  m_Back = -1;
+}
+
+ProgressiveState ProgressiveVolume::State() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  ProgressiveState state{};
+  state.front_level = kProgressiveNoLevel;
+  state.uploading_level = kProgressiveNoLevel;
+  if (m_Front >= 0) {
+    const Buffer& front = m_Buffers[m_Front];
+    state.front_texture_id = front.texture_id;
+    state.front_level = front.level;
+    state.front_width = front.extent[0];
+    state.front_height = front.extent[1];
+    state.front_depth = front.extent[2];
+  }
+  if (m_Back >= 0) {
+    state.uploading_level = m_Buffers[m_Back].level;
+    state.uploaded_bricks = m_NextBrick;
+    state.brick_count = m_BrickCount[0] * m_BrickCount[1] * m_BrickCount[2];
+  }
+  state.uploaded_bytes = m_UploadedBytes;
+  return state;
+}
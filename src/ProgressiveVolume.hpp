@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <vector>
+
+#include "TextureSubPluginAPI.hpp"
+
+/// @brief Level of ProgressiveState members that refer to no level
+static const uint32_t kProgressiveNoLevel = 0xFFFFFFFF;
+
+/// @brief Maximum number of levels below the full resolution
+static const uint32_t kMaxProgressiveLevels = 16;
+
+enum ProgressiveFlags {
+  PROGRESSIVE_FLAG_NONE = 0,
+  // average the voxels of each cell instead of sampling one voxel. Smoother,
+  // but computing a level reads the whole volume, so the first frame takes
+  // longer for larger volumes
+  PROGRESSIVE_FLAG_BOX_FILTER = 1 << 0
+};
+
+struct ProgressiveDesc {
+  // full resolution volume (x-fastest, tightly packed in format). It has to
+  // stay valid until the full resolution was uploaded or the volume was
+  // destroyed
+  const void* data_ptr;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  Format format;
+  // user assigned IDs of the two textures the levels are uploaded into (see
+  // CreateTexture3D). Each level gets a texture of its own extent
+  uint32_t texture_ids[2];
+  // level that is shown first, i.e., the volume is reduced by 2^coarse_level
+  // along each axis (0 selects the level at which the volume fits into a
+  // single brick)
+  uint32_t coarse_level;
+  // edge length of the bricks that are uploaded at once (0 selects 64)
+  uint32_t brick_size;
+  // combination of ProgressiveFlags
+  uint32_t flags;
+  // maximum number of bytes uploaded per UpdateProgressive event (0 for no
+  // limit). At least one brick is uploaded per event
+  uint64_t max_upload_bytes;
+};
+
+struct ProgressiveState {
+  // texture that holds the finest completely uploaded level (only valid if
+  // front_level is not kProgressiveNoLevel)
+  uint32_t front_texture_id;
+  // reduction of the front texture (0 once the full resolution is shown).
+  // Shaders can offset their LOD bias by it
+  uint32_t front_level;
+  uint32_t front_width;
+  uint32_t front_height;
+  uint32_t front_depth;
+  // level that is being uploaded into the back texture
+  uint32_t uploading_level;
+  // bricks of the uploading level that are done and its total brick count
+  uint32_t uploaded_bricks;
+  uint32_t brick_count;
+  // bytes uploaded by the last UpdateProgressive event
+  uint64_t uploaded_bytes;
+};
+
+/// @brief Streams a volume coarse to fine so that something is shown right
+/// after the volume was opened. The coarsest level is small enough to be
+/// uploaded at once; every following level halves the reduction and is
+/// uploaded brick by brick under a per-event budget into the back texture,
+/// which becomes the front texture once the level is complete. Levels are
+/// computed from the full resolution on the fly (see ReduceVolumeRegion)
+class ProgressiveVolume {
+ public:
+  explicit ProgressiveVolume(const ProgressiveDesc& desc);
+  ProgressiveVolume(const ProgressiveVolume&) = delete;
+  ProgressiveVolume& operator=(const ProgressiveVolume&) = delete;
+
+  /// @brief Checks the data pointer, extent, format, level and texture IDs
+  static bool IsValidDesc(const ProgressiveDesc& desc);
+
+  /// @brief Uploads (part of) the next level and swaps the front texture once
+  /// the level is complete. Render thread
+  void Update(TextureSubPluginAPI* api);
+
+  /// @brief Destroys the textures. Render thread
+  void DestroyTextures(TextureSubPluginAPI* api);
+
+  /// @brief Any thread
+  ProgressiveState State() const;
+
+ private:
+  struct Buffer {
+    uint32_t texture_id;
+    uint32_t level = kProgressiveNoLevel;
+    uint32_t extent[3] = {0, 0, 0};
+    // update in which the texture stopped being the front texture (see
+    // kRetiredUpdates in VolumePlayback.cpp)
+    uint64_t retired_update = 0;
+  };
+
+  // creates the texture of the level following the front one in
+  // m_Buffers[back]
+  void StartLevel(TextureSubPluginAPI* api, int back);
+
+  const ProgressiveDesc m_Desc;
+  uint32_t m_BrickSize;
+  uint32_t m_CoarseLevel;
+  // reduced texels of the current brick (unused at the full resolution)
+  std::vector<uint8_t> m_Scratch;
+
+  mutable std::mutex m_Mutex;
+  Buffer m_Buffers[2];
+  uint64_t m_UpdateCount = 0;
+  int m_Front = -1;
+  int m_Back = -1;
+  // bricks of the back texture's level (x-fastest)
+  uint32_t m_BrickCount[3] = {0, 0, 0};
+  uint32_t m_NextBrick = 0;
+  uint64_t m_UploadedBytes = 0;
+};
@@ -1,16 +1,42 @@
 #include <assert.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include "CommandStream.hpp"
+#include "ConversionKernels.hpp"
 #include "IUnityLog.h"
+#include "PluginEvents.hpp"
+#include "PluginLog.hpp"
+#include "ProgressiveVolume.hpp"
 #include "TextureSubPluginAPI.hpp"
+#include "ThreadPool.hpp"
+#include "Tickets.hpp"
+#include "Tracing.hpp"
+#include "VolumeContainer.hpp"
+#include "VolumePlayback.hpp"
 
-
-enum Event {
-  TextureSubImage2D = 0,
-  TextureSubImage3D = 1,
-  CreateTexture3D = 2,
-  DestroyTexture3D = 3
-};
+// names of the events in traces (indexed by Event)
+static const char* const kEventNames[] = {
+    "TextureSubImage2D",     "TextureSubImage3D",
+    "CreateTexture3D",       "DestroyTexture3D",
+    "TextureSubImage3DByID", "UploadBrickStatisticsTexture",
+    "ReadbackTexture3D",     "ProcessReadbacks",
+    "CopyTexture3DRegions",  "DefragmentTexture3D",
+    "BenchmarkUploadPaths",  "CreateBuffer",
+    "DestroyBuffer",         "BufferSubData",
+    "UnregisterHostMemory",  "ComputeGradients",
+    "TextureSubImage3DBitpacked", "UpdatePlayback",
+    "DestroyPlayback",       "ExecuteCommandStream",
+    "TextureSubImage3DSlices", "UpdateProgressive",
+    "DestroyProgressive"};
 
 struct TextureSubImage2DParams {
   void* texture_handle;
@@ -21,6 +47,7 @@ struct TextureSubImage2DParams {
   void* data_ptr;
   int32_t level;
   Format format;
+  uint64_t ticket;
 };
 
 struct TextureSubImage3DParams {
@@ -34,6 +61,10 @@ struct TextureSubImage3DParams {
   void* data_ptr;
   int32_t level;
   Format format;
+  // optional: encoding of the data pointed to by data_ptr (NULL if the data
+  // is already in the texture format)
+  const SourceDescriptor* source;
+  uint64_t ticket;
 };
 
 struct CreateTexture3DParams {
@@ -42,25 +73,230 @@ struct CreateTexture3DParams {
   uint32_t height;
   uint32_t depth;
   Format format;
+  uint64_t ticket;
 };
 
 struct DestroyTexture3DParams {
   uint32_t texture_id;
+  uint64_t ticket;
+};
+
+struct TextureSubImage3DByIDParams {
+  uint32_t texture_id;
+  int32_t xoffset;
+  int32_t yoffset;
+  int32_t zoffset;
+  int32_t width;
+  int32_t height;
+  int32_t depth;
+  void* data_ptr;
+  int32_t level;
+  Format format;
+  // optional: encoding of the data pointed to by data_ptr (NULL if the data
+  // is already in the texture format)
+  const SourceDescriptor* source;
+  // combination of UploadFlags
+  uint32_t flags;
+  uint64_t ticket;
+};
+
+struct TextureSubImage3DBitpackedParams {
+  uint32_t texture_id;
+  int32_t xoffset;
+  int32_t yoffset;
+  int32_t zoffset;
+  int32_t width;
+  int32_t height;
+  int32_t depth;
+  // texels encoded with BRICK_CODEC_BITPACK (see EncodeBitpackedData)
+  const uint32_t* words;
+  uint32_t bits;
+  uint32_t min;
+  // R8_UINT or R16_UINT
+  Format format;
+  uint64_t ticket;
+};
+
+struct TextureSubImage3DSlicesParams {
+  uint32_t texture_id;
+  int32_t xoffset;
+  int32_t yoffset;
+  int32_t zoffset;
+  int32_t width;
+  int32_t height;
+  int32_t depth;
+  // depth slices (front to back). The array and the slices only have to stay
+  // valid until the event was executed
+  const SliceSource* slices;
+  Format format;
+  // combination of UploadFlags
+  uint32_t flags;
+  uint64_t ticket;
+};
+
+struct UploadBrickStatisticsTextureParams {
+  uint32_t texture_id;
+  uint32_t stats_texture_id;
+};
+
+struct ReadbackTexture3DParams {
+  uint32_t texture_id;
+  uint32_t readback_id;
+  int32_t xoffset;
+  int32_t yoffset;
+  int32_t zoffset;
+  int32_t width;
+  int32_t height;
+  int32_t depth;
+};
+
+struct CopyTexture3DRegionsParams {
+  const TextureCopyRegion* regions;
+  uint32_t count;
+  uint64_t ticket;
+};
+
+struct DefragmentTexture3DParams {
+  uint32_t texture_id;
+  const BrickMove* moves;
+  uint32_t count;
+  uint64_t ticket;
+};
+
+struct BenchmarkUploadPathsParams {
+  // extent of the benchmarked bricks
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  Format format;
+  // number of bricks uploaded through each path
+  uint32_t count;
+};
+
+struct CreateBufferParams {
+  uint32_t buffer_id;
+  uint64_t size;
+  uint64_t ticket;
+};
+
+struct DestroyBufferParams {
+  uint32_t buffer_id;
+  uint64_t ticket;
+};
+
+struct BufferSubDataParams {
+  uint32_t buffer_id;
+  uint64_t offset;
+  uint64_t size;
+  const void* data_ptr;
+  uint64_t ticket;
 };
 
+struct UnregisterHostMemoryParams {
+  uint32_t memory_id;
+  // completes once the memory can be released
+  uint64_t ticket;
+};
+
+struct ComputeGradientsParams {
+  uint32_t src_texture_id;
+  // created on first use with the extent of the source
+  uint32_t dst_texture_id;
+  // RGBA8_UINT or RG16_UINT
+  Format dst_format;
+  // scale applied to the gradient magnitude in RGBA8 outputs (0 for 1)
+  float magnitude_scale;
+  // boxes in upload coordinates that changed since the last pass (nullptr
+  // for the whole volume)
+  const TextureBox* boxes;
+  uint32_t count;
+  uint64_t ticket;
+};
+
+struct UpdatePlaybackParams {
+  uint32_t playback_id;
+};
+
+struct DestroyPlaybackParams {
+  uint32_t playback_id;
+  uint64_t ticket;
+};
+
+struct UpdateProgressiveParams {
+  uint32_t volume_id;
+};
+
+struct DestroyProgressiveParams {
+  uint32_t volume_id;
+  uint64_t ticket;
+};
+
+struct ExecuteCommandStreamParams {
+  // command stream (see CommandStream.hpp), 8 byte aligned. Like the data
+  // its commands point to, it only has to stay valid until the event was
+  // executed
+  const void* stream;
+  uint64_t size;
+  uint64_t ticket;
+};
+
+// Header of the parameter ring (see GetParamRing). The ring's data follows
+// the header. Each slot starts with a ParamSlotHeader, the event's data
+// pointer points right behind it
+struct ParamRingHeader {
+  // size of the ring's data in bytes
+  uint64_t size;
+  // ring position (monotonically increasing, modulo size is the offset) up
+  // to which slots have been consumed and can be overwritten
+  std::atomic<uint64_t> consumed;
+  // pads the header to a cache line
+  uint64_t reserved[6];
+};
+
+struct ParamSlotHeader {
+  // ring position right behind the slot (including its padding)
+  uint64_t end;
+  uint64_t reserved;
+};
+
+static_assert(sizeof(ParamRingHeader) == 64, "unexpected ring header size");
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+              "C# reads the consumed position as a plain 64-bit integer");
+
 // global state
 static TextureSubPluginAPI* s_CurrentAPI = NULL;
+static ParamRingHeader* s_ParamRing = NULL;
+static TicketTracker s_Tickets;
+static std::mutex s_ContainersMutex;
+static std::map<uint32_t, std::shared_ptr<VolumeContainerReader>> s_Containers;
+static std::mutex s_PlaybacksMutex;
+static std::map<uint32_t, std::shared_ptr<VolumePlayback>> s_Playbacks;
+static std::mutex s_ProgressiveVolumesMutex;
+static std::map<uint32_t, std::shared_ptr<ProgressiveVolume>>
+    s_ProgressiveVolumes;
 static UnityGfxRenderer s_DeviceType = kUnityGfxRendererNull;
 
 static void UNITY_INTERFACE_API
 OnGraphicsDeviceEvent(UnityGfxDeviceEventType eventType);
 
+#if SUPPORT_VULKAN
+extern "C" void RenderAPI_Vulkan_OnPluginLoad(IUnityInterfaces* interfaces);
+#endif  // if SUPPORT_VULKAN
+
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
 UnityPluginLoad(IUnityInterfaces* unityInterfaces) {
   g_UnityInterfaces = unityInterfaces;
   g_Graphics = g_UnityInterfaces->Get<IUnityGraphics>();
   g_Graphics->RegisterDeviceEventCallback(OnGraphicsDeviceEvent);
   g_Log = g_UnityInterfaces->Get<IUnityLog>();
+  StartPluginLog(g_Log);
+
+#if SUPPORT_VULKAN
+  // the Vulkan device has not been created yet if the plugin is loaded on
+  // startup. Intercept its initialization to enable optional extensions
+  if (g_Graphics->GetRenderer() == kUnityGfxRendererNull)
+    RenderAPI_Vulkan_OnPluginLoad(unityInterfaces);
+#endif  // if SUPPORT_VULKAN
 
   // Run OnGraphicsDeviceEvent(initialize) manually on plugin load
   OnGraphicsDeviceEvent(kUnityGfxDeviceEventInitialize);
@@ -68,6 +304,40 @@ UnityPluginLoad(IUnityInterfaces* unityInterfaces) {
 
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginUnload() {
   g_Graphics->UnregisterDeviceEventCallback(OnGraphicsDeviceEvent);
+  free(s_ParamRing);
+  s_ParamRing = NULL;
+  {
+    std::lock_guard<std::mutex> lock(s_ContainersMutex);
+    s_Containers.clear();
+  }
+  // stopping the prefetch threads waits for their callbacks, so the
+  // playbacks are destroyed without holding the lock
+  std::map<uint32_t, std::shared_ptr<VolumePlayback>> playbacks;
+  {
+    std::lock_guard<std::mutex> lock(s_PlaybacksMutex);
+    playbacks.swap(s_Playbacks);
+  }
+  playbacks.clear();
+  {
+    std::lock_guard<std::mutex> lock(s_ProgressiveVolumesMutex);
+    s_ProgressiveVolumes.clear();
+  }
+  StopThreadPool();
+  // forwards the messages that are still queued
+  StopPluginLog();
+}
+
+static std::shared_ptr<VolumePlayback> FindPlayback(uint32_t playback_id) {
+  std::lock_guard<std::mutex> lock(s_PlaybacksMutex);
+  auto search = s_Playbacks.find(playback_id);
+  return search == s_Playbacks.end() ? nullptr : search->second;
+}
+
+static std::shared_ptr<ProgressiveVolume> FindProgressiveVolume(
+    uint32_t volume_id) {
+  std::lock_guard<std::mutex> lock(s_ProgressiveVolumesMutex);
+  auto search = s_ProgressiveVolumes.find(volume_id);
+  return search == s_ProgressiveVolumes.end() ? nullptr : search->second;
 }
 
 static void UNITY_INTERFACE_API
@@ -86,16 +356,97 @@ OnGraphicsDeviceEvent(UnityGfxDeviceEventType eventType) {
 
   // Cleanup graphics API implementation upon shutdown
   if (eventType == kUnityGfxDeviceEventShutdown) {
+    // the device is idle, everything that was recorded has completed
+    s_Tickets.Update(~0ull);
     delete s_CurrentAPI;
     s_CurrentAPI = NULL;
     s_DeviceType = kUnityGfxRendererNull;
   }
 }
 
+template <typename Params>
+static uint64_t TicketOf(void* data) {
+  return static_cast<Params*>(data)->ticket;
+}
+
+// returns the ticket in the params of an event, or 0 if it has none
+static uint64_t EventTicket(Event event, void* data) {
+  switch (event) {
+    case Event::TextureSubImage2D:
+      return TicketOf<TextureSubImage2DParams>(data);
+    case Event::TextureSubImage3D:
+      return TicketOf<TextureSubImage3DParams>(data);
+    case Event::CreateTexture3D:
+      return TicketOf<CreateTexture3DParams>(data);
+    case Event::DestroyTexture3D:
+      return TicketOf<DestroyTexture3DParams>(data);
+    case Event::TextureSubImage3DByID:
+      return TicketOf<TextureSubImage3DByIDParams>(data);
+    case Event::TextureSubImage3DBitpacked:
+      return TicketOf<TextureSubImage3DBitpackedParams>(data);
+    case Event::TextureSubImage3DSlices:
+      return TicketOf<TextureSubImage3DSlicesParams>(data);
+    case Event::DestroyPlayback:
+      return TicketOf<DestroyPlaybackParams>(data);
+    case Event::DestroyProgressive:
+      return TicketOf<DestroyProgressiveParams>(data);
+    case Event::ExecuteCommandStream:
+      return TicketOf<ExecuteCommandStreamParams>(data);
+    case Event::CopyTexture3DRegions:
+      return TicketOf<CopyTexture3DRegionsParams>(data);
+    case Event::DefragmentTexture3D:
+      return TicketOf<DefragmentTexture3DParams>(data);
+    case Event::CreateBuffer:
+      return TicketOf<CreateBufferParams>(data);
+    case Event::DestroyBuffer:
+      return TicketOf<DestroyBufferParams>(data);
+    case Event::BufferSubData:
+      return TicketOf<BufferSubDataParams>(data);
+    case Event::UnregisterHostMemory:
+      return TicketOf<UnregisterHostMemoryParams>(data);
+    case Event::ComputeGradients:
+      return TicketOf<ComputeGradientsParams>(data);
+    default:
+      return 0;
+  }
+}
+
+// events are executed in the order they were issued, hence consuming a slot
+// also reclaims the slots of events that were never executed and of data
+// (e.g., SourceDescriptors) that was placed in front of it
+static void ReleaseParamSlot(const void* data) {
+  if (s_ParamRing == NULL) return;
+  const uint8_t* ring_data = reinterpret_cast<const uint8_t*>(s_ParamRing + 1);
+  const uint8_t* slot_data = static_cast<const uint8_t*>(data);
+  if (slot_data < ring_data + sizeof(ParamSlotHeader) ||
+      slot_data >= ring_data + s_ParamRing->size)
+    return;
+  const ParamSlotHeader* slot =
+      reinterpret_cast<const ParamSlotHeader*>(slot_data) - 1;
+  if (slot->end > s_ParamRing->consumed.load(std::memory_order_relaxed))
+    s_ParamRing->consumed.store(slot->end, std::memory_order_release);
+}
+
 static void UNITY_INTERFACE_API OnRenderEvent(int eventID, void* data) {
-  // Unknown / unsupported graphics device type? Do nothing
-  if (s_CurrentAPI == NULL) return;
+  const uint64_t ticket = data ? EventTicket((Event)eventID, data) : 0;
 
+  // Unknown / unsupported graphics device type? The event's work can never
+  // be done
+  if (s_CurrentAPI == NULL) {
+    if (ticket != 0) s_Tickets.Abandon(ticket);
+    s_Tickets.Update(~0ull);
+    ReleaseParamSlot(data);
+    return;
+  }
+
+  const bool known_event =
+      eventID >= 0 &&
+      eventID < static_cast<int>(sizeof(kEventNames) / sizeof(*kEventNames));
+  if (IsTracingEnabled()) TraceThreadName("Unity render thread");
+  TraceScope trace("plugin", known_event ? kEventNames[eventID] : "Unknown",
+                   "event", static_cast<uint64_t>(eventID));
+
+  const uint64_t errors = GetThreadErrorCount();
   switch ((Event)eventID) {
     case Event::TextureSubImage2D: {
       auto args = static_cast<TextureSubImage2DParams*>(data);
@@ -106,6 +457,13 @@ static void UNITY_INTERFACE_API OnRenderEvent(int eventID, void* data) {
     }
     case Event::TextureSubImage3D: {
       auto args = static_cast<TextureSubImage3DParams*>(data);
+      if (args->source != NULL) {
+        s_CurrentAPI->TextureSubImage3DFromSource(
+            args->texture_handle, args->xoffset, args->yoffset, args->zoffset,
+            args->width, args->height, args->depth, args->data_ptr,
+            args->level, args->format, *args->source);
+        break;
+      }
       s_CurrentAPI->TextureSubImage3D(args->texture_handle, args->xoffset,
                                       args->yoffset, args->zoffset, args->width,
                                       args->height, args->depth, args->data_ptr,
@@ -123,11 +481,155 @@ static void UNITY_INTERFACE_API OnRenderEvent(int eventID, void* data) {
       s_CurrentAPI->DestroyTexture3D(args->texture_id);
       break;
     }
+    case Event::TextureSubImage3DByID: {
+      auto args = static_cast<TextureSubImage3DByIDParams*>(data);
+      s_CurrentAPI->TextureSubImage3DByID(
+          args->texture_id, args->xoffset, args->yoffset, args->zoffset,
+          args->width, args->height, args->depth, args->data_ptr, args->level,
+          args->format, args->source, args->flags);
+      break;
+    }
+    case Event::TextureSubImage3DBitpacked: {
+      auto args = static_cast<TextureSubImage3DBitpackedParams*>(data);
+      s_CurrentAPI->TextureSubImage3DBitpacked(
+          args->texture_id, args->xoffset, args->yoffset, args->zoffset,
+          args->width, args->height, args->depth, args->words, args->bits,
+          args->min, args->format);
+      break;
+    }
+    case Event::TextureSubImage3DSlices: {
+      auto args = static_cast<TextureSubImage3DSlicesParams*>(data);
+      s_CurrentAPI->TextureSubImage3DSlices(
+          args->texture_id, args->xoffset, args->yoffset, args->zoffset,
+          args->width, args->height, args->depth, args->slices, args->format,
+          args->flags);
+      break;
+    }
+    case Event::UpdatePlayback: {
+      auto args = static_cast<UpdatePlaybackParams*>(data);
+      auto playback = FindPlayback(args->playback_id);
+      if (playback) playback->Update(s_CurrentAPI);
+      break;
+    }
+    case Event::DestroyPlayback: {
+      auto args = static_cast<DestroyPlaybackParams*>(data);
+      std::shared_ptr<VolumePlayback> playback;
+      {
+        std::lock_guard<std::mutex> lock(s_PlaybacksMutex);
+        auto search = s_Playbacks.find(args->playback_id);
+        if (search != s_Playbacks.end()) {
+          playback = search->second;
+          s_Playbacks.erase(search);
+        }
+      }
+      if (playback) playback->DestroyTextures(s_CurrentAPI);
+      break;
+    }
+    case Event::UpdateProgressive: {
+      auto args = static_cast<UpdateProgressiveParams*>(data);
+      auto volume = FindProgressiveVolume(args->volume_id);
+      if (volume) volume->Update(s_CurrentAPI);
+      break;
+    }
+    case Event::DestroyProgressive: {
+      auto args = static_cast<DestroyProgressiveParams*>(data);
+      std::shared_ptr<ProgressiveVolume> volume;
+      {
+        std::lock_guard<std::mutex> lock(s_ProgressiveVolumesMutex);
+        auto search = s_ProgressiveVolumes.find(args->volume_id);
+        if (search != s_ProgressiveVolumes.end()) {
+          volume = search->second;
+          s_ProgressiveVolumes.erase(search);
+        }
+      }
+      if (volume) volume->DestroyTextures(s_CurrentAPI);
+      break;
+    }
+    case Event::ExecuteCommandStream: {
+      auto args = static_cast<ExecuteCommandStreamParams*>(data);
+      RunCommandStream(s_CurrentAPI, args->stream, args->size);
+      break;
+    }
+    case Event::UploadBrickStatisticsTexture: {
+      auto args = static_cast<UploadBrickStatisticsTextureParams*>(data);
+      s_CurrentAPI->UploadBrickStatisticsTexture(args->texture_id,
+                                                 args->stats_texture_id);
+      break;
+    }
+    case Event::ReadbackTexture3D: {
+      auto args = static_cast<ReadbackTexture3DParams*>(data);
+      s_CurrentAPI->ReadbackTexture3D(args->texture_id, args->readback_id,
+                                      args->xoffset, args->yoffset,
+                                      args->zoffset, args->width, args->height,
+                                      args->depth);
+      break;
+    }
+    case Event::ProcessReadbacks: {
+      s_CurrentAPI->ProcessReadbacks();
+      break;
+    }
+    case Event::CopyTexture3DRegions: {
+      auto args = static_cast<CopyTexture3DRegionsParams*>(data);
+      s_CurrentAPI->CopyTexture3DRegions(args->regions, args->count);
+      break;
+    }
+    case Event::DefragmentTexture3D: {
+      auto args = static_cast<DefragmentTexture3DParams*>(data);
+      s_CurrentAPI->DefragmentTexture3D(args->texture_id, args->moves,
+                                        args->count);
+      break;
+    }
+    case Event::BenchmarkUploadPaths: {
+      auto args = static_cast<BenchmarkUploadPathsParams*>(data);
+      s_CurrentAPI->BenchmarkUploadPaths(args->width, args->height,
+                                         args->depth, args->format,
+                                         args->count);
+      break;
+    }
+    case Event::CreateBuffer: {
+      auto args = static_cast<CreateBufferParams*>(data);
+      s_CurrentAPI->CreateBuffer(args->buffer_id, args->size);
+      break;
+    }
+    case Event::DestroyBuffer: {
+      auto args = static_cast<DestroyBufferParams*>(data);
+      s_CurrentAPI->DestroyBuffer(args->buffer_id);
+      break;
+    }
+    case Event::BufferSubData: {
+      auto args = static_cast<BufferSubDataParams*>(data);
+      s_CurrentAPI->BufferSubData(args->buffer_id, args->offset, args->size,
+                                  args->data_ptr);
+      break;
+    }
+    case Event::UnregisterHostMemory: {
+      auto args = static_cast<UnregisterHostMemoryParams*>(data);
+      s_CurrentAPI->UnregisterHostMemory(args->memory_id);
+      break;
+    }
+    case Event::ComputeGradients: {
+      auto args = static_cast<ComputeGradientsParams*>(data);
+      s_CurrentAPI->ComputeGradients(args->src_texture_id,
+                                     args->dst_texture_id, args->dst_format,
+                                     args->magnitude_scale, args->boxes,
+                                     args->count);
+      break;
+    }
     default: {
-      UNITY_LOG_ERROR(g_Log, "unknown event ID!");
-      return;
+      PLUGIN_LOG_ERROR("unknown event ID!");
+      break;
     }
   }
+
+  unsigned long long current_frame = 0, safe_frame = 0;
+  const bool deferred =
+      s_CurrentAPI->UpdateFrameNumbers(&current_frame, &safe_frame);
+  // an event whose execution logged an error failed (possibly partially)
+  if (ticket != 0)
+    s_Tickets.Record(ticket, current_frame, !deferred,
+                     GetThreadErrorCount() != errors);
+  s_Tickets.Update(deferred ? safe_frame : ~0ull);
+  ReleaseParamSlot(data);
 }
 
 extern "C" UnityRenderingEventAndData UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
@@ -135,8 +637,445 @@ GetRenderEventFunc() {
   return OnRenderEvent;
 }
 
+// The params of most events end with a ticket field: 0, or a ticket from
+// AcquireTicket to track the completion of the event's work (see IsComplete,
+// GetTicketStatus, GetCompletedTicket and SetTicketCallback)
+extern "C" UNITY_INTERFACE_EXPORT uint64_t UNITY_INTERFACE_API
+AcquireTicket() {
+  return s_Tickets.Acquire();
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+IsComplete(uint64_t ticket) {
+  return s_Tickets.IsComplete(ticket);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT uint32_t UNITY_INTERFACE_API
+GetTicketStatus(uint64_t ticket) {
+  return s_Tickets.GetStatus(ticket);
+}
+
+// retires a ticket that will not be passed to an executed event (e.g., the
+// event was not issued) as failed, so that GetCompletedTicket advances past it
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API
+ReleaseTicket(uint64_t ticket) {
+  s_Tickets.Abandon(ticket);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT uint64_t UNITY_INTERFACE_API
+GetCompletedTicket() {
+  return s_Tickets.GetCompleted();
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API
+SetTicketCallback(TicketCallback callback) {
+  s_Tickets.SetCallback(callback);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void* UNITY_INTERFACE_API
+GetParamRing(uint32_t size) {
+  // allocated once and kept until the plugin is unloaded since events may
+  // still reference it
+  if (s_ParamRing == NULL) {
+    const uint64_t data_size = (static_cast<uint64_t>(size) + 15) & ~15ull;
+    void* memory =
+        data_size ? calloc(1, sizeof(ParamRingHeader) + data_size) : NULL;
+    if (memory == NULL) {
+      PLUGIN_LOG_ERROR("failed to allocate the parameter ring");
+      return NULL;
+    }
+    s_ParamRing = new (memory) ParamRingHeader();
+    s_ParamRing->size = data_size;
+  }
+  return s_ParamRing;
+}
+
 extern "C" UNITY_INTERFACE_EXPORT void* UNITY_INTERFACE_API
 RetrieveCreatedTexture3D(uint32_t texture_id) {
   if (s_CurrentAPI == NULL) return nullptr;
   return s_CurrentAPI->RetrieveCreatedTexture3D(texture_id);
 }
+
+extern "C" UNITY_INTERFACE_EXPORT void* UNITY_INTERFACE_API
+RetrieveCreatedTexture3DTile(uint32_t texture_id, uint32_t tile_index) {
+  if (s_CurrentAPI == NULL) return nullptr;
+  return s_CurrentAPI->RetrieveCreatedTexture3DTile(texture_id, tile_index);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT uint32_t UNITY_INTERFACE_API
+GetTextureTileDescriptors(uint32_t texture_id, TileDescriptor* tiles,
+                          uint32_t max_tiles) {
+  if (s_CurrentAPI == NULL) return 0;
+  return s_CurrentAPI->GetTextureTileDescriptors(texture_id, tiles, max_tiles);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void* UNITY_INTERFACE_API
+RetrieveCreatedBuffer(uint32_t buffer_id) {
+  if (s_CurrentAPI == NULL) return NULL;
+  return s_CurrentAPI->RetrieveCreatedBuffer(buffer_id);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+GetBufferInfo(uint32_t buffer_id, BufferInfo* info) {
+  if (s_CurrentAPI == NULL || info == NULL) return false;
+  return s_CurrentAPI->GetBufferInfo(buffer_id, info);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+RegisterHostMemory(uint32_t memory_id, void* ptr, uint64_t size) {
+  if (s_CurrentAPI == NULL) return false;
+  return s_CurrentAPI->RegisterHostMemory(memory_id, ptr, size);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+GetTexture3DInfo(uint32_t texture_id, Texture3DInfo* info) {
+  if (s_CurrentAPI == NULL || info == NULL) return false;
+  return s_CurrentAPI->GetTexture3DInfo(texture_id, info);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT uint32_t UNITY_INTERFACE_API
+GetMemoryBudget(MemoryHeapBudget* heaps, uint32_t max_heaps) {
+  if (s_CurrentAPI == NULL) return 0;
+  return s_CurrentAPI->GetMemoryBudget(heaps, max_heaps);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API
+SetMemoryBudgetPolicy(const MemoryBudgetPolicy* policy) {
+  if (s_CurrentAPI == NULL || policy == NULL) return;
+  s_CurrentAPI->SetMemoryBudgetPolicy(*policy);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API
+SetHostImageCopyPolicy(const HostImageCopyPolicy* policy) {
+  if (s_CurrentAPI == NULL || policy == NULL) return;
+  s_CurrentAPI->SetHostImageCopyPolicy(*policy);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT uint32_t UNITY_INTERFACE_API
+GetUploadBenchmark(UploadBenchmark* result) {
+  if (s_CurrentAPI == NULL || result == NULL) return READBACK_STATUS_UNKNOWN;
+  return s_CurrentAPI->GetUploadBenchmark(result);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+ConfigureBrickStatistics(uint32_t texture_id,
+                         const BrickStatisticsConfig* config) {
+  if (s_CurrentAPI == NULL || config == NULL) return false;
+  return s_CurrentAPI->ConfigureBrickStatistics(texture_id, *config);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT uint32_t UNITY_INTERFACE_API
+GetBrickStatistics(uint32_t texture_id, BrickStatistics* stats,
+                   uint32_t max_bricks, uint32_t* histograms,
+                   uint32_t max_histogram_entries) {
+  if (s_CurrentAPI == NULL) return 0;
+  return s_CurrentAPI->GetBrickStatistics(texture_id, stats, max_bricks,
+                                          histograms, max_histogram_entries);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT uint32_t UNITY_INTERFACE_API
+GetOccupancyBitmap(uint32_t texture_id, uint32_t* words, uint32_t max_words) {
+  if (s_CurrentAPI == NULL) return 0;
+  return s_CurrentAPI->GetOccupancyBitmap(texture_id, words, max_words);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT uint32_t UNITY_INTERFACE_API
+GetReadback(uint32_t readback_id, const void** data, uint64_t* size) {
+  if (s_CurrentAPI == NULL) return READBACK_STATUS_UNKNOWN;
+  return s_CurrentAPI->GetReadback(readback_id, data, size);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API
+ReleaseReadback(uint32_t readback_id) {
+  if (s_CurrentAPI == NULL) return;
+  s_CurrentAPI->ReleaseReadback(readback_id);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API
+SetReadbackCallback(ReadbackCallback callback) {
+  if (s_CurrentAPI == NULL) return;
+  s_CurrentAPI->SetReadbackCallback(callback);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+CreatePlayback(uint32_t playback_id, const PlaybackDesc* desc,
+               PlaybackLoadCallback callback, void* user_data) {
+  if (desc == NULL || callback == NULL || !VolumePlayback::IsValidDesc(*desc)) {
+    PLUGIN_LOG_ERROR("invalid playback description");
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(s_PlaybacksMutex);
+  if (s_Playbacks.count(playback_id)) {
+    PLUGIN_LOG_ERROR(
+        "playback ID %u is in use (playbacks have to be destroyed using the "
+        "DestroyPlayback event before their ID can be reused)",
+        playback_id);
+    return false;
+  }
+  s_Playbacks[playback_id] =
+      std::make_shared<VolumePlayback>(playback_id, *desc, callback, user_data);
+  return true;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API
+SeekPlayback(uint32_t playback_id, uint32_t timestep) {
+  auto playback = FindPlayback(playback_id);
+  if (playback) playback->Seek(timestep);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+GetPlaybackState(uint32_t playback_id, PlaybackState* state) {
+  auto playback = FindPlayback(playback_id);
+  if (playback == nullptr || state == NULL) return false;
+  *state = playback->State();
+  return true;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void* UNITY_INTERFACE_API
+RetrievePlaybackTexture3D(uint32_t playback_id) {
+  auto playback = FindPlayback(playback_id);
+  if (playback == nullptr || s_CurrentAPI == NULL) return nullptr;
+  const PlaybackState state = playback->State();
+  if (state.front_timestep == kPlaybackNoTimestep) return nullptr;
+  return s_CurrentAPI->RetrieveCreatedTexture3D(state.front_texture_id);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+CreateProgressiveVolume(uint32_t volume_id, const ProgressiveDesc* desc) {
+  if (desc == NULL || !ProgressiveVolume::IsValidDesc(*desc)) {
+    PLUGIN_LOG_ERROR("invalid progressive volume description");
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(s_ProgressiveVolumesMutex);
+  if (s_ProgressiveVolumes.count(volume_id)) {
+    PLUGIN_LOG_ERROR(
+        "progressive volume ID %u is in use (progressive volumes have to be "
+        "destroyed using the DestroyProgressive event before their ID can be "
+        "reused)",
+        volume_id);
+    return false;
+  }
+  s_ProgressiveVolumes[volume_id] = std::make_shared<ProgressiveVolume>(*desc);
+  return true;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+GetProgressiveState(uint32_t volume_id, ProgressiveState* state) {
+  auto volume = FindProgressiveVolume(volume_id);
+  if (volume == nullptr || state == NULL) return false;
+  *state = volume->State();
+  return true;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void* UNITY_INTERFACE_API
+RetrieveProgressiveTexture3D(uint32_t volume_id) {
+  auto volume = FindProgressiveVolume(volume_id);
+  if (volume == nullptr || s_CurrentAPI == NULL) return nullptr;
+  const ProgressiveState state = volume->State();
+  if (state.front_level == kProgressiveNoLevel) return nullptr;
+  return s_CurrentAPI->RetrieveCreatedTexture3D(state.front_texture_id);
+}
+
+static std::shared_ptr<VolumeContainerReader> FindContainer(
+    uint32_t container_id) {
+  std::lock_guard<std::mutex> lock(s_ContainersMutex);
+  auto search = s_Containers.find(container_id);
+  return search == s_Containers.end() ? nullptr : search->second;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+WriteVolumeContainerFile(const char* path, const void* data, uint32_t width,
+                         uint32_t height, uint32_t depth, Format format,
+                         const VolumeContainerOptions* options) {
+  const VolumeContainerOptions defaults = {};
+  return WriteVolumeContainer(path, data, width, height, depth, format,
+                              options ? *options : defaults);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+OpenVolumeContainer(uint32_t container_id, const char* path) {
+  auto reader = std::make_shared<VolumeContainerReader>();
+  if (!reader->Open(path)) {
+    PLUGIN_LOG_ERROR("failed to open volume container %s",
+                     path ? path : "(null)");
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(s_ContainersMutex);
+  s_Containers[container_id] = reader;
+  return true;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API
+CloseVolumeContainer(uint32_t container_id) {
+  std::lock_guard<std::mutex> lock(s_ContainersMutex);
+  s_Containers.erase(container_id);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+GetVolumeContainerInfo(uint32_t container_id, VolumeContainerInfo* info) {
+  auto reader = FindContainer(container_id);
+  if (reader == nullptr || info == NULL) return false;
+  *info = reader->Info();
+  return true;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT uint32_t UNITY_INTERFACE_API
+GetVolumeContainerLods(uint32_t container_id, VolumeContainerLod* lods,
+                       uint32_t max_lods) {
+  auto reader = FindContainer(container_id);
+  if (reader == nullptr) return 0;
+  const uint32_t count = reader->Info().lod_count;
+  if (lods != NULL)
+    memcpy(lods, reader->Lods(),
+           std::min(count, max_lods) * sizeof(VolumeContainerLod));
+  return count;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT uint32_t UNITY_INTERFACE_API
+GetVolumeContainerBricks(uint32_t container_id, uint32_t first_brick,
+                         VolumeContainerBrick* bricks, uint32_t max_bricks) {
+  auto reader = FindContainer(container_id);
+  if (reader == nullptr) return 0;
+  const uint32_t count = reader->Info().brick_count;
+  if (bricks != NULL && first_brick < count)
+    memcpy(bricks, reader->Bricks() + first_brick,
+           std::min(count - first_brick, max_bricks) *
+               sizeof(VolumeContainerBrick));
+  return count;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+DecodeVolumeContainerBrick(uint32_t container_id, uint32_t brick_index,
+                           void* dst, uint64_t dst_size) {
+  auto reader = FindContainer(container_id);
+  if (reader == nullptr) return false;
+  return reader->DecodeBrick(brick_index, dst, static_cast<size_t>(dst_size));
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+PrepareVolumeContainerBitpackedUpload(
+    uint32_t container_id, uint32_t brick_index, uint32_t texture_id,
+    int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    TextureSubImage3DBitpackedParams* params) {
+  auto reader = FindContainer(container_id);
+  if (reader == nullptr || params == NULL ||
+      brick_index >= reader->Info().brick_count)
+    return false;
+  const VolumeContainerBrick& brick = reader->Bricks()[brick_index];
+  if (brick.codec != BRICK_CODEC_BITPACK) return false;
+
+  // the packed words are read straight from the mapping
+  *params = TextureSubImage3DBitpackedParams{};
+  params->texture_id = texture_id;
+  params->xoffset = xoffset;
+  params->yoffset = yoffset;
+  params->zoffset = zoffset;
+  params->width = static_cast<int32_t>(brick.width);
+  params->height = static_cast<int32_t>(brick.height);
+  params->depth = static_cast<int32_t>(brick.depth);
+  params->words = static_cast<const uint32_t*>(reader->BrickData(brick_index));
+  params->bits = brick.bits;
+  params->min = brick.min;
+  params->format = reader->Info().format;
+  return true;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT uint64_t UNITY_INTERFACE_API
+EncodeBitpackedData(const void* data, uint64_t count, Format format,
+                    uint32_t* words, uint64_t max_words, uint32_t* bits,
+                    uint32_t* min) {
+  if (data == NULL || bits == NULL || min == NULL || count == 0 ||
+      (format != R8_UINT && format != R16_UINT))
+    return 0;
+  uint32_t max = 0;
+  *min = 0xFFFFFFFF;
+  AccumulateStatistics(data, static_cast<size_t>(count), format, min, &max,
+                       nullptr, 0);
+  *bits = BitpackedBits(*min, max);
+  const uint64_t word_count =
+      BitpackedWordCount(static_cast<size_t>(count), *bits);
+  if (words == NULL || word_count > max_words) return word_count;
+  EncodeBitpackedBrick(data, static_cast<size_t>(count), format, *min, *bits,
+                       words);
+  return word_count;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+DecodeBitpackedData(const uint32_t* words, uint32_t bits, uint32_t min,
+                    uint64_t count, Format format, void* dst) {
+  if (words == NULL || dst == NULL ||
+      (format != R8_UINT && format != R16_UINT) ||
+      bits > FormatTexelSize(format) * 8)
+    return false;
+  DecodeBitpackedBrick(words, bits, min, static_cast<size_t>(count), format,
+                       dst);
+  return true;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+GetVolumeContainerMapping(uint32_t container_id, void** data,
+                          uint64_t* size) {
+  auto reader = FindContainer(container_id);
+  if (reader == nullptr || data == NULL || size == NULL) return false;
+  *data = reader->Mapping();
+  *size = reader->MappingSize();
+  return true;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+PrepareVolumeContainerUpload(uint32_t container_id, uint32_t brick_index,
+                             uint32_t texture_id, int32_t xoffset,
+                             int32_t yoffset, int32_t zoffset, void* scratch,
+                             uint64_t scratch_size,
+                             TextureSubImage3DByIDParams* params) {
+  auto reader = FindContainer(container_id);
+  if (reader == nullptr || params == NULL ||
+      brick_index >= reader->Info().brick_count)
+    return false;
+  const VolumeContainerBrick& brick = reader->Bricks()[brick_index];
+
+  // uncompressed and constant bricks are uploaded straight from the mapping,
+  // bit packed ones are decoded into the caller's scratch memory
+  void* data_ptr = const_cast<void*>(reader->BrickData(brick_index));
+  if (brick.codec == BRICK_CODEC_BITPACK) {
+    if (!reader->DecodeBrick(brick_index, scratch,
+                             static_cast<size_t>(scratch_size)))
+      return false;
+    data_ptr = scratch;
+  }
+
+  *params = TextureSubImage3DByIDParams{};
+  params->texture_id = texture_id;
+  params->xoffset = xoffset;
+  params->yoffset = yoffset;
+  params->zoffset = zoffset;
+  params->width = static_cast<int32_t>(brick.width);
+  params->height = static_cast<int32_t>(brick.height);
+  params->depth = static_cast<int32_t>(brick.depth);
+  params->data_ptr = data_ptr;
+  params->format = reader->Info().format;
+  params->flags = brick.codec == BRICK_CODEC_CONSTANT ? UPLOAD_FLAG_CONSTANT
+                                                      : UPLOAD_FLAG_NONE;
+  return true;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API
+EnableTracing(bool enabled) {
+  SetTracingEnabled(enabled);
+  if (s_CurrentAPI != NULL) s_CurrentAPI->InterceptTracedCalls(enabled);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API
+WriteTraceFile(const char* path) {
+  return WriteTrace(path);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API
+GetLogCounters(LogCounters* counters) {
+  if (counters != NULL) *counters = GetPluginLogCounters();
+}
+
+extern "C" UNITY_INTERFACE_EXPORT uint32_t UNITY_INTERFACE_API
+GetLogMessageStats(LogMessageStats* stats, uint32_t max_stats) {
+  return GetPluginLogMessageStats(stats, max_stats);
+}
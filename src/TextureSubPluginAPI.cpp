@@ -1,14 +1,21 @@
 #include "TextureSubPluginAPI.hpp"
 
+#include <string.h>
+
+#include <vector>
+
+#include "ConversionKernels.hpp"
 #include "IUnityGraphics.h"
 #include "PlatformBase.hpp"
-
+#include "PluginLog.hpp"
+#include "VolumeContainer.hpp"
 
 IUnityInterfaces* g_UnityInterfaces = NULL;
 IUnityGraphics* g_Graphics = NULL;
 IUnityLog* g_Log = NULL;
 
-TextureSubPluginAPI* CreateTextureSubPluginAPI(UnityGfxRenderer apiType) {
+TextureSubPluginAPI* CreateTextureSubPluginAPI(
+    [[maybe_unused]] UnityGfxRenderer apiType) {
 #if SUPPORT_D3D11
   if (apiType == kUnityGfxRendererD3D11) {
     extern TextureSubPluginAPI* CreateTextureSubPluginAPI_D3D11();
@@ -16,14 +23,14 @@ TextureSubPluginAPI* CreateTextureSubPluginAPI(UnityGfxRenderer apiType) {
   }
 #endif  // if SUPPORT_D3D11
 
-#if SUPPORT_OPENGL_UNIFIED
+#if SUPPORT_OPENGL_CORE || SUPPORT_OPENGL_ES
   if (apiType == kUnityGfxRendererOpenGLCore ||
       apiType == kUnityGfxRendererOpenGLES30) {
     extern TextureSubPluginAPI* CreateTextureSubPluginAPI_OpenGLCoreES(
         UnityGfxRenderer apiType);
     return CreateTextureSubPluginAPI_OpenGLCoreES(apiType);
   }
-#endif  // if SUPPORT_OPENGL_UNIFIED
+#endif  // if SUPPORT_OPENGL_CORE || SUPPORT_OPENGL_ES
 
 #if SUPPORT_VULKAN
   if (apiType == kUnityGfxRendererVulkan) {
@@ -35,3 +42,146 @@ TextureSubPluginAPI* CreateTextureSubPluginAPI(UnityGfxRenderer apiType) {
   // Unknown or unsupported graphics API
   return NULL;
 }
+
+void TextureSubPluginAPI::TextureSubImage3DFromSource(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, void* data_ptr, int32_t level,
+    Format format, const SourceDescriptor& source) {
+  std::vector<uint8_t> packed;
+  if (!PackStridedSource(&source, width, height, depth, format, &data_ptr,
+                         &packed)) {
+    PLUGIN_LOG_ERROR("strides are only supported for native sources");
+    return;
+  }
+  if (source.encoding == SOURCE_ENCODING_NATIVE) {
+    TextureSubImage3D(texture_handle, xoffset, yoffset, zoffset, width, height,
+                      depth, data_ptr, level, format);
+    return;
+  }
+
+  const size_t count = static_cast<size_t>(width) * height * depth;
+  std::vector<uint8_t> converted(count * FormatTexelSize(format));
+  if (!ConvertSource(source, data_ptr, 0, count, format, converted.data())) {
+    PLUGIN_LOG_ERROR(
+        "unsupported conversion from source encoding %u to texture format: %d",
+        source.encoding, format);
+    return;
+  }
+  TextureSubImage3D(texture_handle, xoffset, yoffset, zoffset, width, height,
+                    depth, converted.data(), level, format);
+}
+
+void TextureSubPluginAPI::TextureSubImage3DByID(
+    uint32_t texture_id, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, void* data_ptr, int32_t level,
+    Format format, const SourceDescriptor* source, uint32_t flags) {
+  void* texture_handle = RetrieveCreatedTexture3D(texture_id);
+  if (!texture_handle) return;
+
+  if (flags & UPLOAD_FLAG_CONSTANT) {
+    // data_ptr only points to a single texel (in the source encoding)
+    const size_t texel_size = FormatTexelSize(format);
+    uint8_t texel[16];
+    if (texel_size == 0 || texel_size > sizeof(texel) || width <= 0 ||
+        height <= 0 || depth <= 0) {
+      PLUGIN_LOG_ERROR("invalid constant region (format: %d)", format);
+      return;
+    }
+    if (source && source->encoding != SOURCE_ENCODING_NATIVE) {
+      if (!ConvertSource(*source, data_ptr, 0, 1, format, texel)) {
+        PLUGIN_LOG_ERROR(
+            "unsupported conversion from source encoding %u to texture "
+            "format: %d",
+            source->encoding, format);
+        return;
+      }
+    } else {
+      memcpy(texel, data_ptr, texel_size);
+    }
+    const size_t count = static_cast<size_t>(width) * height * depth;
+    std::vector<uint8_t> filled(count * texel_size);
+    for (size_t i = 0; i < count; ++i)
+      memcpy(filled.data() + i * texel_size, texel, texel_size);
+    TextureSubImage3D(texture_handle, xoffset, yoffset, zoffset, width, height,
+                      depth, filled.data(), level, format);
+    return;
+  }
+
+  if (source)
+    TextureSubImage3DFromSource(texture_handle, xoffset, yoffset, zoffset,
+                                width, height, depth, data_ptr, level, format,
+                                *source);
+  else
+    TextureSubImage3D(texture_handle, xoffset, yoffset, zoffset, width, height,
+                      depth, data_ptr, level, format);
+}
+
+void TextureSubPluginAPI::TextureSubImage3DBatch(
+    uint32_t texture_id, const TextureUploadRegion* regions, uint32_t count,
+    Format format) {
+  for (uint32_t i = 0; i < count; ++i) {
+    const TextureUploadRegion& region = regions[i];
+    TextureSubImage3DByID(texture_id, region.xoffset, region.yoffset,
+                          region.zoffset, region.width, region.height,
+                          region.depth, const_cast<void*>(region.data_ptr), 0,
+                          format, region.source, region.flags);
+  }
+}
+
+void TextureSubPluginAPI::TextureSubImage3DSlices(
+    uint32_t texture_id, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, const SliceSource* slices,
+    Format format, uint32_t flags) {
+  const size_t row_size = FormatTexelSize(format) * (width > 0 ? width : 0);
+  if (height <= 0 || depth <= 0 ||
+      !IsValidSliceStack(slices, row_size, height, depth)) {
+    PLUGIN_LOG_ERROR("invalid slice stack (%d x %d x %d, format: %d)", width,
+                     height, depth, format);
+    return;
+  }
+  std::vector<uint8_t> gathered(row_size * height * depth);
+  GatherSlices(slices, row_size, height, depth, gathered.data());
+  TextureSubImage3DByID(texture_id, xoffset, yoffset, zoffset, width, height,
+                        depth, gathered.data(), 0, format, nullptr, flags);
+}
+
+void TextureSubPluginAPI::BufferSubDataBatch(uint32_t buffer_id,
+                                             const BufferWriteRange* ranges,
+                                             uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i)
+    BufferSubData(buffer_id, ranges[i].offset, ranges[i].size,
+                  ranges[i].data_ptr);
+}
+
+void TextureSubPluginAPI::TextureSubImage3DBitpacked(
+    uint32_t texture_id, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, const uint32_t* words,
+    uint32_t bits, uint32_t min, Format format) {
+  if ((format != R8_UINT && format != R16_UINT) ||
+      bits > FormatTexelSize(format) * 8 || width <= 0 || height <= 0 ||
+      depth <= 0) {
+    PLUGIN_LOG_ERROR("invalid bit packed region (format: %d, bits: %u)", format,
+                     bits);
+    return;
+  }
+  const size_t count = static_cast<size_t>(width) * height * depth;
+  std::vector<uint8_t> decoded(count * FormatTexelSize(format));
+  DecodeBitpackedBrick(words, bits, min, count, format, decoded.data());
+  TextureSubImage3DByID(texture_id, xoffset, yoffset, zoffset, width, height,
+                        depth, decoded.data(), 0, format, nullptr,
+                        UPLOAD_FLAG_NONE);
+}
+
+void TextureSubPluginAPI::DefragmentTexture3D(uint32_t texture_id,
+                                              const BrickMove* moves,
+                                              uint32_t count) {
+  if (!moves || count == 0) return;
+  std::vector<TextureCopyRegion> regions(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    const BrickMove& move = moves[i];
+    regions[i] = {texture_id, texture_id, move.src_x, move.src_y,
+                  move.src_z, move.dst_x, move.dst_y, move.dst_z,
+                  move.width, move.height, move.depth};
+  }
+  CopyTexture3DRegions(regions.data(), count);
+}
@@ -3,12 +3,304 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "FormatTraits.hpp"
 #include "IUnityGraphics.h"
 #include "IUnityLog.h"
+#include "PluginLog.hpp"
 
 struct IUnityInterfaces;
 
-enum Format { R8_UINT = 0, R16_UINT = 1 };
+/// @brief Encodings of upload source data that are converted to the texture
+/// format while being copied into staging memory (see SourceDescriptor)
+enum SourceEncoding {
+  // data is already in the texture format
+  SOURCE_ENCODING_NATIVE = 0,
+  // 32-bit floats mapped to unorm using the descriptor's window
+  SOURCE_ENCODING_FLOAT32 = 1,
+  // little-endian 12-bit values, two values per three bytes
+  SOURCE_ENCODING_PACKED_12BIT = 2,
+  // big-endian 16-bit values
+  SOURCE_ENCODING_UINT16_BIG_ENDIAN = 3,
+  // one separate array per channel of a multi-channel format (each in the
+  // format's channel type). data_ptr points to an array of channel pointers
+  SOURCE_ENCODING_PLANAR = 4
+};
+
+struct SourceDescriptor {
+  uint32_t encoding;
+  // window/level for SOURCE_ENCODING_FLOAT32 sources: values in
+  // [center - width / 2, center + width / 2] are mapped to [0, 1]
+  float window_center;
+  float window_width;
+  // optional strides (in texels) of a region that is part of a larger volume
+  // in client memory: texels between the starts of consecutive rows (0 if
+  // rows are tightly packed) and rows between the starts of consecutive
+  // slices (0 if slices are tightly packed). SOURCE_ENCODING_NATIVE only
+  uint32_t row_length;
+  uint32_t image_height;
+};
+
+/// @brief Per-upload flags of TextureSubImage3DByID
+enum UploadFlags {
+  UPLOAD_FLAG_NONE = 0,
+  // check whether the uploaded region is constant and, if so, write it on the
+  // GPU (clear/fill) instead of copying it through staging memory
+  UPLOAD_FLAG_DETECT_CONSTANT = 1 << 0,
+  // the caller guarantees that the region is constant. data_ptr only has to
+  // point to a single texel (in the source encoding)
+  UPLOAD_FLAG_CONSTANT = 1 << 1
+};
+
+/// @brief Degradation steps CreateTexture3D may apply when a requested texture
+/// does not fit into the memory budget (see MemoryBudgetPolicy)
+enum BudgetFallbackFlags {
+  BUDGET_FALLBACK_NONE = 0,
+  // store R16_UINT textures as R8_UINT using the policy's intensity window
+  BUDGET_FALLBACK_REDUCE_PRECISION = 1 << 0,
+  // halve the texture's dimensions (up to max_downsample_levels times).
+  // Uploads then have to be aligned to 2^level voxels
+  BUDGET_FALLBACK_DOWNSAMPLE = 1 << 1,
+  // refuse to allocate textures that still exceed the budget instead of
+  // relying on the driver/OS to fail or evict
+  BUDGET_FALLBACK_REJECT = 1 << 2
+};
+
+struct MemoryBudgetPolicy {
+  uint32_t fallback_flags;
+  uint32_t max_downsample_levels;
+  // fraction of the heap budget that may be in use after an allocation
+  float budget_fraction;
+  // intensity window that is mapped to [0, 255] when reducing precision
+  uint16_t window_min;
+  uint16_t window_max;
+};
+
+/// @brief When TextureSubImage3DByID writes regions into textures directly
+/// from the CPU (VK_EXT_host_image_copy) instead of copying them through a
+/// staging buffer on the GPU (see HostImageCopyPolicy)
+enum HostImageCopyMode {
+  // always use staging buffers (default)
+  HOST_IMAGE_COPY_NEVER = 0,
+  // regions of up to max_region_bytes, and regions of any size if the
+  // texture memory is host visible (UMA devices)
+  HOST_IMAGE_COPY_AUTO = 1,
+  // whenever possible. Textures are created with host transfer usage even if
+  // the driver reports that it may slow down sampling
+  HOST_IMAGE_COPY_ALWAYS = 2
+};
+
+struct HostImageCopyPolicy {
+  uint32_t mode;
+  uint32_t reserved;
+  uint64_t max_region_bytes;
+};
+
+/// @brief Result of an upload path benchmark (see BenchmarkUploadPaths).
+/// Times are averages per brick in nanoseconds
+struct UploadBenchmark {
+  // a ReadbackStatus (UNKNOWN if no benchmark was started)
+  uint32_t status;
+  uint32_t host_image_copy_supported;
+  uint32_t brick_count;
+  uint32_t reserved;
+  uint64_t brick_bytes;
+  // render thread time of vkCopyMemoryToImageEXT. The data is in the texture
+  // when it returns
+  double host_copy_ns;
+  // render thread time to fill a staging buffer and record its copy
+  double staging_cpu_ns;
+  // GPU time of the staging copies (0 if timestamps are not supported)
+  double staging_gpu_ns;
+  // render thread time to copy a brick into staging memory with memcpy and
+  // with StreamCopy (non-temporal stores, split across the thread pool)
+  double memcpy_ns;
+  double stream_copy_ns;
+};
+
+struct MemoryHeapBudget {
+  uint64_t heap_size;
+  // from VK_EXT_memory_budget if available, otherwise a heuristic
+  uint64_t budget;
+  // process usage if VK_EXT_memory_budget is available, otherwise the plugin's
+  uint64_t usage;
+  // memory allocated by this plugin (textures and staging buffers)
+  uint64_t plugin_usage;
+  uint32_t device_local;
+  uint32_t from_budget_extension;
+};
+
+struct Texture3DInfo {
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  Format format;
+  // number of times the texture was halved by the memory budget policy
+  uint32_t downsample_level;
+  uint64_t size_in_bytes;
+  // number of tiles along each axis (1 if the texture is not tiled)
+  uint32_t tile_count_x;
+  uint32_t tile_count_y;
+  uint32_t tile_count_z;
+  // distance between the origins of adjacent tiles. Adjacent tiles overlap by
+  // one voxel so that they can be sampled with linear filtering seamlessly
+  uint32_t tile_stride_x;
+  uint32_t tile_stride_y;
+  uint32_t tile_stride_z;
+  // 1 if uploads can be written into the texture from the CPU (see
+  // HostImageCopyPolicy)
+  uint32_t host_image_copy;
+};
+
+struct BufferInfo {
+  uint64_t size;
+  // GPU virtual address of the buffer (0 if buffer device addresses are not
+  // supported)
+  uint64_t device_address;
+  // memory heap the buffer was allocated from
+  uint32_t heap;
+  uint32_t reserved;
+};
+
+struct TileDescriptor {
+  uint32_t origin_x;
+  uint32_t origin_y;
+  uint32_t origin_z;
+  uint32_t index;
+  uint32_t extent_x;
+  uint32_t extent_y;
+  uint32_t extent_z;
+  uint32_t reserved;
+};
+
+struct BrickStatisticsConfig {
+  // brick size in voxels (in the texture's requested, i.e., non-degraded,
+  // coordinates)
+  uint32_t brick_size_x;
+  uint32_t brick_size_y;
+  uint32_t brick_size_z;
+  // number of histogram bins spanning the texture format's value range (0 to
+  // only compute min/max)
+  uint32_t histogram_bins;
+};
+
+struct BrickStatistics {
+  // min/max in the texture format's value range (0 if voxel_count is 0)
+  uint32_t min;
+  uint32_t max;
+  // number of voxels the statistics were accumulated over
+  uint64_t voxel_count;
+};
+
+/// @brief A box that is copied on the GPU from one texture created using
+/// CreateTexture3D to another (or to a different location of the same one).
+/// Coordinates are in the textures' actual (possibly degraded) resolution
+struct TextureCopyRegion {
+  uint32_t src_texture_id;
+  uint32_t dst_texture_id;
+  int32_t src_x;
+  int32_t src_y;
+  int32_t src_z;
+  int32_t dst_x;
+  int32_t dst_y;
+  int32_t dst_z;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+};
+
+/// @brief Moves a brick within a texture (see DefragmentTexture3D)
+struct BrickMove {
+  int32_t src_x;
+  int32_t src_y;
+  int32_t src_z;
+  int32_t dst_x;
+  int32_t dst_y;
+  int32_t dst_z;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+};
+
+/// @brief A box of a texture, e.g., a region that was uploaded to (see
+/// ComputeGradients)
+struct TextureBox {
+  int32_t x;
+  int32_t y;
+  int32_t z;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+};
+
+/// @brief A region of TextureSubImage3DBatch (see TextureSubImage3DByID)
+struct TextureUploadRegion {
+  int32_t xoffset;
+  int32_t yoffset;
+  int32_t zoffset;
+  int32_t width;
+  int32_t height;
+  int32_t depth;
+  const void* data_ptr;
+  // encoding of the data pointed to by data_ptr (nullptr if the data is
+  // already in the texture format)
+  const SourceDescriptor* source;
+  // combination of UploadFlags
+  uint32_t flags;
+};
+
+/// @brief A depth slice of TextureSubImage3DSlices, e.g., one DICOM image
+struct SliceSource {
+  // the slice's first row, in the texture format
+  const void* data_ptr;
+  // bytes between the starts of consecutive rows (0 if rows are tightly
+  // packed)
+  uint64_t row_pitch;
+};
+
+/// @brief A range of BufferSubDataBatch (see BufferSubData)
+struct BufferWriteRange {
+  uint64_t offset;
+  uint64_t size;
+  const void* data_ptr;
+};
+
+/// @brief State of an asynchronous readback (see ReadbackTexture3D)
+enum ReadbackStatus {
+  // the readback ID does not refer to a (not yet released) readback
+  READBACK_STATUS_UNKNOWN = 0,
+  // the copy was recorded but the GPU has not finished it yet
+  READBACK_STATUS_PENDING = 1,
+  // the data is available until the readback is released
+  READBACK_STATUS_READY = 2,
+  // the copy could not be recorded (e.g., invalid texture or region)
+  READBACK_STATUS_FAILED = 3
+};
+
+/// @brief Called on the render thread once a readback's data is available.
+/// data stays valid until ReleaseReadback is called for readback_id
+typedef void(UNITY_INTERFACE_API* ReadbackCallback)(uint32_t readback_id,
+                                                    const void* data,
+                                                    uint64_t size);
+
+/// @brief State of a completion ticket (see AcquireTicket)
+enum TicketStatus {
+  // the ticket was not acquired
+  TICKET_STATUS_UNKNOWN = 0,
+  // the ticket's event was not executed yet or its work is still in flight
+  TICKET_STATUS_PENDING = 1,
+  // the GPU has finished the work of the ticket's event
+  TICKET_STATUS_COMPLETE = 2,
+  // the event logged an error, could not be executed (e.g., no supported
+  // graphics device) or the ticket was released with ReleaseTicket
+  TICKET_STATUS_FAILED = 3
+};
+
+/// @brief Called on the render thread with the tickets that retired (completed
+/// or failed) since the last call (in no particular order) and the largest
+/// ticket up to which all tickets have retired
+typedef void(UNITY_INTERFACE_API* TicketCallback)(const uint64_t* tickets,
+                                                  uint32_t count,
+                                                  uint64_t completed_ticket);
 
 extern IUnityInterfaces* g_UnityInterfaces;
 extern IUnityGraphics* g_Graphics;
@@ -75,6 +367,402 @@ class TextureSubPluginAPI {
                                  void* data_ptr, int32_t level,
                                  Format format) = 0;
 
+  /// @brief Same as TextureSubImage3D except that the source data is encoded
+  /// as described by source and converted to format during the upload. The
+  /// default implementation converts into a temporary buffer first
+  /// @param[in] source encoding of the data pointed to by data_ptr
+  virtual void TextureSubImage3DFromSource(void* texture_handle,
+                                           int32_t xoffset, int32_t yoffset,
+                                           int32_t zoffset, int32_t width,
+                                           int32_t height, int32_t depth,
+                                           void* data_ptr, int32_t level,
+                                           Format format,
+                                           const SourceDescriptor& source);
+
+  /// @brief Fills per-heap memory budget information. This function can be
+  /// called outside of the render thread
+  /// @param[out] heaps array of at least max_heaps elements (may be nullptr)
+  /// @param[in] max_heaps capacity of the heaps array
+  /// @return number of memory heaps of the device (0 if unsupported)
+  virtual uint32_t GetMemoryBudget(MemoryHeapBudget* /*heaps*/,
+                                   uint32_t /*max_heaps*/) {
+    return 0;
+  }
+
+  /// @brief Sets the policy that is applied by subsequent CreateTexture3D
+  /// calls when a texture does not fit into the memory budget
+  /// @param[in] policy the new policy
+  virtual void SetMemoryBudgetPolicy(const MemoryBudgetPolicy& /*policy*/) {}
+
+  /// @brief Retrieves the actual (i.e., possibly degraded) properties of a 3D
+  /// texture that was created using CreateTexture3D. This function can be
+  /// called outside of the render thread
+  /// @param[in] texture_id the user assigned unique ID of the texture
+  /// @param[out] info the texture's properties
+  /// @return false if no texture was created with the provided ID
+  virtual bool GetTexture3DInfo(uint32_t /*texture_id*/,
+                                Texture3DInfo* /*info*/) {
+    return false;
+  }
+
+  /// @brief Updates a sub-region of a 3D texture that was created using
+  /// CreateTexture3D. Unlike TextureSubImage3D, the region is given in the
+  /// texture's logical coordinates and is routed to every tile it intersects.
+  /// On Vulkan, handle-based TextureSubImage3D calls with the handle of any
+  /// tile of such a texture are routed the same way (the plugin keeps track of
+  /// the tiles' layouts itself)
+  /// @param[in] texture_id the user assigned unique ID of the texture
+  /// @param[in] xoffset x offset within the target 3D texture
+  /// @param[in] yoffset y offset within the target 3D texture
+  /// @param[in] zoffset z offset within the target 3D texture
+  /// @param[in] width width of the source region
+  /// @param[in] height height of the source region
+  /// @param[in] depth depth of the source region
+  /// @param[in] data_ptr pointer to the data array in memory
+  /// @param[in] level mipmap level
+  /// @param[in] format texture format
+  /// @param[in] source encoding of the source data (nullptr if the data is
+  /// already in the texture format)
+  /// @param[in] flags combination of UploadFlags. The default implementation
+  /// uploads through TextureSubImage3D to the handle returned by
+  /// RetrieveCreatedTexture3D: constant regions are expanded on the CPU and
+  /// UPLOAD_FLAG_DETECT_CONSTANT has no effect
+  virtual void TextureSubImage3DByID(uint32_t texture_id, int32_t xoffset,
+                                     int32_t yoffset, int32_t zoffset,
+                                     int32_t width, int32_t height,
+                                     int32_t depth, void* data_ptr,
+                                     int32_t level, Format format,
+                                     const SourceDescriptor* source,
+                                     uint32_t flags);
+
+  /// @brief Uploads several regions of a texture that was created using
+  /// CreateTexture3D, in order (see TextureSubImage3DByID). Backends that
+  /// track layouts record the transitions of all regions at once instead of
+  /// a pair per region; the default implementation uploads one by one
+  /// @param[in] texture_id the user assigned unique ID of the texture
+  /// @param[in] regions count regions (mipmap level 0)
+  /// @param[in] format format of the regions' data
+  virtual void TextureSubImage3DBatch(uint32_t texture_id,
+                                      const TextureUploadRegion* regions,
+                                      uint32_t count, Format format);
+
+  /// @brief Same as TextureSubImage3DByID for a region whose depth slices
+  /// are separate buffers (a slice stack). The slices are gathered into
+  /// staging memory, in parallel for large stacks, so the region never has
+  /// to exist in contiguous client memory
+  /// @param[in] texture_id the user assigned unique ID of the texture
+  /// @param[in] xoffset x offset within the target 3D texture
+  /// @param[in] yoffset y offset within the target 3D texture
+  /// @param[in] zoffset z offset within the target 3D texture
+  /// @param[in] width width of the source region
+  /// @param[in] height height of the source region
+  /// @param[in] depth depth of the source region
+  /// @param[in] slices depth slices (front to back)
+  /// @param[in] format texture format
+  /// @param[in] flags combination of UploadFlags
+  virtual void TextureSubImage3DSlices(uint32_t texture_id, int32_t xoffset,
+                                       int32_t yoffset, int32_t zoffset,
+                                       int32_t width, int32_t height,
+                                       int32_t depth, const SliceSource* slices,
+                                       Format format, uint32_t flags);
+
+  /// @brief Same as TextureSubImage3DByID for a region whose texels are bit
+  /// packed relative to a base value (BRICK_CODEC_BITPACK, see
+  /// VolumeContainer.hpp). Backends that can decode on the GPU only transfer
+  /// the packed words; the default implementation decodes on the CPU
+  /// @param[in] texture_id the user assigned unique ID of the texture
+  /// @param[in] xoffset x offset within the target 3D texture
+  /// @param[in] yoffset y offset within the target 3D texture
+  /// @param[in] zoffset z offset within the target 3D texture
+  /// @param[in] width width of the source region
+  /// @param[in] height height of the source region
+  /// @param[in] depth depth of the source region
+  /// @param[in] words BitpackedWordCount(width * height * depth, bits) words
+  /// @param[in] bits bits per texel (at most the format's texel size)
+  /// @param[in] min base value that is added to each decoded texel
+  /// @param[in] format R8_UINT or R16_UINT
+  virtual void TextureSubImage3DBitpacked(uint32_t texture_id, int32_t xoffset,
+                                          int32_t yoffset, int32_t zoffset,
+                                          int32_t width, int32_t height,
+                                          int32_t depth, const uint32_t* words,
+                                          uint32_t bits, uint32_t min,
+                                          Format format);
+
+  /// @brief Retrieves the handle of one tile of a 3D texture that was created
+  /// using CreateTexture3D. This function can be called outside of the render
+  /// thread
+  /// @param[in] texture_id the user assigned unique ID of the texture
+  /// @param[in] tile_index index of the tile (see GetTextureTileDescriptors)
+  virtual void* RetrieveCreatedTexture3DTile(uint32_t texture_id,
+                                             uint32_t tile_index) {
+    return tile_index == 0 ? RetrieveCreatedTexture3D(texture_id) : nullptr;
+  }
+
+  /// @brief Fills the descriptors of the tiles a 3D texture was split into
+  /// because it exceeds the device's maximum 3D image dimension. This function
+  /// can be called outside of the render thread
+  /// @param[in] texture_id the user assigned unique ID of the texture
+  /// @param[out] tiles array of at least max_tiles elements (may be nullptr)
+  /// @param[in] max_tiles capacity of the tiles array
+  /// @return number of tiles of the texture (0 if unsupported)
+  virtual uint32_t GetTextureTileDescriptors(uint32_t /*texture_id*/,
+                                             TileDescriptor* /*tiles*/,
+                                             uint32_t /*max_tiles*/) {
+    return 0;
+  }
+
+  /// @brief Enables (or reconfigures and resets) per-brick statistics that
+  /// are accumulated while uploads to the texture are copied into staging
+  /// memory. This function can be called outside of the render thread
+  /// @param[in] texture_id the user assigned unique ID of the texture
+  /// @param[in] config brick size and histogram resolution
+  /// @return false if no texture was created with the provided ID or if
+  /// statistics are not supported
+  virtual bool ConfigureBrickStatistics(
+      uint32_t /*texture_id*/, const BrickStatisticsConfig& /*config*/) {
+    return false;
+  }
+
+  /// @brief Reads the per-brick statistics table of a texture in bulk (bricks
+  /// are ordered x-fastest). This function can be called outside of the render
+  /// thread
+  /// @param[in] texture_id the user assigned unique ID of the texture
+  /// @param[out] stats array of at least max_bricks elements (may be nullptr)
+  /// @param[in] max_bricks capacity of the stats array
+  /// @param[out] histograms array of at least max_histogram_entries elements
+  /// receiving histogram_bins counts per brick (may be nullptr)
+  /// @param[in] max_histogram_entries capacity of the histograms array
+  /// @return number of bricks of the texture (0 if statistics are disabled)
+  virtual uint32_t GetBrickStatistics(uint32_t /*texture_id*/,
+                                      BrickStatistics* /*stats*/,
+                                      uint32_t /*max_bricks*/,
+                                      uint32_t* /*histograms*/,
+                                      uint32_t /*max_histogram_entries*/) {
+    return 0;
+  }
+
+  /// @brief Fills a bitmap (32 bricks per word, bricks ordered x-fastest) in
+  /// which a brick's bit is set if it contains any non-zero voxel. Requires
+  /// brick statistics to be configured. This function can be called outside
+  /// of the render thread
+  /// @param[in] texture_id the user assigned unique ID of the texture
+  /// @param[out] words array of at least max_words elements (may be nullptr)
+  /// @param[in] max_words capacity of the words array
+  /// @return number of bricks of the texture (0 if statistics are disabled)
+  virtual uint32_t GetOccupancyBitmap(uint32_t /*texture_id*/,
+                                      uint32_t* /*words*/,
+                                      uint32_t /*max_words*/) {
+    return 0;
+  }
+
+  /// @brief Uploads the per-brick min/max of a texture into a two-channel 3D
+  /// texture with one voxel per brick (created with stats_texture_id on first
+  /// use)
+  /// @param[in] texture_id the user assigned unique ID of the texture
+  /// @param[in] stats_texture_id the user assigned unique ID of the min/max
+  /// texture
+  virtual void UploadBrickStatisticsTexture(uint32_t /*texture_id*/,
+                                            uint32_t /*stats_texture_id*/) {
+    PLUGIN_LOG_ERROR("brick statistics are not supported");
+  }
+
+  /// @brief Records an asynchronous copy of a sub-region of a texture created
+  /// using CreateTexture3D into host memory. Completion is detected on the
+  /// render thread (see ProcessReadbacks) without stalling it
+  /// @param[in] texture_id the user assigned unique ID of the texture
+  /// @param[in] readback_id user assigned unique ID of the readback (reusable
+  /// once the readback is released)
+  /// @param[in] xoffset x offset of the region (in the texture's possibly
+  /// degraded resolution, see GetTexture3DInfo)
+  /// @param[in] yoffset y offset of the region
+  /// @param[in] zoffset z offset of the region
+  /// @param[in] width width of the region
+  /// @param[in] height height of the region
+  /// @param[in] depth depth of the region
+  virtual void ReadbackTexture3D(uint32_t /*texture_id*/,
+                                 uint32_t /*readback_id*/, int32_t /*xoffset*/,
+                                 int32_t /*yoffset*/, int32_t /*zoffset*/,
+                                 int32_t /*width*/, int32_t /*height*/,
+                                 int32_t /*depth*/) {
+    PLUGIN_LOG_ERROR("texture readbacks are not supported");
+  }
+
+  /// @brief Checks for readbacks whose copies have completed and invokes the
+  /// readback callback for them. Called from the render thread
+  virtual void ProcessReadbacks() {}
+
+  /// @brief Queries the state of a readback. This function can be called
+  /// outside of the render thread
+  /// @param[in] readback_id the user assigned unique ID of the readback
+  /// @param[out] data pointer to the tightly packed (x-fastest) texels of the
+  /// region once the readback is ready (may be nullptr)
+  /// @param[out] size size of the data in bytes (may be nullptr)
+  /// @return a ReadbackStatus
+  virtual uint32_t GetReadback(uint32_t /*readback_id*/, const void** /*data*/,
+                               uint64_t* /*size*/) {
+    return READBACK_STATUS_UNKNOWN;
+  }
+
+  /// @brief Releases the host memory of a readback (pending readbacks are
+  /// released once they complete). This function can be called outside of the
+  /// render thread
+  /// @param[in] readback_id the user assigned unique ID of the readback
+  virtual void ReleaseReadback(uint32_t /*readback_id*/) {}
+
+  /// @brief Sets the callback that is invoked once a readback is ready
+  /// (nullptr to only poll using GetReadback)
+  virtual void SetReadbackCallback(ReadbackCallback /*callback*/) {}
+
+  /// @brief Copies boxes between textures created using CreateTexture3D on the
+  /// GPU. Copies behave as if they were executed one after the other (a copy
+  /// may read what a previous one wrote), barriers are only recorded between
+  /// copies that depend on each other. Source and destination textures need
+  /// to have the same format
+  /// @param[in] regions array of count copies
+  /// @param[in] count number of copies
+  virtual void CopyTexture3DRegions(const TextureCopyRegion* /*regions*/,
+                                    uint32_t /*count*/) {
+    PLUGIN_LOG_ERROR("GPU texture copies are not supported");
+  }
+
+  /// @brief Compacts the bricks of an atlas texture according to a plan of
+  /// moves that are applied in order (e.g., a brick may be moved into a slot
+  /// that a previous move vacated). The default implementation forwards the
+  /// moves to CopyTexture3DRegions
+  /// @param[in] texture_id the user assigned unique ID of the atlas texture
+  /// @param[in] moves array of count moves
+  /// @param[in] count number of moves
+  virtual void DefragmentTexture3D(uint32_t texture_id, const BrickMove* moves,
+                                   uint32_t count);
+
+  /// @brief Computes central difference gradients of the first channel of a
+  /// texture on the GPU. RGBA8_UINT destinations hold the normalized gradient
+  /// (mapped to [0, 1]) and its scaled magnitude, RG16_UINT destinations the
+  /// octahedral encoding of the normalized gradient. Only the given boxes and
+  /// the voxels around them (whose differences read the boxes) are updated
+  /// @param[in] src_texture_id the user assigned unique ID of the volume
+  /// @param[in] dst_texture_id ID of the gradient texture. It is created with
+  /// the volume's extent on first use
+  /// @param[in] dst_format RGBA8_UINT or RG16_UINT
+  /// @param[in] magnitude_scale factor of the magnitude stored in RGBA8_UINT
+  /// destinations (0 selects 1)
+  /// @param[in] boxes array of count boxes in the coordinates of uploads to
+  /// the volume (nullptr to update the whole texture)
+  /// @param[in] count number of boxes
+  virtual void ComputeGradients(uint32_t /*src_texture_id*/,
+                                uint32_t /*dst_texture_id*/,
+                                Format /*dst_format*/,
+                                float /*magnitude_scale*/,
+                                const TextureBox* /*boxes*/,
+                                uint32_t /*count*/) {
+    PLUGIN_LOG_ERROR("GPU gradients are not supported");
+  }
+
+  /// @brief Creates a device local storage buffer. Unlike Unity's
+  /// ComputeBuffer/GraphicsBuffer, its size is only limited by the device
+  /// @param[in] buffer_id assigned unique buffer ID (see CreateTexture3D)
+  /// @param[in] size size of the buffer in bytes
+  virtual void CreateBuffer(uint32_t /*buffer_id*/, uint64_t /*size*/) {
+    PLUGIN_LOG_ERROR("storage buffers are not supported");
+  }
+
+  /// @brief Destroys a buffer that was created using CreateBuffer once the
+  /// frames in flight no longer access it
+  virtual void DestroyBuffer(uint32_t /*buffer_id*/) {}
+
+  /// @brief Updates a range of a buffer that was created using CreateBuffer.
+  /// The data is copied through a staging buffer, so data_ptr only has to
+  /// stay valid until the event was executed
+  /// @param[in] buffer_id the user assigned unique ID of the buffer
+  /// @param[in] offset offset of the range in bytes
+  /// @param[in] size size of the range in bytes
+  /// @param[in] data_ptr pointer to size bytes
+  virtual void BufferSubData(uint32_t /*buffer_id*/, uint64_t /*offset*/,
+                             uint64_t /*size*/, const void* /*data_ptr*/) {}
+
+  /// @brief Updates several ranges of a buffer, in order (see
+  /// BufferSubData). Backends copy ranges that do not overlap each other
+  /// through a single staging buffer and pair of barriers
+  virtual void BufferSubDataBatch(uint32_t buffer_id,
+                                  const BufferWriteRange* ranges,
+                                  uint32_t count);
+
+  /// @brief Retrieves the native handle of a buffer that was created using
+  /// CreateBuffer (a VkBuffer* on Vulkan). This function can be called outside
+  /// of the render thread
+  virtual void* RetrieveCreatedBuffer(uint32_t /*buffer_id*/) {
+    return nullptr;
+  }
+
+  /// @brief Retrieves the size and device address of a buffer. This function
+  /// can be called outside of the render thread
+  /// @return false if no buffer was created with the provided ID
+  virtual bool GetBufferInfo(uint32_t /*buffer_id*/, BufferInfo* /*info*/) {
+    return false;
+  }
+
+  /// @brief Imports a range of caller memory (e.g., an arena of decoded
+  /// bricks) so that TextureSubImage3DByID copies regions that lie within it
+  /// straight to the GPU instead of through a staging buffer. This function
+  /// can be called outside of the render thread
+  /// @param[in] memory_id assigned unique ID of the range
+  /// @param[in] ptr start of the range. Only the part of the range that is
+  /// aligned to the device's import alignment (typically a page) is imported
+  /// @param[in] size size of the range in bytes
+  /// @return false if the range could not be imported (uploads from it are
+  /// staged)
+  virtual bool RegisterHostMemory(uint32_t /*memory_id*/, void* /*ptr*/,
+                                  uint64_t /*size*/) {
+    return false;
+  }
+
+  /// @brief Releases a range that was registered using RegisterHostMemory.
+  /// The memory must stay valid until the frame in which this event was
+  /// executed has completed (see AcquireTicket)
+  virtual void UnregisterHostMemory(uint32_t /*memory_id*/) {}
+
+  /// @brief Sets when TextureSubImage3DByID uploads are written into textures
+  /// from the CPU instead of being staged. Applies to textures created
+  /// afterwards and to all following uploads. Host copies are disabled by
+  /// default: they are written immediately, while frames that Unity recorded
+  /// earlier may still sample the region on the GPU. Only enable them if such
+  /// regions are not sampled by frames in flight (e.g., unused cache slots)
+  virtual void SetHostImageCopyPolicy(const HostImageCopyPolicy& /*policy*/) {}
+
+  /// @brief Measures the cost of count uploads of a width x height x depth
+  /// brick through a staging buffer and, if supported, through host image
+  /// copies (into a scratch texture). The result is available a few frames
+  /// later via GetUploadBenchmark
+  virtual void BenchmarkUploadPaths(uint32_t /*width*/, uint32_t /*height*/,
+                                    uint32_t /*depth*/, Format /*format*/,
+                                    uint32_t /*count*/) {
+    PLUGIN_LOG_ERROR("upload benchmarks are not supported");
+  }
+
+  /// @brief Retrieves the result of the last BenchmarkUploadPaths call. This
+  /// function can be called outside of the render thread
+  /// @return the result's status (a ReadbackStatus)
+  virtual uint32_t GetUploadBenchmark(UploadBenchmark* /*result*/) {
+    return READBACK_STATUS_UNKNOWN;
+  }
+
+  /// @brief Queries the number of the frame that is currently being recorded
+  /// and of the last frame whose GPU work has completed. Called from the
+  /// render thread after every event; resources that were destroyed in frames
+  /// that have completed are released
+  /// @return false if commands are executed immediately (i.e., the work of an
+  /// event is complete once the event was executed)
+  virtual bool UpdateFrameNumbers(unsigned long long* /*current_frame*/,
+                                  unsigned long long* /*safe_frame*/) {
+    return false;
+  }
+
+  /// @brief Installs (or removes) the hooks that trace graphics API calls
+  /// issued by Unity. Called when tracing is enabled or disabled so that the
+  /// hooks cost nothing while tracing is off
+  /// @param[in] enabled whether tracing is enabled
+  virtual void InterceptTracedCalls(bool /*enabled*/) {}
+
   /// @brief Processes general events like initialization, shutdown, device
   /// loss/reset etc.
   /// @param[in] type event type
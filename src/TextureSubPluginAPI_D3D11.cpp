@@ -6,13 +6,12 @@
 #include <assert.h>
 #include <d3d11.h>
 
-#include <ostream>
-#include <sstream>
 #include <string>
 #include <unordered_map>
 
 #include "IUnityGraphicsD3D11.h"
 #include "IUnityLog.h"
+#include "PluginLog.hpp"
 
 class TextureSubPluginAPI_D3D11 : public TextureSubPluginAPI {
  public:
@@ -62,24 +61,29 @@ void TextureSubPluginAPI_D3D11::ProcessDeviceEvent(
   }
 }
 
+// returns DXGI_FORMAT_UNKNOWN for unknown formats
+static DXGI_FORMAT ToDXGIFormat(Format format) {
+#define DXGI_FORMAT_CASE(name, channels, size, type, vk_format, dxgi_format, \
+                         ...)                                                \
+  case name:                                                                 \
+    return dxgi_format;
+  switch (format) {
+    TEXTURE_FORMATS(DXGI_FORMAT_CASE)
+    default:
+      return DXGI_FORMAT_UNKNOWN;
+  }
+#undef DXGI_FORMAT_CASE
+}
+
 void TextureSubPluginAPI_D3D11::TextureSubImage2D(
     void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t width,
     int32_t height, void* data_ptr, int32_t level, Format format) {
   // determine row pitch/depth from provided format
-  uint32_t row_pitch;
-  switch (format) {
-    case Format::R8_UINT:
-      row_pitch = width;  // width * sizeof(uint8_t)
-      break;
-    case Format::R16_UINT:
-      row_pitch = width * 2;  // width * sizeof(uint16_t)
-      break;
-    default: {
-      std::ostringstream ss;
-      ss << __FUNCTION__ << " unsupported texture format: " << format;
-      UNITY_LOG_ERROR(g_Log, ss.str().c_str());
-      return;
-    }
+  const uint32_t row_pitch =
+      width * static_cast<uint32_t>(FormatTexelSize(format));
+  if (row_pitch == 0) {
+    PLUGIN_LOG_ERROR("unsupported texture format: %d", format);
+    return;
   }
 
   ID3D11Texture2D* d3dtex = (ID3D11Texture2D*)texture_handle;
@@ -106,20 +110,11 @@ void TextureSubPluginAPI_D3D11::TextureSubImage3D(
     int32_t width, int32_t height, int32_t depth, void* data_ptr, int32_t level,
     Format format) {
   // determine row pitch/depth from provided format
-  uint32_t row_pitch;
-  switch (format) {
-    case Format::R8_UINT:
-      row_pitch = width;  // width * sizeof(uint8_t)
-      break;
-    case Format::R16_UINT:
-      row_pitch = width * 2;  // width * sizeof(uint16_t)
-      break;
-    default: {
-      std::ostringstream ss;
-      ss << __FUNCTION__ << " unsupported texture format: " << format;
-      UNITY_LOG_ERROR(g_Log, ss.str().c_str());
-      return;
-    }
+  const uint32_t row_pitch =
+      width * static_cast<uint32_t>(FormatTexelSize(format));
+  if (row_pitch == 0) {
+    PLUGIN_LOG_ERROR("unsupported texture format: %d", format);
+    return;
   }
 
   uint32_t depth_pitch = height * row_pitch;
@@ -144,43 +139,30 @@ void TextureSubPluginAPI_D3D11::TextureSubImage3D(
 void TextureSubPluginAPI_D3D11::CreateTexture3D(uint32_t texture_id,
                                                 uint32_t width, uint32_t height,
                                                 uint32_t depth, Format format) {
-  uint32_t size_in_mbs;
   D3D11_TEXTURE3D_DESC desc{};
   desc.Width = width;
   desc.Height = height;
   desc.Depth = depth;
   desc.MipLevels = 1;
-  switch (format) {
-    case R8_UINT:
-      desc.Format = DXGI_FORMAT_R8_UNORM;
-      size_in_mbs = width * height * depth / (1024 * 1024);
-      break;
-    case R16_UINT:
-      desc.Format = DXGI_FORMAT_R16_UNORM;
-      size_in_mbs = width * height * depth * 2 / (1024 * 1024);
-      break;
-    default: {
-      std::ostringstream ss;
-      ss << __FUNCTION__
-         << "failed to create 3D texture, unsupported texture format: "
-         << format;
-      UNITY_LOG_ERROR(g_Log, ss.str().c_str());
-      return;
-    }
+  desc.Format = ToDXGIFormat(format);
+  if (desc.Format == DXGI_FORMAT_UNKNOWN) {
+    PLUGIN_LOG_ERROR(
+        "failed to create 3D texture, unsupported texture format: %d", format);
+    return;
   }
+  const uint64_t size_in_mbs = static_cast<uint64_t>(width) * height * depth *
+                               FormatTexelSize(format) / (1024 * 1024);
   desc.Usage = D3D11_USAGE_DEFAULT;
   desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
   desc.CPUAccessFlags = 0;
   desc.MiscFlags = 0;
 
   if (size_in_mbs > D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_C_TERM) {
-    std::ostringstream msg;
-    msg << "Texture size exceeds Direct3D 11/12 max resource size. Texture "
-           "Size: "
-        << size_in_mbs << "MB"
-        << " Max: " << D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_C_TERM
-        << "MB";
-    UNITY_LOG_ERROR(g_Log, msg.str().c_str());
+    PLUGIN_LOG_ERROR(
+        "Texture size exceeds Direct3D 11/12 max resource size. Texture Size: "
+        "%lluMB Max: %dMB",
+        static_cast<unsigned long long>(size_in_mbs),
+        D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_C_TERM);
     return;
   }
 
@@ -190,14 +172,11 @@ void TextureSubPluginAPI_D3D11::CreateTexture3D(uint32_t texture_id,
   ID3D11Texture3D* d3dtex;
   HRESULT result = m_Device->CreateTexture3D(&desc, NULL, &d3dtex);
   if (S_OK != result) {
-    std::ostringstream msg;
-    msg << "CreateTexture3D failed, return code: 0x" << std::hex << result;
-    UNITY_LOG_ERROR(g_Log, msg.str().c_str());
+    PLUGIN_LOG_ERROR("CreateTexture3D failed, return code: 0x%lx",
+                     static_cast<unsigned long>(result));
     return;
   }
-  std::ostringstream address;
-  address << "created texture 3D ID3D11Texture3D ptr: 0x" << std::hex << d3dtex;
-  UNITY_LOG(g_Log, address.str().c_str());
+  PLUGIN_LOG("created texture 3D ID3D11Texture3D ptr: %p", d3dtex);
 
   // store created texture handle
   m_CreatedTextures.insert({texture_id, d3dtex});
@@ -210,7 +189,7 @@ void* TextureSubPluginAPI_D3D11::RetrieveCreatedTexture3D(uint32_t texture_id) {
       search != m_CreatedTextures.end()) {
     return search->second;
   }
-  UNITY_LOG_ERROR(g_Log, "no texture was created with the provided texture ID");
+  PLUGIN_LOG_ERROR("no texture was created with the provided texture ID");
   return nullptr;
 }
 
@@ -218,11 +197,11 @@ void TextureSubPluginAPI_D3D11::DestroyTexture3D(uint32_t texture_id) {
   if (auto search = m_CreatedTextures.find(texture_id);
       search != m_CreatedTextures.end()) {
     search->second->Release();
+    m_CreatedTextures.erase(search);
     return;
   }
-  UNITY_LOG_ERROR(g_Log,
-                  "failed to destroy texture 3D (texture ID does not refer to "
-                  "a created texture 3D)");
+  PLUGIN_LOG_ERROR("failed to destroy texture 3D (texture ID does not refer "
+                   "to a created texture 3D)");
 }
 
 #endif  // #if SUPPORT_D3D11
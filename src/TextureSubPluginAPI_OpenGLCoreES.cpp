@@ -1,9 +1,15 @@
 #include <cstdint>
-#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <unordered_map>
+#include <vector>
 
+#include "ConversionKernels.hpp"
 #include "PlatformBase.hpp"
+#include "PluginLog.hpp"
 #include "TextureSubPluginAPI.hpp"
+#include "Tracing.hpp"
 
 // OpenGL Core profile (desktop) or OpenGL ES (mobile) implementation of
 // RenderAPI. Supports several flavors: Core, ES2, ES3
@@ -33,6 +39,13 @@
 #error Unknown platform
 #endif
 
+// persistently mapped upload buffers need GL 4.4 or ARB_buffer_storage
+#ifdef GL_MAP_PERSISTENT_BIT
+#define SUPPORT_GL_STREAM_BUFFER 1
+#else
+#define SUPPORT_GL_STREAM_BUFFER 0
+#endif
+
 class TextureSubPluginAPI_OpenGLCoreES : public TextureSubPluginAPI {
  public:
   TextureSubPluginAPI_OpenGLCoreES(UnityGfxRenderer apiType);
@@ -54,14 +67,113 @@ class TextureSubPluginAPI_OpenGLCoreES : public TextureSubPluginAPI {
                                  int32_t width, int32_t height, int32_t depth,
                                  void* data_ptr, int32_t level, Format format);
 
+  virtual void TextureSubImage3DFromSource(void* texture_handle,
+                                           int32_t xoffset, int32_t yoffset,
+                                           int32_t zoffset, int32_t width,
+                                           int32_t height, int32_t depth,
+                                           void* data_ptr, int32_t level,
+                                           Format format,
+                                           const SourceDescriptor& source);
+
   virtual void ProcessDeviceEvent(UnityGfxDeviceEventType type,
                                   IUnityInterfaces* interfaces);
 
  private:
+  // a region of the stream buffer that is read by uploads the GPU may not
+  // have executed yet
+  struct StreamRegion {
+    size_t offset;
+    size_t size;
+    GLsync fence;
+  };
+
+  void UploadSubImage3D(void* texture_handle, int32_t xoffset, int32_t yoffset,
+                        int32_t zoffset, int32_t width, int32_t height,
+                        int32_t depth, void* data_ptr, int32_t level,
+                        Format format, const SourceDescriptor* source);
+
+  bool EnsureStreamBuffer();
+  uint8_t* AllocateStream(size_t size, size_t* offset);
+  void RetireStreamRegions(size_t offset, size_t size);
+  void ReleaseStreamBuffer();
+
   UnityGfxRenderer m_APIType;
   std::unordered_map<uint32_t, uint32_t> m_CreatedTextures;
+
+  // persistently mapped GL_PIXEL_UNPACK_BUFFER ring through which uploads are
+  // streamed (the GL counterpart of the Vulkan staging buffers)
+  GLuint m_StreamBuffer = 0;
+  uint8_t* m_StreamMapped = nullptr;
+  size_t m_StreamHead = 0;
+  std::deque<StreamRegion> m_StreamInFlight;
+  // 0: not checked yet, 1: supported, -1: not supported
+  int m_StreamSupport = 0;
+};
+
+// size of the stream buffer - larger uploads fall back to client memory
+static const size_t kStreamBufferSize = 64ull * 1024 * 1024;
+static const size_t kStreamAlignment = 16;
+
+// sets the pixel unpack state of an upload and restores the previous state
+// (which belongs to Unity) when it goes out of scope
+class UnpackState {
+ public:
+  UnpackState(GLuint buffer, GLint row_length, GLint image_height) {
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &m_Alignment);
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &m_RowLength);
+    glGetIntegerv(GL_UNPACK_IMAGE_HEIGHT, &m_ImageHeight);
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &m_Buffer);
+    // rows are tightly packed (the default alignment of 4 breaks rows whose
+    // size is not a multiple of 4 bytes)
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+    glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, image_height);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+  }
+  ~UnpackState() {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, m_Alignment);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, m_RowLength);
+    glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, m_ImageHeight);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, static_cast<GLuint>(m_Buffer));
+  }
+  UnpackState(const UnpackState&) = delete;
+  UnpackState& operator=(const UnpackState&) = delete;
+
+ private:
+  GLint m_Alignment;
+  GLint m_RowLength;
+  GLint m_ImageHeight;
+  GLint m_Buffer;
 };
 
+// formats err and the errors that follow it (glGetError) as hex codes
+static void FormatGLErrors(GLenum err, char* text, size_t size) {
+  int length = snprintf(text, size, "0x%x", err);
+  while ((err = glGetError()) != GL_NO_ERROR) {
+    if (length < 0 || static_cast<size_t>(length) >= size) continue;
+    length += snprintf(text + length, size - length, " 0x%x", err);
+  }
+}
+
+// maps a texture format to the GL internal format and the client data
+// format/type of uploads
+static bool GetGLFormat(Format format, GLint* internal_format,
+                        GLenum* gl_format, GLenum* gl_type) {
+#define GL_FORMAT_CASE(name, channels, size, type, vk_format, dxgi_format, \
+                       gl_internal, gl_client_format, gl_client_type)      \
+  case name:                                                               \
+    *internal_format = gl_internal;                                        \
+    *gl_format = gl_client_format;                                         \
+    *gl_type = gl_client_type;                                             \
+    return true;
+  switch (format) {
+    TEXTURE_FORMATS(GL_FORMAT_CASE)
+    default:
+      return false;
+  }
+#undef GL_FORMAT_CASE
+}
+
 TextureSubPluginAPI* CreateTextureSubPluginAPI_OpenGLCoreES(
     UnityGfxRenderer apiType) {
   return new TextureSubPluginAPI_OpenGLCoreES(apiType);
@@ -72,10 +184,10 @@ TextureSubPluginAPI_OpenGLCoreES::TextureSubPluginAPI_OpenGLCoreES(
     : m_APIType(apiType) {}
 
 void TextureSubPluginAPI_OpenGLCoreES::ProcessDeviceEvent(
-    UnityGfxDeviceEventType type, IUnityInterfaces* interfaces) {
+    UnityGfxDeviceEventType type, IUnityInterfaces* /*interfaces*/) {
   if (type == kUnityGfxDeviceEventInitialize) {
 #ifdef DEBUG
-    UNITY_LOG(g_Log, "kUnityGfxDeviceEventInitialize");
+    PLUGIN_LOG("kUnityGfxDeviceEventInitialize");
 #endif
 #if UNITY_WIN && SUPPORT_OPENGL_CORE
     if (m_APIType == kUnityGfxRendererOpenGLCore) {
@@ -83,10 +195,9 @@ void TextureSubPluginAPI_OpenGLCoreES::ProcessDeviceEvent(
       int version_major, version_minor;
       glGetIntegerv(GL_MAJOR_VERSION, &version_major);
       glGetIntegerv(GL_MINOR_VERSION, &version_minor);
-      std::ostringstream ss;
-      ss << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
-      ss << "Supports " << version_major << "." << version_minor;
-      UNITY_LOG(g_Log, ss.str().c_str());
+      PLUGIN_LOG("OpenGL version: %s\nSupports %d.%d",
+                 reinterpret_cast<const char*>(glGetString(GL_VERSION)),
+                 version_major, version_minor);
     }
 #endif
     // Make sure that there are no GL error flags set before proceeding
@@ -94,71 +205,234 @@ void TextureSubPluginAPI_OpenGLCoreES::ProcessDeviceEvent(
     }
   } else if (type == kUnityGfxDeviceEventShutdown) {
 #ifdef DEBUG
-    UNITY_LOG(g_Log, "kUnityGfxDeviceEventShutdown");
+    PLUGIN_LOG("kUnityGfxDeviceEventShutdown");
 #endif
+    ReleaseStreamBuffer();
   } else if (type == kUnityGfxDeviceEventAfterReset) {
 #ifdef DEBUG
-    UNITY_LOG(g_Log, "kUnityGfxDeviceEventAfterReset");
+    PLUGIN_LOG("kUnityGfxDeviceEventAfterReset");
 #endif
   }
 }
 
-void TextureSubPluginAPI_OpenGLCoreES::TextureSubImage3D(
+bool TextureSubPluginAPI_OpenGLCoreES::EnsureStreamBuffer() {
+#if SUPPORT_GL_STREAM_BUFFER
+  if (m_StreamSupport == 0) {
+    m_StreamSupport = -1;
+    if (m_APIType != kUnityGfxRendererOpenGLCore) return false;
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    bool supported = major > 4 || (major == 4 && minor >= 4);
+    GLint extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for (GLint i = 0; !supported && i < extension_count; ++i) {
+      const char* name = reinterpret_cast<const char*>(
+          glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+      supported = name && strcmp(name, "GL_ARB_buffer_storage") == 0;
+    }
+    if (!supported) {
+      PLUGIN_LOG("persistently mapped buffers are not supported - uploads "
+                 "are copied from client memory");
+      return false;
+    }
+
+    GLint previous_buffer;
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &previous_buffer);
+    glGenBuffers(1, &m_StreamBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_StreamBuffer);
+    const GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, kStreamBufferSize, nullptr, flags);
+    m_StreamMapped = static_cast<uint8_t*>(glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, kStreamBufferSize, flags));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, static_cast<GLuint>(previous_buffer));
+    if (!m_StreamMapped) {
+      PLUGIN_LOG_ERROR("failed to map the stream buffer: 0x%x", glGetError());
+      glDeleteBuffers(1, &m_StreamBuffer);
+      m_StreamBuffer = 0;
+      return false;
+    }
+    m_StreamHead = 0;
+    m_StreamSupport = 1;
+  }
+  return m_StreamSupport > 0;
+#else
+  return false;
+#endif
+}
+
+void TextureSubPluginAPI_OpenGLCoreES::RetireStreamRegions(size_t offset,
+                                                           size_t size) {
+#if SUPPORT_GL_STREAM_BUFFER
+  // regions of finished uploads are retired without blocking
+  while (!m_StreamInFlight.empty()) {
+    GLenum status = glClientWaitSync(m_StreamInFlight.front().fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+    glDeleteSync(m_StreamInFlight.front().fence);
+    m_StreamInFlight.pop_front();
+  }
+
+  // the CPU only waits if the requested range is still read by the GPU (the
+  // ring is full). Regions are retired oldest first since fences signal in
+  // submission order
+  auto overlaps = [&](const StreamRegion& region) {
+    return region.offset < offset + size &&
+           offset < region.offset + region.size;
+  };
+  while (!m_StreamInFlight.empty()) {
+    bool in_use = false;
+    for (const StreamRegion& region : m_StreamInFlight)
+      in_use = in_use || overlaps(region);
+    if (!in_use) break;
+    TraceScope trace("gl", "WaitStreamBuffer");
+    GLsync fence = m_StreamInFlight.front().fence;
+    glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(fence);
+    m_StreamInFlight.pop_front();
+  }
+#endif
+}
+
+uint8_t* TextureSubPluginAPI_OpenGLCoreES::AllocateStream(size_t size,
+                                                          size_t* offset) {
+  if (size > kStreamBufferSize || !EnsureStreamBuffer()) return nullptr;
+  size_t begin =
+      (m_StreamHead + kStreamAlignment - 1) & ~(kStreamAlignment - 1);
+  if (begin + size > kStreamBufferSize) begin = 0;
+  RetireStreamRegions(begin, size);
+  m_StreamHead = begin + size;
+  *offset = begin;
+  return m_StreamMapped + begin;
+}
+
+void TextureSubPluginAPI_OpenGLCoreES::ReleaseStreamBuffer() {
+#if SUPPORT_GL_STREAM_BUFFER
+  for (const StreamRegion& region : m_StreamInFlight)
+    glDeleteSync(region.fence);
+  m_StreamInFlight.clear();
+  if (m_StreamBuffer) {
+    GLint previous_buffer;
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &previous_buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_StreamBuffer);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER,
+                 static_cast<GLuint>(previous_buffer) == m_StreamBuffer
+                     ? 0
+                     : static_cast<GLuint>(previous_buffer));
+    glDeleteBuffers(1, &m_StreamBuffer);
+  }
+  m_StreamBuffer = 0;
+  m_StreamMapped = nullptr;
+  m_StreamSupport = 0;
+#endif
+}
+
+void TextureSubPluginAPI_OpenGLCoreES::UploadSubImage3D(
     void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
     int32_t width, int32_t height, int32_t depth, void* data_ptr, int32_t level,
-    Format format) {
+    Format format, const SourceDescriptor* source) {
   GLuint gltex = (GLuint)(size_t)(texture_handle);
 
-  GLenum gltype;
-  switch (format) {
-    case Format::R8_UINT:
-      gltype = GL_UNSIGNED_BYTE;
-      break;
-    case Format::R16_UINT:
-      gltype = GL_UNSIGNED_SHORT;
-      break;
-    default:
-      return;
-      break;
+  GLint internal_format;
+  GLenum glformat, gltype;
+  if (!GetGLFormat(format, &internal_format, &glformat, &gltype)) return;
+
+  const bool native = !source || source->encoding == SOURCE_ENCODING_NATIVE;
+  if (!native && IsStridedSource(source, width, height)) {
+    PLUGIN_LOG_ERROR("strides are only supported for native sources");
+    return;
   }
+  const GLint row_length = source ? source->row_length : 0;
+  const GLint image_height = source ? source->image_height : 0;
+  const size_t size =
+      static_cast<size_t>(width) * height * depth * FormatTexelSize(format);
+
+  size_t offset;
+  if (uint8_t* mapped = AllocateStream(size, &offset)) {
+    // the data is copied (converted, packed) into the ring and the upload
+    // reads it from there once the GPU gets to it - nothing blocks here
+    TraceScope trace("gl", "StreamSubImage3D", "bytes", size);
+    if (!native) {
+      if (!ConvertSource(*source, data_ptr, 0, size / FormatTexelSize(format),
+                         format, mapped)) {
+        PLUGIN_LOG_ERROR(
+            "unsupported conversion from source encoding %u to texture "
+            "format: %d",
+            source->encoding, format);
+        return;
+      }
+    } else if (IsStridedSource(source, width, height)) {
+      CopyStrided(data_ptr, FormatTexelSize(format), width, height, depth,
+                  row_length, image_height, mapped);
+    } else {
+      StreamCopy(mapped, data_ptr, size);
+    }
 
-  glBindTexture(GL_TEXTURE_3D, gltex);
-  glTexSubImage3D(GL_TEXTURE_3D, level, xoffset, yoffset, zoffset, width,
-                  height, depth, GL_RED, gltype, data_ptr);
+    UnpackState unpack(m_StreamBuffer, 0, 0);
+    glBindTexture(GL_TEXTURE_3D, gltex);
+    glTexSubImage3D(GL_TEXTURE_3D, level, xoffset, yoffset, zoffset, width,
+                    height, depth, glformat, gltype,
+                    reinterpret_cast<const void*>(offset));
+#if SUPPORT_GL_STREAM_BUFFER
+    m_StreamInFlight.push_back(
+        {offset, size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+#endif
+  } else if (native) {
+    // GL reads strided regions directly from client memory
+    UnpackState unpack(0, row_length, image_height);
+    glBindTexture(GL_TEXTURE_3D, gltex);
+    glTexSubImage3D(GL_TEXTURE_3D, level, xoffset, yoffset, zoffset, width,
+                    height, depth, glformat, gltype, data_ptr);
+  } else {
+    TextureSubPluginAPI::TextureSubImage3DFromSource(
+        texture_handle, xoffset, yoffset, zoffset, width, height, depth,
+        data_ptr, level, format, *source);
+    return;
+  }
 
   GLenum err;
   if ((err = glGetError()) != GL_NO_ERROR) {
-    std::ostringstream ss;
-    ss << __FUNCTION__ << " error(s): 0x" << std::hex << err;
-    while ((err = glGetError()) != GL_NO_ERROR) {
-      ss << " 0x" << err;
-    }
-    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    char errors[64];
+    FormatGLErrors(err, errors, sizeof(errors));
+    PLUGIN_LOG_ERROR("error(s): %s", errors);
     return;
   }
 }
 
+void TextureSubPluginAPI_OpenGLCoreES::TextureSubImage3D(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, void* data_ptr, int32_t level,
+    Format format) {
+  UploadSubImage3D(texture_handle, xoffset, yoffset, zoffset, width, height,
+                   depth, data_ptr, level, format, nullptr);
+}
+
+void TextureSubPluginAPI_OpenGLCoreES::TextureSubImage3DFromSource(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, void* data_ptr, int32_t level,
+    Format format, const SourceDescriptor& source) {
+  UploadSubImage3D(texture_handle, xoffset, yoffset, zoffset, width, height,
+                   depth, data_ptr, level, format, &source);
+}
+
 void TextureSubPluginAPI_OpenGLCoreES::TextureSubImage2D(
     void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t width,
     int32_t height, void* data_ptr, int32_t level, Format format) {
   GLuint gltex = (GLuint)(size_t)(texture_handle);
 
-  GLenum gltype;
-  switch (format) {
-    case Format::R8_UINT:
-      gltype = GL_UNSIGNED_BYTE;
-      break;
-    case Format::R16_UINT:
-      gltype = GL_UNSIGNED_SHORT;
-      break;
-    default:
-      return;
-      break;
-  }
+  GLint internal_format;
+  GLenum glformat, gltype;
+  if (!GetGLFormat(format, &internal_format, &glformat, &gltype)) return;
 
+  GLint unpack_alignment;
+  glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpack_alignment);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
   glBindTexture(GL_TEXTURE_2D, gltex);
-  glTexSubImage2D(GL_TEXTURE_2D, level, xoffset, yoffset, width, height, GL_RED,
-                  gltype, data_ptr);
+  glTexSubImage2D(GL_TEXTURE_2D, level, xoffset, yoffset, width, height,
+                  glformat, gltype, data_ptr);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
 }
 
 void TextureSubPluginAPI_OpenGLCoreES::CreateTexture3D(uint32_t texture_id,
@@ -168,36 +442,19 @@ void TextureSubPluginAPI_OpenGLCoreES::CreateTexture3D(uint32_t texture_id,
                                                        Format format) {
   if (auto search = m_CreatedTextures.find(texture_id);
       search != m_CreatedTextures.end()) {
-    UNITY_LOG_ERROR(g_Log,
-                    "a texture with the provided texture ID already exists!");
+    PLUGIN_LOG_ERROR("a texture with the provided texture ID already exists!");
     return;
   }
 
   int MAX_DIM_SIZE;
   glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &MAX_DIM_SIZE);
-  {
-    std::ostringstream ss;
-    ss << "GL_MAX_3D_TEXTURE_SIZE: " << MAX_DIM_SIZE;
-    UNITY_LOG(g_Log, ss.str().c_str());
-  }
+  PLUGIN_LOG("GL_MAX_3D_TEXTURE_SIZE: %d", MAX_DIM_SIZE);
 
   GLint internal_format;
-  GLenum type;
-  switch (format) {
-    case R8_UINT:
-      internal_format = GL_R8;
-      type = GL_UNSIGNED_BYTE;
-      break;
-    case R16_UINT:
-      internal_format = GL_R16;
-      type = GL_UNSIGNED_SHORT;
-      break;
-    default: {
-      std::ostringstream ss;
-      ss << __FUNCTION__ << " unsupported texture format: " << format;
-      UNITY_LOG_ERROR(g_Log, ss.str().c_str());
-      return;
-    }
+  GLenum gl_format, type;
+  if (!GetGLFormat(format, &internal_format, &gl_format, &type)) {
+    PLUGIN_LOG_ERROR("unsupported texture format: %d", format);
+    return;
   }
 
   GLuint gl_texture;
@@ -211,31 +468,19 @@ void TextureSubPluginAPI_OpenGLCoreES::CreateTexture3D(uint32_t texture_id,
   glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-  {
-    std::ostringstream ss;
-    ss << "supplied width: " << width << " height: " << height
-       << " depth: " << depth;
-    UNITY_LOG(g_Log, ss.str().c_str());
-  }
+  PLUGIN_LOG("supplied width: %u height: %u depth: %u", width, height, depth);
 
   glTexStorage3D(GL_TEXTURE_3D, 1, internal_format, width, height, depth);
 
   GLenum err;
   if ((err = glGetError()) != GL_NO_ERROR) {
-    std::ostringstream ss;
-    ss << __FUNCTION__ << " error(s): 0x" << std::hex << err;
-    while ((err = glGetError()) != GL_NO_ERROR) {
-      ss << " 0x" << err;
-    }
-    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    char errors[64];
+    FormatGLErrors(err, errors, sizeof(errors));
+    PLUGIN_LOG_ERROR("error(s): %s", errors);
     return;
   }
 
-  {
-    std::ostringstream ss;
-    ss << "created texture 3D glTexImage3D texture handle: " << gl_texture;
-    UNITY_LOG(g_Log, ss.str().c_str());
-  }
+  PLUGIN_LOG("created texture 3D glTexImage3D texture handle: %u", gl_texture);
 
   m_CreatedTextures.insert({texture_id, gl_texture});
 }
@@ -246,7 +491,7 @@ void* TextureSubPluginAPI_OpenGLCoreES::RetrieveCreatedTexture3D(
       search != m_CreatedTextures.end()) {
     return reinterpret_cast<void*>(search->second);
   }
-  UNITY_LOG_ERROR(g_Log, "no texture was created with the provided texture ID");
+  PLUGIN_LOG_ERROR("no texture was created with the provided texture ID");
   return nullptr;
 }
 
@@ -254,11 +499,11 @@ void TextureSubPluginAPI_OpenGLCoreES::DestroyTexture3D(uint32_t texture_id) {
   if (auto search = m_CreatedTextures.find(texture_id);
       search != m_CreatedTextures.end()) {
     glDeleteTextures(1, &(search->second));
+    m_CreatedTextures.erase(search);
     return;
   }
-  UNITY_LOG_ERROR(g_Log,
-                  "failed to destroy texture 3D (texture ID does not refer to "
-                  "a created texture 3D)");
+  PLUGIN_LOG_ERROR("failed to destroy texture 3D (texture ID does not refer "
+                   "to a created texture 3D)");
 }
 
 #endif  // #if SUPPORT_OPENGL_CORE
@@ -2,12 +2,25 @@
 #include "TextureSubPluginAPI.hpp"
 #if SUPPORT_VULKAN
 
+#include "BrickStatistics.hpp"
+#include "ConversionKernels.hpp"
+#include "PluginEvents.hpp"
+#include "PluginLog.hpp"
+#include "Tracing.hpp"
+#include "VolumeContainer.hpp"
+
 #include <math.h>
+#include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
-#include <sstream>
+#include <mutex>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -18,10 +31,17 @@
 
 #define UNITY_USED_VULKAN_API_FUNCTIONS(apply) \
   apply(vkCreateInstance);                     \
+  apply(vkCreateDevice);                       \
+  apply(vkEnumerateDeviceExtensionProperties); \
   apply(vkCmdBeginRenderPass);                 \
+  apply(vkCmdEndRenderPass);                   \
+  apply(vkQueueSubmit);                        \
   apply(vkCreateBuffer);                       \
   apply(vkCreateImage);                        \
   apply(vkGetPhysicalDeviceMemoryProperties);  \
+  apply(vkGetPhysicalDeviceMemoryProperties2); \
+  apply(vkGetPhysicalDeviceProperties);        \
+  apply(vkGetPhysicalDeviceProperties2);       \
   apply(vkGetImageMemoryRequirements);         \
   apply(vkGetBufferMemoryRequirements);        \
   apply(vkMapMemory);                          \
@@ -35,11 +55,60 @@
   apply(vkQueueWaitIdle);                      \
   apply(vkDeviceWaitIdle);                     \
   apply(vkCmdCopyBufferToImage);               \
-  apply(vkFlushMappedMemoryRanges);
+  apply(vkCmdCopyImageToBuffer);               \
+  apply(vkCmdCopyImage);                       \
+  apply(vkCmdClearColorImage);                 \
+  apply(vkCmdFillBuffer);                      \
+  apply(vkCmdPipelineBarrier);                 \
+  apply(vkFlushMappedMemoryRanges);            \
+  apply(vkInvalidateMappedMemoryRanges);       \
+  apply(vkCreateQueryPool);                    \
+  apply(vkDestroyQueryPool);                   \
+  apply(vkCmdResetQueryPool);                  \
+  apply(vkCmdWriteTimestamp);                  \
+  apply(vkGetQueryPoolResults);                \
+  apply(vkCmdCopyBuffer);                      \
+  apply(vkGetBufferDeviceAddress);             \
+  apply(vkGetMemoryHostPointerPropertiesEXT);  \
+  apply(vkGetPhysicalDeviceFormatProperties);  \
+  apply(vkCreateImageView);                    \
+  apply(vkDestroyImageView);                   \
+  apply(vkCreateSampler);                      \
+  apply(vkDestroySampler);                     \
+  apply(vkCreateShaderModule);                 \
+  apply(vkDestroyShaderModule);                \
+  apply(vkCreateDescriptorSetLayout);          \
+  apply(vkDestroyDescriptorSetLayout);         \
+  apply(vkCreatePipelineLayout);               \
+  apply(vkDestroyPipelineLayout);              \
+  apply(vkCreateComputePipelines);             \
+  apply(vkDestroyPipeline);                    \
+  apply(vkCreateDescriptorPool);               \
+  apply(vkDestroyDescriptorPool);              \
+  apply(vkResetDescriptorPool);                \
+  apply(vkAllocateDescriptorSets);             \
+  apply(vkUpdateDescriptorSets);               \
+  apply(vkCmdBindPipeline);                    \
+  apply(vkCmdBindDescriptorSets);              \
+  apply(vkCmdPushConstants);                   \
+  apply(vkCmdDispatch);
+
+// VK_EXT_host_image_copy needs Vulkan headers 1.3.268 or newer
+#ifdef VK_EXT_host_image_copy
+#define SUPPORT_HOST_IMAGE_COPY 1
+#define HOST_IMAGE_COPY_API_FUNCTIONS(apply)        \
+  apply(vkGetPhysicalDeviceImageFormatProperties2); \
+  apply(vkCopyMemoryToImageEXT);                    \
+  apply(vkTransitionImageLayoutEXT);
+#else
+#define SUPPORT_HOST_IMAGE_COPY 0
+#define HOST_IMAGE_COPY_API_FUNCTIONS(apply)
+#endif
 
 #define VULKAN_DEFINE_API_FUNCPTR(func) static PFN_##func func
 VULKAN_DEFINE_API_FUNCPTR(vkGetInstanceProcAddr);
 UNITY_USED_VULKAN_API_FUNCTIONS(VULKAN_DEFINE_API_FUNCPTR);
+HOST_IMAGE_COPY_API_FUNCTIONS(VULKAN_DEFINE_API_FUNCPTR);
 #undef VULKAN_DEFINE_API_FUNCPTR
 
 struct VulkanBuffer {
@@ -49,6 +118,120 @@ struct VulkanBuffer {
   VkDeviceSize sizeInBytes;
   VkDeviceSize deviceMemorySize;
   VkMemoryPropertyFlags deviceMemoryFlags;
+  uint32_t deviceMemoryHeap;
+};
+
+// a buffer created by CreateBuffer
+struct VulkanStorageBuffer {
+  VulkanBuffer buffer;
+  // 0 if buffer device addresses are not supported
+  VkDeviceAddress deviceAddress;
+};
+
+// caller memory imported with VK_EXT_external_memory_host (see
+// RegisterHostMemory)
+struct VulkanHostMemory {
+  VulkanBuffer buffer;
+  // start of the imported (aligned) part of the registered range
+  const uint8_t* hostPointer;
+};
+
+struct VulkanTile {
+  // a VkImage pointer has to be stored instead of a VkImage because
+  // the nativeTex parameter of the Texture3D.CreateExternalTexture call
+  // expects a VkImage*
+  std::unique_ptr<VkImage> image;
+  VkDeviceMemory deviceMemory;
+  VkDeviceSize deviceMemorySize;
+  uint32_t deviceMemoryHeap;
+  // region of the (stored) volume that is covered by this tile
+  VkOffset3D offset;
+  VkExtent3D extent;
+  // layout the image is left in by the last recorded plugin command
+  VkImageLayout layout;
+  // frame in which the last plugin command that accesses the image was
+  // recorded (host copies have to wait until it completed)
+  unsigned long long lastRecordedFrame;
+  // view used by compute passes (created on first use)
+  VkImageView view;
+};
+
+struct VulkanTexture3D {
+  // volumes larger than maxImageDimension3D are split into several tiles that
+  // overlap by one voxel so that filtering never has to cross a tile border.
+  // Tile (i, j, k) starts at (i, j, k) * tileStride
+  std::vector<VulkanTile> tiles;
+  VkExtent3D tileCount;
+  VkExtent3D tileStride;
+  // extent and format of the image (may differ from the requested ones if
+  // the memory budget policy degraded the texture)
+  VkExtent3D extent;
+  Format format;
+  uint32_t downsampleLevel;
+  uint16_t windowMin;
+  uint16_t windowMax;
+  // the tiles were created with host transfer usage (see HostCopySubImage3D)
+  bool hostImageCopy;
+  // the tiles' memory is host visible (UMA)
+  bool hostVisible;
+  // usage of the tiles in addition to kTileImageUsage (e.g., storage for
+  // gradient textures)
+  VkImageUsageFlags extraUsage;
+  // extent and format as requested by the caller of CreateTexture3D
+  VkExtent3D requestedExtent;
+  Format requestedFormat;
+  // per-brick statistics accumulated during uploads (if configured). Shared
+  // because uploads keep using a table while it may be reconfigured
+  std::shared_ptr<BrickStatisticsTable> statistics;
+};
+
+// A range of host visible memory that an upload is copied through (see
+// AllocateStaging)
+struct VulkanStaging {
+  VkBuffer buffer;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  // mapped memory of the range (i.e., at offset)
+  uint8_t* mapped;
+  VkDeviceMemory deviceMemory;
+  bool coherent;
+};
+
+// Persistently mapped staging memory that uploads are sub-allocated from.
+// Space is allocated in FIFO order and reclaimed from the front once the
+// frames that read it have completed
+struct VulkanUploadRing {
+  struct Allocation {
+    unsigned long long frameNumber;
+    VkDeviceSize offset;
+    VkDeviceSize end;
+  };
+  VulkanBuffer buffer;
+  std::deque<Allocation> allocations;
+};
+
+struct VulkanReadbackRing;
+
+struct VulkanReadback {
+  uint32_t id;
+  // nullptr if the readback failed
+  VulkanReadbackRing* ring;
+  VkDeviceSize offset;
+  // size of the texel data and of the (aligned) ring allocation
+  VkDeviceSize size;
+  VkDeviceSize allocationSize;
+  // the copy has completed once Unity's safe frame number reaches this
+  unsigned long long frameNumber;
+  ReadbackStatus status;
+  bool released;
+};
+
+// Persistently mapped host memory that readbacks are copied into. Space is
+// allocated in FIFO order and reclaimed from the front once the oldest
+// readbacks have been released
+struct VulkanReadbackRing {
+  VulkanBuffer buffer;
+  std::deque<std::shared_ptr<VulkanReadback>> allocations;
 };
 
 class TextureSubPluginAPI_Vulkan : public TextureSubPluginAPI {
@@ -64,16 +247,132 @@ class TextureSubPluginAPI_Vulkan : public TextureSubPluginAPI {
   virtual void DestroyTexture3D(uint32_t texture_id);
 
   // TODO: implement TextureSubImage2D for Vulkan API
-  virtual void TextureSubImage2D(void* texture_handle, int32_t xoffset,
-                                 int32_t yoffset, int32_t width, int32_t height,
-                                 void* data_ptr, int32_t level, Format format) {
-  }
+  virtual void TextureSubImage2D(void* /*texture_handle*/,
+                                 int32_t /*xoffset*/, int32_t /*yoffset*/,
+                                 int32_t /*width*/, int32_t /*height*/,
+                                 void* /*data_ptr*/, int32_t /*level*/,
+                                 Format /*format*/) {}
 
   virtual void TextureSubImage3D(void* texture_handle, int32_t xoffset,
                                  int32_t yoffset, int32_t zoffset,
                                  int32_t width, int32_t height, int32_t depth,
                                  void* data_ptr, int32_t level, Format format);
 
+  virtual void TextureSubImage3DFromSource(void* texture_handle,
+                                           int32_t xoffset, int32_t yoffset,
+                                           int32_t zoffset, int32_t width,
+                                           int32_t height, int32_t depth,
+                                           void* data_ptr, int32_t level,
+                                           Format format,
+                                           const SourceDescriptor& source);
+
+  virtual void TextureSubImage3DByID(uint32_t texture_id, int32_t xoffset,
+                                     int32_t yoffset, int32_t zoffset,
+                                     int32_t width, int32_t height,
+                                     int32_t depth, void* data_ptr,
+                                     int32_t level, Format format,
+                                     const SourceDescriptor* source,
+                                     uint32_t flags);
+
+  virtual void TextureSubImage3DBatch(uint32_t texture_id,
+                                      const TextureUploadRegion* regions,
+                                      uint32_t count, Format format);
+
+  virtual void TextureSubImage3DSlices(uint32_t texture_id, int32_t xoffset,
+                                       int32_t yoffset, int32_t zoffset,
+                                       int32_t width, int32_t height,
+                                       int32_t depth, const SliceSource* slices,
+                                       Format format, uint32_t flags);
+
+  virtual void* RetrieveCreatedTexture3DTile(uint32_t texture_id,
+                                             uint32_t tile_index);
+
+  virtual uint32_t GetTextureTileDescriptors(uint32_t texture_id,
+                                             TileDescriptor* tiles,
+                                             uint32_t max_tiles);
+
+  virtual uint32_t GetMemoryBudget(MemoryHeapBudget* heaps, uint32_t max_heaps);
+
+  virtual void SetMemoryBudgetPolicy(const MemoryBudgetPolicy& policy);
+
+  virtual bool GetTexture3DInfo(uint32_t texture_id, Texture3DInfo* info);
+
+  virtual bool ConfigureBrickStatistics(uint32_t texture_id,
+                                        const BrickStatisticsConfig& config);
+
+  virtual uint32_t GetBrickStatistics(uint32_t texture_id,
+                                      BrickStatistics* stats,
+                                      uint32_t max_bricks, uint32_t* histograms,
+                                      uint32_t max_histogram_entries);
+
+  virtual uint32_t GetOccupancyBitmap(uint32_t texture_id, uint32_t* words,
+                                      uint32_t max_words);
+
+  virtual void UploadBrickStatisticsTexture(uint32_t texture_id,
+                                            uint32_t stats_texture_id);
+
+  virtual void ReadbackTexture3D(uint32_t texture_id, uint32_t readback_id,
+                                 int32_t xoffset, int32_t yoffset,
+                                 int32_t zoffset, int32_t width,
+                                 int32_t height, int32_t depth);
+
+  virtual void ProcessReadbacks();
+
+  virtual uint32_t GetReadback(uint32_t readback_id, const void** data,
+                               uint64_t* size);
+
+  virtual void ReleaseReadback(uint32_t readback_id);
+
+  virtual void SetReadbackCallback(ReadbackCallback callback);
+
+  virtual void InterceptTracedCalls(bool enabled);
+
+  virtual bool UpdateFrameNumbers(unsigned long long* current_frame,
+                                  unsigned long long* safe_frame);
+
+  virtual void CopyTexture3DRegions(const TextureCopyRegion* regions,
+                                    uint32_t count);
+
+  virtual void CreateBuffer(uint32_t buffer_id, uint64_t size);
+
+  virtual void DestroyBuffer(uint32_t buffer_id);
+
+  virtual void BufferSubData(uint32_t buffer_id, uint64_t offset,
+                             uint64_t size, const void* data_ptr);
+
+  virtual void BufferSubDataBatch(uint32_t buffer_id,
+                                  const BufferWriteRange* ranges,
+                                  uint32_t count);
+
+  virtual void* RetrieveCreatedBuffer(uint32_t buffer_id);
+
+  virtual bool GetBufferInfo(uint32_t buffer_id, BufferInfo* info);
+
+  virtual bool RegisterHostMemory(uint32_t memory_id, void* ptr,
+                                  uint64_t size);
+
+  virtual void UnregisterHostMemory(uint32_t memory_id);
+
+  virtual void SetHostImageCopyPolicy(const HostImageCopyPolicy& policy);
+
+  virtual void BenchmarkUploadPaths(uint32_t width, uint32_t height,
+                                    uint32_t depth, Format format,
+                                    uint32_t count);
+
+  virtual uint32_t GetUploadBenchmark(UploadBenchmark* result);
+
+  virtual void TextureSubImage3DBitpacked(uint32_t texture_id, int32_t xoffset,
+                                          int32_t yoffset, int32_t zoffset,
+                                          int32_t width, int32_t height,
+                                          int32_t depth, const uint32_t* words,
+                                          uint32_t bits, uint32_t min,
+                                          Format format);
+
+  virtual void ComputeGradients(uint32_t src_texture_id,
+                                uint32_t dst_texture_id, Format dst_format,
+                                float magnitude_scale, const TextureBox* boxes,
+                                uint32_t count);
+
   virtual void ProcessDeviceEvent(UnityGfxDeviceEventType type,
                                   IUnityInterfaces* interfaces);
 
@@ -82,26 +381,194 @@ class TextureSubPluginAPI_Vulkan : public TextureSubPluginAPI {
   typedef std::map<unsigned long long, VulkanBuffers> DeleteQueue;
 
  private:
-  bool CreateVulkanBuffer(size_t bytes, VulkanBuffer* buffer,
-                          VkBufferUsageFlags usage);
+  bool CreateVulkanBuffer(
+      size_t bytes, VulkanBuffer* buffer, VkBufferUsageFlags usage,
+      VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
   void ImmediateDestroyVulkanBuffer(const VulkanBuffer& buffer);
   void SafeDestroy(unsigned long long frameNumber, const VulkanBuffer& buffer);
   void GarbageCollect(bool force = false);
+  bool AllocateStaging(VkDeviceSize size, unsigned long long frame_number,
+                       VulkanStaging* staging);
+  void FlushStaging(const VulkanStaging& staging);
+
+  bool AllocateDeviceMemory(VkDeviceSize size, uint32_t memory_type,
+                            VkDeviceMemory* memory,
+                            VkMemoryAllocateFlags flags = 0);
+  void FreeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size,
+                        uint32_t heap);
+  void QueryHeapBudgets(VkDeviceSize* budgets, VkDeviceSize* usages);
+  bool FitsIntoBudget(uint32_t heap, VkDeviceSize size,
+                      const MemoryBudgetPolicy& policy);
+  bool FindCreatedTexture3D(void* texture_handle, uint32_t* texture_id);
+  void CreateTexture3DWithUsage(uint32_t texture_id, uint32_t width,
+                                uint32_t height, uint32_t depth, Format format,
+                                VkImageUsageFlags extra_usage);
+  bool CreateTileImages(VulkanTexture3D* texture, VkFormat format,
+                        std::vector<VkMemoryRequirements>* requirements);
+  void DestroyTile(VulkanTile* tile);
+  void DestroyTileImages(VulkanTexture3D* texture);
+  void TransitionTiles(VkCommandBuffer command_buffer,
+                       unsigned long long frame_number,
+                       VulkanTile* const* tiles, size_t count,
+                       VkImageLayout new_layout);
+  bool StageSubImage3D(const VulkanTexture3D* texture,
+                       const VkOffset3D& src_offset,
+                       const VkExtent3D& src_extent, const void* data_ptr,
+                       Format format, const SourceDescriptor* source,
+                       unsigned long long frame_number, VkOffset3D* dst_offset,
+                       VkExtent3D* dst_extent, size_t* texel_size,
+                       VulkanStaging* staging);
+  bool QueryHostImageCopySupport();
+  bool SupportsHostTransfer(VkFormat format, bool* optimal_device_access);
+  bool HostCopySubImage3D(VulkanTexture3D* texture,
+                          const VkOffset3D& src_offset,
+                          const VkExtent3D& src_extent, const void* data_ptr,
+                          Format format, const SourceDescriptor* source,
+                          unsigned long long safe_frame_number);
+  void CompleteBenchmark(unsigned long long safe_frame_number);
+  bool ImportedCopySubImage3D(VkCommandBuffer command_buffer,
+                              unsigned long long frame_number,
+                              VulkanTexture3D* texture,
+                              const VkOffset3D& src_offset,
+                              const VkExtent3D& src_extent, const void* src_ptr,
+                              const void* packed_ptr, Format format,
+                              const SourceDescriptor* source);
+  bool RecordConstantSubImage3D(VkCommandBuffer command_buffer,
+                                unsigned long long frame_number,
+                                VulkanTexture3D* texture,
+                                const VkOffset3D& src_offset,
+                                const VkExtent3D& src_extent, Format format,
+                                uint32_t texel);
+  bool AllocateReadback(VulkanReadback* readback);
+  VkPipeline CreateComputePipeline(const uint32_t* code, size_t code_size,
+                                   VkPipelineLayout layout);
+  bool CreateGradientPipelines();
+  bool CreateDecodePipeline();
+  void DestroyComputeResources();
+  VkImageView TileView(VulkanTile* tile, Format format);
+  VkDescriptorSet AllocateDescriptorSet(VkDescriptorSetLayout layout,
+                                        unsigned long long frame_number);
+  void CompleteReadbacks(unsigned long long safe_frame_number);
+  void UploadSubImage3D(void* texture_handle, int32_t xoffset, int32_t yoffset,
+                        int32_t zoffset, int32_t width, int32_t height,
+                        int32_t depth, void* data_ptr, int32_t level,
+                        Format format, const SourceDescriptor* source);
 
  private:
   IUnityGraphicsVulkan* m_UnityVulkan;
   UnityVulkanInstance m_Instance;
-  VulkanBuffer m_TextureStagingBuffer;
+  // staging memory of uploads (see AllocateStaging)
+  VulkanUploadRing m_UploadRing;
+  // device local buffer that constant regions are filled into on the GPU
+  VulkanBuffer m_ConstantFillBuffer;
   std::map<unsigned long long, VulkanBuffers> m_DeleteQueue;
+  // tiles of destroyed textures, released once their last frame completed
+  std::map<unsigned long long, std::vector<VulkanTile>> m_TileDeleteQueue;
 
-  // a VkImage pointer has to be stored instead of a VkImage because
-  // the nativeTex parameter of the Texture3D.CreateExternalTexture call
-  // expects a VkImage*
-  std::unordered_map<uint32_t,
-                     std::pair<std::unique_ptr<VkImage>, VkDeviceMemory>>
-      m_CreatedTextures;
+  VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+  uint32_t m_MaxImageDimension3D;
+  VkDeviceSize m_NonCoherentAtomSize;
+  bool m_MemoryBudgetSupported;
+  // memory allocated by this plugin per heap
+  std::atomic<uint64_t> m_HeapUsage[VK_MAX_MEMORY_HEAPS];
+  std::mutex m_PolicyMutex;
+  MemoryBudgetPolicy m_BudgetPolicy;
+  HostImageCopyPolicy m_HostImageCopyPolicy;
+  // VK_EXT_host_image_copy is enabled and can write into images that are in
+  // VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+  bool m_HostImageCopySupported;
+  // nanoseconds per timestamp tick (0 if timestamps are not supported)
+  float m_TimestampPeriod;
+
+  // the last upload benchmark. The scratch tile and the queries are released
+  // once the frame that the staging copies were recorded in has completed
+  std::mutex m_BenchmarkMutex;
+  UploadBenchmark m_Benchmark;
+  VulkanTile m_BenchmarkTile;
+  VkQueryPool m_BenchmarkQueries;
+  unsigned long long m_BenchmarkFrame;
+
+  // guards m_CreatedTextures against concurrent modification (render thread)
+  // and lookups from outside of the render thread
+  std::mutex m_TexturesMutex;
+  std::unordered_map<uint32_t, VulkanTexture3D> m_CreatedTextures;
+  // IDs of created textures keyed by the handles of their tiles (both the
+  // VkImage* and the VkImage, see FindCreatedTexture3D)
+  std::unordered_map<void*, uint32_t> m_TextureHandles;
+
+  // the bufferDeviceAddress feature is enabled
+  bool m_BufferDeviceAddressSupported;
+  // same as m_TexturesMutex for m_CreatedBuffers
+  std::mutex m_BuffersMutex;
+  std::unordered_map<uint32_t, VulkanStorageBuffer> m_CreatedBuffers;
+
+  // gradient compute pass (see ComputeGradients), created on first use. One
+  // pipeline per destination format (RGBA8_UINT, RG16_UINT)
+  VkSampler m_NearestSampler;
+  VkDescriptorSetLayout m_GradientSetLayout;
+  VkPipelineLayout m_GradientPipelineLayout;
+  VkPipeline m_GradientPipelines[2];
+  // decoding of bit packed uploads (see TextureSubImage3DBitpacked), created
+  // on first use. Regions are decoded into m_DecodeBuffer and copied from
+  // there into the tiles
+  VkDescriptorSetLayout m_DecodeSetLayout;
+  VkPipelineLayout m_DecodePipelineLayout;
+  VkPipeline m_DecodePipeline;
+  VulkanBuffer m_DecodeBuffer;
+  // descriptor pools are reset and reused once their frame has completed
+  std::vector<VkDescriptorPool> m_FreeDescriptorPools;
+  std::map<unsigned long long, std::vector<VkDescriptorPool>>
+      m_UsedDescriptorPools;
+
+  // VK_EXT_external_memory_host is enabled
+  bool m_ExternalMemoryHostSupported;
+  VkDeviceSize m_HostPointerAlignment;
+  // registered from any thread, unregistered on the render thread
+  std::mutex m_HostMemoryMutex;
+  std::unordered_map<uint32_t, VulkanHostMemory> m_HostMemory;
+
+  // guards the readbacks against queries/releases from outside of the render
+  // thread. The last ring is the one new readbacks are allocated from
+  std::mutex m_ReadbackMutex;
+  std::unordered_map<uint32_t, std::shared_ptr<VulkanReadback>> m_Readbacks;
+  std::vector<std::unique_ptr<VulkanReadbackRing>> m_ReadbackRings;
+  ReadbackCallback m_ReadbackCallback;
+
+  // vkCmdBeginRenderPass, vkCmdEndRenderPass and vkQueueSubmit
+  static const size_t kTracedCallCount = 3;
+  bool m_TracedCallsIntercepted;
+  PFN_vkVoidFunction m_UntracedCalls[kTracedCallCount];
 };
 
+// optional device extensions that are enabled (if supported) by intercepting
+// Unity's vkCreateDevice call. This only works if the plugin is loaded before
+// the Vulkan device is created
+static const char* const s_OptionalDeviceExtensions[] = {
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+    // core in Vulkan 1.2
+    VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
+    // dependency of VK_EXT_external_memory_host (core in Vulkan 1.1)
+    VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
+    VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME,
+#if SUPPORT_HOST_IMAGE_COPY
+    // dependencies of VK_EXT_host_image_copy (core in Vulkan 1.3)
+    VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME,
+    VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME,
+    VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME,
+#endif
+};
+static std::vector<std::string> s_EnabledDeviceExtensions;
+// the hostImageCopy/bufferDeviceAddress features were enabled along with
+// their extensions (or by Unity)
+static bool s_HostImageCopyFeatureEnabled = false;
+static bool s_BufferDeviceAddressFeatureEnabled = false;
+
+static bool IsDeviceExtensionEnabled(const char* name) {
+  return std::find(s_EnabledDeviceExtensions.begin(),
+                   s_EnabledDeviceExtensions.end(),
+                   name) != s_EnabledDeviceExtensions.end();
+}
+
 static void LoadVulkanAPI(PFN_vkGetInstanceProcAddr getInstanceProcAddr,
                           VkInstance instance) {
   if (!vkGetInstanceProcAddr && getInstanceProcAddr)
@@ -114,32 +581,54 @@ static void LoadVulkanAPI(PFN_vkGetInstanceProcAddr getInstanceProcAddr,
 #define LOAD_VULKAN_FUNC(fn) \
   if (!fn) fn = (PFN_##fn)vkGetInstanceProcAddr(instance, #fn)
   UNITY_USED_VULKAN_API_FUNCTIONS(LOAD_VULKAN_FUNC);
+  HOST_IMAGE_COPY_API_FUNCTIONS(LOAD_VULKAN_FUNC);
 #undef LOAD_VULKAN_FUNC
+
+  // Vulkan 1.0 instances only expose the KHR variant
+  if (!vkGetPhysicalDeviceMemoryProperties2 && instance != VK_NULL_HANDLE)
+    vkGetPhysicalDeviceMemoryProperties2 =
+        (PFN_vkGetPhysicalDeviceMemoryProperties2)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+  if (!vkGetPhysicalDeviceProperties2 && instance != VK_NULL_HANDLE)
+    vkGetPhysicalDeviceProperties2 =
+        (PFN_vkGetPhysicalDeviceProperties2)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceProperties2KHR");
+  if (!vkGetBufferDeviceAddress && instance != VK_NULL_HANDLE)
+    vkGetBufferDeviceAddress =
+        (PFN_vkGetBufferDeviceAddress)vkGetInstanceProcAddr(
+            instance, "vkGetBufferDeviceAddressKHR");
+#if SUPPORT_HOST_IMAGE_COPY
+  if (!vkGetPhysicalDeviceImageFormatProperties2 && instance != VK_NULL_HANDLE)
+    vkGetPhysicalDeviceImageFormatProperties2 =
+        (PFN_vkGetPhysicalDeviceImageFormatProperties2)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceImageFormatProperties2KHR");
+#endif
 }
 
+// hooks of Unity's Vulkan calls, only installed while tracing is enabled.
+// Render passes are traced when they are recorded (on the thread recording
+// them), submits with the time spent in the driver
 static VKAPI_ATTR void VKAPI_CALL Hook_vkCmdBeginRenderPass(
     VkCommandBuffer commandBuffer,
     const VkRenderPassBeginInfo* pRenderPassBegin, VkSubpassContents contents) {
-  // Change this to 'true' to override the clear color with green
-  const bool allowOverrideClearColor = false;
-  if (pRenderPassBegin->clearValueCount <= 16 &&
-      pRenderPassBegin->clearValueCount > 0 && allowOverrideClearColor) {
-    VkClearValue clearValues[16] = {};
-    memcpy(clearValues, pRenderPassBegin->pClearValues,
-           pRenderPassBegin->clearValueCount * sizeof(VkClearValue));
-
-    VkRenderPassBeginInfo patchedBeginInfo = *pRenderPassBegin;
-    patchedBeginInfo.pClearValues = clearValues;
-    for (unsigned int i = 0; i < pRenderPassBegin->clearValueCount - 1; ++i) {
-      clearValues[i].color.float32[0] = 0.0;
-      clearValues[i].color.float32[1] = 1.0;
-      clearValues[i].color.float32[2] = 0.0;
-      clearValues[i].color.float32[3] = 1.0;
-    }
-    vkCmdBeginRenderPass(commandBuffer, &patchedBeginInfo, contents);
-  } else {
-    vkCmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
-  }
+  if (IsTracingEnabled())
+    TraceEvent('B', "unity", "RenderPass", TraceNow(), 0, "clear_values",
+               pRenderPassBegin->clearValueCount);
+  vkCmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+Hook_vkCmdEndRenderPass(VkCommandBuffer commandBuffer) {
+  vkCmdEndRenderPass(commandBuffer);
+  if (IsTracingEnabled()) TraceEvent('E', "unity", "RenderPass", TraceNow(), 0);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL
+Hook_vkQueueSubmit(VkQueue queue, uint32_t submitCount,
+                   const VkSubmitInfo* pSubmits, VkFence fence) {
+  TraceScope scope("unity", "vkQueueSubmit", "command_buffers",
+                   submitCount ? pSubmits[0].commandBufferCount : 0);
+  return vkQueueSubmit(queue, submitCount, pSubmits, fence);
 }
 
 static VKAPI_ATTR VkResult VKAPI_CALL Hook_vkCreateInstance(
@@ -153,6 +642,125 @@ static VKAPI_ATTR VkResult VKAPI_CALL Hook_vkCreateInstance(
   return result;
 }
 
+// returns the structure of the given type in a pNext chain (nullptr if there
+// is none)
+static const VkBaseInStructure* FindInChain(const void* next,
+                                            VkStructureType type) {
+  const VkBaseInStructure* chained =
+      static_cast<const VkBaseInStructure*>(next);
+  while (chained && chained->sType != type) chained = chained->pNext;
+  return chained;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL Hook_vkCreateDevice(
+    VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator, VkDevice* pDevice) {
+  std::vector<const char*> extensions(
+      pCreateInfo->ppEnabledExtensionNames,
+      pCreateInfo->ppEnabledExtensionNames +
+          pCreateInfo->enabledExtensionCount);
+
+  uint32_t available_count = 0;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &available_count,
+                                       NULL);
+  std::vector<VkExtensionProperties> available(available_count);
+  vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &available_count,
+                                       available.data());
+
+  for (const char* optional : s_OptionalDeviceExtensions) {
+    auto matches = [optional](const char* name) {
+      return strcmp(name, optional) == 0;
+    };
+    if (std::any_of(extensions.begin(), extensions.end(), matches)) continue;
+    if (std::any_of(available.begin(), available.end(),
+                    [&](const VkExtensionProperties& properties) {
+                      return matches(properties.extensionName);
+                    }))
+      extensions.push_back(optional);
+  }
+
+  VkDeviceCreateInfo patchedCreateInfo = *pCreateInfo;
+  patchedCreateInfo.enabledExtensionCount =
+      static_cast<uint32_t>(extensions.size());
+  patchedCreateInfo.ppEnabledExtensionNames = extensions.data();
+
+  // the extensions' features also have to be enabled (they are supported by
+  // every device that supports the extensions). Features that Unity already
+  // specifies are left as they are
+  auto is_enabled = [&extensions](const char* extension) {
+    return std::any_of(
+        extensions.begin(), extensions.end(),
+        [extension](const char* name) { return strcmp(name, extension) == 0; });
+  };
+
+  s_BufferDeviceAddressFeatureEnabled = false;
+  VkPhysicalDeviceBufferDeviceAddressFeatures buffer_device_address{};
+  buffer_device_address.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+  buffer_device_address.bufferDeviceAddress = VK_TRUE;
+  // the Vulkan 1.2 features must not be chained together with the features
+  // of extensions that were promoted to Vulkan 1.2
+  const VkBaseInStructure* chained_vulkan12 =
+      FindInChain(pCreateInfo->pNext,
+                  VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES);
+  const VkBaseInStructure* chained_buffer_device_address = FindInChain(
+      pCreateInfo->pNext,
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES);
+  if (chained_vulkan12) {
+    s_BufferDeviceAddressFeatureEnabled =
+        reinterpret_cast<const VkPhysicalDeviceVulkan12Features*>(
+            chained_vulkan12)
+            ->bufferDeviceAddress == VK_TRUE;
+  } else if (chained_buffer_device_address) {
+    s_BufferDeviceAddressFeatureEnabled =
+        reinterpret_cast<const VkPhysicalDeviceBufferDeviceAddressFeatures*>(
+            chained_buffer_device_address)
+            ->bufferDeviceAddress == VK_TRUE;
+  } else if (is_enabled(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME)) {
+    buffer_device_address.pNext = const_cast<void*>(patchedCreateInfo.pNext);
+    patchedCreateInfo.pNext = &buffer_device_address;
+    s_BufferDeviceAddressFeatureEnabled = true;
+  }
+
+  s_HostImageCopyFeatureEnabled = false;
+#if SUPPORT_HOST_IMAGE_COPY
+  VkPhysicalDeviceHostImageCopyFeaturesEXT host_image_copy{};
+  host_image_copy.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+  host_image_copy.hostImageCopy = VK_TRUE;
+  const VkBaseInStructure* chained_host_image_copy = FindInChain(
+      pCreateInfo->pNext,
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT);
+  if (chained_host_image_copy) {
+    s_HostImageCopyFeatureEnabled =
+        reinterpret_cast<const VkPhysicalDeviceHostImageCopyFeaturesEXT*>(
+            chained_host_image_copy)
+            ->hostImageCopy == VK_TRUE;
+  } else if (is_enabled(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME)) {
+    host_image_copy.pNext = const_cast<void*>(patchedCreateInfo.pNext);
+    patchedCreateInfo.pNext = &host_image_copy;
+    s_HostImageCopyFeatureEnabled = true;
+  }
+#endif
+
+  VkResult result =
+      vkCreateDevice(physicalDevice, &patchedCreateInfo, pAllocator, pDevice);
+  if (result != VK_SUCCESS) {
+    s_HostImageCopyFeatureEnabled = false;
+    s_BufferDeviceAddressFeatureEnabled = false;
+    // fall back to exactly what Unity asked for
+    extensions.assign(pCreateInfo->ppEnabledExtensionNames,
+                      pCreateInfo->ppEnabledExtensionNames +
+                          pCreateInfo->enabledExtensionCount);
+    result = vkCreateDevice(physicalDevice, pCreateInfo, pAllocator, pDevice);
+  }
+
+  if (result == VK_SUCCESS)
+    s_EnabledDeviceExtensions.assign(extensions.begin(), extensions.end());
+
+  return result;
+}
+
 static int FindMemoryTypeIndex(
     VkPhysicalDeviceMemoryProperties const& physicalDeviceMemoryProperties,
     VkMemoryRequirements const& memoryRequirements,
@@ -176,12 +784,13 @@ static int FindMemoryTypeIndex(
 }
 
 static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
-Hook_vkGetInstanceProcAddr(VkInstance device, const char* funcName) {
+Hook_vkGetInstanceProcAddr(VkInstance /*device*/, const char* funcName) {
   if (!funcName) return NULL;
 
 #define INTERCEPT(fn) \
   if (strcmp(funcName, #fn) == 0) return (PFN_vkVoidFunction) & Hook_##fn
   INTERCEPT(vkCreateInstance);
+  INTERCEPT(vkCreateDevice);
 #undef INTERCEPT
 
   return NULL;
@@ -210,7 +819,46 @@ TextureSubPluginAPI* CreateTextureSubPluginAPI_Vulkan() {
 }
 
 TextureSubPluginAPI_Vulkan::TextureSubPluginAPI_Vulkan()
-    : m_UnityVulkan(NULL), m_Instance{}, m_TextureStagingBuffer() {}
+    : m_UnityVulkan(NULL),
+      m_Instance{},
+      m_UploadRing(),
+      m_ConstantFillBuffer(),
+      m_MemoryProperties{},
+      m_MaxImageDimension3D(0),
+      m_NonCoherentAtomSize(1),
+      m_MemoryBudgetSupported(false),
+      m_BudgetPolicy{},
+      m_HostImageCopyPolicy{},
+      m_HostImageCopySupported(false),
+      m_TimestampPeriod(0.0f),
+      m_Benchmark{},
+      m_BenchmarkTile{},
+      m_BenchmarkQueries(VK_NULL_HANDLE),
+      m_BenchmarkFrame(0),
+      m_BufferDeviceAddressSupported(false),
+      m_NearestSampler(VK_NULL_HANDLE),
+      m_GradientSetLayout(VK_NULL_HANDLE),
+      m_GradientPipelineLayout(VK_NULL_HANDLE),
+      m_GradientPipelines{},
+      m_DecodeSetLayout(VK_NULL_HANDLE),
+      m_DecodePipelineLayout(VK_NULL_HANDLE),
+      m_DecodePipeline(VK_NULL_HANDLE),
+      m_DecodeBuffer(),
+      m_ExternalMemoryHostSupported(false),
+      m_HostPointerAlignment(4096),
+      m_ReadbackCallback(nullptr),
+      m_TracedCallsIntercepted(false),
+      m_UntracedCalls{} {
+  for (auto& usage : m_HeapUsage) usage = 0;
+  m_BudgetPolicy.fallback_flags = BUDGET_FALLBACK_NONE;
+  m_BudgetPolicy.budget_fraction = 1.0f;
+  m_BudgetPolicy.window_min = 0;
+  m_BudgetPolicy.window_max = 0xFFFF;
+  // host copies race with frames in flight that sample the written region
+  // (the plugin only tracks its own commands), so they are opt-in
+  m_HostImageCopyPolicy.mode = HOST_IMAGE_COPY_NEVER;
+  m_HostImageCopyPolicy.max_region_bytes = 256 * 1024;
+}
 
 void TextureSubPluginAPI_Vulkan::ProcessDeviceEvent(
     UnityGfxDeviceEventType type, IUnityInterfaces* interfaces) {
@@ -222,26 +870,115 @@ void TextureSubPluginAPI_Vulkan::ProcessDeviceEvent(
       // Make sure Vulkan API functions are loaded
       LoadVulkanAPI(m_Instance.getInstanceProcAddr, m_Instance.instance);
 
+      vkGetPhysicalDeviceMemoryProperties(m_Instance.physicalDevice,
+                                          &m_MemoryProperties);
+      VkPhysicalDeviceProperties deviceProperties;
+      vkGetPhysicalDeviceProperties(m_Instance.physicalDevice,
+                                    &deviceProperties);
+      m_MaxImageDimension3D = deviceProperties.limits.maxImageDimension3D;
+      m_NonCoherentAtomSize = std::max<VkDeviceSize>(
+          1, deviceProperties.limits.nonCoherentAtomSize);
+      m_MemoryBudgetSupported =
+          vkGetPhysicalDeviceMemoryProperties2 &&
+          IsDeviceExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+      if (!m_MemoryBudgetSupported)
+        PLUGIN_LOG_WARNING("VK_EXT_memory_budget is not enabled - memory "
+                           "budget is estimated from the heap sizes");
+      m_BufferDeviceAddressSupported =
+          s_BufferDeviceAddressFeatureEnabled && vkGetBufferDeviceAddress;
+      m_ExternalMemoryHostSupported =
+          vkGetMemoryHostPointerPropertiesEXT &&
+          vkGetPhysicalDeviceProperties2 &&
+          IsDeviceExtensionEnabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+      if (m_ExternalMemoryHostSupported) {
+        VkPhysicalDeviceExternalMemoryHostPropertiesEXT host_properties{};
+        host_properties.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &host_properties;
+        vkGetPhysicalDeviceProperties2(m_Instance.physicalDevice, &properties);
+        m_HostPointerAlignment = std::max<VkDeviceSize>(
+            1, host_properties.minImportedHostPointerAlignment);
+      }
+      m_HostImageCopySupported = QueryHostImageCopySupport();
+      if (m_HostImageCopySupported)
+        PLUGIN_LOG("VK_EXT_host_image_copy is enabled");
+      m_TimestampPeriod = deviceProperties.limits.timestampComputeAndGraphics
+                              ? deviceProperties.limits.timestampPeriod
+                              : 0.0f;
+
       UnityVulkanPluginEventConfig config_1{};
       config_1.graphicsQueueAccess = kUnityVulkanGraphicsQueueAccess_DontCare;
       config_1.renderPassPrecondition = kUnityVulkanRenderPass_EnsureInside;
       config_1.flags =
           kUnityVulkanEventConfigFlag_EnsurePreviousFrameSubmission |
           kUnityVulkanEventConfigFlag_ModifiesCommandBuffersState;
-      m_UnityVulkan->ConfigureEvent(1, &config_1);
+      m_UnityVulkan->ConfigureEvent(static_cast<int>(Event::TextureSubImage3D),
+                                    &config_1);
 
-      // alternative way to intercept API
-      m_UnityVulkan->InterceptVulkanAPI(
-          "vkCmdBeginRenderPass",
-          (PFN_vkVoidFunction)Hook_vkCmdBeginRenderPass);
+      // events that record their own barriers and copies
+      UnityVulkanPluginEventConfig config_recording{};
+      config_recording.graphicsQueueAccess =
+          kUnityVulkanGraphicsQueueAccess_DontCare;
+      config_recording.renderPassPrecondition =
+          kUnityVulkanRenderPass_EnsureOutside;
+      config_recording.flags =
+          kUnityVulkanEventConfigFlag_EnsurePreviousFrameSubmission |
+          kUnityVulkanEventConfigFlag_ModifiesCommandBuffersState;
+      const Event recording_events[] = {
+          Event::CreateTexture3D, Event::TextureSubImage3DByID,
+          Event::ReadbackTexture3D, Event::CopyTexture3DRegions,
+          Event::DefragmentTexture3D, Event::BenchmarkUploadPaths,
+          Event::CreateBuffer, Event::DestroyBuffer, Event::BufferSubData,
+          Event::ComputeGradients, Event::TextureSubImage3DBitpacked,
+          Event::UpdatePlayback, Event::ExecuteCommandStream,
+          Event::TextureSubImage3DSlices, Event::UpdateProgressive};
+      for (Event event : recording_events)
+        m_UnityVulkan->ConfigureEvent(static_cast<int>(event),
+                                      &config_recording);
+
+      // tracing may have been enabled before the device was (re)created
+      if (IsTracingEnabled()) InterceptTracedCalls(true);
       break;
     }
     case kUnityGfxDeviceEventShutdown: {
       if (m_Instance.device != VK_NULL_HANDLE) {
         GarbageCollect(true);
+        CompleteBenchmark(~0ull);
+        DestroyComputeResources();
+        ImmediateDestroyVulkanBuffer(m_UploadRing.buffer);
+        ImmediateDestroyVulkanBuffer(m_ConstantFillBuffer);
+        ImmediateDestroyVulkanBuffer(m_DecodeBuffer);
+        m_UploadRing = VulkanUploadRing();
+        m_ConstantFillBuffer = VulkanBuffer();
+        m_DecodeBuffer = VulkanBuffer();
+        {
+          std::lock_guard<std::mutex> lock(m_BuffersMutex);
+          for (auto& created : m_CreatedBuffers)
+            ImmediateDestroyVulkanBuffer(created.second.buffer);
+          m_CreatedBuffers.clear();
+        }
+        {
+          std::lock_guard<std::mutex> lock(m_HostMemoryMutex);
+          for (auto& registered : m_HostMemory)
+            ImmediateDestroyVulkanBuffer(registered.second.buffer);
+          m_HostMemory.clear();
+        }
+
+        std::lock_guard<std::mutex> lock(m_ReadbackMutex);
+        for (auto& ring : m_ReadbackRings)
+          ImmediateDestroyVulkanBuffer(ring->buffer);
+        m_ReadbackRings.clear();
+        m_Readbacks.clear();
       }
       m_UnityVulkan = NULL;
       m_Instance = UnityVulkanInstance();
+      m_TracedCallsIntercepted = false;
+      for (auto& call : m_UntracedCalls) call = NULL;
+      m_HostImageCopySupported = false;
+      m_BufferDeviceAddressSupported = false;
+      m_ExternalMemoryHostSupported = false;
       break;
     }
     default:
@@ -249,9 +986,9 @@ void TextureSubPluginAPI_Vulkan::ProcessDeviceEvent(
   }
 }
 
-bool TextureSubPluginAPI_Vulkan::CreateVulkanBuffer(size_t sizeInBytes,
-                                                    VulkanBuffer* buffer,
-                                                    VkBufferUsageFlags usage) {
+bool TextureSubPluginAPI_Vulkan::CreateVulkanBuffer(
+    size_t sizeInBytes, VulkanBuffer* buffer, VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags properties) {
   if (sizeInBytes == 0) return false;
 
   VkBufferCreateInfo bufferCreateInfo{};
@@ -270,35 +1007,34 @@ bool TextureSubPluginAPI_Vulkan::CreateVulkanBuffer(size_t sizeInBytes,
                      &buffer->buffer) != VK_SUCCESS)
     return false;
 
-  VkPhysicalDeviceMemoryProperties physicalDeviceProperties;
-  vkGetPhysicalDeviceMemoryProperties(m_Instance.physicalDevice,
-                                      &physicalDeviceProperties);
-
   VkMemoryRequirements memoryRequirements;
   vkGetBufferMemoryRequirements(m_Instance.device, buffer->buffer,
                                 &memoryRequirements);
 
   const int memoryTypeIndex =
-      FindMemoryTypeIndex(physicalDeviceProperties, memoryRequirements,
-                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+      FindMemoryTypeIndex(m_MemoryProperties, memoryRequirements, properties);
   if (memoryTypeIndex < 0) {
     ImmediateDestroyVulkanBuffer(*buffer);
     return false;
   }
 
-  VkMemoryAllocateInfo memoryAllocateInfo{};
-  memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  memoryAllocateInfo.pNext = NULL;
-  memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
-  memoryAllocateInfo.allocationSize = memoryRequirements.size;
-
-  if (vkAllocateMemory(m_Instance.device, &memoryAllocateInfo, NULL,
-                       &buffer->deviceMemory) != VK_SUCCESS) {
+  // buffers whose device address is queried need memory that was allocated
+  // with VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+  const VkMemoryAllocateFlags allocate_flags =
+      (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
+          ? VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+          : 0;
+  if (!AllocateDeviceMemory(memoryRequirements.size, memoryTypeIndex,
+                            &buffer->deviceMemory, allocate_flags)) {
     ImmediateDestroyVulkanBuffer(*buffer);
     return false;
   }
+  buffer->deviceMemorySize = memoryRequirements.size;
+  buffer->deviceMemoryHeap =
+      m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
 
-  if (vkMapMemory(m_Instance.device, buffer->deviceMemory, 0, VK_WHOLE_SIZE, 0,
+  if ((properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+      vkMapMemory(m_Instance.device, buffer->deviceMemory, 0, VK_WHOLE_SIZE, 0,
                   &buffer->mapped) != VK_SUCCESS) {
     ImmediateDestroyVulkanBuffer(*buffer);
     return false;
@@ -312,8 +1048,7 @@ bool TextureSubPluginAPI_Vulkan::CreateVulkanBuffer(size_t sizeInBytes,
 
   buffer->sizeInBytes = sizeInBytes;
   buffer->deviceMemoryFlags =
-      physicalDeviceProperties.memoryTypes[memoryTypeIndex].propertyFlags;
-  buffer->deviceMemorySize = memoryAllocateInfo.allocationSize;
+      m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
 
   return true;
 }
@@ -327,7 +1062,340 @@ void TextureSubPluginAPI_Vulkan::ImmediateDestroyVulkanBuffer(
     vkUnmapMemory(m_Instance.device, buffer.deviceMemory);
 
   if (buffer.deviceMemory != VK_NULL_HANDLE)
-    vkFreeMemory(m_Instance.device, buffer.deviceMemory, NULL);
+    FreeDeviceMemory(buffer.deviceMemory, buffer.deviceMemorySize,
+                     buffer.deviceMemoryHeap);
+}
+
+bool TextureSubPluginAPI_Vulkan::AllocateDeviceMemory(
+    VkDeviceSize size, uint32_t memory_type, VkDeviceMemory* memory,
+    VkMemoryAllocateFlags flags /*= 0*/) {
+  VkMemoryAllocateFlagsInfo flags_info{};
+  flags_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+  flags_info.flags = flags;
+  VkMemoryAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.pNext = flags ? &flags_info : nullptr;
+  alloc_info.allocationSize = size;
+  alloc_info.memoryTypeIndex = memory_type;
+  if (vkAllocateMemory(m_Instance.device, &alloc_info, nullptr, memory) !=
+      VK_SUCCESS)
+    return false;
+
+  m_HeapUsage[m_MemoryProperties.memoryTypes[memory_type].heapIndex] += size;
+  return true;
+}
+
+void TextureSubPluginAPI_Vulkan::FreeDeviceMemory(VkDeviceMemory memory,
+                                                  VkDeviceSize size,
+                                                  uint32_t heap) {
+  vkFreeMemory(m_Instance.device, memory, nullptr);
+  m_HeapUsage[heap] -= size;
+}
+
+void TextureSubPluginAPI_Vulkan::QueryHeapBudgets(VkDeviceSize* budgets,
+                                                  VkDeviceSize* usages) {
+  if (m_MemoryBudgetSupported) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{};
+    budget_properties.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budget_properties;
+    vkGetPhysicalDeviceMemoryProperties2(m_Instance.physicalDevice,
+                                         &properties);
+    for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; ++i) {
+      budgets[i] = budget_properties.heapBudget[i];
+      usages[i] = budget_properties.heapUsage[i];
+    }
+    return;
+  }
+
+  // without VK_EXT_memory_budget, only the plugin's own allocations are known.
+  // Assume (like most allocators do) that 80% of a heap can be used safely
+  for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; ++i) {
+    budgets[i] = m_MemoryProperties.memoryHeaps[i].size * 8 / 10;
+    usages[i] = m_HeapUsage[i];
+  }
+}
+
+bool TextureSubPluginAPI_Vulkan::FitsIntoBudget(
+    uint32_t heap, VkDeviceSize size, const MemoryBudgetPolicy& policy) {
+  VkDeviceSize budgets[VK_MAX_MEMORY_HEAPS];
+  VkDeviceSize usages[VK_MAX_MEMORY_HEAPS];
+  QueryHeapBudgets(budgets, usages);
+  return static_cast<double>(usages[heap] + size) <=
+         static_cast<double>(budgets[heap]) * policy.budget_fraction;
+}
+
+uint32_t TextureSubPluginAPI_Vulkan::GetMemoryBudget(MemoryHeapBudget* heaps,
+                                                     uint32_t max_heaps) {
+  if (m_Instance.physicalDevice == VK_NULL_HANDLE) return 0;
+
+  VkDeviceSize budgets[VK_MAX_MEMORY_HEAPS];
+  VkDeviceSize usages[VK_MAX_MEMORY_HEAPS];
+  QueryHeapBudgets(budgets, usages);
+  const uint32_t count =
+      heaps ? std::min(max_heaps, m_MemoryProperties.memoryHeapCount) : 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    heaps[i].heap_size = m_MemoryProperties.memoryHeaps[i].size;
+    heaps[i].budget = budgets[i];
+    heaps[i].usage = usages[i];
+    heaps[i].plugin_usage = m_HeapUsage[i];
+    heaps[i].device_local = (m_MemoryProperties.memoryHeaps[i].flags &
+                             VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    heaps[i].from_budget_extension = m_MemoryBudgetSupported;
+  }
+  return m_MemoryProperties.memoryHeapCount;
+}
+
+void TextureSubPluginAPI_Vulkan::SetMemoryBudgetPolicy(
+    const MemoryBudgetPolicy& policy) {
+  std::lock_guard<std::mutex> lock(m_PolicyMutex);
+  m_BudgetPolicy = policy;
+  if (!(m_BudgetPolicy.budget_fraction > 0.0f) ||
+      m_BudgetPolicy.budget_fraction > 1.0f)
+    m_BudgetPolicy.budget_fraction = 1.0f;
+  if (m_BudgetPolicy.window_max <= m_BudgetPolicy.window_min) {
+    m_BudgetPolicy.window_min = 0;
+    m_BudgetPolicy.window_max = 0xFFFF;
+  }
+}
+
+// shader stages that may access buffers created by CreateBuffer
+static const VkPipelineStageFlags kBufferShaderStages =
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+static void RecordBufferBarrier(VkCommandBuffer command_buffer,
+                                VkBuffer buffer, VkDeviceSize offset,
+                                VkDeviceSize size,
+                                VkPipelineStageFlags src_stages,
+                                VkAccessFlags src_access,
+                                VkPipelineStageFlags dst_stages,
+                                VkAccessFlags dst_access) {
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = src_access;
+  barrier.dstAccessMask = dst_access;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer;
+  barrier.offset = offset;
+  barrier.size = size;
+  vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 0, nullptr,
+                       1, &barrier, 0, nullptr);
+}
+
+void TextureSubPluginAPI_Vulkan::CreateBuffer(uint32_t buffer_id,
+                                              uint64_t size) {
+  {
+    std::lock_guard<std::mutex> lock(m_BuffersMutex);
+    if (m_CreatedBuffers.count(buffer_id) != 0) {
+      PLUGIN_LOG_ERROR("a buffer with the provided buffer ID already exists!");
+      return;
+    }
+  }
+
+  m_UnityVulkan->EnsureOutsideRenderPass();
+  UnityVulkanRecordingState recordingState;
+  if (!m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+    PLUGIN_LOG_ERROR("failed to intercept the current command buffer state");
+    return;
+  }
+
+  VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                             VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  if (m_BufferDeviceAddressSupported)
+    usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+  VulkanStorageBuffer created{};
+  if (static_cast<size_t>(size) != size ||
+      !CreateVulkanBuffer(static_cast<size_t>(size), &created.buffer, usage,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+    PLUGIN_LOG_ERROR("failed to create a buffer of %llu bytes",
+                     static_cast<unsigned long long>(size));
+    return;
+  }
+  if (m_BufferDeviceAddressSupported) {
+    VkBufferDeviceAddressInfo address_info{};
+    address_info.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    address_info.buffer = created.buffer.buffer;
+    created.deviceAddress =
+        vkGetBufferDeviceAddress(m_Instance.device, &address_info);
+  }
+
+  // zeroed, like the textures created by CreateTexture3D
+  vkCmdFillBuffer(recordingState.commandBuffer, created.buffer.buffer, 0,
+                  VK_WHOLE_SIZE, 0);
+  RecordBufferBarrier(recordingState.commandBuffer, created.buffer.buffer, 0,
+                      VK_WHOLE_SIZE, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_TRANSFER_WRITE_BIT,
+                      kBufferShaderStages | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                          VK_ACCESS_TRANSFER_READ_BIT |
+                          VK_ACCESS_TRANSFER_WRITE_BIT);
+
+  std::lock_guard<std::mutex> lock(m_BuffersMutex);
+  m_CreatedBuffers[buffer_id] = created;
+}
+
+void TextureSubPluginAPI_Vulkan::DestroyBuffer(uint32_t buffer_id) {
+  std::lock_guard<std::mutex> lock(m_BuffersMutex);
+  auto search = m_CreatedBuffers.find(buffer_id);
+  if (search == m_CreatedBuffers.end()) {
+    PLUGIN_LOG_ERROR("failed to destroy buffer (buffer ID does not refer to "
+                     "a created buffer)");
+    return;
+  }
+  // frames that are still in flight may access the buffer
+  UnityVulkanRecordingState recordingState;
+  if (m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare))
+    SafeDestroy(recordingState.currentFrameNumber, search->second.buffer);
+  else
+    ImmediateDestroyVulkanBuffer(search->second.buffer);
+  m_CreatedBuffers.erase(search);
+}
+
+void TextureSubPluginAPI_Vulkan::BufferSubData(uint32_t buffer_id,
+                                               uint64_t offset, uint64_t size,
+                                               const void* data_ptr) {
+  const BufferWriteRange range{offset, size, data_ptr};
+  BufferSubDataBatch(buffer_id, &range, 1);
+}
+
+void TextureSubPluginAPI_Vulkan::BufferSubDataBatch(
+    uint32_t buffer_id, const BufferWriteRange* ranges, uint32_t count) {
+  VulkanBuffer buffer;
+  {
+    std::lock_guard<std::mutex> lock(m_BuffersMutex);
+    auto search = m_CreatedBuffers.find(buffer_id);
+    if (search == m_CreatedBuffers.end()) {
+      PLUGIN_LOG_ERROR("no buffer was created with the provided buffer ID");
+      return;
+    }
+    buffer = search->second.buffer;
+  }
+  std::vector<BufferWriteRange> valid;
+  valid.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    const BufferWriteRange& range = ranges[i];
+    if (range.data_ptr == nullptr || range.size == 0 ||
+        range.size > buffer.sizeInBytes ||
+        range.offset > buffer.sizeInBytes - range.size) {
+      PLUGIN_LOG_ERROR(
+          "invalid range: [%llu, %llu) of a buffer of %llu bytes",
+          static_cast<unsigned long long>(range.offset),
+          static_cast<unsigned long long>(range.offset + range.size),
+          static_cast<unsigned long long>(buffer.sizeInBytes));
+      continue;
+    }
+    valid.push_back(range);
+  }
+  if (valid.empty()) return;
+
+  m_UnityVulkan->EnsureOutsideRenderPass();
+  UnityVulkanRecordingState recordingState;
+  if (!m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+    PLUGIN_LOG_ERROR("failed to intercept the current command buffer state");
+    return;
+  }
+  const VkCommandBuffer command_buffer = recordingState.commandBuffer;
+
+  // the destination ranges of a copy must not overlap, so a range that
+  // overlaps one of the pending ranges starts the next copy (keeping the
+  // writes in order). Pending ranges are keyed by their end
+  std::map<VkDeviceSize, VkDeviceSize> pending;
+  std::vector<VkBufferCopy> copies;
+  size_t first = 0;
+  while (first < valid.size()) {
+    pending.clear();
+    copies.clear();
+    VkDeviceSize staged = 0;
+    VkDeviceSize lo = ~VkDeviceSize(0);
+    VkDeviceSize hi = 0;
+    size_t last = first;
+    for (; last < valid.size(); ++last) {
+      const BufferWriteRange& range = valid[last];
+      auto next = pending.upper_bound(range.offset);
+      if (next != pending.end() && next->second < range.offset + range.size)
+        break;
+      pending.emplace(range.offset + range.size, range.offset);
+      VkBufferCopy copy{};
+      copy.srcOffset = staged;
+      copy.dstOffset = range.offset;
+      copy.size = range.size;
+      copies.push_back(copy);
+      staged += range.size;
+      lo = std::min<VkDeviceSize>(lo, range.offset);
+      hi = std::max<VkDeviceSize>(hi, range.offset + range.size);
+    }
+
+    TraceScope trace("upload", "BufferSubData", "bytes", staged);
+    // same as for texture uploads (see StageSubImage3D)
+    VulkanStaging staging;
+    if (!AllocateStaging(staged, recordingState.currentFrameNumber, &staging))
+      return;
+    for (size_t i = 0; i < copies.size(); ++i) {
+      StreamCopy(staging.mapped + copies[i].srcOffset,
+                 valid[first + i].data_ptr,
+                 static_cast<size_t>(copies[i].size));
+      copies[i].srcOffset += staging.offset;
+    }
+    FlushStaging(staging);
+
+    // previously recorded shader accesses and copies have to finish first
+    RecordBufferBarrier(
+        command_buffer, buffer.buffer, lo, hi - lo,
+        kBufferShaderStages | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdCopyBuffer(command_buffer, staging.buffer, buffer.buffer,
+                    static_cast<uint32_t>(copies.size()), copies.data());
+    RecordBufferBarrier(command_buffer, buffer.buffer, lo, hi - lo,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_ACCESS_TRANSFER_WRITE_BIT,
+                        kBufferShaderStages | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                            VK_ACCESS_TRANSFER_READ_BIT |
+                            VK_ACCESS_TRANSFER_WRITE_BIT);
+    first = last;
+  }
+}
+
+void* TextureSubPluginAPI_Vulkan::RetrieveCreatedBuffer(uint32_t buffer_id) {
+  std::lock_guard<std::mutex> lock(m_BuffersMutex);
+  auto search = m_CreatedBuffers.find(buffer_id);
+  if (search == m_CreatedBuffers.end()) {
+    PLUGIN_LOG_ERROR("no buffer was created with the provided buffer ID");
+    return nullptr;
+  }
+  // the map's nodes are stable, so the VkBuffer stays at this address until
+  // the buffer is destroyed
+  return reinterpret_cast<void*>(&search->second.buffer.buffer);
+}
+
+bool TextureSubPluginAPI_Vulkan::GetBufferInfo(uint32_t buffer_id,
+                                               BufferInfo* info) {
+  std::lock_guard<std::mutex> lock(m_BuffersMutex);
+  auto search = m_CreatedBuffers.find(buffer_id);
+  if (search == m_CreatedBuffers.end()) return false;
+  *info = BufferInfo();
+  info->size = search->second.buffer.sizeInBytes;
+  info->device_address = search->second.deviceAddress;
+  info->heap = search->second.buffer.deviceMemoryHeap;
+  return true;
+}
+
+void TextureSubPluginAPI_Vulkan::SetHostImageCopyPolicy(
+    const HostImageCopyPolicy& policy) {
+  std::lock_guard<std::mutex> lock(m_PolicyMutex);
+  m_HostImageCopyPolicy = policy;
+  if (m_HostImageCopyPolicy.mode > HOST_IMAGE_COPY_ALWAYS)
+    m_HostImageCopyPolicy.mode = HOST_IMAGE_COPY_NEVER;
 }
 
 void TextureSubPluginAPI_Vulkan::SafeDestroy(unsigned long long frameNumber,
@@ -352,226 +1420,3130 @@ void TextureSubPluginAPI_Vulkan::GarbageCollect(bool force /*= false*/) {
     } else
       ++it;
   }
-}
-
-void TextureSubPluginAPI_Vulkan::CreateTexture3D(uint32_t texture_id,
-                                                 uint32_t width,
-                                                 uint32_t height,
-                                                 uint32_t depth,
-                                                 Format format) {
-  if (auto search = m_CreatedTextures.find(texture_id);
-      search != m_CreatedTextures.end()) {
-    UNITY_LOG_ERROR(g_Log,
-                    "a texture with the provided texture ID already exists!");
-    return;
-  }
 
-  // cannot do resource uploads inside renderpass
-  m_UnityVulkan->EnsureOutsideRenderPass();
+  // ordered by frame
+  while (!m_UploadRing.allocations.empty() &&
+         m_UploadRing.allocations.front().frameNumber <=
+             recordingState.safeFrameNumber)
+    m_UploadRing.allocations.pop_front();
 
-  VkFormat vk_format;
-  switch (format) {
-    case Format::R8_UINT:
-      vk_format = VK_FORMAT_R8_UNORM;
-      break;
-    case Format::R16_UINT:
-      vk_format = VK_FORMAT_R16_UNORM;
-      break;
-    default: {
-      std::ostringstream ss;
-      ss << __FUNCTION__ << " unsupported texture format: " << format;
-      UNITY_LOG_ERROR(g_Log, ss.str().c_str());
-      return;
+  // ordered by frame
+  while (!m_UsedDescriptorPools.empty() &&
+         m_UsedDescriptorPools.begin()->first <=
+             recordingState.safeFrameNumber) {
+    for (VkDescriptorPool pool : m_UsedDescriptorPools.begin()->second) {
+      vkResetDescriptorPool(m_Instance.device, pool, 0);
+      m_FreeDescriptorPools.push_back(pool);
     }
+    m_UsedDescriptorPools.erase(m_UsedDescriptorPools.begin());
   }
 
-  VkImageCreateInfo img_info{};
-  img_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-  img_info.imageType = VK_IMAGE_TYPE_3D;
-  img_info.extent.width = static_cast<uint32_t>(width);
-  img_info.extent.height = static_cast<uint32_t>(height);
-  img_info.extent.depth = static_cast<uint32_t>(depth);
-  img_info.mipLevels = 1;
-  img_info.arrayLayers = 1;
-  img_info.format = vk_format;
-  img_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-  img_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  img_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-  img_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  img_info.samples = VK_SAMPLE_COUNT_1_BIT;
-  img_info.flags = 0;
-
-  VkImage img;
-  if (vkCreateImage(m_Instance.device, &img_info, nullptr, &img) !=
-      VK_SUCCESS) {
-    std::ostringstream ss;
-    ss << __FUNCTION__ << " vkCreateImage failed";
-    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
-    return;
+  while (!m_TileDeleteQueue.empty() &&
+         m_TileDeleteQueue.begin()->first <= recordingState.safeFrameNumber) {
+    for (VulkanTile& tile : m_TileDeleteQueue.begin()->second)
+      DestroyTile(&tile);
+    m_TileDeleteQueue.erase(m_TileDeleteQueue.begin());
   }
+}
 
-  // allocate memory for the image
-  VkDeviceMemory img_memory;
-
-  VkPhysicalDeviceMemoryProperties physicalDeviceProperties;
-  vkGetPhysicalDeviceMemoryProperties(m_Instance.physicalDevice,
-                                      &physicalDeviceProperties);
-
-  VkMemoryRequirements mem_requirements;
-  vkGetImageMemoryRequirements(m_Instance.device, img, &mem_requirements);
+// size of the upload ring. Larger uploads (and uploads that do not fit next to
+// the ones of frames in flight) are staged in buffers of their own
+static const VkDeviceSize kUploadRingSize = 64ull << 20;
+// covers the alignment of copies, of storage buffer descriptors (staged bit
+// packed words) and of flushes of non-coherent memory (all at most 256)
+static const VkDeviceSize kStagingAlignment = 256;
 
-  const int memory_type_idx =
-      FindMemoryTypeIndex(physicalDeviceProperties, mem_requirements,
-                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-  if (memory_type_idx < 0) {
-    UNITY_LOG_ERROR(
-        g_Log,
-        "failed to find adequate memory type index for texture 3D memory");
-    return;
+// finds space for size bytes in the upload ring
+static bool RingAllocate(const VulkanUploadRing& ring, VkDeviceSize size,
+                         VkDeviceSize* offset) {
+  const VkDeviceSize capacity = ring.buffer.sizeInBytes;
+  if (ring.allocations.empty()) {
+    *offset = 0;
+    return size <= capacity;
   }
 
-  VkMemoryAllocateInfo alloc_info{};
-  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  alloc_info.allocationSize = mem_requirements.size;
-  alloc_info.memoryTypeIndex = memory_type_idx;
-  if (vkAllocateMemory(m_Instance.device, &alloc_info, nullptr, &img_memory) !=
-      VK_SUCCESS) {
-    UNITY_LOG_ERROR(g_Log, "failed to allocate texture 3D memory!");
-    vkDestroyImage(m_Instance.device, img, nullptr);
-    return;
+  const VkDeviceSize front = ring.allocations.front().offset;
+  const VkDeviceSize end = ring.allocations.back().end;
+  if (end > front) {
+    // free space is [end, capacity) and [0, front)
+    *offset = capacity - end >= size ? end : 0;
+    return capacity - end >= size || front >= size;
   }
+  // wrapped around, free space is [end, front)
+  *offset = end;
+  return front - end >= size;
+}
 
-  // bind the image to the allocated memory
-  vkBindImageMemory(m_Instance.device, img, img_memory, 0);
+bool TextureSubPluginAPI_Vulkan::AllocateStaging(
+    VkDeviceSize size, unsigned long long frame_number,
+    VulkanStaging* staging) {
+  const VkDeviceSize alignment =
+      std::max<VkDeviceSize>(kStagingAlignment, m_NonCoherentAtomSize);
+  const VkDeviceSize allocation_size =
+      (std::max<VkDeviceSize>(size, 1) + alignment - 1) / alignment *
+      alignment;
+  const VkBufferUsageFlags usage =
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 
-  {
-    std::ostringstream ss;
-    ss << "successfully created native texture 3D [VkImage] handle: " << img;
-    UNITY_LOG(g_Log, ss.str().c_str());
+  if (m_UploadRing.buffer.buffer == VK_NULL_HANDLE &&
+      !CreateVulkanBuffer(kUploadRingSize, &m_UploadRing.buffer, usage))
+    m_UploadRing.buffer = VulkanBuffer();
+
+  VkDeviceSize offset;
+  if (m_UploadRing.buffer.buffer != VK_NULL_HANDLE &&
+      RingAllocate(m_UploadRing, allocation_size, &offset)) {
+    // consecutive allocations of a frame are retired together
+    if (!m_UploadRing.allocations.empty() &&
+        m_UploadRing.allocations.back().frameNumber == frame_number &&
+        m_UploadRing.allocations.back().end == offset)
+      m_UploadRing.allocations.back().end = offset + allocation_size;
+    else
+      m_UploadRing.allocations.push_back(
+          {frame_number, offset, offset + allocation_size});
+    staging->buffer = m_UploadRing.buffer.buffer;
+    staging->offset = offset;
+    staging->size = size;
+    staging->mapped =
+        static_cast<uint8_t*>(m_UploadRing.buffer.mapped) + offset;
+    staging->deviceMemory = m_UploadRing.buffer.deviceMemory;
+    staging->coherent = m_UploadRing.buffer.deviceMemoryFlags &
+                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    return true;
   }
 
-  // store created image handle and its device memory handle
-  m_CreatedTextures.insert(
-      {texture_id, std::make_pair(std::make_unique<VkImage>(img), img_memory)});
+  // destroyed once the frame that reads it has completed
+  VulkanBuffer buffer;
+  if (!CreateVulkanBuffer(static_cast<size_t>(allocation_size), &buffer,
+                          usage)) {
+    PLUGIN_LOG_ERROR("failed to create staging buffer");
+    return false;
+  }
+  SafeDestroy(frame_number, buffer);
+  staging->buffer = buffer.buffer;
+  staging->offset = 0;
+  staging->size = size;
+  staging->mapped = static_cast<uint8_t*>(buffer.mapped);
+  staging->deviceMemory = buffer.deviceMemory;
+  staging->coherent =
+      buffer.deviceMemoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  return true;
 }
 
-void* TextureSubPluginAPI_Vulkan::RetrieveCreatedTexture3D(
-    uint32_t texture_id) {
-  if (auto search = m_CreatedTextures.find(texture_id);
-      search != m_CreatedTextures.end()) {
-    // a VkImage* has to be void* casted because Unity expects a VkImage*
-    // for the nativeTex parameter of the Texture3D.CreateExternalTexture call
-    return reinterpret_cast<void*>((search->second.first).get());
-  }
-  UNITY_LOG_ERROR(g_Log, "no texture was created with the provided texture ID");
-  return nullptr;
+void TextureSubPluginAPI_Vulkan::FlushStaging(const VulkanStaging& staging) {
+  if (staging.coherent) return;
+  // allocations are aligned to the atom size, so the rounded up range stays
+  // within the allocation
+  VkMappedMemoryRange range{};
+  range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory = staging.deviceMemory;
+  range.offset = staging.offset;
+  range.size = (std::max<VkDeviceSize>(staging.size, 1) +
+                m_NonCoherentAtomSize - 1) /
+               m_NonCoherentAtomSize * m_NonCoherentAtomSize;
+  vkFlushMappedMemoryRanges(m_Instance.device, 1, &range);
 }
 
-void TextureSubPluginAPI_Vulkan::DestroyTexture3D(uint32_t texture_id) {
-  if (auto search = m_CreatedTextures.find(texture_id);
-      search != m_CreatedTextures.end()) {
-    vkDestroyImage(m_Instance.device, *(search->second.first), nullptr);
-    vkFreeMemory(m_Instance.device, search->second.second, nullptr);
-    m_CreatedTextures.erase(search);
+// Splits extent into count tiles along one axis such that each tile, including
+// the one voxel overlap with its successor, fits into max_dim
+static void ComputeTiling(uint32_t extent, uint32_t max_dim, uint32_t* count,
+                          uint32_t* stride) {
+  if (extent <= max_dim) {
+    *count = 1;
+    *stride = extent;
     return;
   }
-  UNITY_LOG_ERROR(g_Log,
-                  "failed to destroy texture 3D (texture ID does not refer to "
-                  "a created texture 3D)");
+  *count = (extent - 1 + max_dim - 2) / (max_dim - 1);
+  *stride = (extent - 1 + *count - 1) / *count;
 }
 
-void TextureSubPluginAPI_Vulkan::TextureSubImage3D(
-    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
-    int32_t width, int32_t height, int32_t depth, void* data_ptr, int32_t level,
-    Format format) {
-  UnityVulkanRecordingState recordingState;
-  if (!m_UnityVulkan->CommandRecordingState(
-          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
-    std::ostringstream ss;
-    ss << __FUNCTION__
-       << " failed to intercept the current command buffer state";
-    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
-    return;
-  }
-  // safely (not necessarily immediately) destroy the current staging buffer
-  // before creating a new one. A staging buffer is simply a buffer in host
-  // (CPU) visible memory that we copy image data to which then a command on
-  // the client (GPU) copies a (sub)region from.
-  // TODO:  maybe we can check if requirements have changed. If not, then no
-  //        staging buffer recreation has to be done.
-  SafeDestroy(recordingState.currentFrameNumber, m_TextureStagingBuffer);
-  size_t data_size;
-  switch (format) {
-    case R8_UINT:
-      data_size = static_cast<size_t>(width) * height * height;
+static void LayoutAccess(VkImageLayout layout, VkPipelineStageFlags* stage,
+                         VkAccessFlags* access) {
+  switch (layout) {
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+      *stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      *access = VK_ACCESS_TRANSFER_WRITE_BIT;
       break;
-    case R16_UINT:
-      data_size = static_cast<size_t>(width) * height * height * 2;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+      *stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      *access = VK_ACCESS_TRANSFER_READ_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_GENERAL:
+      // used for images that are copied from and to at the same time and for
+      // images that compute passes write to
+      *stage =
+          VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+      *access = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT |
+                VK_ACCESS_SHADER_WRITE_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+      *stage = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+               VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+      *access = VK_ACCESS_SHADER_READ_BIT;
+      break;
+    default:
+      *stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+      *access = 0;
       break;
-    default: {
-      std::ostringstream ss;
-      ss << __FUNCTION__ << " unsupported texture format: " << format;
-      UNITY_LOG_ERROR(g_Log, ss.str().c_str());
-      return;
-    }
-  }
-  m_TextureStagingBuffer = VulkanBuffer();
-  if (!CreateVulkanBuffer(data_size, &m_TextureStagingBuffer,
-                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT)) {
-    std::ostringstream ss;
-    ss << __FUNCTION__ << " failed to create texture staging buffer";
-    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
-    return;
   }
-  memcpy(m_TextureStagingBuffer.mapped, data_ptr, data_size);
-  vkUnmapMemory(m_Instance.device, m_TextureStagingBuffer.deviceMemory);
+}
+
+void TextureSubPluginAPI_Vulkan::TransitionTiles(
+    VkCommandBuffer command_buffer, unsigned long long frame_number,
+    VulkanTile* const* tiles, size_t count, VkImageLayout new_layout) {
+  std::vector<VkImageMemoryBarrier> barriers;
+  barriers.reserve(count);
+  VkPipelineStageFlags src_stages = 0;
+  VkPipelineStageFlags dst_stages = 0;
+  for (size_t i = 0; i < count; ++i) {
+    VulkanTile* tile = tiles[i];
+    tile->lastRecordedFrame = frame_number;
+    if (tile->layout == new_layout) continue;
+
+    VkPipelineStageFlags src_stage, dst_stage;
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    LayoutAccess(tile->layout, &src_stage, &barrier.srcAccessMask);
+    LayoutAccess(new_layout, &dst_stage, &barrier.dstAccessMask);
+    barrier.oldLayout = tile->layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = *tile->image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barriers.push_back(barrier);
+    src_stages |= src_stage;
+    dst_stages |= dst_stage;
+    tile->layout = new_layout;
+  }
+  if (barriers.empty()) return;
+
+  vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 0, nullptr, 0,
+                       nullptr, static_cast<uint32_t>(barriers.size()),
+                       barriers.data());
+}
+
+// tiles are uploaded to, read back and copied between
+static const VkImageUsageFlags kTileImageUsage =
+    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+    VK_IMAGE_USAGE_SAMPLED_BIT;
+
+bool TextureSubPluginAPI_Vulkan::QueryHostImageCopySupport() {
+#if SUPPORT_HOST_IMAGE_COPY
+  if (!s_HostImageCopyFeatureEnabled || !vkGetPhysicalDeviceProperties2 ||
+      !vkGetPhysicalDeviceImageFormatProperties2 || !vkCopyMemoryToImageEXT ||
+      !vkTransitionImageLayoutEXT)
+    return false;
+
+  VkPhysicalDeviceHostImageCopyPropertiesEXT copy_properties{};
+  copy_properties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT;
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &copy_properties;
+  vkGetPhysicalDeviceProperties2(m_Instance.physicalDevice, &properties);
+  std::vector<VkImageLayout> layouts(copy_properties.copyDstLayoutCount);
+  copy_properties.pCopyDstLayouts = layouts.data();
+  vkGetPhysicalDeviceProperties2(m_Instance.physicalDevice, &properties);
+  layouts.resize(copy_properties.copyDstLayoutCount);
+
+  // tiles rest in this layout, so host copies never have to transition them
+  return std::find(layouts.begin(), layouts.end(),
+                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) != layouts.end();
+#else
+  return false;
+#endif
+}
+
+bool TextureSubPluginAPI_Vulkan::SupportsHostTransfer(
+    VkFormat format, bool* optimal_device_access) {
+  *optimal_device_access = false;
+#if SUPPORT_HOST_IMAGE_COPY
+  if (!m_HostImageCopySupported) return false;
+  VkPhysicalDeviceImageFormatInfo2 format_info{};
+  format_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2;
+  format_info.format = format;
+  format_info.type = VK_IMAGE_TYPE_3D;
+  format_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  format_info.usage = kTileImageUsage | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+  // whether host transfer usage changes the image's memory layout (and hence
+  // may slow down sampling)
+  VkHostImageCopyDevicePerformanceQueryEXT performance{};
+  performance.sType =
+      VK_STRUCTURE_TYPE_HOST_IMAGE_COPY_DEVICE_PERFORMANCE_QUERY_EXT;
+  VkImageFormatProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2;
+  properties.pNext = &performance;
+  if (vkGetPhysicalDeviceImageFormatProperties2(
+          m_Instance.physicalDevice, &format_info, &properties) != VK_SUCCESS)
+    return false;
+  *optimal_device_access = performance.optimalDeviceAccess == VK_TRUE;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool TextureSubPluginAPI_Vulkan::CreateTileImages(
+    VulkanTexture3D* texture, VkFormat format,
+    std::vector<VkMemoryRequirements>* requirements) {
+  const uint32_t max_dim = m_MaxImageDimension3D ? m_MaxImageDimension3D : 2048;
+  ComputeTiling(texture->extent.width, max_dim, &texture->tileCount.width,
+                &texture->tileStride.width);
+  ComputeTiling(texture->extent.height, max_dim, &texture->tileCount.height,
+                &texture->tileStride.height);
+  ComputeTiling(texture->extent.depth, max_dim, &texture->tileCount.depth,
+                &texture->tileStride.depth);
+
+  texture->tiles.clear();
+  requirements->clear();
+  for (uint32_t k = 0; k < texture->tileCount.depth; ++k)
+    for (uint32_t j = 0; j < texture->tileCount.height; ++j)
+      for (uint32_t i = 0; i < texture->tileCount.width; ++i) {
+        VulkanTile tile{};
+        tile.offset.x = static_cast<int32_t>(i * texture->tileStride.width);
+        tile.offset.y = static_cast<int32_t>(j * texture->tileStride.height);
+        tile.offset.z = static_cast<int32_t>(k * texture->tileStride.depth);
+        tile.extent.width = std::min(texture->tileStride.width + 1,
+                                     texture->extent.width - tile.offset.x);
+        tile.extent.height = std::min(texture->tileStride.height + 1,
+                                      texture->extent.height - tile.offset.y);
+        tile.extent.depth = std::min(texture->tileStride.depth + 1,
+                                     texture->extent.depth - tile.offset.z);
+        tile.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkImageCreateInfo img_info{};
+        img_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        img_info.imageType = VK_IMAGE_TYPE_3D;
+        img_info.extent = tile.extent;
+        img_info.mipLevels = 1;
+        img_info.arrayLayers = 1;
+        img_info.format = format;
+        img_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        img_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        img_info.usage = kTileImageUsage | texture->extraUsage;
+#if SUPPORT_HOST_IMAGE_COPY
+        if (texture->hostImageCopy)
+          img_info.usage |= VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+#endif
+        img_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        img_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        img_info.flags = 0;
+
+        VkImage img;
+        if (vkCreateImage(m_Instance.device, &img_info, nullptr, &img) !=
+            VK_SUCCESS) {
+          DestroyTileImages(texture);
+          return false;
+        }
+        tile.image = std::make_unique<VkImage>(img);
+
+        VkMemoryRequirements mem_requirements;
+        vkGetImageMemoryRequirements(m_Instance.device, img, &mem_requirements);
+        requirements->push_back(mem_requirements);
+        texture->tiles.push_back(std::move(tile));
+      }
+  return true;
+}
+
+void TextureSubPluginAPI_Vulkan::DestroyTile(VulkanTile* tile) {
+  if (tile->view != VK_NULL_HANDLE)
+    vkDestroyImageView(m_Instance.device, tile->view, nullptr);
+  tile->view = VK_NULL_HANDLE;
+  if (tile->image) vkDestroyImage(m_Instance.device, *tile->image, nullptr);
+  if (tile->deviceMemory != VK_NULL_HANDLE)
+    FreeDeviceMemory(tile->deviceMemory, tile->deviceMemorySize,
+                     tile->deviceMemoryHeap);
+  tile->image.reset();
+  tile->deviceMemory = VK_NULL_HANDLE;
+}
+
+void TextureSubPluginAPI_Vulkan::DestroyTileImages(VulkanTexture3D* texture) {
+  for (VulkanTile& tile : texture->tiles) DestroyTile(&tile);
+  texture->tiles.clear();
+}
+
+// returns VK_FORMAT_UNDEFINED for unknown formats
+static VkFormat ToVkFormat(Format format) {
+#define VK_FORMAT_CASE(name, channels, size, type, vk_format, ...) \
+  case name:                                                       \
+    return vk_format;
+  switch (format) {
+    TEXTURE_FORMATS(VK_FORMAT_CASE)
+    default:
+      return VK_FORMAT_UNDEFINED;
+  }
+#undef VK_FORMAT_CASE
+}
+
+void TextureSubPluginAPI_Vulkan::CreateTexture3D(uint32_t texture_id,
+                                                 uint32_t width,
+                                                 uint32_t height,
+                                                 uint32_t depth,
+                                                 Format format) {
+  CreateTexture3DWithUsage(texture_id, width, height, depth, format, 0);
+}
+
+void TextureSubPluginAPI_Vulkan::CreateTexture3DWithUsage(
+    uint32_t texture_id, uint32_t width, uint32_t height, uint32_t depth,
+    Format format, VkImageUsageFlags extra_usage) {
+  if (auto search = m_CreatedTextures.find(texture_id);
+      search != m_CreatedTextures.end()) {
+    PLUGIN_LOG_ERROR("a texture with the provided texture ID already exists!");
+    return;
+  }
 
   // cannot do resource uploads inside renderpass
   m_UnityVulkan->EnsureOutsideRenderPass();
 
-  // get the VkImage from the provided texture handle
-  UnityVulkanImage image;
-  if (!m_UnityVulkan->AccessTexture(
-          texture_handle, UnityVulkanWholeImage,
-          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
-          VK_ACCESS_TRANSFER_WRITE_BIT,
-          kUnityVulkanResourceAccess_PipelineBarrier, &image)) {
-    std::ostringstream ss;
-    ss << __FUNCTION__
-       << " failed to access texture from provided texture handle: "
-       << texture_handle;
-    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+  MemoryBudgetPolicy policy;
+  HostImageCopyPolicy host_copy_policy;
+  {
+    std::lock_guard<std::mutex> lock(m_PolicyMutex);
+    policy = m_BudgetPolicy;
+    host_copy_policy = m_HostImageCopyPolicy;
+  }
+
+  // the images are (re)created until they fit into the memory budget or no
+  // further degradation is allowed by the policy
+  VulkanTexture3D texture{};
+  texture.format = format;
+  texture.windowMin = policy.window_min;
+  texture.windowMax = policy.window_max;
+  texture.requestedExtent = {width, height, depth};
+  texture.requestedFormat = format;
+  texture.extraUsage = extra_usage;
+  std::vector<VkMemoryRequirements> mem_requirements;
+  std::vector<int> memory_type_indices;
+  for (;;) {
+    const VkFormat vk_format = ToVkFormat(texture.format);
+    if (vk_format == VK_FORMAT_UNDEFINED) {
+      PLUGIN_LOG_ERROR("unsupported texture format: %d", format);
+      return;
+    }
+
+    // uploads into textures that the CPU can write to may skip the staging
+    // copy (see HostCopySubImage3D)
+    bool optimal_device_access;
+    texture.hostImageCopy =
+        host_copy_policy.mode != HOST_IMAGE_COPY_NEVER && extra_usage == 0 &&
+        SupportsHostTransfer(vk_format, &optimal_device_access) &&
+        (optimal_device_access ||
+         host_copy_policy.mode == HOST_IMAGE_COPY_ALWAYS);
+
+    const uint32_t level = texture.downsampleLevel;
+    const uint32_t round = (1u << level) - 1;
+    texture.extent.width = (width + round) >> level;
+    texture.extent.height = (height + round) >> level;
+    texture.extent.depth = (depth + round) >> level;
+
+    if (!CreateTileImages(&texture, vk_format, &mem_requirements)) {
+      PLUGIN_LOG_ERROR("vkCreateImage failed");
+      return;
+    }
+
+    VkDeviceSize total_size = 0;
+    memory_type_indices.clear();
+    for (const VkMemoryRequirements& requirements : mem_requirements) {
+      const int memory_type_idx =
+          FindMemoryTypeIndex(m_MemoryProperties, requirements,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+      if (memory_type_idx < 0) {
+        PLUGIN_LOG_ERROR(
+            "failed to find adequate memory type index for texture 3D memory");
+        DestroyTileImages(&texture);
+        return;
+      }
+      memory_type_indices.push_back(memory_type_idx);
+      total_size += requirements.size;
+    }
+
+    // all tiles have the same format and usage and hence end up in the same
+    // heap
+    const uint32_t heap =
+        m_MemoryProperties.memoryTypes[memory_type_indices[0]].heapIndex;
+    texture.hostVisible =
+        (m_MemoryProperties.memoryTypes[memory_type_indices[0]].propertyFlags &
+         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+    if (FitsIntoBudget(heap, total_size, policy)) break;
+
+    // reducing precision is tried first because it halves the memory without
+    // losing any resolution
+    const bool can_reduce_precision =
+        (policy.fallback_flags & BUDGET_FALLBACK_REDUCE_PRECISION) &&
+        texture.format == Format::R16_UINT;
+    // the box filter only handles single-channel formats
+    const bool can_downsample =
+        (policy.fallback_flags & BUDGET_FALLBACK_DOWNSAMPLE) &&
+        (texture.format == Format::R8_UINT ||
+         texture.format == Format::R16_UINT) &&
+        texture.downsampleLevel < policy.max_downsample_levels &&
+        (texture.extent.width > 1 || texture.extent.height > 1 ||
+         texture.extent.depth > 1);
+    if (!can_reduce_precision && !can_downsample) {
+      if (policy.fallback_flags & BUDGET_FALLBACK_REJECT) {
+        PLUGIN_LOG_ERROR(
+            "texture 3D of size %llu bytes exceeds the memory budget of heap "
+            "%u",
+            static_cast<unsigned long long>(total_size), heap);
+        DestroyTileImages(&texture);
+        return;
+      }
+      PLUGIN_LOG_WARNING(
+          "texture 3D of size %llu bytes exceeds the memory budget of heap %u",
+          static_cast<unsigned long long>(total_size), heap);
+      break;
+    }
+
+    DestroyTileImages(&texture);
+    if (can_reduce_precision)
+      texture.format = Format::R8_UINT;
+    else
+      ++texture.downsampleLevel;
+  }
+
+  // allocate memory for the images and bind them to it
+  for (size_t i = 0; i < texture.tiles.size(); ++i) {
+    VulkanTile& tile = texture.tiles[i];
+    if (!AllocateDeviceMemory(mem_requirements[i].size, memory_type_indices[i],
+                              &tile.deviceMemory)) {
+      PLUGIN_LOG_ERROR("failed to allocate texture 3D memory!");
+      DestroyTileImages(&texture);
+      return;
+    }
+    tile.deviceMemorySize = mem_requirements[i].size;
+    tile.deviceMemoryHeap =
+        m_MemoryProperties.memoryTypes[memory_type_indices[i]].heapIndex;
+    vkBindImageMemory(m_Instance.device, *tile.image, tile.deviceMemory, 0);
+  }
+
+  // clear the images so that regions that are never uploaded to are
+  // well-defined and leave them ready to be sampled
+  UnityVulkanRecordingState recordingState;
+  if (!m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+    PLUGIN_LOG_ERROR("failed to intercept the current command buffer state");
+    DestroyTileImages(&texture);
+    return;
+  }
+  std::vector<VulkanTile*> tiles;
+  for (VulkanTile& tile : texture.tiles) tiles.push_back(&tile);
+  TransitionTiles(recordingState.commandBuffer,
+                  recordingState.currentFrameNumber, tiles.data(), tiles.size(),
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  VkClearColorValue clear_color{};
+  VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  for (VulkanTile* tile : tiles)
+    vkCmdClearColorImage(recordingState.commandBuffer, *tile->image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear_color, 1,
+                         &range);
+  TransitionTiles(recordingState.commandBuffer,
+                  recordingState.currentFrameNumber, tiles.data(), tiles.size(),
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  {
+    char tiled[64] = "";
+    if (texture.tiles.size() > 1)
+      snprintf(tiled, sizeof(tiled), " (split into %ux%ux%u tiles)",
+               texture.tileCount.width, texture.tileCount.height,
+               texture.tileCount.depth);
+    char degraded[96] = "";
+    if (texture.format != format || texture.downsampleLevel > 0)
+      snprintf(degraded, sizeof(degraded),
+               " (degraded to fit the memory budget: %ux%ux%u format: %d)",
+               texture.extent.width, texture.extent.height,
+               texture.extent.depth, texture.format);
+    // non-dispatchable handles are pointers or 64-bit integers
+    PLUGIN_LOG(
+        "successfully created native texture 3D [VkImage] handle: 0x%llx%s%s",
+        (unsigned long long)*texture.tiles[0].image, tiled, degraded);
+  }
+
+  // store created image handles and their device memory handles
+  std::lock_guard<std::mutex> lock(m_TexturesMutex);
+  for (const VulkanTile& tile : texture.tiles) {
+    m_TextureHandles[tile.image.get()] = texture_id;
+    m_TextureHandles[reinterpret_cast<void*>(*tile.image)] = texture_id;
+  }
+  m_CreatedTextures.insert({texture_id, std::move(texture)});
+}
+
+void* TextureSubPluginAPI_Vulkan::RetrieveCreatedTexture3D(
+    uint32_t texture_id) {
+  return RetrieveCreatedTexture3DTile(texture_id, 0);
+}
+
+void* TextureSubPluginAPI_Vulkan::RetrieveCreatedTexture3DTile(
+    uint32_t texture_id, uint32_t tile_index) {
+  std::lock_guard<std::mutex> lock(m_TexturesMutex);
+  if (auto search = m_CreatedTextures.find(texture_id);
+      search != m_CreatedTextures.end()) {
+    if (tile_index >= search->second.tiles.size()) {
+      PLUGIN_LOG_ERROR("tile index is out of range");
+      return nullptr;
+    }
+    // a VkImage* has to be void* casted because Unity expects a VkImage*
+    // for the nativeTex parameter of the Texture3D.CreateExternalTexture call
+    return reinterpret_cast<void*>(
+        search->second.tiles[tile_index].image.get());
+  }
+  PLUGIN_LOG_ERROR("no texture was created with the provided texture ID");
+  return nullptr;
+}
+
+uint32_t TextureSubPluginAPI_Vulkan::GetTextureTileDescriptors(
+    uint32_t texture_id, TileDescriptor* tiles, uint32_t max_tiles) {
+  std::lock_guard<std::mutex> lock(m_TexturesMutex);
+  auto search = m_CreatedTextures.find(texture_id);
+  if (search == m_CreatedTextures.end()) return 0;
+
+  const VulkanTexture3D& texture = search->second;
+  const uint32_t count =
+      tiles ? std::min<uint32_t>(max_tiles, texture.tiles.size()) : 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    const VulkanTile& tile = texture.tiles[i];
+    tiles[i].origin_x = tile.offset.x;
+    tiles[i].origin_y = tile.offset.y;
+    tiles[i].origin_z = tile.offset.z;
+    tiles[i].index = i;
+    tiles[i].extent_x = tile.extent.width;
+    tiles[i].extent_y = tile.extent.height;
+    tiles[i].extent_z = tile.extent.depth;
+    tiles[i].reserved = 0;
+  }
+  return static_cast<uint32_t>(texture.tiles.size());
+}
+
+bool TextureSubPluginAPI_Vulkan::GetTexture3DInfo(uint32_t texture_id,
+                                                  Texture3DInfo* info) {
+  std::lock_guard<std::mutex> lock(m_TexturesMutex);
+  auto search = m_CreatedTextures.find(texture_id);
+  if (search == m_CreatedTextures.end()) return false;
+
+  const VulkanTexture3D& texture = search->second;
+  info->width = texture.extent.width;
+  info->height = texture.extent.height;
+  info->depth = texture.extent.depth;
+  info->format = texture.format;
+  info->downsample_level = texture.downsampleLevel;
+  info->size_in_bytes = 0;
+  for (const VulkanTile& tile : texture.tiles)
+    info->size_in_bytes += tile.deviceMemorySize;
+  info->tile_count_x = texture.tileCount.width;
+  info->tile_count_y = texture.tileCount.height;
+  info->tile_count_z = texture.tileCount.depth;
+  info->tile_stride_x = texture.tileStride.width;
+  info->tile_stride_y = texture.tileStride.height;
+  info->tile_stride_z = texture.tileStride.depth;
+  info->host_image_copy = texture.hostImageCopy ? 1 : 0;
+  return true;
+}
+
+bool TextureSubPluginAPI_Vulkan::ConfigureBrickStatistics(
+    uint32_t texture_id, const BrickStatisticsConfig& config) {
+  std::lock_guard<std::mutex> lock(m_TexturesMutex);
+  auto search = m_CreatedTextures.find(texture_id);
+  if (search == m_CreatedTextures.end()) {
+    PLUGIN_LOG_ERROR("no texture was created with the provided texture ID");
+    return false;
+  }
+
+  VulkanTexture3D& texture = search->second;
+  if (texture.requestedFormat != R8_UINT &&
+      texture.requestedFormat != R16_UINT) {
+    PLUGIN_LOG_ERROR("brick statistics require a single-channel format");
+    return false;
+  }
+  texture.statistics = std::make_shared<BrickStatisticsTable>(
+      config, texture.requestedExtent.width, texture.requestedExtent.height,
+      texture.requestedExtent.depth, texture.requestedFormat);
+  return true;
+}
+
+uint32_t TextureSubPluginAPI_Vulkan::GetBrickStatistics(
+    uint32_t texture_id, BrickStatistics* stats, uint32_t max_bricks,
+    uint32_t* histograms, uint32_t max_histogram_entries) {
+  std::shared_ptr<BrickStatisticsTable> statistics;
+  {
+    std::lock_guard<std::mutex> lock(m_TexturesMutex);
+    auto search = m_CreatedTextures.find(texture_id);
+    if (search == m_CreatedTextures.end()) return 0;
+    statistics = search->second.statistics;
+  }
+  if (!statistics) return 0;
+  return statistics->Read(stats, max_bricks, histograms,
+                          max_histogram_entries);
+}
+
+uint32_t TextureSubPluginAPI_Vulkan::GetOccupancyBitmap(uint32_t texture_id,
+                                                       uint32_t* words,
+                                                       uint32_t max_words) {
+  std::shared_ptr<BrickStatisticsTable> statistics;
+  {
+    std::lock_guard<std::mutex> lock(m_TexturesMutex);
+    auto search = m_CreatedTextures.find(texture_id);
+    if (search == m_CreatedTextures.end()) return 0;
+    statistics = search->second.statistics;
+  }
+  if (!statistics) return 0;
+  return statistics->GetOccupancy(words, max_words);
+}
+
+void TextureSubPluginAPI_Vulkan::UploadBrickStatisticsTexture(
+    uint32_t texture_id, uint32_t stats_texture_id) {
+  std::shared_ptr<BrickStatisticsTable> statistics;
+  bool stats_texture_exists = false;
+  {
+    std::lock_guard<std::mutex> lock(m_TexturesMutex);
+    if (auto search = m_CreatedTextures.find(texture_id);
+        search != m_CreatedTextures.end())
+      statistics = search->second.statistics;
+    if (auto search = m_CreatedTextures.find(stats_texture_id);
+        search != m_CreatedTextures.end()) {
+      const VkExtent3D& extent = search->second.requestedExtent;
+      stats_texture_exists = true;
+      if (statistics && (extent.width != statistics->BrickCountX() ||
+                         extent.height != statistics->BrickCountY() ||
+                         extent.depth != statistics->BrickCountZ())) {
+        PLUGIN_LOG_ERROR("the min/max texture does not match the brick grid "
+                         "(destroy it after reconfiguring the statistics)");
+        return;
+      }
+    }
+  }
+  if (!statistics) {
+    PLUGIN_LOG_ERROR(
+        "brick statistics are not configured for the provided texture ID");
+    return;
+  }
+
+  std::vector<uint8_t> texels;
+  const Format format = statistics->GetMinMaxTexels(&texels);
+  if (!stats_texture_exists) {
+    CreateTexture3D(stats_texture_id, statistics->BrickCountX(),
+                    statistics->BrickCountY(), statistics->BrickCountZ(),
+                    format);
+  }
+  TextureSubImage3DByID(stats_texture_id, 0, 0, 0, statistics->BrickCountX(),
+                        statistics->BrickCountY(), statistics->BrickCountZ(),
+                        texels.data(), 0, format, nullptr, UPLOAD_FLAG_NONE);
+}
+
+bool TextureSubPluginAPI_Vulkan::FindCreatedTexture3D(void* texture_handle,
+                                                      uint32_t* texture_id) {
+  // the handle is either what RetrieveCreatedTexture3D returned (VkImage*) or
+  // what GetNativeTexturePtr returned for the external texture (VkImage)
+  auto handle = m_TextureHandles.find(texture_handle);
+  if (handle == m_TextureHandles.end()) return false;
+  *texture_id = handle->second;
+  return true;
+}
+
+void TextureSubPluginAPI_Vulkan::DestroyTexture3D(uint32_t texture_id) {
+  std::lock_guard<std::mutex> lock(m_TexturesMutex);
+  if (auto search = m_CreatedTextures.find(texture_id);
+      search != m_CreatedTextures.end()) {
+    // frames that are still in flight may sample the images - they are
+    // released once the current frame has completed
+    for (const VulkanTile& tile : search->second.tiles) {
+      m_TextureHandles.erase(tile.image.get());
+      m_TextureHandles.erase(reinterpret_cast<void*>(*tile.image));
+    }
+    UnityVulkanRecordingState recordingState;
+    if (m_UnityVulkan->CommandRecordingState(
+            &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+      std::vector<VulkanTile>& tiles =
+          m_TileDeleteQueue[recordingState.currentFrameNumber];
+      for (VulkanTile& tile : search->second.tiles)
+        tiles.push_back(std::move(tile));
+    } else {
+      DestroyTileImages(&search->second);
+    }
+    m_CreatedTextures.erase(search);
+    return;
+  }
+  PLUGIN_LOG_ERROR("failed to destroy texture 3D (texture ID does not refer "
+                   "to a created texture 3D)");
+}
+
+// Box-filters a brick by 2^level along each axis and converts the averaged
+// values using convert. Voxels at the brick's borders only average the source
+// voxels that lie inside of the brick, hence bricks have to be aligned to
+// 2^level (see IsDownsampleAligned) - except at the volume's far borders.
+template <typename Src, typename Dst, typename Convert>
+static void ReduceBrick(const Src* src, const VkOffset3D& src_offset,
+                        const VkExtent3D& src_extent, uint32_t level, Dst* dst,
+                        const VkOffset3D& dst_offset,
+                        const VkExtent3D& dst_extent, Convert convert) {
+  auto range = [level](int32_t dst_coord, int32_t src_begin, int32_t src_size,
+                       int32_t* first, int32_t* last) {
+    *first = std::max(dst_coord << level, src_begin) - src_begin;
+    *last = std::min((dst_coord + 1) << level, src_begin + src_size) -
+            src_begin;
+  };
+
+  for (uint32_t z = 0; z < dst_extent.depth; ++z) {
+    int32_t z0, z1;
+    range(dst_offset.z + z, src_offset.z, src_extent.depth, &z0, &z1);
+    for (uint32_t y = 0; y < dst_extent.height; ++y) {
+      int32_t y0, y1;
+      range(dst_offset.y + y, src_offset.y, src_extent.height, &y0, &y1);
+      for (uint32_t x = 0; x < dst_extent.width; ++x) {
+        int32_t x0, x1;
+        range(dst_offset.x + x, src_offset.x, src_extent.width, &x0, &x1);
+        uint64_t sum = 0;
+        for (int32_t zz = z0; zz < z1; ++zz)
+          for (int32_t yy = y0; yy < y1; ++yy) {
+            const Src* row =
+                src + (static_cast<size_t>(zz) * src_extent.height + yy) *
+                          src_extent.width;
+            for (int32_t xx = x0; xx < x1; ++xx) sum += row[xx];
+          }
+        const uint64_t count =
+            static_cast<uint64_t>(z1 - z0) * (y1 - y0) * (x1 - x0);
+        *dst++ = convert(static_cast<uint32_t>((sum + count / 2) / count));
+      }
+    }
+  }
+}
+
+// maps [lo, hi] to [0, 255] (used when the precision of a texture is reduced)
+static uint8_t WindowTexel(uint32_t v, uint32_t lo, uint32_t hi) {
+  if (v <= lo) return 0;
+  if (v >= hi) return 255;
+  return static_cast<uint8_t>(((v - lo) * 255 + (hi - lo) / 2) / (hi - lo));
+}
+
+// checks that a region of a downsampled texture covers whole 2^level cells
+// along each axis, i.e., that no voxel of the texture is averaged from
+// several uploads (the last one would overwrite it with a partial average)
+static bool IsDownsampleAligned(const VulkanTexture3D& texture,
+                                const VkOffset3D& offset,
+                                const VkExtent3D& extent) {
+  const uint32_t cell = 1u << texture.downsampleLevel;
+  auto aligned = [cell](int32_t begin, uint32_t size, uint32_t volume_size) {
+    const uint32_t end = static_cast<uint32_t>(begin) + size;
+    return begin % cell == 0 && (end % cell == 0 || end == volume_size);
+  };
+  return aligned(offset.x, extent.width, texture.requestedExtent.width) &&
+         aligned(offset.y, extent.height, texture.requestedExtent.height) &&
+         aligned(offset.z, extent.depth, texture.requestedExtent.depth);
+}
+
+// computes the region of a (possibly downsampled) texture that an upload of
+// the given (requested-coordinates) region ends up in
+static void DegradeRegion(const VulkanTexture3D* texture,
+                          const VkOffset3D& src_offset,
+                          const VkExtent3D& src_extent, VkOffset3D* dst_offset,
+                          VkExtent3D* dst_extent) {
+  *dst_offset = src_offset;
+  *dst_extent = src_extent;
+  if (!texture || texture->downsampleLevel == 0) return;
+
+  const uint32_t k = texture->downsampleLevel;
+  *dst_offset = {src_offset.x >> k, src_offset.y >> k, src_offset.z >> k};
+  dst_extent->width =
+      ((src_offset.x + src_extent.width - 1) >> k) - dst_offset->x + 1;
+  dst_extent->height =
+      ((src_offset.y + src_extent.height - 1) >> k) - dst_offset->y + 1;
+  dst_extent->depth =
+      ((src_offset.z + src_extent.depth - 1) >> k) - dst_offset->z + 1;
+}
+
+// routes a region of a texture to every tile it intersects. The buffer
+// offsets assume that the buffer holds the whole region (x-fastest). If
+// exclusive is set, voxels that adjacent tiles share are only routed to the
+// latter tile (e.g., so that readbacks do not write them twice)
+static void IntersectTiles(VulkanTexture3D* texture,
+                           const VkOffset3D& dst_offset,
+                           const VkExtent3D& dst_extent, size_t texel_size,
+                           int32_t level, std::vector<VulkanTile*>* tiles,
+                           std::vector<VkBufferImageCopy>* regions,
+                           bool exclusive = false) {
+  for (VulkanTile& tile : texture->tiles) {
+    VkExtent3D extent = tile.extent;
+    if (exclusive) {
+      if (tile.offset.x + extent.width < texture->extent.width)
+        extent.width = texture->tileStride.width;
+      if (tile.offset.y + extent.height < texture->extent.height)
+        extent.height = texture->tileStride.height;
+      if (tile.offset.z + extent.depth < texture->extent.depth)
+        extent.depth = texture->tileStride.depth;
+    }
+    const int32_t x0 = std::max(dst_offset.x, tile.offset.x);
+    const int32_t y0 = std::max(dst_offset.y, tile.offset.y);
+    const int32_t z0 = std::max(dst_offset.z, tile.offset.z);
+    const int32_t x1 = std::min<int32_t>(dst_offset.x + dst_extent.width,
+                                         tile.offset.x + extent.width);
+    const int32_t y1 = std::min<int32_t>(dst_offset.y + dst_extent.height,
+                                         tile.offset.y + extent.height);
+    const int32_t z1 = std::min<int32_t>(dst_offset.z + dst_extent.depth,
+                                         tile.offset.z + extent.depth);
+    if (x0 >= x1 || y0 >= y1 || z0 >= z1) continue;
+
+    VkBufferImageCopy region{};
+    region.bufferOffset =
+        texel_size * ((static_cast<VkDeviceSize>(z0 - dst_offset.z) *
+                           dst_extent.height +
+                       (y0 - dst_offset.y)) *
+                          dst_extent.width +
+                      (x0 - dst_offset.x));
+    region.bufferRowLength = dst_extent.width;
+    region.bufferImageHeight = dst_extent.height;
+    region.imageOffset = {x0 - tile.offset.x, y0 - tile.offset.y,
+                          z0 - tile.offset.z};
+    region.imageExtent = {static_cast<uint32_t>(x1 - x0),
+                          static_cast<uint32_t>(y1 - y0),
+                          static_cast<uint32_t>(z1 - z0)};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageSubresource.mipLevel = level;
+    tiles->push_back(&tile);
+    regions->push_back(region);
+  }
+}
+
+// whether an upload region is not empty and lies within extent (the signed
+// fields are checked before they are used as a VkOffset3D/VkExtent3D)
+static bool RegionInside(const TextureUploadRegion& region,
+                         const VkExtent3D& extent) {
+  return region.width > 0 && region.height > 0 && region.depth > 0 &&
+         region.xoffset >= 0 && region.yoffset >= 0 && region.zoffset >= 0 &&
+         static_cast<int64_t>(region.xoffset) + region.width <= extent.width &&
+         static_cast<int64_t>(region.yoffset) + region.height <=
+             extent.height &&
+         static_cast<int64_t>(region.zoffset) + region.depth <= extent.depth;
+}
+
+// reads the value of a constant region (detecting whether it is constant
+// unless the caller guarantees it) and converts it to the requested format
+static bool ReadConstantTexel(const void* data_ptr, size_t count,
+                              Format format, const SourceDescriptor* source,
+                              uint32_t flags, uint32_t* texel) {
+  // 64-bit texels (RGBA16_UINT) do not fit into a fill pattern
+  if (FormatTexelSize(format) > sizeof(*texel)) return false;
+
+  const bool convert = source && source->encoding != SOURCE_ENCODING_NATIVE;
+  if (!(flags & UPLOAD_FLAG_CONSTANT)) {
+    size_t element_size = FormatTexelSize(format);
+    if (convert) {
+      switch (source->encoding) {
+        case SOURCE_ENCODING_FLOAT32:
+          element_size = sizeof(float);
+          break;
+        case SOURCE_ENCODING_UINT16_BIG_ENDIAN:
+          element_size = sizeof(uint16_t);
+          break;
+        default:
+          // packed 12-bit values straddle bytes, planar channels are not
+          // contiguous
+          return false;
+      }
+    }
+    if (element_size == 0 || !IsConstant(data_ptr, count, element_size))
+      return false;
+  }
+
+  *texel = 0;
+  if (convert) return ConvertSource(*source, data_ptr, 0, 1, format, texel);
+  memcpy(texel, data_ptr, FormatTexelSize(format));
+  return true;
+}
+
+static VkClearColorValue TexelToClearColor(uint32_t texel, Format format) {
+  // UNORM/SNORM clear values are converted back exactly for 8 and 16 bit
+  // channels (except for the SNORM minimum which is clamped to -1 anyway)
+  const FormatTraits traits = GetFormatTraits(format);
+  VkClearColorValue color{};
+  if (traits.channel_size == 0 || traits.texel_size > sizeof(texel))
+    return color;
+  const uint32_t bits = traits.channel_size * 8;
+  const uint32_t mask = bits == 32 ? 0xFFFFFFFF : (1u << bits) - 1;
+  for (uint32_t c = 0; c < traits.channel_count; ++c) {
+    const uint32_t value = (texel >> (bits * c)) & mask;
+    switch (traits.channel_type) {
+      case CHANNEL_TYPE_UNORM:
+        color.float32[c] = value / static_cast<float>(mask);
+        break;
+      case CHANNEL_TYPE_SNORM:
+        color.float32[c] = std::max(-1.0f, static_cast<int8_t>(value) / 127.0f);
+        break;
+      case CHANNEL_TYPE_SFLOAT:
+        if (bits == 32)
+          memcpy(&color.float32[c], &value, sizeof(float));
+        else
+          color.float32[c] = HalfToFloat(static_cast<uint16_t>(value));
+        break;
+    }
+  }
+  return color;
+}
+
+bool TextureSubPluginAPI_Vulkan::RecordConstantSubImage3D(
+    VkCommandBuffer command_buffer, unsigned long long frame_number,
+    VulkanTexture3D* texture, const VkOffset3D& src_offset,
+    const VkExtent3D& src_extent, Format format, uint32_t texel) {
+  TraceScope trace("upload", "RecordConstantSubImage3D", "voxels",
+                   static_cast<uint64_t>(src_extent.width) *
+                       src_extent.height * src_extent.depth);
+  std::shared_ptr<BrickStatisticsTable> statistics;
+  {
+    std::lock_guard<std::mutex> lock(m_TexturesMutex);
+    statistics = texture->statistics;
+  }
+  if (statistics)
+    statistics->AccumulateConstant(texel, src_offset.x, src_offset.y,
+                                   src_offset.z, src_extent.width,
+                                   src_extent.height, src_extent.depth);
+
+  // downsampling does not change a constant region's value, reducing the
+  // precision does
+  if (texture->format != format) {
+    if (format != R16_UINT || texture->format != R8_UINT) {
+      PLUGIN_LOG_ERROR(
+          "source format %d does not match the texture's format %d", format,
+          texture->format);
+      return false;
+    }
+    texel = WindowTexel(texel, texture->windowMin, texture->windowMax);
+  }
+
+  VkOffset3D dst_offset;
+  VkExtent3D dst_extent;
+  DegradeRegion(texture, src_offset, src_extent, &dst_offset, &dst_extent);
+  const size_t texel_size = FormatTexelSize(texture->format);
+  std::vector<VulkanTile*> tiles;
+  std::vector<VkBufferImageCopy> regions;
+  IntersectTiles(texture, dst_offset, dst_extent, texel_size, 0, &tiles,
+                 &regions);
+
+  // tiles that are covered completely are cleared, all others are copied
+  // from a buffer that is filled with the texel on the GPU
+  bool needs_fill = false;
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    const VkBufferImageCopy& region = regions[i];
+    needs_fill = needs_fill || region.imageOffset.x != 0 ||
+                 region.imageOffset.y != 0 || region.imageOffset.z != 0 ||
+                 region.imageExtent.width != tiles[i]->extent.width ||
+                 region.imageExtent.height != tiles[i]->extent.height ||
+                 region.imageExtent.depth != tiles[i]->extent.depth;
+  }
+
+  if (needs_fill) {
+    // vkCmdFillBuffer writes 32-bit words
+    const VkDeviceSize fill_size =
+        (texel_size * dst_extent.width * dst_extent.height * dst_extent.depth +
+         3) &
+        ~VkDeviceSize(3);
+    if (m_ConstantFillBuffer.sizeInBytes < fill_size) {
+      SafeDestroy(frame_number, m_ConstantFillBuffer);
+      m_ConstantFillBuffer = VulkanBuffer();
+      if (!CreateVulkanBuffer(
+              fill_size, &m_ConstantFillBuffer,
+              VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+        PLUGIN_LOG_ERROR("failed to create constant fill buffer");
+        return false;
+      }
+    }
+
+    uint32_t pattern = texel;
+    if (texel_size == 1)
+      pattern *= 0x01010101u;
+    else if (texel_size == 2)
+      pattern |= pattern << 16;
+
+    // the buffer may still be read by a previously recorded copy
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+    vkCmdFillBuffer(command_buffer, m_ConstantFillBuffer.buffer, 0, fill_size,
+                    pattern);
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+  }
+
+  const VkClearColorValue clear_color =
+      TexelToClearColor(texel, texture->format);
+  const VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  TransitionTiles(command_buffer, frame_number, tiles.data(), tiles.size(),
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    const VkBufferImageCopy& region = regions[i];
+    const bool whole_tile =
+        region.imageOffset.x == 0 && region.imageOffset.y == 0 &&
+        region.imageOffset.z == 0 &&
+        region.imageExtent.width == tiles[i]->extent.width &&
+        region.imageExtent.height == tiles[i]->extent.height &&
+        region.imageExtent.depth == tiles[i]->extent.depth;
+    if (whole_tile)
+      vkCmdClearColorImage(command_buffer, *tiles[i]->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear_color,
+                           1, &range);
+    else
+      vkCmdCopyBufferToImage(command_buffer, m_ConstantFillBuffer.buffer,
+                             *tiles[i]->image,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  }
+  TransitionTiles(command_buffer, frame_number, tiles.data(), tiles.size(),
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  return true;
+}
+
+bool TextureSubPluginAPI_Vulkan::StageSubImage3D(
+    const VulkanTexture3D* texture, const VkOffset3D& src_offset,
+    const VkExtent3D& src_extent, const void* data_ptr, Format format,
+    const SourceDescriptor* source, unsigned long long frame_number,
+    VkOffset3D* dst_offset, VkExtent3D* dst_extent, size_t* texel_size,
+    VulkanStaging* staging) {
+  TraceScope trace("upload", "StageSubImage3D", "voxels",
+                   static_cast<uint64_t>(src_extent.width) *
+                       src_extent.height * src_extent.depth);
+  // textures that were degraded by the memory budget policy expect their
+  // uploads to be downsampled and/or windowed accordingly
+  const bool degraded = texture && (texture->downsampleLevel > 0 ||
+                                    texture->format != format);
+  Format dst_format = degraded ? texture->format : format;
+  if (texture && texture->downsampleLevel > 0 &&
+      !IsDownsampleAligned(*texture, src_offset, src_extent)) {
+    PLUGIN_LOG_ERROR(
+        "uploads to a texture that was downsampled %u times have to be aligned "
+        "to %u voxels",
+        texture->downsampleLevel, 1u << texture->downsampleLevel);
+    return false;
+  }
+  DegradeRegion(texture, src_offset, src_extent, dst_offset, dst_extent);
+
+  *texel_size = FormatTexelSize(dst_format);
+  if (*texel_size == 0) {
+    PLUGIN_LOG_ERROR("unsupported texture format: %d", format);
+    return false;
+  }
+  const size_t data_size = *texel_size * dst_extent->width *
+                           dst_extent->height * dst_extent->depth;
+  // staging memory is host (CPU) visible memory that we copy image data to
+  // which then a command on the client (GPU) copies a (sub)region from
+  if (!AllocateStaging(data_size, frame_number, staging)) return false;
+  void* const mapped = staging->mapped;
+
+  const bool convert = source && source->encoding != SOURCE_ENCODING_NATIVE;
+  const size_t count = static_cast<size_t>(src_extent.width) *
+                       src_extent.height * src_extent.depth;
+  std::shared_ptr<BrickStatisticsTable> statistics;
+  if (texture) {
+    std::lock_guard<std::mutex> lock(m_TexturesMutex);
+    statistics = texture->statistics;
+  }
+
+  std::vector<uint8_t> converted;
+  if (convert && degraded) {
+    // the downsampling/windowing below expects the data in the requested
+    // format, so degraded textures cannot fuse the conversion
+    converted.resize(count * FormatTexelSize(format));
+    if (!ConvertSource(*source, data_ptr, 0, count, format,
+                       converted.data())) {
+      PLUGIN_LOG_ERROR(
+          "unsupported conversion from source encoding %u to texture format: "
+          "%d",
+          source->encoding, format);
+      return false;
+    }
+    data_ptr = converted.data();
+  }
+
+  if (statistics && !degraded) {
+    // statistics are accumulated on the data while it is copied (and
+    // converted) into the staging buffer
+    if (!statistics->CopyRegion(data_ptr, source, mapped,
+                                src_offset.x, src_offset.y, src_offset.z,
+                                src_extent.width, src_extent.height,
+                                src_extent.depth)) {
+      PLUGIN_LOG_ERROR(
+          "unsupported conversion from source encoding %u to texture format: "
+          "%d",
+          source->encoding, format);
+      return false;
+    }
+  } else if (!degraded && convert) {
+    // convert while copying into the staging buffer - a single pass over the
+    // source data
+    if (!ConvertSource(*source, data_ptr, 0, count, format,
+                       mapped)) {
+      PLUGIN_LOG_ERROR(
+          "unsupported conversion from source encoding %u to texture format: "
+          "%d",
+          source->encoding, format);
+      return false;
+    }
+  } else if (!degraded) {
+    StreamCopy(mapped, data_ptr, data_size);
+  } else if (format == R16_UINT && dst_format == R8_UINT) {
+    const uint32_t lo = texture->windowMin;
+    const uint32_t hi = texture->windowMax;
+    ReduceBrick(static_cast<const uint16_t*>(data_ptr), src_offset, src_extent,
+                texture->downsampleLevel,
+                static_cast<uint8_t*>(mapped),
+                *dst_offset, *dst_extent,
+                [lo, hi](uint32_t v) { return WindowTexel(v, lo, hi); });
+  } else if (format == R16_UINT) {
+    ReduceBrick(static_cast<const uint16_t*>(data_ptr), src_offset, src_extent,
+                texture->downsampleLevel,
+                static_cast<uint16_t*>(mapped),
+                *dst_offset, *dst_extent,
+                [](uint32_t v) { return static_cast<uint16_t>(v); });
+  } else if (format == dst_format) {
+    ReduceBrick(static_cast<const uint8_t*>(data_ptr), src_offset, src_extent,
+                texture->downsampleLevel,
+                static_cast<uint8_t*>(mapped),
+                *dst_offset, *dst_extent,
+                [](uint32_t v) { return static_cast<uint8_t>(v); });
+  } else {
+    PLUGIN_LOG_ERROR("source format %d does not match the texture's format %d",
+                     format, dst_format);
+    return false;
+  }
+
+  // statistics of degraded textures describe the data in the requested format
+  // and hence need a separate pass over the (converted) source data
+  if (statistics && degraded)
+    statistics->CopyRegion(data_ptr, nullptr, nullptr, src_offset.x,
+                           src_offset.y, src_offset.z, src_extent.width,
+                           src_extent.height, src_extent.depth);
+
+  FlushStaging(*staging);
+  return true;
+}
+
+bool TextureSubPluginAPI_Vulkan::HostCopySubImage3D(
+    VulkanTexture3D* texture, const VkOffset3D& src_offset,
+    const VkExtent3D& src_extent, const void* data_ptr, Format format,
+    const SourceDescriptor* source, unsigned long long safe_frame_number) {
+#if SUPPORT_HOST_IMAGE_COPY
+  // uploads into degraded textures have to be downsampled/windowed first
+  if (!texture->hostImageCopy || texture->downsampleLevel > 0 ||
+      texture->format != format)
+    return false;
+
+  HostImageCopyPolicy policy;
+  {
+    std::lock_guard<std::mutex> lock(m_PolicyMutex);
+    policy = m_HostImageCopyPolicy;
+  }
+  const size_t texel_size = FormatTexelSize(format);
+  const size_t count = static_cast<size_t>(src_extent.width) *
+                       src_extent.height * src_extent.depth;
+  // on discrete GPUs the driver writes large regions over the bus in the
+  // image's tiled layout, which is slower than a staged copy
+  if (policy.mode == HOST_IMAGE_COPY_NEVER ||
+      (policy.mode == HOST_IMAGE_COPY_AUTO && !texture->hostVisible &&
+       count * texel_size > policy.max_region_bytes))
+    return false;
+
+  std::vector<VulkanTile*> tiles;
+  std::vector<VkBufferImageCopy> regions;
+  IntersectTiles(texture, src_offset, src_extent, texel_size, 0, &tiles,
+                 &regions);
+  // the CPU writes right away, so tiles that are still accessed by recorded
+  // commands (e.g., the clear after creation or earlier staged uploads) are
+  // staged to keep the uploads in order
+  for (const VulkanTile* tile : tiles)
+    if (tile->layout != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL ||
+        tile->lastRecordedFrame > safe_frame_number)
+      return false;
+
+  TraceScope trace("upload", "HostCopySubImage3D", "voxels", count);
+  std::vector<uint8_t> converted;
+  if (source && source->encoding != SOURCE_ENCODING_NATIVE) {
+    converted.resize(count * texel_size);
+    // unsupported conversions are reported by the staging path
+    if (!ConvertSource(*source, data_ptr, 0, count, format, converted.data()))
+      return false;
+    data_ptr = converted.data();
+  }
+
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    const VkBufferImageCopy& region = regions[i];
+    VkMemoryToImageCopyEXT copy{};
+    copy.sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+    copy.pHostPointer =
+        static_cast<const uint8_t*>(data_ptr) + region.bufferOffset;
+    copy.memoryRowLength = region.bufferRowLength;
+    copy.memoryImageHeight = region.bufferImageHeight;
+    copy.imageSubresource = region.imageSubresource;
+    copy.imageOffset = region.imageOffset;
+    copy.imageExtent = region.imageExtent;
+
+    VkCopyMemoryToImageInfoEXT copy_info{};
+    copy_info.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+    copy_info.dstImage = *tiles[i]->image;
+    copy_info.dstImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    copy_info.regionCount = 1;
+    copy_info.pRegions = &copy;
+    if (vkCopyMemoryToImageEXT(m_Instance.device, &copy_info) != VK_SUCCESS) {
+      PLUGIN_LOG_WARNING("vkCopyMemoryToImageEXT failed - staging instead");
+      return false;
+    }
+  }
+
+  std::shared_ptr<BrickStatisticsTable> statistics;
+  {
+    std::lock_guard<std::mutex> lock(m_TexturesMutex);
+    statistics = texture->statistics;
+  }
+  if (statistics)
+    statistics->CopyRegion(data_ptr, nullptr, nullptr, src_offset.x,
+                           src_offset.y, src_offset.z, src_extent.width,
+                           src_extent.height, src_extent.depth);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool TextureSubPluginAPI_Vulkan::RegisterHostMemory(uint32_t memory_id,
+                                                    void* ptr, uint64_t size) {
+  if (!m_ExternalMemoryHostSupported || ptr == nullptr || size == 0)
+    return false;
+  {
+    std::lock_guard<std::mutex> lock(m_HostMemoryMutex);
+    if (m_HostMemory.count(memory_id) != 0) {
+      PLUGIN_LOG_ERROR(
+          "host memory with the provided memory ID is already registered!");
+      return false;
+    }
+  }
+
+  // only the part of the range that is aligned to
+  // minImportedHostPointerAlignment can be imported. Uploads from outside of
+  // it are staged
+  const uintptr_t alignment = static_cast<uintptr_t>(m_HostPointerAlignment);
+  const uintptr_t begin =
+      (reinterpret_cast<uintptr_t>(ptr) + alignment - 1) & ~(alignment - 1);
+  const uintptr_t end =
+      (reinterpret_cast<uintptr_t>(ptr) + size) & ~(alignment - 1);
+  if (end <= begin) {
+    PLUGIN_LOG_WARNING(
+        "the range does not contain a block of %llu aligned bytes",
+        static_cast<unsigned long long>(alignment));
+    return false;
+  }
+  void* const host_pointer = reinterpret_cast<void*>(begin);
+  const VkDeviceSize import_size = end - begin;
+
+  VkMemoryHostPointerPropertiesEXT pointer_properties{};
+  pointer_properties.sType =
+      VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+  if (vkGetMemoryHostPointerPropertiesEXT(
+          m_Instance.device,
+          VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, host_pointer,
+          &pointer_properties) != VK_SUCCESS) {
+    PLUGIN_LOG_WARNING("the pointer cannot be imported");
+    return false;
+  }
+
+  VkExternalMemoryBufferCreateInfo external_info{};
+  external_info.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+  external_info.handleTypes =
+      VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+  VkBufferCreateInfo buffer_info{};
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.pNext = &external_info;
+  buffer_info.size = import_size;
+  buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  // the memory is owned by the caller, so it is neither mapped nor counted as
+  // plugin usage (deviceMemorySize stays 0)
+  VulkanHostMemory registered{};
+  registered.hostPointer = static_cast<const uint8_t*>(host_pointer);
+  VulkanBuffer& buffer = registered.buffer;
+  if (vkCreateBuffer(m_Instance.device, &buffer_info, nullptr,
+                     &buffer.buffer) != VK_SUCCESS)
+    return false;
+
+  // writes of the caller have to be visible without flushes
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(m_Instance.device, buffer.buffer,
+                                &requirements);
+  requirements.memoryTypeBits &= pointer_properties.memoryTypeBits;
+  const int memory_type = FindMemoryTypeIndex(
+      m_MemoryProperties, requirements, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  VkImportMemoryHostPointerInfoEXT import_info{};
+  import_info.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+  import_info.handleType =
+      VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+  import_info.pHostPointer = host_pointer;
+  VkMemoryAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.pNext = &import_info;
+  alloc_info.allocationSize = import_size;
+  alloc_info.memoryTypeIndex = static_cast<uint32_t>(memory_type);
+  if (memory_type < 0 || requirements.size > import_size ||
+      vkAllocateMemory(m_Instance.device, &alloc_info, nullptr,
+                       &buffer.deviceMemory) != VK_SUCCESS ||
+      vkBindBufferMemory(m_Instance.device, buffer.buffer, buffer.deviceMemory,
+                         0) != VK_SUCCESS) {
+    PLUGIN_LOG_WARNING("failed to import %llu bytes",
+                       static_cast<unsigned long long>(import_size));
+    ImmediateDestroyVulkanBuffer(buffer);
+    return false;
+  }
+  buffer.sizeInBytes = import_size;
+  buffer.deviceMemoryFlags =
+      m_MemoryProperties.memoryTypes[memory_type].propertyFlags;
+  buffer.deviceMemoryHeap =
+      m_MemoryProperties.memoryTypes[memory_type].heapIndex;
+
+  std::lock_guard<std::mutex> lock(m_HostMemoryMutex);
+  m_HostMemory[memory_id] = registered;
+  return true;
+}
+
+void TextureSubPluginAPI_Vulkan::UnregisterHostMemory(uint32_t memory_id) {
+  std::lock_guard<std::mutex> lock(m_HostMemoryMutex);
+  auto search = m_HostMemory.find(memory_id);
+  if (search == m_HostMemory.end()) {
+    PLUGIN_LOG_ERROR("failed to unregister host memory (memory ID does not "
+                     "refer to registered host memory)");
+    return;
+  }
+  // copies from the memory may still be in flight
+  UnityVulkanRecordingState recordingState;
+  if (m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare))
+    SafeDestroy(recordingState.currentFrameNumber, search->second.buffer);
+  else
+    ImmediateDestroyVulkanBuffer(search->second.buffer);
+  m_HostMemory.erase(search);
+}
+
+bool TextureSubPluginAPI_Vulkan::ImportedCopySubImage3D(
+    VkCommandBuffer command_buffer, unsigned long long frame_number,
+    VulkanTexture3D* texture, const VkOffset3D& src_offset,
+    const VkExtent3D& src_extent, const void* src_ptr,
+    const void* packed_ptr, Format format, const SourceDescriptor* source) {
+  // the GPU copies the data as it is, so it has to be in the texture's format
+  if (!m_ExternalMemoryHostSupported || texture->downsampleLevel > 0 ||
+      texture->format != format ||
+      (source && source->encoding != SOURCE_ENCODING_NATIVE))
+    return false;
+
+  const size_t texel_size = FormatTexelSize(format);
+  const uint32_t row_length =
+      source && source->row_length ? source->row_length : src_extent.width;
+  const uint32_t image_height = source && source->image_height
+                                    ? source->image_height
+                                    : src_extent.height;
+  const VkDeviceSize span =
+      texel_size *
+      ((static_cast<VkDeviceSize>(src_extent.depth - 1) * image_height +
+        (src_extent.height - 1)) *
+           row_length +
+       src_extent.width);
+
+  const uint8_t* data = static_cast<const uint8_t*>(src_ptr);
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceSize base_offset = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_HostMemoryMutex);
+    for (const auto& registered : m_HostMemory) {
+      const VulkanHostMemory& memory = registered.second;
+      if (data < memory.hostPointer ||
+          data + span > memory.hostPointer + memory.buffer.sizeInBytes)
+        continue;
+      buffer = memory.buffer.buffer;
+      base_offset = static_cast<VkDeviceSize>(data - memory.hostPointer);
+      break;
+    }
+  }
+  // copies have to start at multiples of the texel size
+  if (buffer == VK_NULL_HANDLE || base_offset % texel_size != 0) return false;
+
+  TraceScope trace("upload", "ImportedCopySubImage3D", "bytes", span);
+  std::vector<VulkanTile*> tiles;
+  std::vector<VkBufferImageCopy> regions;
+  IntersectTiles(texture, src_offset, src_extent, texel_size, 0, &tiles,
+                 &regions);
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    // IntersectTiles addresses a tightly packed region
+    VkBufferImageCopy& region = regions[i];
+    const VkDeviceSize x =
+        tiles[i]->offset.x + region.imageOffset.x - src_offset.x;
+    const VkDeviceSize y =
+        tiles[i]->offset.y + region.imageOffset.y - src_offset.y;
+    const VkDeviceSize z =
+        tiles[i]->offset.z + region.imageOffset.z - src_offset.z;
+    region.bufferOffset =
+        base_offset + texel_size * ((z * image_height + y) * row_length + x);
+    region.bufferRowLength = row_length;
+    region.bufferImageHeight = image_height;
+  }
+
+  TransitionTiles(command_buffer, frame_number, tiles.data(), tiles.size(),
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  for (size_t i = 0; i < tiles.size(); ++i)
+    vkCmdCopyBufferToImage(command_buffer, buffer, *tiles[i]->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                           &regions[i]);
+  TransitionTiles(command_buffer, frame_number, tiles.data(), tiles.size(),
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  std::shared_ptr<BrickStatisticsTable> statistics;
+  {
+    std::lock_guard<std::mutex> lock(m_TexturesMutex);
+    statistics = texture->statistics;
+  }
+  if (statistics)
+    statistics->CopyRegion(packed_ptr, nullptr, nullptr, src_offset.x,
+                           src_offset.y, src_offset.z, src_extent.width,
+                           src_extent.height, src_extent.depth);
+  return true;
+}
+
+void TextureSubPluginAPI_Vulkan::TextureSubImage3D(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, void* data_ptr, int32_t level,
+    Format format) {
+  UploadSubImage3D(texture_handle, xoffset, yoffset, zoffset, width, height,
+                   depth, data_ptr, level, format, nullptr);
+}
+
+void TextureSubPluginAPI_Vulkan::TextureSubImage3DFromSource(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, void* data_ptr, int32_t level,
+    Format format, const SourceDescriptor& source) {
+  UploadSubImage3D(texture_handle, xoffset, yoffset, zoffset, width, height,
+                   depth, data_ptr, level, format, &source);
+}
+
+void TextureSubPluginAPI_Vulkan::UploadSubImage3D(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, void* data_ptr, int32_t level,
+    Format format, const SourceDescriptor* source) {
+  // textures created by the plugin may be tiled and their layouts are tracked
+  // per tile, so their regions are routed like the ones of uploads by ID
+  uint32_t texture_id;
+  if (FindCreatedTexture3D(texture_handle, &texture_id)) {
+    TextureSubImage3DByID(texture_id, xoffset, yoffset, zoffset, width, height,
+                          depth, data_ptr, level, format, source,
+                          UPLOAD_FLAG_NONE);
+    return;
+  }
+
+  // strided regions are packed while they are copied anyway
+  std::vector<uint8_t> packed;
+  if (!PackStridedSource(source, width, height, depth, format, &data_ptr,
+                         &packed)) {
+    PLUGIN_LOG_ERROR("strides are only supported for native sources");
+    return;
+  }
+
+  UnityVulkanRecordingState recordingState;
+  if (!m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+    PLUGIN_LOG_ERROR("failed to intercept the current command buffer state");
+    return;
+  }
+
+  VkOffset3D dst_offset;
+  VkExtent3D dst_extent;
+  size_t texel_size;
+  VulkanStaging staging;
+  if (!StageSubImage3D(nullptr, {xoffset, yoffset, zoffset},
+                       {static_cast<uint32_t>(width),
+                        static_cast<uint32_t>(height),
+                        static_cast<uint32_t>(depth)},
+                       data_ptr, format, source,
+                       recordingState.currentFrameNumber, &dst_offset,
+                       &dst_extent, &texel_size, &staging))
+    return;
+
+  // cannot do resource uploads inside renderpass
+  m_UnityVulkan->EnsureOutsideRenderPass();
+
+  // get the VkImage from the provided texture handle
+  UnityVulkanImage image;
+  if (!m_UnityVulkan->AccessTexture(
+          texture_handle, UnityVulkanWholeImage,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_ACCESS_TRANSFER_WRITE_BIT,
+          kUnityVulkanResourceAccess_PipelineBarrier, &image)) {
+    PLUGIN_LOG_ERROR(
+        "failed to access texture from provided texture handle: %p",
+        texture_handle);
+    return;
+  }
+
+  // since we have done a resource access, the previous CommandRecordingState is
+  // invalidated and has to be requested again
+  if (!m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+    PLUGIN_LOG_ERROR("failed to intercept the current command buffer state");
+    return;
+  }
+
+  VkBufferImageCopy region{};
+  region.bufferImageHeight = 0;
+  region.bufferRowLength = 0;
+  region.bufferOffset = staging.offset;
+  region.imageOffset = dst_offset;
+  region.imageExtent = dst_extent;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageSubresource.mipLevel = level;
+  vkCmdCopyBufferToImage(recordingState.commandBuffer, staging.buffer,
+                         image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                         &region);
+}
+
+void TextureSubPluginAPI_Vulkan::TextureSubImage3DByID(
+    uint32_t texture_id, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, void* data_ptr, int32_t level,
+    Format format, const SourceDescriptor* source, uint32_t flags) {
+  if (level != 0) {
+    PLUGIN_LOG_ERROR("invalid mipmap level: %d", level);
+    return;
+  }
+  const TextureUploadRegion region{xoffset, yoffset, zoffset, width, height,
+                                   depth,   data_ptr, source,  flags};
+  TextureSubImage3DBatch(texture_id, &region, 1, format);
+}
+
+void TextureSubPluginAPI_Vulkan::TextureSubImage3DBatch(
+    uint32_t texture_id, const TextureUploadRegion* uploads, uint32_t count,
+    Format format) {
+  auto search = m_CreatedTextures.find(texture_id);
+  if (search == m_CreatedTextures.end()) {
+    PLUGIN_LOG_ERROR("failed to update texture 3D (texture ID does not refer "
+                     "to a created texture 3D)");
+    return;
+  }
+  VulkanTexture3D& texture = search->second;
+  if (count == 0) return;
+
+  // cannot do resource uploads inside renderpass
+  m_UnityVulkan->EnsureOutsideRenderPass();
+
+  UnityVulkanRecordingState recordingState;
+  if (!m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+    PLUGIN_LOG_ERROR("failed to intercept the current command buffer state");
+    return;
+  }
+  const VkCommandBuffer command_buffer = recordingState.commandBuffer;
+  const unsigned long long frame_number = recordingState.currentFrameNumber;
+
+  // staged regions are copied together, so the tiles they intersect are
+  // transitioned once per batch instead of once per region. Copies within
+  // a batch are not ordered, hence a region that overlaps a staged one (in
+  // texture coordinates, which may be downsampled) records the staged
+  // copies first. The regions are sub-allocated from the upload ring (see
+  // AllocateStaging) and share its buffer, so the (non-overlapping) copies
+  // into a tile are grouped and recorded as one vkCmdCopyBufferToImage
+  std::vector<TextureBox> staged;
+  std::vector<VulkanTile*> tiles;
+  std::vector<VkBufferImageCopy> regions;
+  std::vector<VkBuffer> sources;
+  auto record_staged = [&]() {
+    TransitionTiles(command_buffer, frame_number, tiles.data(), tiles.size(),
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    std::vector<size_t> order(tiles.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return tiles[a] != tiles[b]
+                 ? std::less<VulkanTile*>()(tiles[a], tiles[b])
+                 : std::less<VkBuffer>()(sources[a], sources[b]);
+    });
+    std::vector<VkBufferImageCopy> group;
+    for (size_t i = 0; i < order.size();) {
+      const size_t first = order[i];
+      group.clear();
+      for (; i < order.size() && tiles[order[i]] == tiles[first] &&
+             sources[order[i]] == sources[first];
+           ++i)
+        group.push_back(regions[order[i]]);
+      vkCmdCopyBufferToImage(command_buffer, sources[first],
+                             *tiles[first]->image,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             static_cast<uint32_t>(group.size()), group.data());
+    }
+    TransitionTiles(command_buffer, frame_number, tiles.data(), tiles.size(),
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    staged.clear();
+    tiles.clear();
+    regions.clear();
+    sources.clear();
+  };
+  auto overlaps_staged = [&](const VkOffset3D& offset,
+                             const VkExtent3D& extent) {
+    for (const TextureBox& box : staged)
+      if (offset.x < box.x + static_cast<int32_t>(box.width) &&
+          box.x < offset.x + static_cast<int32_t>(extent.width) &&
+          offset.y < box.y + static_cast<int32_t>(box.height) &&
+          box.y < offset.y + static_cast<int32_t>(extent.height) &&
+          offset.z < box.z + static_cast<int32_t>(box.depth) &&
+          box.z < offset.z + static_cast<int32_t>(extent.depth))
+        return true;
+    return false;
+  };
+
+  for (uint32_t u = 0; u < count; ++u) {
+    const TextureUploadRegion& upload = uploads[u];
+    // regions are given in the coordinates of the requested texture
+    if (!upload.data_ptr || !RegionInside(upload, texture.requestedExtent)) {
+      PLUGIN_LOG_ERROR(
+          "region %u is invalid (no data or it exceeds the texture's extent "
+          "%ux%ux%u)",
+          u, texture.requestedExtent.width, texture.requestedExtent.height,
+          texture.requestedExtent.depth);
+      continue;
+    }
+    const VkOffset3D src_offset{upload.xoffset, upload.yoffset,
+                                upload.zoffset};
+    const VkExtent3D src_extent{static_cast<uint32_t>(upload.width),
+                                static_cast<uint32_t>(upload.height),
+                                static_cast<uint32_t>(upload.depth)};
+    VkOffset3D dst_offset;
+    VkExtent3D dst_extent;
+    DegradeRegion(&texture, src_offset, src_extent, &dst_offset, &dst_extent);
+    if (overlaps_staged(dst_offset, dst_extent)) record_staged();
+
+    // registered host memory is copied from as it is (including its strides)
+    void* data_ptr = const_cast<void*>(upload.data_ptr);
+    const void* const src_ptr = data_ptr;
+    std::vector<uint8_t> packed;
+    if (!PackStridedSource(upload.source, upload.width, upload.height,
+                           upload.depth, format, &data_ptr, &packed)) {
+      PLUGIN_LOG_ERROR("strides are only supported for native sources");
+      continue;
+    }
+
+    // constant regions (e.g., empty bricks) are written on the GPU and skip
+    // the staging copy entirely
+    uint32_t texel;
+    if ((upload.flags &
+         (UPLOAD_FLAG_CONSTANT | UPLOAD_FLAG_DETECT_CONSTANT)) &&
+        ReadConstantTexel(
+            data_ptr,
+            static_cast<size_t>(upload.width) * upload.height * upload.depth,
+            format, upload.source, upload.flags, &texel)) {
+      RecordConstantSubImage3D(command_buffer, frame_number, &texture,
+                               src_offset, src_extent, format, texel);
+      continue;
+    }
+
+    // copied straight from registered host memory (no staging copy)
+    if (ImportedCopySubImage3D(command_buffer, frame_number, &texture,
+                               src_offset, src_extent, src_ptr, data_ptr,
+                               format, upload.source))
+      continue;
+
+    // written by the CPU right away if the texture allows it and no recorded
+    // command still accesses the tiles (staged tiles count as recorded)
+    if (HostCopySubImage3D(&texture, src_offset, src_extent, data_ptr, format,
+                           upload.source, recordingState.safeFrameNumber))
+      continue;
+
+    size_t texel_size;
+    VulkanStaging staging;
+    if (!StageSubImage3D(&texture, src_offset, src_extent, data_ptr, format,
+                         upload.source, frame_number, &dst_offset,
+                         &dst_extent, &texel_size, &staging))
+      continue;
+
+    // route the (logical) region to every tile it intersects. The staging
+    // memory holds the whole region, so each copy just addresses its sub-box
+    const size_t first_tile = tiles.size();
+    IntersectTiles(&texture, dst_offset, dst_extent, texel_size, 0, &tiles,
+                   &regions);
+    sources.resize(tiles.size(), staging.buffer);
+    for (size_t i = first_tile; i < tiles.size(); ++i) {
+      regions[i].bufferOffset += staging.offset;
+      tiles[i]->lastRecordedFrame = frame_number;
+    }
+    staged.push_back(TextureBox{dst_offset.x, dst_offset.y, dst_offset.z,
+                                dst_extent.width, dst_extent.height,
+                                dst_extent.depth});
+  }
+  record_staged();
+}
+
+void TextureSubPluginAPI_Vulkan::TextureSubImage3DSlices(
+    uint32_t texture_id, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, const SliceSource* slices,
+    Format format, uint32_t flags) {
+  auto search = m_CreatedTextures.find(texture_id);
+  if (search == m_CreatedTextures.end()) {
+    PLUGIN_LOG_ERROR("failed to update texture 3D (texture ID does not refer "
+                     "to a created texture 3D)");
+    return;
+  }
+  VulkanTexture3D& texture = search->second;
+  std::shared_ptr<BrickStatisticsTable> statistics;
+  {
+    std::lock_guard<std::mutex> lock(m_TexturesMutex);
+    statistics = texture.statistics;
+  }
+  // constant detection, degraded textures and statistics need the region in
+  // contiguous memory first
+  if (flags != UPLOAD_FLAG_NONE || statistics || texture.downsampleLevel > 0 ||
+      texture.format != format) {
+    TextureSubPluginAPI::TextureSubImage3DSlices(texture_id, xoffset, yoffset,
+                                                 zoffset, width, height, depth,
+                                                 slices, format, flags);
+    return;
+  }
+  const size_t texel_size = FormatTexelSize(format);
+  const size_t row_size = texel_size * (width > 0 ? width : 0);
+  if (height <= 0 || depth <= 0 ||
+      !IsValidSliceStack(slices, row_size, height, depth)) {
+    PLUGIN_LOG_ERROR("invalid slice stack (%d x %d x %d, format: %d)", width,
+                     height, depth, format);
+    return;
+  }
+
+  // cannot do resource uploads inside renderpass
+  m_UnityVulkan->EnsureOutsideRenderPass();
+
+  UnityVulkanRecordingState recordingState;
+  if (!m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+    PLUGIN_LOG_ERROR("failed to intercept the current command buffer state");
+    return;
+  }
+
+  // the slices are gathered straight into staging memory (see
+  // StageSubImage3D)
+  VulkanStaging staging;
+  if (!AllocateStaging(row_size * height * depth,
+                       recordingState.currentFrameNumber, &staging))
+    return;
+  {
+    TraceScope trace("upload", "GatherSlices", "slices",
+                     static_cast<uint64_t>(depth));
+    GatherSlices(slices, row_size, height, depth, staging.mapped);
+  }
+  FlushStaging(staging);
+
+  const VkOffset3D offset{xoffset, yoffset, zoffset};
+  const VkExtent3D extent{static_cast<uint32_t>(width),
+                          static_cast<uint32_t>(height),
+                          static_cast<uint32_t>(depth)};
+  std::vector<VulkanTile*> tiles;
+  std::vector<VkBufferImageCopy> regions;
+  IntersectTiles(&texture, offset, extent, texel_size, 0, &tiles, &regions);
+  const VkCommandBuffer command_buffer = recordingState.commandBuffer;
+  const unsigned long long frame_number = recordingState.currentFrameNumber;
+  TransitionTiles(command_buffer, frame_number, tiles.data(), tiles.size(),
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    regions[i].bufferOffset += staging.offset;
+    vkCmdCopyBufferToImage(command_buffer, staging.buffer, *tiles[i]->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                           &regions[i]);
+  }
+  TransitionTiles(command_buffer, frame_number, tiles.data(), tiles.size(),
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+// size of the first readback ring. Rings are replaced by ones twice as large
+// whenever a readback does not fit
+static const VkDeviceSize kReadbackRingSize = 64ull << 20;
+
+// finds space for readback->allocationSize bytes in a ring
+static bool RingAllocate(VulkanReadbackRing* ring, VkDeviceSize size,
+                         VkDeviceSize* offset) {
+  const VkDeviceSize capacity = ring->buffer.sizeInBytes;
+  if (ring->allocations.empty()) {
+    *offset = 0;
+    return size <= capacity;
+  }
+
+  const VkDeviceSize front = ring->allocations.front()->offset;
+  const VulkanReadback& back = *ring->allocations.back();
+  const VkDeviceSize end = back.offset + back.allocationSize;
+  if (end > front) {
+    // free space is [end, capacity) and [0, front)
+    *offset = capacity - end >= size ? end : 0;
+    return capacity - end >= size || front >= size;
+  }
+  // wrapped around, free space is [end, front)
+  *offset = end;
+  return front - end >= size;
+}
+
+bool TextureSubPluginAPI_Vulkan::AllocateReadback(VulkanReadback* readback) {
+  // offsets have to be aligned for the invalidation of non-coherent memory
+  // and for the copies (multiple of 4 and of the texel size)
+  const VkDeviceSize alignment =
+      std::max<VkDeviceSize>(16, m_NonCoherentAtomSize);
+  readback->allocationSize =
+      (readback->size + alignment - 1) / alignment * alignment;
+
+  VulkanReadbackRing* ring =
+      m_ReadbackRings.empty() ? nullptr : m_ReadbackRings.back().get();
+  if (ring && RingAllocate(ring, readback->allocationSize, &readback->offset)) {
+    readback->ring = ring;
+    return true;
+  }
+
+  // the current ring is retired (and destroyed once all of its readbacks are
+  // released) and replaced by a larger one
+  VkDeviceSize capacity =
+      ring ? 2 * ring->buffer.sizeInBytes : kReadbackRingSize;
+  capacity = std::max(capacity, readback->allocationSize);
+  auto new_ring = std::make_unique<VulkanReadbackRing>();
+  // prefer cached memory, reading uncached memory on the CPU is very slow
+  if (!CreateVulkanBuffer(capacity, &new_ring->buffer,
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                              VK_MEMORY_PROPERTY_HOST_CACHED_BIT) &&
+      !CreateVulkanBuffer(capacity, &new_ring->buffer,
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT))
+    return false;
+  if (!(new_ring->buffer.deviceMemoryFlags &
+        VK_MEMORY_PROPERTY_HOST_CACHED_BIT))
+    PLUGIN_LOG_WARNING(
+        "no host cached memory type - readbacks are read from uncached memory");
+
+  readback->ring = new_ring.get();
+  readback->offset = 0;
+  m_ReadbackRings.push_back(std::move(new_ring));
+  return true;
+}
+
+void TextureSubPluginAPI_Vulkan::ReadbackTexture3D(
+    uint32_t texture_id, uint32_t readback_id, int32_t xoffset,
+    int32_t yoffset, int32_t zoffset, int32_t width, int32_t height,
+    int32_t depth) {
+  auto readback = std::make_shared<VulkanReadback>();
+  readback->id = readback_id;
+  readback->status = READBACK_STATUS_FAILED;
+  {
+    std::lock_guard<std::mutex> lock(m_ReadbackMutex);
+    if (m_Readbacks.count(readback_id)) {
+      PLUGIN_LOG_ERROR(
+          "readback ID %u is in use (readbacks have to be released before "
+          "their ID can be reused)",
+          readback_id);
+      return;
+    }
+    // failed readbacks are reported by GetReadback until they are released
+    m_Readbacks[readback_id] = readback;
+  }
+
+  auto search = m_CreatedTextures.find(texture_id);
+  if (search == m_CreatedTextures.end()) {
+    PLUGIN_LOG_ERROR("failed to read back texture 3D (texture ID does not "
+                     "refer to a created texture 3D)");
+    return;
+  }
+  VulkanTexture3D& texture = search->second;
+  if (width <= 0 || height <= 0 || depth <= 0 || xoffset < 0 || yoffset < 0 ||
+      zoffset < 0 ||
+      static_cast<uint32_t>(xoffset + width) > texture.extent.width ||
+      static_cast<uint32_t>(yoffset + height) > texture.extent.height ||
+      static_cast<uint32_t>(zoffset + depth) > texture.extent.depth) {
+    PLUGIN_LOG_ERROR("region exceeds the texture's extent %ux%ux%u",
+                     texture.extent.width, texture.extent.height,
+                     texture.extent.depth);
+    return;
+  }
+
+  // cannot do resource copies inside renderpass
+  m_UnityVulkan->EnsureOutsideRenderPass();
+
+  UnityVulkanRecordingState recordingState;
+  if (!m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+    PLUGIN_LOG_ERROR("failed to intercept the current command buffer state");
     return;
   }
 
-  // since we have done a resource access, the previous CommandRecordingState is
-  // invalidated and has to be requested again
+  const size_t texel_size = FormatTexelSize(texture.format);
+  const VkOffset3D offset{xoffset, yoffset, zoffset};
+  const VkExtent3D extent{static_cast<uint32_t>(width),
+                          static_cast<uint32_t>(height),
+                          static_cast<uint32_t>(depth)};
+  VkBuffer buffer;
+  {
+    std::lock_guard<std::mutex> lock(m_ReadbackMutex);
+    readback->size = texel_size * extent.width * extent.height * extent.depth;
+    readback->frameNumber = recordingState.currentFrameNumber;
+    if (!AllocateReadback(readback.get())) {
+      PLUGIN_LOG_ERROR("failed to allocate %llu bytes of readback memory",
+                       static_cast<unsigned long long>(readback->size));
+      return;
+    }
+    readback->status = READBACK_STATUS_PENDING;
+    readback->ring->allocations.push_back(readback);
+    buffer = readback->ring->buffer.buffer;
+  }
+
+  std::vector<VulkanTile*> tiles;
+  std::vector<VkBufferImageCopy> regions;
+  IntersectTiles(&texture, offset, extent, texel_size, 0, &tiles, &regions,
+                 true);
+  for (VkBufferImageCopy& region : regions)
+    region.bufferOffset += readback->offset;
+
+  TransitionTiles(recordingState.commandBuffer,
+                  recordingState.currentFrameNumber, tiles.data(), tiles.size(),
+                  VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+  for (size_t i = 0; i < tiles.size(); ++i)
+    vkCmdCopyImageToBuffer(recordingState.commandBuffer, *tiles[i]->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1,
+                           &regions[i]);
+  TransitionTiles(recordingState.commandBuffer,
+                  recordingState.currentFrameNumber, tiles.data(), tiles.size(),
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  // make the copied data visible to the host once the frame's fence signals
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer;
+  barrier.offset = readback->offset;
+  barrier.size = readback->allocationSize;
+  vkCmdPipelineBarrier(recordingState.commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier,
+                       0, nullptr);
+
+  CompleteReadbacks(recordingState.safeFrameNumber);
+}
+
+bool TextureSubPluginAPI_Vulkan::UpdateFrameNumbers(
+    unsigned long long* current_frame, unsigned long long* safe_frame) {
+  UnityVulkanRecordingState recordingState;
+  if (!m_UnityVulkan || !m_UnityVulkan->CommandRecordingState(
+                            &recordingState,
+                            kUnityVulkanGraphicsQueueAccess_DontCare)) {
+    // nothing can be tracked without the frame numbers
+    *current_frame = 0;
+    *safe_frame = ~0ull;
+    return true;
+  }
+  *current_frame = recordingState.currentFrameNumber;
+  *safe_frame = recordingState.safeFrameNumber;
+  GarbageCollect();
+  CompleteBenchmark(recordingState.safeFrameNumber);
+  return true;
+}
+
+void TextureSubPluginAPI_Vulkan::ProcessReadbacks() {
+  UnityVulkanRecordingState recordingState;
+  if (!m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare))
+    return;
+  CompleteReadbacks(recordingState.safeFrameNumber);
+}
+
+void TextureSubPluginAPI_Vulkan::CompleteReadbacks(
+    unsigned long long safe_frame_number) {
+  struct Completed {
+    uint32_t readback_id;
+    const void* data;
+    uint64_t size;
+  };
+  std::vector<Completed> completed;
+  ReadbackCallback callback;
+  {
+    std::lock_guard<std::mutex> lock(m_ReadbackMutex);
+    callback = m_ReadbackCallback;
+
+    std::vector<VkMappedMemoryRange> ranges;
+    for (auto& ring : m_ReadbackRings) {
+      for (auto& readback : ring->allocations) {
+        if (readback->status != READBACK_STATUS_PENDING ||
+            readback->frameNumber > safe_frame_number)
+          continue;
+        readback->status = READBACK_STATUS_READY;
+        if (callback && !readback->released)
+          completed.push_back(
+              {readback->id,
+               static_cast<const uint8_t*>(ring->buffer.mapped) +
+                   readback->offset,
+               readback->size});
+        if (!(ring->buffer.deviceMemoryFlags &
+              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+          VkMappedMemoryRange range{};
+          range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+          range.memory = ring->buffer.deviceMemory;
+          range.offset = readback->offset;
+          range.size = readback->allocationSize;
+          ranges.push_back(range);
+        }
+      }
+
+      // reclaim the space of released readbacks
+      while (!ring->allocations.empty() &&
+             ring->allocations.front()->released &&
+             ring->allocations.front()->status != READBACK_STATUS_PENDING)
+        ring->allocations.pop_front();
+    }
+    if (!ranges.empty())
+      vkInvalidateMappedMemoryRanges(m_Instance.device,
+                                     static_cast<uint32_t>(ranges.size()),
+                                     ranges.data());
+
+    // retired rings are destroyed once they are empty
+    for (size_t i = 0; i + 1 < m_ReadbackRings.size();) {
+      if (m_ReadbackRings[i]->allocations.empty()) {
+        ImmediateDestroyVulkanBuffer(m_ReadbackRings[i]->buffer);
+        m_ReadbackRings.erase(m_ReadbackRings.begin() + i);
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  // the data stays valid (even if the readback is released concurrently)
+  // until the next call on the render thread
+  for (const Completed& c : completed)
+    callback(c.readback_id, c.data, c.size);
+}
+
+uint32_t TextureSubPluginAPI_Vulkan::GetReadback(uint32_t readback_id,
+                                                 const void** data,
+                                                 uint64_t* size) {
+  std::lock_guard<std::mutex> lock(m_ReadbackMutex);
+  auto search = m_Readbacks.find(readback_id);
+  if (search == m_Readbacks.end()) return READBACK_STATUS_UNKNOWN;
+  const VulkanReadback& readback = *search->second;
+  if (readback.status == READBACK_STATUS_READY) {
+    if (data)
+      *data = static_cast<const uint8_t*>(readback.ring->buffer.mapped) +
+              readback.offset;
+    if (size) *size = readback.size;
+  }
+  return readback.status;
+}
+
+void TextureSubPluginAPI_Vulkan::ReleaseReadback(uint32_t readback_id) {
+  std::lock_guard<std::mutex> lock(m_ReadbackMutex);
+  auto search = m_Readbacks.find(readback_id);
+  if (search == m_Readbacks.end()) return;
+  // the ring space is reclaimed on the render thread
+  search->second->released = true;
+  m_Readbacks.erase(search);
+}
+
+void TextureSubPluginAPI_Vulkan::InterceptTracedCalls(bool enabled) {
+  if (!m_UnityVulkan || enabled == m_TracedCallsIntercepted) return;
+  const char* const names[kTracedCallCount] = {
+      "vkCmdBeginRenderPass", "vkCmdEndRenderPass", "vkQueueSubmit"};
+  const PFN_vkVoidFunction hooks[kTracedCallCount] = {
+      (PFN_vkVoidFunction)&Hook_vkCmdBeginRenderPass,
+      (PFN_vkVoidFunction)&Hook_vkCmdEndRenderPass,
+      (PFN_vkVoidFunction)&Hook_vkQueueSubmit};
+  const PFN_vkVoidFunction loaded[kTracedCallCount] = {
+      (PFN_vkVoidFunction)vkCmdBeginRenderPass,
+      (PFN_vkVoidFunction)vkCmdEndRenderPass,
+      (PFN_vkVoidFunction)vkQueueSubmit};
+  for (size_t i = 0; i < kTracedCallCount; ++i) {
+    // Unity's own function pointers are restored when tracing is disabled
+    PFN_vkVoidFunction untraced =
+        m_UntracedCalls[i] ? m_UntracedCalls[i] : loaded[i];
+    PFN_vkVoidFunction previous = m_UnityVulkan->InterceptVulkanAPI(
+        names[i], enabled ? hooks[i] : untraced);
+    if (enabled) m_UntracedCalls[i] = previous;
+  }
+  m_TracedCallsIntercepted = enabled;
+}
+
+void TextureSubPluginAPI_Vulkan::SetReadbackCallback(
+    ReadbackCallback callback) {
+  std::lock_guard<std::mutex> lock(m_ReadbackMutex);
+  m_ReadbackCallback = callback;
+}
+
+static bool BoxesOverlap(const VkOffset3D& a_offset, const VkExtent3D& a_extent,
+                         const VkOffset3D& b_offset,
+                         const VkExtent3D& b_extent) {
+  return a_offset.x < b_offset.x + static_cast<int32_t>(b_extent.width) &&
+         b_offset.x < a_offset.x + static_cast<int32_t>(a_extent.width) &&
+         a_offset.y < b_offset.y + static_cast<int32_t>(b_extent.height) &&
+         b_offset.y < a_offset.y + static_cast<int32_t>(a_extent.height) &&
+         a_offset.z < b_offset.z + static_cast<int32_t>(b_extent.depth) &&
+         b_offset.z < a_offset.z + static_cast<int32_t>(a_extent.depth);
+}
+
+static bool BoxInside(const VkOffset3D& offset, const VkExtent3D& extent,
+                      const VkExtent3D& bounds) {
+  return offset.x >= 0 && offset.y >= 0 && offset.z >= 0 &&
+         extent.width > 0 && extent.height > 0 && extent.depth > 0 &&
+         offset.x + extent.width <= bounds.width &&
+         offset.y + extent.height <= bounds.height &&
+         offset.z + extent.depth <= bounds.depth;
+}
+
+void TextureSubPluginAPI_Vulkan::CopyTexture3DRegions(
+    const TextureCopyRegion* regions, uint32_t count) {
+  if (!regions || count == 0) return;
+
+  struct Access {
+    uint32_t texture_id;
+    VkOffset3D offset;
+    VkExtent3D extent;
+  };
+  struct Piece {
+    VulkanTile* src;
+    VulkanTile* dst;
+    VkImageCopy copy;
+    // copies of the same batch do not depend on each other
+    uint32_t batch;
+  };
+
+  // copies are split into batches at read-after-write, write-after-write and
+  // write-after-read hazards so that a barrier is only needed between batches
+  std::vector<Access> reads, writes;
+  std::vector<Piece> pieces;
+  uint32_t batch = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    const TextureCopyRegion& region = regions[i];
+    auto src_search = m_CreatedTextures.find(region.src_texture_id);
+    auto dst_search = m_CreatedTextures.find(region.dst_texture_id);
+    if (src_search == m_CreatedTextures.end() ||
+        dst_search == m_CreatedTextures.end()) {
+      PLUGIN_LOG_ERROR(
+          "copy %u refers to a texture that was not created using "
+          "CreateTexture3D",
+          i);
+      continue;
+    }
+    VulkanTexture3D& src = src_search->second;
+    VulkanTexture3D& dst = dst_search->second;
+    const Access read{region.src_texture_id,
+                      {region.src_x, region.src_y, region.src_z},
+                      {region.width, region.height, region.depth}};
+    const Access write{region.dst_texture_id,
+                       {region.dst_x, region.dst_y, region.dst_z},
+                       read.extent};
+    if (src.format != dst.format ||
+        !BoxInside(read.offset, read.extent, src.extent) ||
+        !BoxInside(write.offset, write.extent, dst.extent) ||
+        (read.texture_id == write.texture_id &&
+         BoxesOverlap(read.offset, read.extent, write.offset, write.extent))) {
+      PLUGIN_LOG_ERROR(
+          "copy %u is invalid (formats differ, a box exceeds its texture or "
+          "the boxes overlap)",
+          i);
+      continue;
+    }
+
+    bool hazard = false;
+    for (const Access& w : writes)
+      hazard = hazard ||
+               (w.texture_id == read.texture_id &&
+                BoxesOverlap(w.offset, w.extent, read.offset, read.extent)) ||
+               (w.texture_id == write.texture_id &&
+                BoxesOverlap(w.offset, w.extent, write.offset, write.extent));
+    for (const Access& r : reads)
+      hazard = hazard ||
+               (r.texture_id == write.texture_id &&
+                BoxesOverlap(r.offset, r.extent, write.offset, write.extent));
+    if (hazard) {
+      ++batch;
+      reads.clear();
+      writes.clear();
+    }
+    reads.push_back(read);
+    writes.push_back(write);
+
+    // every source voxel is read from one tile, but written to every
+    // destination tile that contains it (tiles share their border voxels)
+    const size_t texel_size = FormatTexelSize(src.format);
+    std::vector<VulkanTile*> src_tiles;
+    std::vector<VkBufferImageCopy> src_regions;
+    IntersectTiles(&src, read.offset, read.extent, texel_size, 0, &src_tiles,
+                   &src_regions, true);
+    for (size_t s = 0; s < src_tiles.size(); ++s) {
+      const VkOffset3D src_origin{
+          src_tiles[s]->offset.x + src_regions[s].imageOffset.x,
+          src_tiles[s]->offset.y + src_regions[s].imageOffset.y,
+          src_tiles[s]->offset.z + src_regions[s].imageOffset.z};
+      const VkOffset3D dst_origin{
+          write.offset.x + (src_origin.x - read.offset.x),
+          write.offset.y + (src_origin.y - read.offset.y),
+          write.offset.z + (src_origin.z - read.offset.z)};
+      std::vector<VulkanTile*> dst_tiles;
+      std::vector<VkBufferImageCopy> dst_regions;
+      IntersectTiles(&dst, dst_origin, src_regions[s].imageExtent, texel_size,
+                     0, &dst_tiles, &dst_regions);
+      for (size_t d = 0; d < dst_tiles.size(); ++d) {
+        const VkBufferImageCopy& dst_region = dst_regions[d];
+        Piece piece{src_tiles[s], dst_tiles[d], {}, batch};
+        piece.copy.srcSubresource = dst_region.imageSubresource;
+        piece.copy.dstSubresource = dst_region.imageSubresource;
+        piece.copy.dstOffset = dst_region.imageOffset;
+        piece.copy.srcOffset = {
+            dst_tiles[d]->offset.x + dst_region.imageOffset.x - dst_origin.x +
+                src_origin.x - src_tiles[s]->offset.x,
+            dst_tiles[d]->offset.y + dst_region.imageOffset.y - dst_origin.y +
+                src_origin.y - src_tiles[s]->offset.y,
+            dst_tiles[d]->offset.z + dst_region.imageOffset.z - dst_origin.z +
+                src_origin.z - src_tiles[s]->offset.z};
+        piece.copy.extent = dst_region.imageExtent;
+        pieces.push_back(piece);
+      }
+    }
+  }
+  if (pieces.empty()) return;
+
+  // cannot do resource copies inside renderpass
+  m_UnityVulkan->EnsureOutsideRenderPass();
+
+  UnityVulkanRecordingState recordingState;
   if (!m_UnityVulkan->CommandRecordingState(
           &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
-    std::ostringstream ss;
-    ss << __FUNCTION__
-       << " failed to intercept the current command buffer state";
-    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    PLUGIN_LOG_ERROR("failed to intercept the current command buffer state");
     return;
   }
 
-  VkBufferImageCopy region{};
-  region.bufferImageHeight = 0;
-  region.bufferRowLength = 0;
-  region.bufferOffset = 0;
-  region.imageOffset.x = xoffset;
-  region.imageOffset.y = yoffset;
-  region.imageOffset.z = zoffset;
-  region.imageExtent.width = width;
-  region.imageExtent.height = height;
-  region.imageExtent.depth = depth;
-  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  region.imageSubresource.baseArrayLayer = 0;
-  region.imageSubresource.layerCount = 1;
-  region.imageSubresource.mipLevel = level;
-  vkCmdCopyBufferToImage(recordingState.commandBuffer,
-                         m_TextureStagingBuffer.buffer, image.image,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  // tiles that are both copied from and to have to be in the general layout
+  std::map<VulkanTile*, uint32_t> usage;
+  for (const Piece& piece : pieces) {
+    usage[piece.src] |= 1;
+    usage[piece.dst] |= 2;
+  }
+  std::vector<VulkanTile*> all, src_only, dst_only, src_dst;
+  for (const auto& entry : usage) {
+    all.push_back(entry.first);
+    if (entry.second == 1)
+      src_only.push_back(entry.first);
+    else if (entry.second == 2)
+      dst_only.push_back(entry.first);
+    else
+      src_dst.push_back(entry.first);
+  }
+  TransitionTiles(recordingState.commandBuffer,
+                  recordingState.currentFrameNumber, src_only.data(),
+                  src_only.size(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+  TransitionTiles(recordingState.commandBuffer,
+                  recordingState.currentFrameNumber, dst_only.data(),
+                  dst_only.size(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  TransitionTiles(recordingState.commandBuffer,
+                  recordingState.currentFrameNumber, src_dst.data(),
+                  src_dst.size(), VK_IMAGE_LAYOUT_GENERAL);
+
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    const Piece& piece = pieces[i];
+    if (i > 0 && piece.batch != pieces[i - 1].batch) {
+      VkMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask =
+          VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+      vkCmdPipelineBarrier(recordingState.commandBuffer,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                           nullptr, 0, nullptr);
+    }
+    vkCmdCopyImage(recordingState.commandBuffer, *piece.src->image,
+                   piece.src->layout, *piece.dst->image, piece.dst->layout, 1,
+                   &piece.copy);
+  }
+
+  TransitionTiles(recordingState.commandBuffer,
+                  recordingState.currentFrameNumber, all.data(), all.size(),
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+#if SUPPORT_COMPUTE_SHADERS
+// SPIR-V of src/shaders/Gradients.comp (compiled by the build)
+static const uint32_t kGradientsRGBA8Spirv[] =
+#include "Gradients_RGBA8.comp.inc"
+    ;
+static const uint32_t kGradientsRG16Spirv[] =
+#include "Gradients_RG16.comp.inc"
+    ;
+// SPIR-V of src/shaders/DecodeBitpacked.comp
+static const uint32_t kDecodeBitpackedSpirv[] =
+#include "DecodeBitpacked.comp.inc"
+    ;
+#endif
+
+// push constants of Gradients.comp
+struct GradientPushConstants {
+  int32_t offset[4];
+  int32_t extent[4];
+  int32_t volume[4];
+  float magnitude_scale;
+};
+
+// local size of Gradients.comp along each axis
+static const uint32_t kGradientGroupSize = 4;
+
+VkPipeline TextureSubPluginAPI_Vulkan::CreateComputePipeline(
+    const uint32_t* code, size_t code_size, VkPipelineLayout layout) {
+  VkShaderModuleCreateInfo module_info{};
+  module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  module_info.codeSize = code_size;
+  module_info.pCode = code;
+  VkShaderModule module;
+  if (vkCreateShaderModule(m_Instance.device, &module_info, nullptr,
+                           &module) != VK_SUCCESS)
+    return VK_NULL_HANDLE;
+
+  VkComputePipelineCreateInfo pipeline_info{};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipeline_info.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipeline_info.stage.module = module;
+  pipeline_info.stage.pName = "main";
+  pipeline_info.layout = layout;
+  VkPipeline pipeline;
+  const VkResult result = vkCreateComputePipelines(
+      m_Instance.device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline);
+  // the pipeline does not reference the module once it is created
+  vkDestroyShaderModule(m_Instance.device, module, nullptr);
+  return result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
+}
+
+bool TextureSubPluginAPI_Vulkan::CreateGradientPipelines() {
+#if SUPPORT_COMPUTE_SHADERS
+  if (m_GradientPipelines[1] != VK_NULL_HANDLE) return true;
+
+  VkSamplerCreateInfo sampler_info{};
+  sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  sampler_info.magFilter = VK_FILTER_NEAREST;
+  sampler_info.minFilter = VK_FILTER_NEAREST;
+  sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  if (m_NearestSampler == VK_NULL_HANDLE &&
+      vkCreateSampler(m_Instance.device, &sampler_info, nullptr,
+                      &m_NearestSampler) != VK_SUCCESS) {
+    m_NearestSampler = VK_NULL_HANDLE;
+    return false;
+  }
+
+  VkDescriptorSetLayoutBinding bindings[2]{};
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  bindings[0].pImmutableSamplers = &m_NearestSampler;
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  VkDescriptorSetLayoutCreateInfo set_layout_info{};
+  set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  set_layout_info.bindingCount = 2;
+  set_layout_info.pBindings = bindings;
+  if (m_GradientSetLayout == VK_NULL_HANDLE &&
+      vkCreateDescriptorSetLayout(m_Instance.device, &set_layout_info, nullptr,
+                                  &m_GradientSetLayout) != VK_SUCCESS) {
+    m_GradientSetLayout = VK_NULL_HANDLE;
+    return false;
+  }
+
+  VkPushConstantRange push_constants{};
+  push_constants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constants.size = sizeof(GradientPushConstants);
+  VkPipelineLayoutCreateInfo layout_info{};
+  layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layout_info.setLayoutCount = 1;
+  layout_info.pSetLayouts = &m_GradientSetLayout;
+  layout_info.pushConstantRangeCount = 1;
+  layout_info.pPushConstantRanges = &push_constants;
+  if (m_GradientPipelineLayout == VK_NULL_HANDLE &&
+      vkCreatePipelineLayout(m_Instance.device, &layout_info, nullptr,
+                             &m_GradientPipelineLayout) != VK_SUCCESS) {
+    m_GradientPipelineLayout = VK_NULL_HANDLE;
+    return false;
+  }
+
+  const uint32_t* const code[2] = {kGradientsRGBA8Spirv, kGradientsRG16Spirv};
+  const size_t code_size[2] = {sizeof(kGradientsRGBA8Spirv),
+                               sizeof(kGradientsRG16Spirv)};
+  for (int i = 0; i < 2; ++i) {
+    if (m_GradientPipelines[i] != VK_NULL_HANDLE) continue;
+    m_GradientPipelines[i] =
+        CreateComputePipeline(code[i], code_size[i], m_GradientPipelineLayout);
+    if (m_GradientPipelines[i] == VK_NULL_HANDLE) return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+// push constants of DecodeBitpacked.comp
+struct DecodePushConstants {
+  uint32_t count;
+  uint32_t bits;
+  uint32_t min_value;
+  uint32_t texel_size;
+};
+
+// local size of DecodeBitpacked.comp (one 32-bit output word per invocation)
+static const uint32_t kDecodeGroupSize = 64;
+// guaranteed minimum of maxComputeWorkGroupCount[0]
+static const uint32_t kMaxDispatchGroups = 65535;
+
+bool TextureSubPluginAPI_Vulkan::CreateDecodePipeline() {
+#if SUPPORT_COMPUTE_SHADERS
+  if (m_DecodePipeline != VK_NULL_HANDLE) return true;
+
+  VkDescriptorSetLayoutBinding bindings[2]{};
+  for (uint32_t i = 0; i < 2; ++i) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  VkDescriptorSetLayoutCreateInfo set_layout_info{};
+  set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  set_layout_info.bindingCount = 2;
+  set_layout_info.pBindings = bindings;
+  if (m_DecodeSetLayout == VK_NULL_HANDLE &&
+      vkCreateDescriptorSetLayout(m_Instance.device, &set_layout_info, nullptr,
+                                  &m_DecodeSetLayout) != VK_SUCCESS) {
+    m_DecodeSetLayout = VK_NULL_HANDLE;
+    return false;
+  }
+
+  VkPushConstantRange push_constants{};
+  push_constants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  push_constants.size = sizeof(DecodePushConstants);
+  VkPipelineLayoutCreateInfo layout_info{};
+  layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layout_info.setLayoutCount = 1;
+  layout_info.pSetLayouts = &m_DecodeSetLayout;
+  layout_info.pushConstantRangeCount = 1;
+  layout_info.pPushConstantRanges = &push_constants;
+  if (m_DecodePipelineLayout == VK_NULL_HANDLE &&
+      vkCreatePipelineLayout(m_Instance.device, &layout_info, nullptr,
+                             &m_DecodePipelineLayout) != VK_SUCCESS) {
+    m_DecodePipelineLayout = VK_NULL_HANDLE;
+    return false;
+  }
+
+  m_DecodePipeline =
+      CreateComputePipeline(kDecodeBitpackedSpirv,
+                            sizeof(kDecodeBitpackedSpirv),
+                            m_DecodePipelineLayout);
+  return m_DecodePipeline != VK_NULL_HANDLE;
+#else
+  return false;
+#endif
+}
+
+void TextureSubPluginAPI_Vulkan::DestroyComputeResources() {
+  for (VkPipeline& pipeline : m_GradientPipelines) {
+    if (pipeline != VK_NULL_HANDLE)
+      vkDestroyPipeline(m_Instance.device, pipeline, nullptr);
+    pipeline = VK_NULL_HANDLE;
+  }
+  if (m_GradientPipelineLayout != VK_NULL_HANDLE)
+    vkDestroyPipelineLayout(m_Instance.device, m_GradientPipelineLayout,
+                            nullptr);
+  if (m_GradientSetLayout != VK_NULL_HANDLE)
+    vkDestroyDescriptorSetLayout(m_Instance.device, m_GradientSetLayout,
+                                 nullptr);
+  if (m_NearestSampler != VK_NULL_HANDLE)
+    vkDestroySampler(m_Instance.device, m_NearestSampler, nullptr);
+  m_GradientPipelineLayout = VK_NULL_HANDLE;
+  m_GradientSetLayout = VK_NULL_HANDLE;
+  m_NearestSampler = VK_NULL_HANDLE;
+
+  if (m_DecodePipeline != VK_NULL_HANDLE)
+    vkDestroyPipeline(m_Instance.device, m_DecodePipeline, nullptr);
+  if (m_DecodePipelineLayout != VK_NULL_HANDLE)
+    vkDestroyPipelineLayout(m_Instance.device, m_DecodePipelineLayout, nullptr);
+  if (m_DecodeSetLayout != VK_NULL_HANDLE)
+    vkDestroyDescriptorSetLayout(m_Instance.device, m_DecodeSetLayout, nullptr);
+  m_DecodePipeline = VK_NULL_HANDLE;
+  m_DecodePipelineLayout = VK_NULL_HANDLE;
+  m_DecodeSetLayout = VK_NULL_HANDLE;
+
+  // pools of frames in flight were moved to the free list by a forced
+  // GarbageCollect
+  for (VkDescriptorPool pool : m_FreeDescriptorPools)
+    vkDestroyDescriptorPool(m_Instance.device, pool, nullptr);
+  m_FreeDescriptorPools.clear();
+}
+
+VkImageView TextureSubPluginAPI_Vulkan::TileView(VulkanTile* tile,
+                                                 Format format) {
+  if (tile->view != VK_NULL_HANDLE) return tile->view;
+  VkImageViewCreateInfo view_info{};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.image = *tile->image;
+  view_info.viewType = VK_IMAGE_VIEW_TYPE_3D;
+  view_info.format = ToVkFormat(format);
+  view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  if (vkCreateImageView(m_Instance.device, &view_info, nullptr, &tile->view) !=
+      VK_SUCCESS)
+    tile->view = VK_NULL_HANDLE;
+  return tile->view;
+}
+
+VkDescriptorSet TextureSubPluginAPI_Vulkan::AllocateDescriptorSet(
+    VkDescriptorSetLayout layout, unsigned long long frame_number) {
+  VkDescriptorPool pool = VK_NULL_HANDLE;
+  if (!m_FreeDescriptorPools.empty()) {
+    pool = m_FreeDescriptorPools.back();
+    m_FreeDescriptorPools.pop_back();
+  } else {
+    // a single set of any of the compute passes' layouts
+    const VkDescriptorPoolSize sizes[3] = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2}};
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 3;
+    pool_info.pPoolSizes = sizes;
+    if (vkCreateDescriptorPool(m_Instance.device, &pool_info, nullptr,
+                               &pool) != VK_SUCCESS)
+      return VK_NULL_HANDLE;
+  }
+  m_UsedDescriptorPools[frame_number].push_back(pool);
+
+  VkDescriptorSetAllocateInfo set_info{};
+  set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  set_info.descriptorPool = pool;
+  set_info.descriptorSetCount = 1;
+  set_info.pSetLayouts = &layout;
+  VkDescriptorSet set;
+  if (vkAllocateDescriptorSets(m_Instance.device, &set_info, &set) !=
+      VK_SUCCESS)
+    return VK_NULL_HANDLE;
+  return set;
+}
+
+void TextureSubPluginAPI_Vulkan::TextureSubImage3DBitpacked(
+    uint32_t texture_id, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, const uint32_t* words,
+    uint32_t bits, uint32_t min, Format format) {
+  auto search = m_CreatedTextures.find(texture_id);
+  if (search == m_CreatedTextures.end()) {
+    PLUGIN_LOG_ERROR("failed to update texture 3D (texture ID does not refer "
+                     "to a created texture 3D)");
+    return;
+  }
+  VulkanTexture3D& texture = search->second;
+  std::shared_ptr<BrickStatisticsTable> statistics;
+  {
+    std::lock_guard<std::mutex> lock(m_TexturesMutex);
+    statistics = texture.statistics;
+  }
+
+  // degraded textures and statistics need the decoded texels on the CPU
+  const size_t texel_size = FormatTexelSize(format);
+  const uint64_t count = static_cast<uint64_t>(std::max(width, 0)) *
+                         std::max(height, 0) * std::max(depth, 0);
+  const bool decode_on_gpu =
+      (format == R8_UINT || format == R16_UINT) && bits <= texel_size * 8 &&
+      count > 0 && count <= 0xFFFFFFFFull && texture.format == format &&
+      texture.downsampleLevel == 0 && !statistics && CreateDecodePipeline();
+  if (!decode_on_gpu) {
+    TextureSubPluginAPI::TextureSubImage3DBitpacked(
+        texture_id, xoffset, yoffset, zoffset, width, height, depth, words,
+        bits, min, format);
+    return;
+  }
+  TraceScope trace("upload", "TextureSubImage3DBitpacked", "voxels", count);
+
+  // cannot dispatch inside renderpass
+  m_UnityVulkan->EnsureOutsideRenderPass();
+
+  UnityVulkanRecordingState recordingState;
+  if (!m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+    PLUGIN_LOG_ERROR("failed to intercept the current command buffer state");
+    return;
+  }
+  const unsigned long long frame_number = recordingState.currentFrameNumber;
+
+  // only the packed words are staged (bits == 0 packs into no words at all)
+  const size_t word_count = BitpackedWordCount(count, bits);
+  VulkanStaging staging;
+  if (!AllocateStaging(std::max<size_t>(word_count, 1) * sizeof(uint32_t),
+                       frame_number, &staging))
+    return;
+  StreamCopy(staging.mapped, words, word_count * sizeof(uint32_t));
+  FlushStaging(staging);
+
+  // the shader writes whole 32-bit words
+  const VkDeviceSize decoded_size =
+      (count * texel_size + 3) & ~VkDeviceSize(3);
+  if (m_DecodeBuffer.sizeInBytes < decoded_size) {
+    SafeDestroy(frame_number, m_DecodeBuffer);
+    m_DecodeBuffer = VulkanBuffer();
+    if (!CreateVulkanBuffer(decoded_size, &m_DecodeBuffer,
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+      PLUGIN_LOG_ERROR("failed to create the decode buffer");
+      return;
+    }
+  }
+
+  const VkDescriptorSet set =
+      AllocateDescriptorSet(m_DecodeSetLayout, frame_number);
+  if (set == VK_NULL_HANDLE) {
+    PLUGIN_LOG_ERROR("failed to allocate descriptors");
+    return;
+  }
+  VkDescriptorBufferInfo buffers[2]{};
+  buffers[0].buffer = staging.buffer;
+  buffers[0].offset = staging.offset;
+  buffers[0].range = staging.size;
+  buffers[1].buffer = m_DecodeBuffer.buffer;
+  buffers[1].range = decoded_size;
+  VkWriteDescriptorSet writes[2]{};
+  for (uint32_t i = 0; i < 2; ++i) {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = set;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].pBufferInfo = &buffers[i];
+  }
+  vkUpdateDescriptorSets(m_Instance.device, 2, writes, 0, nullptr);
+
+  const VkCommandBuffer command_buffer = recordingState.commandBuffer;
+  // the decode buffer may still be read by a previously recorded copy
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  DecodePushConstants constants{};
+  constants.count = static_cast<uint32_t>(count);
+  constants.bits = bits;
+  constants.min_value = min;
+  constants.texel_size = static_cast<uint32_t>(texel_size);
+  const uint64_t groups =
+      (decoded_size / sizeof(uint32_t) + kDecodeGroupSize - 1) /
+      kDecodeGroupSize;
+  const uint32_t groups_x =
+      static_cast<uint32_t>(std::min<uint64_t>(groups, kMaxDispatchGroups));
+  const uint32_t groups_y =
+      static_cast<uint32_t>((groups + groups_x - 1) / groups_x);
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    m_DecodePipeline);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          m_DecodePipelineLayout, 0, 1, &set, 0, nullptr);
+  vkCmdPushConstants(command_buffer, m_DecodePipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                     &constants);
+  vkCmdDispatch(command_buffer, groups_x, groups_y, 1);
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  // from here on the same as a staged upload of the decoded texels
+  const VkOffset3D offset{xoffset, yoffset, zoffset};
+  const VkExtent3D extent{static_cast<uint32_t>(width),
+                          static_cast<uint32_t>(height),
+                          static_cast<uint32_t>(depth)};
+  std::vector<VulkanTile*> tiles;
+  std::vector<VkBufferImageCopy> regions;
+  IntersectTiles(&texture, offset, extent, texel_size, 0, &tiles, &regions);
+  TransitionTiles(command_buffer, frame_number, tiles.data(), tiles.size(),
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  for (size_t i = 0; i < tiles.size(); ++i)
+    vkCmdCopyBufferToImage(command_buffer, m_DecodeBuffer.buffer,
+                           *tiles[i]->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                           &regions[i]);
+  TransitionTiles(command_buffer, frame_number, tiles.data(), tiles.size(),
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+void TextureSubPluginAPI_Vulkan::ComputeGradients(
+    uint32_t src_texture_id, uint32_t dst_texture_id, Format dst_format,
+    float magnitude_scale, const TextureBox* boxes, uint32_t count) {
+  if (dst_format != RGBA8_UINT && dst_format != RG16_UINT) {
+    PLUGIN_LOG_ERROR("unsupported gradient format: %d", dst_format);
+    return;
+  }
+  VkFormatProperties format_properties{};
+  vkGetPhysicalDeviceFormatProperties(
+      m_Instance.physicalDevice, ToVkFormat(dst_format), &format_properties);
+  if (!(format_properties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)) {
+    PLUGIN_LOG_ERROR(
+        "format %d cannot be written by compute shaders on this device",
+        dst_format);
+    return;
+  }
+  if (!CreateGradientPipelines()) {
+    PLUGIN_LOG_ERROR("failed to create the gradient compute pipelines");
+    return;
+  }
+
+  auto src_search = m_CreatedTextures.find(src_texture_id);
+  if (src_search == m_CreatedTextures.end() ||
+      src_texture_id == dst_texture_id) {
+    PLUGIN_LOG_ERROR(
+        "the volume was not created using CreateTexture3D (or is the gradient "
+        "texture itself)");
+    return;
+  }
+  if (m_CreatedTextures.count(dst_texture_id) == 0) {
+    const VkExtent3D extent = src_search->second.extent;
+    CreateTexture3DWithUsage(dst_texture_id, extent.width, extent.height,
+                             extent.depth, dst_format,
+                             VK_IMAGE_USAGE_STORAGE_BIT);
+  }
+  // the creation may have rehashed the map
+  src_search = m_CreatedTextures.find(src_texture_id);
+  auto dst_search = m_CreatedTextures.find(dst_texture_id);
+  if (dst_search == m_CreatedTextures.end()) return;
+  VulkanTexture3D& src = src_search->second;
+  VulkanTexture3D& dst = dst_search->second;
+  if (dst.format != dst_format ||
+      !(dst.extraUsage & VK_IMAGE_USAGE_STORAGE_BIT) ||
+      dst.extent.width != src.extent.width ||
+      dst.extent.height != src.extent.height ||
+      dst.extent.depth != src.extent.depth) {
+    PLUGIN_LOG_ERROR("the gradient texture does not match the volume "
+                     "(destroy it so that it is recreated)");
+    return;
+  }
+  // differences at a tile border would need voxels of two tiles
+  if (src.tiles.size() != 1 || dst.tiles.size() != 1) {
+    PLUGIN_LOG_ERROR("gradients of tiled volumes are not supported");
+    return;
+  }
+
+  // boxes are mapped to the (possibly degraded) volume and grown by one voxel
+  // since the differences of the voxels around a box read it
+  const TextureBox whole{0,
+                         0,
+                         0,
+                         src.requestedExtent.width,
+                         src.requestedExtent.height,
+                         src.requestedExtent.depth};
+  const uint32_t box_count = boxes ? count : 1;
+  const int32_t volume[3] = {static_cast<int32_t>(src.extent.width),
+                             static_cast<int32_t>(src.extent.height),
+                             static_cast<int32_t>(src.extent.depth)};
+  std::vector<GradientPushConstants> dispatches;
+  for (uint32_t i = 0; i < box_count; ++i) {
+    const TextureBox& box = boxes ? boxes[i] : whole;
+    if (box.width == 0 || box.height == 0 || box.depth == 0) continue;
+    VkOffset3D offset;
+    VkExtent3D extent;
+    DegradeRegion(&src, {box.x, box.y, box.z},
+                  {box.width, box.height, box.depth}, &offset, &extent);
+    const int32_t lo[3] = {offset.x - 1, offset.y - 1, offset.z - 1};
+    const int32_t hi[3] = {offset.x + static_cast<int32_t>(extent.width) + 1,
+                           offset.y + static_cast<int32_t>(extent.height) + 1,
+                           offset.z + static_cast<int32_t>(extent.depth) + 1};
+    GradientPushConstants constants{};
+    bool empty = false;
+    for (int a = 0; a < 3; ++a) {
+      constants.offset[a] = std::max(0, lo[a]);
+      constants.extent[a] = std::min(volume[a], hi[a]) - constants.offset[a];
+      constants.volume[a] = volume[a];
+      empty = empty || constants.extent[a] <= 0;
+    }
+    constants.magnitude_scale = magnitude_scale > 0.0f ? magnitude_scale : 1.0f;
+    if (!empty) dispatches.push_back(constants);
+  }
+  if (dispatches.empty()) return;
+
+  // cannot dispatch inside renderpass
+  m_UnityVulkan->EnsureOutsideRenderPass();
+
+  UnityVulkanRecordingState recordingState;
+  if (!m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+    PLUGIN_LOG_ERROR("failed to intercept the current command buffer state");
+    return;
+  }
+
+  VulkanTile* src_tile = &src.tiles[0];
+  VulkanTile* dst_tile = &dst.tiles[0];
+  const VkImageView src_view = TileView(src_tile, src.format);
+  const VkImageView dst_view = TileView(dst_tile, dst.format);
+  const VkDescriptorSet set =
+      src_view != VK_NULL_HANDLE && dst_view != VK_NULL_HANDLE
+          ? AllocateDescriptorSet(m_GradientSetLayout,
+                                  recordingState.currentFrameNumber)
+          : VK_NULL_HANDLE;
+  if (set == VK_NULL_HANDLE) {
+    PLUGIN_LOG_ERROR("failed to create the image views or descriptors");
+    return;
+  }
+  VkDescriptorImageInfo images[2]{};
+  images[0].imageView = src_view;
+  images[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  images[1].imageView = dst_view;
+  images[1].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  VkWriteDescriptorSet writes[2]{};
+  for (uint32_t i = 0; i < 2; ++i) {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = set;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].pImageInfo = &images[i];
+  }
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  vkUpdateDescriptorSets(m_Instance.device, 2, writes, 0, nullptr);
+
+  // the volume rests in the shader read layout, so uploads recorded before
+  // already made their writes visible to compute shaders
+  const VkCommandBuffer command_buffer = recordingState.commandBuffer;
+  TransitionTiles(command_buffer, recordingState.currentFrameNumber,
+                  &src_tile, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  TransitionTiles(command_buffer, recordingState.currentFrameNumber,
+                  &dst_tile, 1, VK_IMAGE_LAYOUT_GENERAL);
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    m_GradientPipelines[dst_format == RG16_UINT ? 1 : 0]);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          m_GradientPipelineLayout, 0, 1, &set, 0, nullptr);
+  // overlapping boxes write the same values, so the dispatches need no
+  // barriers in between
+  for (const GradientPushConstants& constants : dispatches) {
+    vkCmdPushConstants(command_buffer, m_GradientPipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                       &constants);
+    vkCmdDispatch(
+        command_buffer,
+        (constants.extent[0] + kGradientGroupSize - 1) / kGradientGroupSize,
+        (constants.extent[1] + kGradientGroupSize - 1) / kGradientGroupSize,
+        (constants.extent[2] + kGradientGroupSize - 1) / kGradientGroupSize);
+  }
+  TransitionTiles(command_buffer, recordingState.currentFrameNumber,
+                  &dst_tile, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+void TextureSubPluginAPI_Vulkan::BenchmarkUploadPaths(uint32_t width,
+                                                      uint32_t height,
+                                                      uint32_t depth,
+                                                      Format format,
+                                                      uint32_t count) {
+  {
+    std::lock_guard<std::mutex> lock(m_BenchmarkMutex);
+    if (m_Benchmark.status == READBACK_STATUS_PENDING) {
+      PLUGIN_LOG_ERROR("an upload benchmark is already running");
+      return;
+    }
+    m_Benchmark = UploadBenchmark();
+    m_Benchmark.status = READBACK_STATUS_FAILED;
+  }
+
+  const VkFormat vk_format = ToVkFormat(format);
+  const uint32_t max_dim = m_MaxImageDimension3D ? m_MaxImageDimension3D : 2048;
+  if (vk_format == VK_FORMAT_UNDEFINED || count == 0 || width == 0 ||
+      height == 0 || depth == 0 || width > max_dim || height > max_dim ||
+      depth > max_dim) {
+    PLUGIN_LOG_ERROR("invalid brick: %ux%ux%u format: %d count: %u", width,
+                     height, depth, format, count);
+    return;
+  }
+
+  m_UnityVulkan->EnsureOutsideRenderPass();
+  UnityVulkanRecordingState recordingState;
+  if (!m_UnityVulkan->CommandRecordingState(
+          &recordingState, kUnityVulkanGraphicsQueueAccess_DontCare)) {
+    PLUGIN_LOG_ERROR("failed to intercept the current command buffer state");
+    return;
+  }
+
+  // both paths write into the same single-tile scratch texture in device
+  // local memory
+  bool optimal_device_access;
+  VulkanTexture3D scratch{};
+  scratch.extent = {width, height, depth};
+  scratch.format = format;
+  scratch.hostImageCopy =
+      SupportsHostTransfer(vk_format, &optimal_device_access);
+  std::vector<VkMemoryRequirements> requirements;
+  if (!CreateTileImages(&scratch, vk_format, &requirements)) {
+    PLUGIN_LOG_ERROR("failed to create the benchmark texture");
+    return;
+  }
+  VulkanTile& tile = scratch.tiles[0];
+  const int memory_type =
+      FindMemoryTypeIndex(m_MemoryProperties, requirements[0],
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (memory_type < 0 || !AllocateDeviceMemory(requirements[0].size,
+                                               memory_type,
+                                               &tile.deviceMemory)) {
+    PLUGIN_LOG_ERROR("failed to allocate the benchmark texture");
+    DestroyTileImages(&scratch);
+    return;
+  }
+  tile.deviceMemorySize = requirements[0].size;
+  tile.deviceMemoryHeap = m_MemoryProperties.memoryTypes[memory_type].heapIndex;
+  vkBindImageMemory(m_Instance.device, *tile.image, tile.deviceMemory, 0);
+
+  std::vector<uint8_t> brick(FormatTexelSize(format) * width * height * depth);
+  for (size_t i = 0; i < brick.size(); ++i)
+    brick[i] = static_cast<uint8_t>(i * 31 + 7);
+
+  UploadBenchmark result{};
+  result.status = READBACK_STATUS_PENDING;
+  result.host_image_copy_supported = scratch.hostImageCopy ? 1 : 0;
+  result.brick_count = count;
+  result.brick_bytes = brick.size();
+
+#if SUPPORT_HOST_IMAGE_COPY
+  if (scratch.hostImageCopy) {
+    // the image was just created, so no recorded command accesses it yet
+    VkHostImageLayoutTransitionInfoEXT transition{};
+    transition.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT;
+    transition.image = *tile.image;
+    transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    transition.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkTransitionImageLayoutEXT(m_Instance.device, 1, &transition);
+    tile.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkMemoryToImageCopyEXT copy{};
+    copy.sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+    copy.pHostPointer = brick.data();
+    copy.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    copy.imageExtent = scratch.extent;
+    VkCopyMemoryToImageInfoEXT copy_info{};
+    copy_info.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+    copy_info.dstImage = *tile.image;
+    copy_info.dstImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    copy_info.regionCount = 1;
+    copy_info.pRegions = &copy;
+    const int64_t start = TraceNow();
+    for (uint32_t i = 0; i < count; ++i)
+      vkCopyMemoryToImageEXT(m_Instance.device, &copy_info);
+    result.host_copy_ns = static_cast<double>(TraceNow() - start) / count;
+  }
+#endif
+
+  VkQueryPool queries = VK_NULL_HANDLE;
+  if (m_TimestampPeriod > 0.0f) {
+    VkQueryPoolCreateInfo query_info{};
+    query_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_info.queryCount = 2;
+    if (vkCreateQueryPool(m_Instance.device, &query_info, nullptr, &queries) !=
+        VK_SUCCESS)
+      queries = VK_NULL_HANDLE;
+  }
+
+  const VkCommandBuffer command_buffer = recordingState.commandBuffer;
+  VulkanTile* tiles[] = {&tile};
+  TransitionTiles(command_buffer, recordingState.currentFrameNumber, tiles, 1,
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  if (queries != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(command_buffer, queries, 0, 2);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        queries, 0);
+  }
+  // what a staged upload costs the render thread: allocating and filling
+  // staging memory and recording the copy
+  const int64_t start = TraceNow();
+  VulkanStaging staging{};
+  for (uint32_t i = 0; i < count; ++i) {
+    VkOffset3D dst_offset;
+    VkExtent3D dst_extent;
+    size_t texel_size;
+    if (!StageSubImage3D(nullptr, {0, 0, 0}, scratch.extent, brick.data(),
+                         format, nullptr, recordingState.currentFrameNumber,
+                         &dst_offset, &dst_extent, &texel_size, &staging)) {
+      staging = VulkanStaging();
+      break;
+    }
+    VkBufferImageCopy region{};
+    region.bufferOffset = staging.offset;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageOffset = dst_offset;
+    region.imageExtent = dst_extent;
+    vkCmdCopyBufferToImage(command_buffer, staging.buffer, *tile.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  }
+  result.staging_cpu_ns = static_cast<double>(TraceNow() - start) / count;
+
+  // the copy into the (usually write-combined) staging memory on its own,
+  // once with libc and once with the stream copy engine. The last brick's
+  // staging memory is overwritten with the same data
+  if (staging.mapped && staging.size >= brick.size()) {
+    int64_t copy_start = TraceNow();
+    for (uint32_t i = 0; i < count; ++i)
+      memcpy(staging.mapped, brick.data(), brick.size());
+    result.memcpy_ns = static_cast<double>(TraceNow() - copy_start) / count;
+    copy_start = TraceNow();
+    for (uint32_t i = 0; i < count; ++i)
+      StreamCopy(staging.mapped, brick.data(), brick.size());
+    result.stream_copy_ns =
+        static_cast<double>(TraceNow() - copy_start) / count;
+  }
+  if (queries != VK_NULL_HANDLE)
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        queries, 1);
+  TransitionTiles(command_buffer, recordingState.currentFrameNumber, tiles, 1,
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  std::lock_guard<std::mutex> lock(m_BenchmarkMutex);
+  m_Benchmark = result;
+  m_BenchmarkTile = std::move(tile);
+  m_BenchmarkQueries = queries;
+  m_BenchmarkFrame = recordingState.currentFrameNumber;
+}
+
+void TextureSubPluginAPI_Vulkan::CompleteBenchmark(
+    unsigned long long safe_frame_number) {
+  if (!m_BenchmarkTile.image || m_BenchmarkFrame > safe_frame_number) return;
+
+  double gpu_ns = 0.0;
+  if (m_BenchmarkQueries != VK_NULL_HANDLE) {
+    uint64_t timestamps[2];
+    if (vkGetQueryPoolResults(m_Instance.device, m_BenchmarkQueries, 0, 2,
+                              sizeof(timestamps), timestamps, sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT) == VK_SUCCESS &&
+        timestamps[1] >= timestamps[0])
+      gpu_ns = static_cast<double>(timestamps[1] - timestamps[0]) *
+               m_TimestampPeriod;
+    vkDestroyQueryPool(m_Instance.device, m_BenchmarkQueries, nullptr);
+    m_BenchmarkQueries = VK_NULL_HANDLE;
+  }
+  DestroyTile(&m_BenchmarkTile);
+
+  std::lock_guard<std::mutex> lock(m_BenchmarkMutex);
+  m_Benchmark.staging_gpu_ns = gpu_ns / m_Benchmark.brick_count;
+  m_Benchmark.status = READBACK_STATUS_READY;
+}
+
+uint32_t TextureSubPluginAPI_Vulkan::GetUploadBenchmark(
+    UploadBenchmark* result) {
+  std::lock_guard<std::mutex> lock(m_BenchmarkMutex);
+  *result = m_Benchmark;
+  return m_Benchmark.status;
 }
 
 #endif  // #if SUPPORT_VULKAN
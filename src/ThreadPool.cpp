@@ -0,0 +1,115 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Tracing.hpp"
+
+struct PoolJob {
+  const std::function<void(uint32_t)>* task;
+  uint32_t count;
+  std::atomic<uint32_t> next;
+};
+
+// held by the thread whose job runs on the pool
+static std::mutex s_SubmitMutex;
+// guards everything below
+static std::mutex s_PoolMutex;
+static std::condition_variable s_WorkAvailable;
+static std::condition_variable s_WorkersIdle;
+static std::vector<std::thread> s_Workers;
+static PoolJob* s_Job = nullptr;
+static uint64_t s_JobGeneration = 0;
+// workers that are running tasks of s_Job
+static uint32_t s_BusyWorkers = 0;
+static bool s_StopWorkers = false;
+
+static uint32_t WorkerCount() {
+  const uint32_t hardware_threads = std::thread::hardware_concurrency();
+  return std::min(kMaxPoolWorkers,
+                  hardware_threads > 1 ? hardware_threads - 1 : 1);
+}
+
+static void RunTasks(PoolJob* job) {
+  for (;;) {
+    const uint32_t i = job->next.fetch_add(1, std::memory_order_relaxed);
+    if (i >= job->count) return;
+    (*job->task)(i);
+  }
+}
+
+// generation is the last job the worker has seen
+static void WorkerLoop(uint64_t generation) {
+  std::unique_lock<std::mutex> lock(s_PoolMutex);
+  for (;;) {
+    s_WorkAvailable.wait(lock, [&generation]() {
+      return s_StopWorkers || s_JobGeneration != generation;
+    });
+    if (s_StopWorkers) return;
+    generation = s_JobGeneration;
+    // the job may have finished before this worker woke up
+    PoolJob* job = s_Job;
+    if (!job) continue;
+    ++s_BusyWorkers;
+    lock.unlock();
+    RunTasks(job);
+    lock.lock();
+    if (--s_BusyWorkers == 0) s_WorkersIdle.notify_all();
+  }
+}
+
+void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& task) {
+  std::unique_lock<std::mutex> submit(s_SubmitMutex, std::try_to_lock);
+  if (count < 2 || !submit.owns_lock()) {
+    for (uint32_t i = 0; i < count; ++i) task(i);
+    return;
+  }
+
+  TraceScope trace("pool", "ParallelFor", "tasks", count);
+  PoolJob job;
+  job.task = &task;
+  job.count = count;
+  job.next.store(0, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(s_PoolMutex);
+    if (s_Workers.empty()) {
+      s_StopWorkers = false;
+      for (uint32_t i = WorkerCount(); i > 0; --i)
+        s_Workers.emplace_back(WorkerLoop, s_JobGeneration);
+    }
+    s_Job = &job;
+    ++s_JobGeneration;
+  }
+  s_WorkAvailable.notify_all();
+  RunTasks(&job);
+
+  // the job lives on this stack, so no worker may still hold it
+  std::unique_lock<std::mutex> lock(s_PoolMutex);
+  s_Job = nullptr;
+  s_WorkersIdle.wait(lock, []() { return s_BusyWorkers == 0; });
+}
+
+uint32_t ParallelThreadCount() { return WorkerCount() + 1; }
+
+void StopThreadPool() {
+  std::lock_guard<std::mutex> submit(s_SubmitMutex);
+  std::vector<std::thread> workers;
+  {
+    std::lock_guard<std::mutex> lock(s_PoolMutex);
+    s_StopWorkers = true;
+    workers.swap(s_Workers);
+  }
+  s_WorkAvailable.notify_all();
+  for (std::thread& worker : workers) worker.join();
+}
+
+// joins the workers if the process exits while they still run (a joinable
+// std::thread calls std::terminate when it is destroyed). Being defined last,
+// it is destroyed before the mutexes and condition variables they wait on
+static struct PoolGuard {
+  ~PoolGuard() { StopThreadPool(); }
+} s_PoolGuard;
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+
+// A small pool of worker threads shared by the CPU-heavy parts of uploads
+// (e.g., gathering slice stacks). The workers are started on first use
+
+/// @brief Maximum number of worker threads (the calling thread helps, too)
+static const uint32_t kMaxPoolWorkers = 7;
+
+/// @brief Calls task(i) for every i in [0, count) on the calling thread and
+/// the pool's workers and returns once all calls returned. Calls run
+/// concurrently and in no particular order. Only one ParallelFor runs on the
+/// pool at a time: concurrent and nested calls run their tasks on the
+/// calling thread
+void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& task);
+
+/// @brief Number of threads a ParallelFor runs on (including the calling
+/// thread)
+uint32_t ParallelThreadCount();
+
+/// @brief Joins the workers (they are started again on the next use)
+void StopThreadPool();
@@ -0,0 +1,85 @@
+#include "Tickets.hpp"
+
+uint64_t TicketTracker::Acquire() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  const uint64_t ticket = ++m_LastTicket;
+  m_Pending[ticket] = Pending{false, false, 0};
+  return ticket;
+}
+
+void TicketTracker::Retire(uint64_t ticket, bool failed) {
+  m_Completed.push_back(ticket);
+  if (!failed) return;
+  m_Failed.insert(ticket);
+  if (m_Failed.size() > kMaxFailedTickets) m_Failed.erase(m_Failed.begin());
+}
+
+void TicketTracker::Record(uint64_t ticket, unsigned long long frame,
+                           bool immediate, bool failed) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  auto search = m_Pending.find(ticket);
+  if (search == m_Pending.end()) return;
+  if (immediate) {
+    m_Pending.erase(search);
+    Retire(ticket, failed);
+    return;
+  }
+  search->second = Pending{true, failed, frame};
+}
+
+void TicketTracker::Abandon(uint64_t ticket) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  auto search = m_Pending.find(ticket);
+  if (search == m_Pending.end() || search->second.recorded) return;
+  m_Pending.erase(search);
+  Retire(ticket, true);
+}
+
+void TicketTracker::Update(unsigned long long safe_frame) {
+  TicketCallback callback;
+  std::vector<uint64_t> completed;
+  uint64_t watermark;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (auto it = m_Pending.begin(); it != m_Pending.end();) {
+      if (it->second.recorded && it->second.frame <= safe_frame) {
+        Retire(it->first, it->second.failed);
+        it = m_Pending.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (m_Completed.empty()) return;
+    completed.swap(m_Completed);
+    callback = m_Callback;
+    watermark =
+        m_Pending.empty() ? m_LastTicket : m_Pending.begin()->first - 1;
+  }
+  // invoked without holding the lock so that the callback may query tickets
+  if (callback)
+    callback(completed.data(), static_cast<uint32_t>(completed.size()),
+             watermark);
+}
+
+bool TicketTracker::IsComplete(uint64_t ticket) const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return ticket <= m_LastTicket && m_Pending.count(ticket) == 0;
+}
+
+uint32_t TicketTracker::GetStatus(uint64_t ticket) const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (ticket == 0 || ticket > m_LastTicket) return TICKET_STATUS_UNKNOWN;
+  if (m_Pending.count(ticket) != 0) return TICKET_STATUS_PENDING;
+  return m_Failed.count(ticket) != 0 ? TICKET_STATUS_FAILED
+                                     : TICKET_STATUS_COMPLETE;
+}
+
+uint64_t TicketTracker::GetCompleted() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Pending.empty() ? m_LastTicket : m_Pending.begin()->first - 1;
+}
+
+void TicketTracker::SetCallback(TicketCallback callback) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Callback = callback;
+}
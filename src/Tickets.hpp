@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "TextureSubPluginAPI.hpp"
+
+/// @brief Tracks the completion of the work of plugin events. Tickets are
+/// acquired from any thread, passed along with events and recorded on the
+/// render thread together with the frame the event's work was recorded in.
+/// A ticket completes once the GPU has finished that frame. Tickets whose
+/// event failed (or was never executed) retire as failed instead
+class TicketTracker {
+ public:
+  /// @brief Returns a new ticket (monotonically increasing, never 0)
+  uint64_t Acquire();
+
+  /// @brief Records that the work of an event was recorded in frame (render
+  /// thread). Tickets of immediate APIs complete when they are recorded. A
+  /// failed ticket still waits for its frame (the event may have recorded
+  /// part of its work) and then retires as failed
+  void Record(uint64_t ticket, unsigned long long frame, bool immediate,
+              bool failed = false);
+
+  /// @brief Retires a ticket whose work will never be recorded (e.g., its
+  /// event was not issued) as failed. Recorded tickets are not affected
+  /// (any thread)
+  void Abandon(uint64_t ticket);
+
+  /// @brief Completes the tickets recorded in frames up to safe_frame and
+  /// invokes the callback with them and the abandoned tickets (render thread)
+  void Update(unsigned long long safe_frame);
+
+  /// @brief Returns true if the ticket has retired, i.e., the work of the
+  /// event that received it has completed or failed (any thread)
+  bool IsComplete(uint64_t ticket) const;
+
+  /// @brief Returns the TicketStatus of ticket (any thread)
+  uint32_t GetStatus(uint64_t ticket) const;
+
+  /// @brief Returns the largest ticket up to which all tickets have retired
+  /// (any thread)
+  uint64_t GetCompleted() const;
+
+  void SetCallback(TicketCallback callback);
+
+  /// @brief Number of failed tickets that are remembered; older failures are
+  /// reported as TICKET_STATUS_COMPLETE
+  static constexpr size_t kMaxFailedTickets = 4096;
+
+ private:
+  struct Pending {
+    bool recorded;
+    bool failed;
+    unsigned long long frame;
+  };
+
+  void Retire(uint64_t ticket, bool failed);
+
+  mutable std::mutex m_Mutex;
+  uint64_t m_LastTicket = 0;
+  std::map<uint64_t, Pending> m_Pending;
+  std::vector<uint64_t> m_Completed;
+  // the most recent kMaxFailedTickets failed tickets
+  std::set<uint64_t> m_Failed;
+  TicketCallback m_Callback = nullptr;
+};
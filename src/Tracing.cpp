@@ -0,0 +1,143 @@
+#include "Tracing.hpp"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> g_TracingEnabled(false);
+
+// events per thread - older events are overwritten (~1 MB per thread)
+static const uint32_t kRingCapacity = 1 << 14;
+
+struct TraceRecord {
+  const char* category;
+  const char* name;
+  const char* arg_name;
+  uint64_t arg;
+  int64_t timestamp_ns;
+  int64_t duration_ns;
+  char phase;
+};
+
+// single producer (the owning thread), exporters only read. The head is
+// published with release semantics after a record is written; exporters
+// re-read it after copying to detect records that were (or are being)
+// overwritten meanwhile
+struct TraceRing {
+  uint32_t tid;
+  std::atomic<const char*> thread_name{nullptr};
+  std::atomic<uint64_t> head{0};
+  TraceRecord records[kRingCapacity];
+};
+
+static std::mutex s_RingsMutex;
+// rings outlive their threads so that their events can still be exported
+static std::vector<std::shared_ptr<TraceRing>> s_Rings;
+static std::atomic<int64_t> s_CaptureStart(0);
+
+static TraceRing* ThreadRing() {
+  thread_local TraceRing* ring = nullptr;
+  if (!ring) {
+    auto created = std::make_shared<TraceRing>();
+    std::lock_guard<std::mutex> lock(s_RingsMutex);
+    created->tid = static_cast<uint32_t>(s_Rings.size()) + 1;
+    s_Rings.push_back(created);
+    ring = created.get();
+  }
+  return ring;
+}
+
+void SetTracingEnabled(bool enabled) {
+  if (enabled && !IsTracingEnabled())
+    s_CaptureStart.store(TraceNow(), std::memory_order_relaxed);
+  g_TracingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+int64_t TraceNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void TraceEvent(char phase, const char* category, const char* name,
+                int64_t timestamp_ns, int64_t duration_ns,
+                const char* arg_name, uint64_t arg) {
+  TraceRing* ring = ThreadRing();
+  const uint64_t head = ring->head.load(std::memory_order_relaxed);
+  ring->records[head % kRingCapacity] =
+      TraceRecord{category,     name,        arg_name, arg,
+                  timestamp_ns, duration_ns, phase};
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+void TraceThreadName(const char* name) {
+  ThreadRing()->thread_name.store(name, std::memory_order_relaxed);
+}
+
+// names are literals chosen by the plugin, so they never need escaping
+static void WriteRecord(FILE* file, uint32_t tid, const TraceRecord& record,
+                        int64_t start) {
+  fprintf(file, ",\n{\"ph\":\"%c\",\"cat\":\"%s\",\"name\":\"%s\",",
+          record.phase, record.category, record.name);
+  fprintf(file, "\"pid\":1,\"tid\":%u,\"ts\":%.3f", tid,
+          (record.timestamp_ns - start) / 1000.0);
+  if (record.phase == 'X')
+    fprintf(file, ",\"dur\":%.3f", record.duration_ns / 1000.0);
+  if (record.phase == 'i') fprintf(file, ",\"s\":\"t\"");
+  if (record.arg_name)
+    fprintf(file, ",\"args\":{\"%s\":%llu}", record.arg_name,
+            static_cast<unsigned long long>(record.arg));
+  fprintf(file, "}");
+}
+
+bool WriteTrace(const char* path) {
+  FILE* file = path ? fopen(path, "w") : nullptr;
+  if (!file) return false;
+
+  std::vector<std::shared_ptr<TraceRing>> rings;
+  {
+    std::lock_guard<std::mutex> lock(s_RingsMutex);
+    rings = s_Rings;
+  }
+  const int64_t start = s_CaptureStart.load(std::memory_order_relaxed);
+
+  // the process name comes first so that every event can be prefixed by a
+  // comma
+  fprintf(file,
+          "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+          "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,"
+          "\"args\":{\"name\":\"TextureSubPlugin\"}}");
+  std::vector<TraceRecord> records;
+  for (const auto& ring : rings) {
+    const uint64_t head = ring->head.load(std::memory_order_acquire);
+    const uint64_t begin = head > kRingCapacity ? head - kRingCapacity : 0;
+    records.resize(static_cast<size_t>(head - begin));
+    for (uint64_t i = begin; i < head; ++i)
+      records[i - begin] = ring->records[i % kRingCapacity];
+
+    // records the owner wrote over while they were copied are dropped. The
+    // owner may also be writing record new_head (the slot of record
+    // new_head - kRingCapacity) right now, so that record is dropped as well
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t new_head = ring->head.load(std::memory_order_relaxed);
+    const uint64_t valid =
+        new_head >= kRingCapacity ? new_head - kRingCapacity + 1 : 0;
+
+    if (const char* name = ring->thread_name.load(std::memory_order_relaxed))
+      fprintf(file,
+              ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,"
+              "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+              ring->tid, name);
+    for (uint64_t i = std::max(begin, valid); i < head; ++i) {
+      const TraceRecord& record = records[i - begin];
+      if (record.timestamp_ns < start) continue;
+      WriteRecord(file, ring->tid, record, start);
+    }
+  }
+  fprintf(file, "\n]}\n");
+  return fclose(file) == 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+// Opt-in tracing of the plugin's own work and of intercepted Unity Vulkan
+// calls. Events are appended to lock-free per-thread rings and exported as
+// Chrome trace JSON (chrome://tracing, https://ui.perfetto.dev) on demand.
+// Event names, categories and argument names must be string literals (only
+// their pointers are stored)
+
+extern std::atomic<bool> g_TracingEnabled;
+
+/// @brief Returns true if tracing is enabled (a single relaxed load - this is
+/// all tracing costs while it is disabled)
+inline bool IsTracingEnabled() {
+  return g_TracingEnabled.load(std::memory_order_relaxed);
+}
+
+/// @brief Enables/disables tracing. Enabling starts a new capture: events
+/// recorded before are not exported
+void SetTracingEnabled(bool enabled);
+
+/// @brief Current time of the trace clock in nanoseconds
+int64_t TraceNow();
+
+/// @brief Records an event. phase is a Chrome trace phase: 'X' (complete,
+/// uses duration_ns), 'B'/'E' (begin/end on the calling thread) or 'i'
+/// (instant). arg_name may be nullptr
+void TraceEvent(char phase, const char* category, const char* name,
+                int64_t timestamp_ns, int64_t duration_ns,
+                const char* arg_name = nullptr, uint64_t arg = 0);
+
+/// @brief Names the calling thread in exported traces
+void TraceThreadName(const char* name);
+
+/// @brief Writes all events recorded since tracing was enabled to path as
+/// Chrome trace JSON. Can be called while tracing is still enabled (events
+/// that are overwritten while exporting are dropped)
+/// @return false if the file could not be written
+bool WriteTrace(const char* path);
+
+/// @brief Records a complete event spanning the lifetime of the scope (if
+/// tracing was enabled when the scope was entered)
+class TraceScope {
+ public:
+  TraceScope(const char* category, const char* name,
+             const char* arg_name = nullptr, uint64_t arg = 0)
+      : m_Name(IsTracingEnabled() ? name : nullptr) {
+    if (!m_Name) return;
+    m_Category = category;
+    m_ArgName = arg_name;
+    m_Arg = arg;
+    m_Start = TraceNow();
+  }
+  ~TraceScope() {
+    if (m_Name)
+      TraceEvent('X', m_Category, m_Name, m_Start, TraceNow() - m_Start,
+                 m_ArgName, m_Arg);
+  }
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+ private:
+  const char* m_Name;
+  const char* m_Category;
+  const char* m_ArgName;
+  uint64_t m_Arg;
+  int64_t m_Start;
+};
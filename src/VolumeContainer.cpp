@@ -0,0 +1,499 @@
+#include "VolumeContainer.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "ConversionKernels.hpp"
+#include "FormatTraits.hpp"
+#include "PlatformBase.hpp"
+
+#if UNITY_WIN
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 'TVOL'
+static const uint32_t kContainerMagic = 0x4C4F5654;
+static const uint32_t kContainerVersion = 1;
+// page size and the sector size of direct (unbuffered) reads
+static const uint32_t kBrickAlignment = 4096;
+static const uint32_t kConstantBrickAlignment = 16;
+
+struct ContainerHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  uint32_t format;
+  uint32_t brick_size;
+  uint32_t lod_count;
+  uint32_t brick_count;
+  uint32_t alignment;
+  uint64_t lod_table_offset;
+  uint64_t brick_table_offset;
+  uint64_t file_size;
+};
+
+static_assert(sizeof(ContainerHeader) == 64, "unexpected header size");
+
+static bool HasStatistics(Format format) {
+  return format == R8_UINT || format == R16_UINT;
+}
+
+// halves a volume with a 2x2x2 box filter (the last voxel of odd extents is
+// repeated)
+static void Downsample(const uint8_t* src, const uint32_t src_extent[3],
+                       Format format, const uint32_t dst_extent[3],
+                       std::vector<uint8_t>* dst) {
+  const FormatTraits traits = GetFormatTraits(format);
+  const size_t row = static_cast<size_t>(src_extent[0]) * traits.texel_size;
+  const size_t slice = row * src_extent[1];
+  dst->resize(static_cast<size_t>(dst_extent[0]) * dst_extent[1] *
+              dst_extent[2] * traits.texel_size);
+  uint8_t* out = dst->data();
+  for (uint32_t z = 0; z < dst_extent[2]; ++z) {
+    const size_t zs[2] = {2 * z * slice,
+                          std::min(2 * z + 1, src_extent[2] - 1) * slice};
+    for (uint32_t y = 0; y < dst_extent[1]; ++y) {
+      const size_t ys[2] = {2 * y * row,
+                            std::min(2 * y + 1, src_extent[1] - 1) * row};
+      for (uint32_t x = 0; x < dst_extent[0]; ++x) {
+        const size_t xs[2] = {
+            2 * x * traits.texel_size,
+            std::min(2 * x + 1, src_extent[0] - 1) * traits.texel_size};
+        for (uint32_t c = 0; c < traits.channel_count; ++c) {
+          double sum = 0.0;
+          for (int i = 0; i < 8; ++i)
+            sum += LoadChannel(src + zs[i >> 2] + ys[(i >> 1) & 1] +
+                                   xs[i & 1] + c * traits.channel_size,
+                               traits);
+          StoreChannel(out + c * traits.channel_size, traits, sum / 8.0);
+        }
+        out += traits.texel_size;
+      }
+    }
+  }
+}
+
+static bool IsConstantBrick(const uint8_t* texels, size_t count,
+                            size_t texel_size) {
+  if (texel_size <= 4) return IsConstant(texels, count, texel_size);
+  for (size_t i = 1; i < count; ++i)
+    if (memcmp(texels, texels + i * texel_size, texel_size) != 0) return false;
+  return true;
+}
+
+uint32_t BitpackedBits(uint32_t min, uint32_t max) {
+  const uint32_t range = max - min;
+  uint32_t bits = 0;
+  while (bits < 32 && (range >> bits) != 0) ++bits;
+  return bits;
+}
+
+void EncodeBitpackedBrick(const void* texels, size_t count, Format format,
+                          uint32_t min, uint32_t bits, uint32_t* words) {
+  const uint8_t* const src = static_cast<const uint8_t*>(texels);
+  std::fill(words, words + BitpackedWordCount(count, bits), 0u);
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t value;
+    if (format == R8_UINT) {
+      value = src[i];
+    } else {
+      uint16_t u16;
+      memcpy(&u16, src + 2 * i, sizeof(u16));
+      value = u16;
+    }
+    value -= min;
+    const size_t bit = i * bits;
+    const uint32_t shift = bit & 31;
+    words[bit >> 5] |= value << shift;
+    if (shift + bits > 32) words[(bit >> 5) + 1] |= value >> (32 - shift);
+  }
+}
+
+void DecodeBitpackedBrick(const uint32_t* words, uint32_t bits, uint32_t min,
+                          size_t count, Format format, void* dst) {
+  const uint32_t mask = bits >= 32 ? 0xFFFFFFFF : (1u << bits) - 1;
+  for (size_t i = 0; i < count; ++i) {
+    const size_t bit = i * bits;
+    const uint32_t shift = bit & 31;
+    uint32_t value = words[bit >> 5] >> shift;
+    if (shift + bits > 32) value |= words[(bit >> 5) + 1] << (32 - shift);
+    value = (value & mask) + min;
+    if (format == R8_UINT)
+      static_cast<uint8_t*>(dst)[i] = static_cast<uint8_t>(value);
+    else
+      static_cast<uint16_t*>(dst)[i] = static_cast<uint16_t>(value);
+  }
+}
+
+namespace {
+
+// sequential writer that keeps track of the file offset
+class ContainerFile {
+ public:
+  explicit ContainerFile(const char* path) : m_File(fopen(path, "wb")) {}
+  ~ContainerFile() {
+    if (m_File) fclose(m_File);
+  }
+
+  bool IsOpen() const { return m_File != nullptr; }
+  bool Ok() const { return m_File != nullptr && !m_Failed; }
+  uint64_t Offset() const { return m_Offset; }
+
+  void Write(const void* data, size_t size) {
+    if (!Ok() || size == 0) return;
+    m_Failed = fwrite(data, 1, size, m_File) != size;
+    m_Offset += size;
+  }
+
+  void Align(uint32_t alignment) {
+    static const uint8_t kZeros[kBrickAlignment] = {};
+    const uint64_t padding = (alignment - m_Offset % alignment) % alignment;
+    Write(kZeros, static_cast<size_t>(padding));
+  }
+
+  // writes data at the start of the file and closes it
+  bool Finish(const void* header, size_t size) {
+    if (!Ok()) return false;
+    rewind(m_File);
+    m_Failed = fwrite(header, 1, size, m_File) != size;
+    const bool closed = fclose(m_File) == 0;
+    m_File = nullptr;
+    return !m_Failed && closed;
+  }
+
+ private:
+  FILE* m_File;
+  bool m_Failed = false;
+  uint64_t m_Offset = 0;
+};
+
+}  // namespace
+
+bool WriteVolumeContainer(const char* path, const void* data, uint32_t width,
+                          uint32_t height, uint32_t depth, Format format,
+                          const VolumeContainerOptions& options) {
+  const size_t texel_size = FormatTexelSize(format);
+  if (path == nullptr || data == nullptr || texel_size == 0 || width == 0 ||
+      height == 0 || depth == 0)
+    return false;
+  const uint32_t brick_size = options.brick_size ? options.brick_size : 64;
+  if (static_cast<uint64_t>(brick_size) * brick_size * brick_size *
+          texel_size >
+      0xFFFFFFFFull)
+    return false;
+
+  std::vector<VolumeContainerLod> lods;
+  uint32_t extent[3] = {width, height, depth};
+  uint32_t brick_count = 0;
+  for (;;) {
+    VolumeContainerLod lod = {};
+    lod.width = extent[0];
+    lod.height = extent[1];
+    lod.depth = extent[2];
+    lod.brick_count_x = (extent[0] + brick_size - 1) / brick_size;
+    lod.brick_count_y = (extent[1] + brick_size - 1) / brick_size;
+    lod.brick_count_z = (extent[2] + brick_size - 1) / brick_size;
+    lod.first_brick = brick_count;
+    brick_count += lod.brick_count_x * lod.brick_count_y * lod.brick_count_z;
+    lods.push_back(lod);
+
+    const bool single_brick = lod.brick_count_x == 1 &&
+                              lod.brick_count_y == 1 && lod.brick_count_z == 1;
+    if (options.lod_count ? lods.size() == options.lod_count : single_brick)
+      break;
+    if (extent[0] == 1 && extent[1] == 1 && extent[2] == 1) break;
+    for (int a = 0; a < 3; ++a) extent[a] = std::max(1u, (extent[a] + 1) / 2);
+  }
+
+  // all LODs are kept in memory (1/7 of the volume's size on top of it)
+  std::vector<std::vector<uint8_t>> levels(lods.size());
+  std::vector<const uint8_t*> level_data(lods.size());
+  level_data[0] = static_cast<const uint8_t*>(data);
+  for (size_t l = 1; l < lods.size(); ++l) {
+    const uint32_t src_extent[3] = {lods[l - 1].width, lods[l - 1].height,
+                                    lods[l - 1].depth};
+    const uint32_t dst_extent[3] = {lods[l].width, lods[l].height,
+                                    lods[l].depth};
+    Downsample(level_data[l - 1], src_extent, format, dst_extent, &levels[l]);
+    level_data[l] = levels[l].data();
+  }
+
+  ContainerFile file(path);
+  if (!file.IsOpen()) return false;
+  ContainerHeader header = {};
+  file.Write(&header, sizeof(header));
+
+  std::vector<VolumeContainerBrick> bricks(brick_count);
+  std::vector<uint8_t> texels;
+  std::vector<uint32_t> words;
+  for (size_t l = lods.size(); l-- > 0;) {
+    const VolumeContainerLod& lod = lods[l];
+    uint32_t index = lod.first_brick;
+    for (uint32_t bz = 0; bz < lod.brick_count_z; ++bz) {
+      for (uint32_t by = 0; by < lod.brick_count_y; ++by) {
+        for (uint32_t bx = 0; bx < lod.brick_count_x; ++bx, ++index) {
+          VolumeContainerBrick& brick = bricks[index];
+          brick.lod = static_cast<uint32_t>(l);
+          brick.x = bx * brick_size;
+          brick.y = by * brick_size;
+          brick.z = bz * brick_size;
+          brick.width = std::min(brick_size, lod.width - brick.x);
+          brick.height = std::min(brick_size, lod.height - brick.y);
+          brick.depth = std::min(brick_size, lod.depth - brick.z);
+          const size_t count =
+              static_cast<size_t>(brick.width) * brick.height * brick.depth;
+          brick.raw_size = static_cast<uint32_t>(count * texel_size);
+
+          texels.resize(brick.raw_size);
+          const size_t origin =
+              ((static_cast<size_t>(brick.z) * lod.height + brick.y) *
+                   lod.width +
+               brick.x) *
+              texel_size;
+          CopyStrided(level_data[l] + origin, texel_size, brick.width,
+                      brick.height, brick.depth, lod.width, lod.height,
+                      texels.data());
+
+          if (HasStatistics(format)) {
+            brick.min = 0xFFFFFFFF;
+            AccumulateStatistics(texels.data(), count, format, &brick.min,
+                                 &brick.max, nullptr, 0);
+          }
+
+          const void* stored = texels.data();
+          brick.codec = BRICK_CODEC_NONE;
+          brick.stored_size = brick.raw_size;
+          if (options.compress &&
+              IsConstantBrick(texels.data(), count, texel_size)) {
+            brick.codec = BRICK_CODEC_CONSTANT;
+            brick.stored_size = static_cast<uint32_t>(texel_size);
+          } else if (options.compress && HasStatistics(format)) {
+            const uint32_t bits = BitpackedBits(brick.min, brick.max);
+            const uint64_t packed_size = BitpackedWordCount(count, bits) * 4;
+            if (packed_size < brick.raw_size) {
+              words.resize(BitpackedWordCount(count, bits));
+              EncodeBitpackedBrick(texels.data(), count, format, brick.min,
+                                   bits, words.data());
+              brick.codec = BRICK_CODEC_BITPACK;
+              brick.bits = bits;
+              brick.stored_size = static_cast<uint32_t>(packed_size);
+              stored = words.data();
+            }
+          }
+
+          file.Align(brick.codec == BRICK_CODEC_CONSTANT
+                         ? kConstantBrickAlignment
+                         : kBrickAlignment);
+          brick.offset = file.Offset();
+          file.Write(stored, brick.stored_size);
+        }
+      }
+    }
+  }
+
+  file.Align(kConstantBrickAlignment);
+  header.magic = kContainerMagic;
+  header.version = kContainerVersion;
+  header.width = width;
+  header.height = height;
+  header.depth = depth;
+  header.format = static_cast<uint32_t>(format);
+  header.brick_size = brick_size;
+  header.lod_count = static_cast<uint32_t>(lods.size());
+  header.brick_count = brick_count;
+  header.alignment = kBrickAlignment;
+  header.lod_table_offset = file.Offset();
+  file.Write(lods.data(), lods.size() * sizeof(VolumeContainerLod));
+  header.brick_table_offset = file.Offset();
+  file.Write(bricks.data(), bricks.size() * sizeof(VolumeContainerBrick));
+  header.file_size = file.Offset();
+  return file.Finish(&header, sizeof(header));
+}
+
+VolumeContainerReader::~VolumeContainerReader() { Close(); }
+
+// checks that the tables describe the volume and that all bricks lie within
+// the file
+static bool ValidateContainer(const ContainerHeader& header,
+                              const VolumeContainerLod* lods,
+                              const VolumeContainerBrick* bricks,
+                              uint64_t file_size) {
+  const size_t texel_size = FormatTexelSize(static_cast<Format>(header.format));
+  uint32_t first_brick = 0;
+  for (uint32_t l = 0; l < header.lod_count; ++l) {
+    const VolumeContainerLod& lod = lods[l];
+    if (lod.first_brick != first_brick || lod.width == 0 || lod.height == 0 ||
+        lod.depth == 0)
+      return false;
+    const uint64_t count = static_cast<uint64_t>(lod.brick_count_x) *
+                           lod.brick_count_y * lod.brick_count_z;
+    if (count > header.brick_count - first_brick) return false;
+    first_brick += static_cast<uint32_t>(count);
+  }
+  if (first_brick != header.brick_count) return false;
+
+  for (uint32_t i = 0; i < header.brick_count; ++i) {
+    const VolumeContainerBrick& brick = bricks[i];
+    if (brick.lod >= header.lod_count) return false;
+    const VolumeContainerLod& lod = lods[brick.lod];
+    if (brick.width == 0 || brick.height == 0 || brick.depth == 0 ||
+        brick.x + static_cast<uint64_t>(brick.width) > lod.width ||
+        brick.y + static_cast<uint64_t>(brick.height) > lod.height ||
+        brick.z + static_cast<uint64_t>(brick.depth) > lod.depth)
+      return false;
+    const uint64_t count =
+        static_cast<uint64_t>(brick.width) * brick.height * brick.depth;
+    if (brick.raw_size != count * texel_size) return false;
+
+    uint64_t stored_size = brick.raw_size;
+    if (brick.codec == BRICK_CODEC_CONSTANT) {
+      stored_size = texel_size;
+    } else if (brick.codec == BRICK_CODEC_BITPACK) {
+      if (!HasStatistics(static_cast<Format>(header.format)) ||
+          brick.bits == 0 || brick.bits > texel_size * 8 ||
+          brick.offset % 4 != 0)
+        return false;
+      stored_size = BitpackedWordCount(count, brick.bits) * 4;
+    } else if (brick.codec != BRICK_CODEC_NONE) {
+      return false;
+    }
+    if (brick.stored_size != stored_size || brick.offset > file_size ||
+        brick.stored_size > file_size - brick.offset)
+      return false;
+  }
+  return true;
+}
+
+bool VolumeContainerReader::Open(const char* path) {
+  Close();
+  if (path == nullptr) return false;
+
+#if UNITY_WIN
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  HANDLE mapping = nullptr;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping == nullptr) return false;
+  // copy on write: pages stay backed by the file unless they are written
+  m_Mapping = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  CloseHandle(mapping);
+  if (m_Mapping == nullptr) return false;
+  m_MappingSize = static_cast<size_t>(size.QuadPart);
+#else
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  void* mapping = MAP_FAILED;
+  // private and writable (copy on write) since read-only mappings cannot be
+  // imported as host memory by most drivers
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+    mapping = mmap(nullptr, static_cast<size_t>(st.st_size),
+                   PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) return false;
+  m_Mapping = mapping;
+  m_MappingSize = static_cast<size_t>(st.st_size);
+#endif
+
+  const uint8_t* bytes = static_cast<const uint8_t*>(m_Mapping);
+  ContainerHeader header;
+  bool valid = m_MappingSize >= sizeof(header);
+  if (valid) {
+    memcpy(&header, bytes, sizeof(header));
+    valid = header.magic == kContainerMagic &&
+            header.version == kContainerVersion &&
+            IsValidFormat(static_cast<Format>(header.format)) &&
+            header.lod_count > 0 && header.file_size <= m_MappingSize &&
+            header.lod_table_offset % 8 == 0 &&
+            header.brick_table_offset % 8 == 0 &&
+            header.lod_table_offset <= header.file_size &&
+            header.lod_count * sizeof(VolumeContainerLod) <=
+                header.file_size - header.lod_table_offset &&
+            header.brick_table_offset <= header.file_size &&
+            header.brick_count * sizeof(VolumeContainerBrick) <=
+                header.file_size - header.brick_table_offset;
+  }
+  if (valid) {
+    m_Lods = reinterpret_cast<const VolumeContainerLod*>(
+        bytes + header.lod_table_offset);
+    m_Bricks = reinterpret_cast<const VolumeContainerBrick*>(
+        bytes + header.brick_table_offset);
+    valid = ValidateContainer(header, m_Lods, m_Bricks, header.file_size);
+  }
+  if (!valid) {
+    Close();
+    return false;
+  }
+
+  m_Info.width = header.width;
+  m_Info.height = header.height;
+  m_Info.depth = header.depth;
+  m_Info.format = static_cast<Format>(header.format);
+  m_Info.brick_size = header.brick_size;
+  m_Info.lod_count = header.lod_count;
+  m_Info.brick_count = header.brick_count;
+  m_Info.alignment = header.alignment;
+  m_Info.file_size = header.file_size;
+  return true;
+}
+
+void VolumeContainerReader::Close() {
+  if (m_Mapping) {
+#if UNITY_WIN
+    UnmapViewOfFile(m_Mapping);
+#else
+    munmap(m_Mapping, m_MappingSize);
+#endif
+  }
+  m_Mapping = nullptr;
+  m_MappingSize = 0;
+  m_Info = VolumeContainerInfo{};
+  m_Lods = nullptr;
+  m_Bricks = nullptr;
+}
+
+const void* VolumeContainerReader::BrickData(uint32_t brick_index) const {
+  if (m_Mapping == nullptr || brick_index >= m_Info.brick_count)
+    return nullptr;
+  return static_cast<const uint8_t*>(m_Mapping) + m_Bricks[brick_index].offset;
+}
+
+bool VolumeContainerReader::DecodeBrick(uint32_t brick_index, void* dst,
+                                        size_t dst_size) const {
+  const void* data = BrickData(brick_index);
+  if (data == nullptr || dst == nullptr) return false;
+  const VolumeContainerBrick& brick = m_Bricks[brick_index];
+  if (dst_size < brick.raw_size) return false;
+
+  const size_t texel_size = FormatTexelSize(m_Info.format);
+  const size_t count = brick.raw_size / texel_size;
+  switch (brick.codec) {
+    case BRICK_CODEC_NONE:
+      memcpy(dst, data, brick.raw_size);
+      break;
+    case BRICK_CODEC_CONSTANT:
+      for (size_t i = 0; i < count; ++i)
+        memcpy(static_cast<uint8_t*>(dst) + i * texel_size, data, texel_size);
+      break;
+    case BRICK_CODEC_BITPACK:
+      DecodeBitpackedBrick(static_cast<const uint32_t*>(data), brick.bits,
+                           brick.min, count, m_Info.format, dst);
+      break;
+  }
+  return true;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "TextureSubPluginAPI.hpp"
+
+// On-disk container of a pre-bricked volume and its LODs. Layout (all values
+// little-endian):
+//   header (64 bytes)
+//   brick data. Uncompressed and bit packed bricks start at a multiple of the
+//   alignment (so they can be read directly), constant bricks at a multiple of
+//   16 bytes. Coarser LODs come first so that a coarse first frame reads a
+//   contiguous prefix of the file
+//   LOD table (VolumeContainerLod per LOD, LOD 0 is the full resolution)
+//   brick table (VolumeContainerBrick per brick, ordered by LOD, then x-fastest
+//   within the LOD)
+// The file is memory mapped by the reader, so uncompressed bricks can be
+// uploaded straight from the mapping (and the mapping registered as host
+// memory, see RegisterHostMemory)
+
+/// @brief How the data of a brick is stored
+enum BrickCodec {
+  BRICK_CODEC_NONE = 0,
+  // all voxels are equal - a single texel is stored
+  BRICK_CODEC_CONSTANT = 1,
+  // single channel UNORM formats: voxels are stored as (value - min) with
+  // bits bits each, packed back to back into little-endian 32-bit words (a
+  // value may straddle two words)
+  BRICK_CODEC_BITPACK = 2
+};
+
+struct VolumeContainerOptions {
+  // edge length of the (cubic) bricks in voxels (0 selects 64)
+  uint32_t brick_size;
+  // number of LODs to store (0 to halve the volume until it fits a brick)
+  uint32_t lod_count;
+  // non-zero to store constant bricks as a single texel and to bit pack
+  // bricks of R8_UINT/R16_UINT volumes if that makes them smaller
+  uint32_t compress;
+  uint32_t reserved;
+};
+
+struct VolumeContainerInfo {
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  Format format;
+  uint32_t brick_size;
+  uint32_t lod_count;
+  uint32_t brick_count;
+  // alignment of the brick data in the file in bytes
+  uint32_t alignment;
+  uint64_t file_size;
+};
+
+struct VolumeContainerLod {
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  uint32_t brick_count_x;
+  uint32_t brick_count_y;
+  uint32_t brick_count_z;
+  // index of the LOD's first brick in the brick table
+  uint32_t first_brick;
+  uint32_t reserved;
+};
+
+struct VolumeContainerBrick {
+  // file offset of the stored data
+  uint64_t offset;
+  uint32_t stored_size;
+  // size of the decoded brick (width * height * depth texels)
+  uint32_t raw_size;
+  // BrickCodec
+  uint32_t codec;
+  // bits per voxel of BRICK_CODEC_BITPACK
+  uint32_t bits;
+  uint32_t lod;
+  // origin and extent within the LOD in voxels (bricks at the border of a
+  // LOD are smaller)
+  uint32_t x;
+  uint32_t y;
+  uint32_t z;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  // min/max in the format's value range (R8_UINT and R16_UINT only, 0
+  // otherwise)
+  uint32_t min;
+  uint32_t max;
+};
+
+static_assert(sizeof(VolumeContainerLod) == 32, "unexpected LOD entry size");
+static_assert(sizeof(VolumeContainerBrick) == 64,
+              "unexpected brick entry size");
+
+/// @brief Bricks a volume (x-fastest, tightly packed in format), computes its
+/// LODs (2x box filter) and per-brick statistics and writes everything to path
+/// @return false if the volume is invalid or the file could not be written
+bool WriteVolumeContainer(const char* path, const void* data, uint32_t width,
+                          uint32_t height, uint32_t depth, Format format,
+                          const VolumeContainerOptions& options);
+
+/// @brief Number of bits per voxel that BRICK_CODEC_BITPACK needs for values
+/// in [min, max]
+uint32_t BitpackedBits(uint32_t min, uint32_t max);
+
+/// @brief Number of 32-bit words that count bit packed voxels occupy
+inline size_t BitpackedWordCount(size_t count, uint32_t bits) {
+  return (count * bits + 31) / 32;
+}
+
+/// @brief Encodes count texels of format (R8_UINT or R16_UINT, all within
+/// [min, min + 2^bits)) with BRICK_CODEC_BITPACK into
+/// BitpackedWordCount(count, bits) words
+void EncodeBitpackedBrick(const void* texels, size_t count, Format format,
+                          uint32_t min, uint32_t bits, uint32_t* words);
+
+/// @brief Decodes a brick stored with BRICK_CODEC_BITPACK into count texels of
+/// format (R8_UINT or R16_UINT)
+void DecodeBitpackedBrick(const uint32_t* words, uint32_t bits, uint32_t min,
+                          size_t count, Format format, void* dst);
+
+/// @brief Read-only view of a container file. The file is mapped copy on write
+/// so that the mapping can be imported as host memory
+class VolumeContainerReader {
+ public:
+  VolumeContainerReader() = default;
+  ~VolumeContainerReader();
+  VolumeContainerReader(const VolumeContainerReader&) = delete;
+  VolumeContainerReader& operator=(const VolumeContainerReader&) = delete;
+
+  /// @brief Maps and validates a container file
+  /// @return false if the file could not be mapped or is not a valid container
+  bool Open(const char* path);
+  void Close();
+
+  const VolumeContainerInfo& Info() const { return m_Info; }
+  const VolumeContainerLod* Lods() const { return m_Lods; }
+  const VolumeContainerBrick* Bricks() const { return m_Bricks; }
+
+  /// @brief Returns the stored data of a brick within the mapping (the voxels
+  /// of BRICK_CODEC_NONE bricks, a single texel for BRICK_CODEC_CONSTANT)
+  const void* BrickData(uint32_t brick_index) const;
+
+  /// @brief Decodes a brick into dst (which must hold raw_size bytes)
+  /// @return false if the index or the size is invalid
+  bool DecodeBrick(uint32_t brick_index, void* dst, size_t dst_size) const;
+
+  void* Mapping() const { return m_Mapping; }
+  size_t MappingSize() const { return m_MappingSize; }
+
+ private:
+  void* m_Mapping = nullptr;
+  size_t m_MappingSize = 0;
+  VolumeContainerInfo m_Info = {};
+  const VolumeContainerLod* m_Lods = nullptr;
+  const VolumeContainerBrick* m_Bricks = nullptr;
+};
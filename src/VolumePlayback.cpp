@@ -0,0 +1,293 @@
+#include "VolumePlayback.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "ConversionKernels.hpp"
+#include "Tracing.hpp"
+
+// Number of updates after which a retired front texture is written again.
+// Scripts read the playback state on the main thread, which runs up to a
+// frame ahead of the render thread, so a texture may still be bound for one
+// frame after it was swapped out
+static const uint64_t kRetiredUpdates = 2;
+
+// 64-bit hash of a brick's voxels (FNV-1a over 64-bit words, mixed so that
+// the high bits of a word affect the whole hash)
+static uint64_t HashBrick(const uint8_t* data, size_t size) {
+  uint64_t hash = 0xCBF29CE484222325ull;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 32;
+  }
+  for (; i < size; ++i) hash = (hash ^ data[i]) * 0x100000001B3ull;
+  return hash;
+}
+
+VolumePlayback::VolumePlayback(uint32_t playback_id, const PlaybackDesc& desc,
+                               PlaybackLoadCallback callback, void* user_data)
+    : m_Id(playback_id),
+      m_Desc(desc),
+      m_Callback(callback),
+      m_UserData(user_data) {
+  const size_t texel_size = FormatTexelSize(desc.format);
+  const uint32_t brick_size = desc.brick_size ? desc.brick_size : 64;
+  for (uint32_t z = 0; z < desc.depth; z += brick_size) {
+    for (uint32_t y = 0; y < desc.height; y += brick_size) {
+      for (uint32_t x = 0; x < desc.width; x += brick_size) {
+        Brick brick;
+        brick.x = x;
+        brick.y = y;
+        brick.z = z;
+        brick.width = std::min(brick_size, desc.width - x);
+        brick.height = std::min(brick_size, desc.height - y);
+        brick.depth = std::min(brick_size, desc.depth - z);
+        brick.offset = m_VolumeSize;
+        brick.size = texel_size * brick.width * brick.height * brick.depth;
+        m_VolumeSize += brick.size;
+        m_Bricks.push_back(brick);
+      }
+    }
+  }
+
+  m_Slots.resize(desc.prefetch_count ? desc.prefetch_count
+                                     : desc.buffer_count);
+  m_Buffers.resize(desc.buffer_count);
+  for (uint32_t i = 0; i < desc.buffer_count; ++i)
+    m_Buffers[i].texture_id = desc.texture_ids[i];
+
+  m_Thread = std::thread(&VolumePlayback::PrefetchLoop, this);
+}
+
+VolumePlayback::~VolumePlayback() {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stop = true;
+  }
+  m_Wakeup.notify_all();
+  m_Thread.join();
+}
+
+bool VolumePlayback::IsValidDesc(const PlaybackDesc& desc) {
+  if (desc.width == 0 || desc.height == 0 || desc.depth == 0 ||
+      !IsValidFormat(desc.format) || desc.timestep_count == 0 ||
+      desc.buffer_count < 2 || desc.buffer_count > 3)
+    return false;
+  for (uint32_t i = 0; i < desc.buffer_count; ++i)
+    for (uint32_t j = 0; j < i; ++j)
+      if (desc.texture_ids[i] == desc.texture_ids[j]) return false;
+  return true;
+}
+
+void VolumePlayback::Seek(uint32_t timestep) {
+  if (timestep >= m_Desc.timestep_count) return;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Requested == timestep) return;
+    m_Requested = timestep;
+    m_Failed = kPlaybackNoTimestep;
+  }
+  m_Wakeup.notify_one();
+}
+
+bool VolumePlayback::InWindow(uint32_t timestep) const {
+  if (m_Requested == kPlaybackNoTimestep) return false;
+  const uint32_t ahead = (timestep + m_Desc.timestep_count - m_Requested) %
+                         m_Desc.timestep_count;
+  return ahead < m_Slots.size();
+}
+
+void VolumePlayback::BrickTimestep(const uint8_t* volume, Slot* slot) const {
+  const size_t texel_size = FormatTexelSize(m_Desc.format);
+  slot->data.resize(m_VolumeSize);
+  slot->hashes.resize(m_Bricks.size());
+  slot->constant.resize(m_Bricks.size());
+  for (size_t i = 0; i < m_Bricks.size(); ++i) {
+    const Brick& brick = m_Bricks[i];
+    const size_t origin =
+        ((static_cast<size_t>(brick.z) * m_Desc.height + brick.y) *
+             m_Desc.width +
+         brick.x) *
+        texel_size;
+    uint8_t* const dst = slot->data.data() + brick.offset;
+    CopyStrided(volume + origin, texel_size, brick.width, brick.height,
+                brick.depth, m_Desc.width, m_Desc.height, dst);
+    slot->hashes[i] = HashBrick(dst, brick.size);
+    slot->constant[i] =
+        texel_size <= 4 &&
+        IsConstant(dst, brick.size / texel_size, texel_size);
+  }
+}
+
+void VolumePlayback::PrefetchLoop() {
+  std::vector<uint8_t> volume(m_VolumeSize);
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  while (!m_Stop) {
+    // timesteps that fell out of the prefetch window are dropped
+    for (Slot& slot : m_Slots)
+      if (slot.state == SLOT_READY && !InWindow(slot.timestep))
+        slot.state = SLOT_FREE;
+
+    // the first timestep of the window that is neither staged nor shown
+    uint32_t next = kPlaybackNoTimestep;
+    for (uint32_t k = 0; m_Requested != kPlaybackNoTimestep &&
+                         k < m_Slots.size() &&
+                         next == kPlaybackNoTimestep;
+         ++k) {
+      const uint32_t timestep = (m_Requested + k) % m_Desc.timestep_count;
+      bool present = timestep == m_Failed ||
+                     (m_Front >= 0 && m_Buffers[m_Front].timestep == timestep);
+      for (const Slot& slot : m_Slots)
+        present = present ||
+                  (slot.state != SLOT_FREE && slot.timestep == timestep);
+      if (!present) next = timestep;
+    }
+    Slot* slot = nullptr;
+    for (Slot& candidate : m_Slots)
+      if (!slot && candidate.state == SLOT_FREE) slot = &candidate;
+    if (next == kPlaybackNoTimestep || slot == nullptr) {
+      m_Wakeup.wait(lock);
+      continue;
+    }
+
+    // the slot's data is only accessed by this thread while it is loading
+    slot->state = SLOT_LOADING;
+    slot->timestep = next;
+    lock.unlock();
+    bool loaded;
+    {
+      TraceScope trace("playback", "LoadTimestep", "timestep", next);
+      loaded = m_Callback(m_Id, next, volume.data(), volume.size(), m_UserData);
+      if (loaded) BrickTimestep(volume.data(), slot);
+    }
+    lock.lock();
+    slot->state = loaded ? SLOT_READY : SLOT_FREE;
+    if (!loaded) m_Failed = next;
+  }
+}
+
+void VolumePlayback::Update(TextureSubPluginAPI* api) {
+  if (!m_TexturesCreated) {
+    for (const Buffer& buffer : m_Buffers)
+      api->CreateTexture3D(buffer.texture_id, m_Desc.width, m_Desc.height,
+                           m_Desc.depth, m_Desc.format);
+    m_TexturesCreated = true;
+  }
+
+  Slot* slot;
+  Buffer* buffer;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    ++m_UpdateCount;
+    m_UploadedBytes = 0;
+    if (m_UploadSlot < 0) {
+      if (m_Requested == kPlaybackNoTimestep ||
+          (m_Front >= 0 && m_Buffers[m_Front].timestep == m_Requested))
+        return;
+      for (size_t i = 0; i < m_Slots.size() && m_UploadSlot < 0; ++i)
+        if (m_Slots[i].state == SLOT_READY &&
+            m_Slots[i].timestep == m_Requested)
+          m_UploadSlot = static_cast<int>(i);
+      if (m_UploadSlot < 0) return;
+
+      // the back texture that was retired the longest time ago
+      m_UploadBuffer = -1;
+      for (size_t i = 0; i < m_Buffers.size(); ++i) {
+        const Buffer& candidate = m_Buffers[i];
+        if (static_cast<int>(i) == m_Front ||
+            (candidate.retired_update != 0 &&
+             m_UpdateCount < candidate.retired_update + kRetiredUpdates))
+          continue;
+        if (m_UploadBuffer < 0 ||
+            candidate.retired_update < m_Buffers[m_UploadBuffer].retired_update)
+          m_UploadBuffer = static_cast<int>(i);
+      }
+      if (m_UploadBuffer < 0) {
+        m_UploadSlot = -1;
+        return;
+      }
+      m_Slots[m_UploadSlot].state = SLOT_UPLOADING;
+      m_NextBrick = 0;
+    }
+    slot = &m_Slots[m_UploadSlot];
+    buffer = &m_Buffers[m_UploadBuffer];
+  }
+
+  // the uploading slot and the back texture's hashes are only accessed by
+  // the render thread
+  TraceScope trace("playback", "UploadTimestep", "timestep", slot->timestep);
+  const bool delta = (m_Desc.flags & PLAYBACK_FLAG_DELTA_BRICKS) &&
+                     buffer->hashes.size() == m_Bricks.size();
+  const size_t texel_size = FormatTexelSize(m_Desc.format);
+  uint64_t uploaded = 0;
+  uint64_t skipped = 0;
+  for (; m_NextBrick < m_Bricks.size(); ++m_NextBrick) {
+    const Brick& brick = m_Bricks[m_NextBrick];
+    if (delta && buffer->hashes[m_NextBrick] == slot->hashes[m_NextBrick]) {
+      ++skipped;
+      continue;
+    }
+    // constant bricks are filled on the GPU and cost no bandwidth
+    const bool constant = slot->constant[m_NextBrick] != 0;
+    const uint64_t size = constant ? texel_size : brick.size;
+    if (m_Desc.max_upload_bytes != 0 && uploaded > 0 &&
+        uploaded + size > m_Desc.max_upload_bytes)
+      break;
+    api->TextureSubImage3DByID(
+        buffer->texture_id, static_cast<int32_t>(brick.x),
+        static_cast<int32_t>(brick.y), static_cast<int32_t>(brick.z),
+        static_cast<int32_t>(brick.width), static_cast<int32_t>(brick.height),
+        static_cast<int32_t>(brick.depth), slot->data.data() + brick.offset, 0,
+        m_Desc.format, nullptr,
+        constant ? UPLOAD_FLAG_CONSTANT : UPLOAD_FLAG_NONE);
+    uploaded += size;
+  }
+
+  bool swapped = false;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_UploadedBytes = uploaded;
+    m_SkippedBricks += skipped;
+    if (m_NextBrick == m_Bricks.size()) {
+      buffer->hashes = slot->hashes;
+      buffer->timestep = slot->timestep;
+      if (m_Front >= 0) m_Buffers[m_Front].retired_update = m_UpdateCount;
+      m_Front = m_UploadBuffer;
+      ++m_SwapCount;
+      slot->state = SLOT_FREE;
+      slot->timestep = kPlaybackNoTimestep;
+      m_UploadSlot = -1;
+      m_UploadBuffer = -1;
+      swapped = true;
+    }
+  }
+  // the freed slot can take the next timestep
+  if (swapped) m_Wakeup.notify_one();
+}
+
+void VolumePlayback::DestroyTextures(TextureSubPluginAPI* api) {
+  if (!m_TexturesCreated) return;
+  for (const Buffer& buffer : m_Buffers)
+    api->DestroyTexture3D(buffer.texture_id);
+  m_TexturesCreated = false;
+}
+
+PlaybackState VolumePlayback::State() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  PlaybackState state{};
+  state.front_texture_id = m_Front >= 0 ? m_Buffers[m_Front].texture_id : 0;
+  state.front_timestep =
+      m_Front >= 0 ? m_Buffers[m_Front].timestep : kPlaybackNoTimestep;
+  state.swap_count = m_SwapCount;
+  state.uploading_timestep =
+      m_UploadSlot >= 0 ? m_Slots[m_UploadSlot].timestep : kPlaybackNoTimestep;
+  for (const Slot& slot : m_Slots)
+    state.prefetched_count += slot.state == SLOT_READY;
+  state.uploaded_bytes = m_UploadedBytes;
+  state.skipped_bricks = m_SkippedBricks;
+  return state;
+}
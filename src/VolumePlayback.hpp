@@ -0,0 +1,171 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TextureSubPluginAPI.hpp"
+
+/// @brief Fills dst (size bytes) with the voxels of a timestep (x-fastest,
+/// tightly packed, in the playback's format). Called on the playback's
+/// prefetch thread
+/// @return false if the timestep could not be loaded (it is not requested
+/// again until the playback seeks to a different timestep)
+typedef bool(UNITY_INTERFACE_API* PlaybackLoadCallback)(uint32_t playback_id,
+                                                        uint32_t timestep,
+                                                        void* dst,
+                                                        uint64_t size,
+                                                        void* user_data);
+
+/// @brief Timestep of PlaybackState members that refer to no timestep
+static const uint32_t kPlaybackNoTimestep = 0xFFFFFFFF;
+
+enum PlaybackFlags {
+  PLAYBACK_FLAG_NONE = 0,
+  // only upload the bricks that differ from the ones the back texture holds
+  // (compared by a 64-bit hash of their voxels)
+  PLAYBACK_FLAG_DELTA_BRICKS = 1 << 0
+};
+
+struct PlaybackDesc {
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  Format format;
+  uint32_t timestep_count;
+  // number of textures the timesteps are uploaded into (2 or 3)
+  uint32_t buffer_count;
+  // user assigned IDs of the textures (see CreateTexture3D). Only the first
+  // buffer_count are used
+  uint32_t texture_ids[3];
+  // edge length of the bricks that are uploaded (and compared) at once (0
+  // selects 64)
+  uint32_t brick_size;
+  // number of timesteps kept in staging memory ahead of the requested one (0
+  // selects buffer_count)
+  uint32_t prefetch_count;
+  // combination of PlaybackFlags
+  uint32_t flags;
+  // maximum number of bytes uploaded per UpdatePlayback event (0 for no
+  // limit). Timesteps larger than that are uploaded over several frames; the
+  // front texture is only swapped once a timestep is complete
+  uint64_t max_upload_bytes;
+};
+
+struct PlaybackState {
+  // texture that holds the last completely uploaded timestep (only valid if
+  // front_timestep is not kPlaybackNoTimestep)
+  uint32_t front_texture_id;
+  uint32_t front_timestep;
+  // incremented whenever the front texture changes
+  uint32_t swap_count;
+  // timestep that is being uploaded into a back texture
+  uint32_t uploading_timestep;
+  // number of timesteps that are waiting in staging memory
+  uint32_t prefetched_count;
+  uint32_t reserved;
+  // bytes uploaded by the last UpdatePlayback event
+  uint64_t uploaded_bytes;
+  // bricks that delta uploads skipped since the playback was created
+  uint64_t skipped_bricks;
+};
+
+/// @brief Plays back a time-varying volume through double or triple
+/// buffered 3D textures. A prefetch thread loads the timesteps following the
+/// requested one into staging memory (bricked, so each brick is uploaded
+/// with a single copy), the render thread uploads a timestep into a back
+/// texture and makes it the front texture once all of its bricks are
+/// uploaded, so a texture that is sampled never holds two timesteps
+class VolumePlayback {
+ public:
+  VolumePlayback(uint32_t playback_id, const PlaybackDesc& desc,
+                 PlaybackLoadCallback callback, void* user_data);
+  ~VolumePlayback();
+  VolumePlayback(const VolumePlayback&) = delete;
+  VolumePlayback& operator=(const VolumePlayback&) = delete;
+
+  /// @brief Checks the extent, format, buffer count and texture IDs
+  static bool IsValidDesc(const PlaybackDesc& desc);
+
+  /// @brief Requests the timestep that is shown next. Prefetching continues
+  /// from there (wrapping around at timestep_count). Any thread
+  void Seek(uint32_t timestep);
+
+  /// @brief Creates the textures on first use, uploads (part of) the
+  /// requested timestep into a back texture and swaps the front texture once
+  /// the timestep is complete. Render thread
+  void Update(TextureSubPluginAPI* api);
+
+  /// @brief Destroys the textures. Render thread
+  void DestroyTextures(TextureSubPluginAPI* api);
+
+  /// @brief Any thread
+  PlaybackState State() const;
+
+ private:
+  enum SlotState { SLOT_FREE, SLOT_LOADING, SLOT_READY, SLOT_UPLOADING };
+
+  // a timestep in staging memory
+  struct Slot {
+    SlotState state = SLOT_FREE;
+    uint32_t timestep = kPlaybackNoTimestep;
+    // the bricks' voxels, each brick tightly packed (see m_Bricks)
+    std::vector<uint8_t> data;
+    std::vector<uint64_t> hashes;
+    std::vector<uint8_t> constant;
+  };
+
+  struct Buffer {
+    uint32_t texture_id;
+    uint32_t timestep = kPlaybackNoTimestep;
+    // hashes of the bricks the texture holds (empty until it was written)
+    std::vector<uint64_t> hashes;
+    // update in which the texture stopped being the front texture (see
+    // kRetiredUpdates)
+    uint64_t retired_update = 0;
+  };
+
+  struct Brick {
+    uint32_t x, y, z;
+    uint32_t width, height, depth;
+    size_t offset;
+    size_t size;
+  };
+
+  void PrefetchLoop();
+  bool InWindow(uint32_t timestep) const;
+  void BrickTimestep(const uint8_t* volume, Slot* slot) const;
+
+  const uint32_t m_Id;
+  const PlaybackDesc m_Desc;
+  const PlaybackLoadCallback m_Callback;
+  void* const m_UserData;
+  std::vector<Brick> m_Bricks;
+  size_t m_VolumeSize = 0;
+
+  mutable std::mutex m_Mutex;
+  std::condition_variable m_Wakeup;
+  bool m_Stop = false;
+  uint32_t m_Requested = kPlaybackNoTimestep;
+  // timestep whose loading failed (not retried until the next seek)
+  uint32_t m_Failed = kPlaybackNoTimestep;
+  std::vector<Slot> m_Slots;
+
+  // render thread state (read by State under m_Mutex)
+  bool m_TexturesCreated = false;
+  std::vector<Buffer> m_Buffers;
+  uint64_t m_UpdateCount = 0;
+  int m_Front = -1;
+  int m_UploadSlot = -1;
+  int m_UploadBuffer = -1;
+  size_t m_NextBrick = 0;
+  uint32_t m_SwapCount = 0;
+  uint64_t m_UploadedBytes = 0;
+  uint64_t m_SkippedBricks = 0;
+
+  std::thread m_Thread;
+};
@@ -0,0 +1,97 @@
+#include <string.h>
+
+#include <vector>
+
+#include "TestMain.hpp"
+#include "VolumeContainer.hpp"
+
+// C++ transcription of src/shaders/DecodeBitpacked.comp - one call per
+// invocation (one output word) so that the word based indexing of the shader
+// is exercised as well
+static uint32_t Extract(const uint32_t* packed, uint32_t bits,
+                        uint32_t min_value, uint32_t index) {
+  uint32_t bit = (index & 31u) * bits;
+  uint32_t word = (index >> 5) * bits + (bit >> 5);
+  uint32_t shift = bit & 31u;
+  uint32_t value = packed[word] >> shift;
+  if (shift + bits > 32u) value |= packed[word + 1u] << (32u - shift);
+  uint32_t mask = bits >= 32u ? 0xFFFFFFFFu : (1u << bits) - 1u;
+  return (value & mask) + min_value;
+}
+
+static void ShaderDecode(const uint32_t* packed, uint32_t count, uint32_t bits,
+                         uint32_t min_value, uint32_t texel_size,
+                         uint32_t* decoded) {
+  const uint32_t texels_per_word = 4u / texel_size;
+  const uint32_t texel_bits = 8u * texel_size;
+  const uint32_t texel_mask = texel_size == 1u ? 0xFFu : 0xFFFFu;
+  const uint32_t words = (count + texels_per_word - 1) / texels_per_word;
+  for (uint32_t word = 0; word < words; ++word) {
+    const uint32_t first = word * texels_per_word;
+    uint32_t result = 0u;
+    for (uint32_t i = 0u; i < texels_per_word && first + i < count; ++i)
+      result |= (Extract(packed, bits, min_value, first + i) & texel_mask)
+                << (i * texel_bits);
+    decoded[word] = result;
+  }
+}
+
+// deterministic values in [min, min + 2^bits) that include both ends
+static uint32_t Value(uint32_t i, uint32_t bits, uint32_t min) {
+  const uint32_t range = 1u << bits;
+  if (i % 7 == 0) return min;
+  if (i % 7 == 1) return min + range - 1;
+  return min + (i * 2654435761u >> 7) % range;
+}
+
+static void CheckDecoders(Format format, uint32_t bits, uint32_t min,
+                          uint32_t count) {
+  const uint32_t texel_size = format == R8_UINT ? 1 : 2;
+  std::vector<uint8_t> texels(count * texel_size);
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint32_t value = Value(i, bits, min);
+    if (format == R8_UINT) {
+      texels[i] = static_cast<uint8_t>(value);
+    } else {
+      const uint16_t u16 = static_cast<uint16_t>(value);
+      memcpy(&texels[2 * i], &u16, sizeof(u16));
+    }
+  }
+
+  std::vector<uint32_t> words(BitpackedWordCount(count, bits));
+  EncodeBitpackedBrick(texels.data(), count, format, min, bits, words.data());
+
+  // the CPU decoder writes count texels, the shader whole words
+  const size_t decoded_words = (count * texel_size + 3) / 4;
+  std::vector<uint32_t> cpu(decoded_words, 0u);
+  std::vector<uint32_t> gpu(decoded_words, 0u);
+  DecodeBitpackedBrick(words.data(), bits, min, count, format, cpu.data());
+  ShaderDecode(words.data(), count, bits, min, texel_size, gpu.data());
+
+  CHECK(memcmp(cpu.data(), texels.data(), texels.size()) == 0);
+  CHECK(memcmp(cpu.data(), gpu.data(), decoded_words * 4) == 0);
+}
+
+TEST(BitpackedR8MatchesShader) {
+  // counts that are not a multiple of the 4 texels per output word
+  for (uint32_t bits = 1; bits <= 8; ++bits)
+    for (uint32_t count : {1u, 3u, 33u, 4095u, 4096u})
+      CheckDecoders(R8_UINT, bits, bits == 8 ? 0 : 17, count);
+}
+
+TEST(BitpackedR16MatchesShader) {
+  // counts that are not a multiple of the 2 texels per output word
+  for (uint32_t bits = 1; bits <= 16; ++bits)
+    for (uint32_t count : {1u, 3u, 33u, 4095u, 4096u})
+      CheckDecoders(R16_UINT, bits, bits == 16 ? 0 : 1000, count);
+}
+
+TEST(BitpackedWordCountRoundsUp) {
+  CHECK(BitpackedWordCount(0, 5) == 0);
+  CHECK(BitpackedWordCount(1, 1) == 1);
+  CHECK(BitpackedWordCount(32, 1) == 1);
+  CHECK(BitpackedWordCount(33, 1) == 2);
+  CHECK(BitpackedWordCount(3, 11) == 2);
+}
+
+int main() { return RunTests(); }
@@ -0,0 +1,275 @@
+#include <stddef.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "CommandStream.hpp"
+#include "TestMain.hpp"
+
+// records the calls RunCommandStream makes
+class RecordingAPI : public TextureSubPluginAPI {
+ public:
+  std::vector<std::string> calls;
+  std::vector<TextureUploadRegion> regions;
+  std::vector<BufferWriteRange> ranges;
+
+  void CreateTexture3D(uint32_t texture_id, uint32_t, uint32_t, uint32_t,
+                       Format) override {
+    calls.push_back("CreateTexture3D " + std::to_string(texture_id));
+  }
+  void* RetrieveCreatedTexture3D(uint32_t) override { return nullptr; }
+  void DestroyTexture3D(uint32_t texture_id) override {
+    calls.push_back("DestroyTexture3D " + std::to_string(texture_id));
+  }
+  void TextureSubImage2D(void*, int32_t, int32_t, int32_t, int32_t, void*,
+                         int32_t, Format) override {}
+  void TextureSubImage3D(void*, int32_t, int32_t, int32_t, int32_t, int32_t,
+                         int32_t, void*, int32_t, Format) override {}
+  void TextureSubImage3DBatch(uint32_t texture_id,
+                              const TextureUploadRegion* batch, uint32_t count,
+                              Format) override {
+    calls.push_back("TextureSubImage3DBatch " + std::to_string(texture_id) +
+                    " x" + std::to_string(count));
+    regions.insert(regions.end(), batch, batch + count);
+  }
+  void CreateBuffer(uint32_t buffer_id, uint64_t) override {
+    calls.push_back("CreateBuffer " + std::to_string(buffer_id));
+  }
+  void BufferSubDataBatch(uint32_t buffer_id, const BufferWriteRange* batch,
+                          uint32_t count) override {
+    calls.push_back("BufferSubDataBatch " + std::to_string(buffer_id) + " x" +
+                    std::to_string(count));
+    ranges.insert(ranges.end(), batch, batch + count);
+  }
+  void ProcessDeviceEvent(UnityGfxDeviceEventType,
+                          IUnityInterfaces*) override {}
+};
+
+// writes an (8 byte aligned) stream the way CommandStreamBuilder does
+class StreamWriter {
+ public:
+  StreamWriter() {
+    CommandStreamHeader header = {};
+    header.magic = kCommandStreamMagic;
+    header.version = kCommandStreamVersion;
+    Append(&header, sizeof(header));
+  }
+
+  // appends a command and its inline data and fixes up its header size
+  template <typename Command>
+  void Add(Command command, uint16_t type, const void* data = nullptr,
+           size_t data_size = 0) {
+    command.header.type = type;
+    command.header.size = static_cast<uint32_t>(
+        (sizeof(command) + data_size + 7) / 8 * 8);
+    const size_t size = command.header.size;
+    Append(&command, sizeof(command));
+    Append(data, data_size);
+    m_Bytes.resize(m_Bytes.size() + (size - sizeof(command) - data_size));
+    ++m_CommandCount;
+  }
+
+  // the stream in 8 byte aligned storage
+  const void* Data() {
+    CommandStreamHeader header;
+    memcpy(&header, m_Bytes.data(), sizeof(header));
+    header.command_count = m_CommandCount;
+    memcpy(m_Bytes.data(), &header, sizeof(header));
+    m_Aligned.assign((m_Bytes.size() + 7) / 8, 0);
+    memcpy(m_Aligned.data(), m_Bytes.data(), m_Bytes.size());
+    return m_Aligned.data();
+  }
+  uint64_t Size() const { return m_Bytes.size(); }
+
+  std::vector<uint8_t>& Bytes() { return m_Bytes; }
+  void SetCommandCount(uint32_t count) { m_CommandCount = count; }
+
+ private:
+  void Append(const void* data, size_t size) {
+    if (size == 0) return;
+    const size_t offset = m_Bytes.size();
+    m_Bytes.resize(offset + size);
+    memcpy(m_Bytes.data() + offset, data, size);
+  }
+
+  std::vector<uint8_t> m_Bytes;
+  std::vector<uint64_t> m_Aligned;
+  uint32_t m_CommandCount = 0;
+};
+
+static TextureSubImage3DCommand SubImage(uint32_t texture_id, int32_t width) {
+  TextureSubImage3DCommand command = {};
+  command.texture_id = texture_id;
+  command.width = width;
+  command.height = 1;
+  command.depth = 1;
+  command.format = R8_UINT;
+  return command;
+}
+
+static CreateTexture3DCommand Create(uint32_t texture_id, uint32_t width) {
+  CreateTexture3DCommand command = {};
+  command.texture_id = texture_id;
+  command.width = width;
+  command.height = 1;
+  command.depth = 1;
+  command.format = R8_UINT;
+  return command;
+}
+
+static BufferSubDataCommand SubData(uint32_t buffer_id, uint64_t size) {
+  BufferSubDataCommand command = {};
+  command.buffer_id = buffer_id;
+  command.size = size;
+  return command;
+}
+
+TEST(GroupsUploadsAndWrites) {
+  const uint8_t texels[5] = {1, 2, 3, 4, 5};
+  StreamWriter stream;
+  stream.Add(Create(3, 5), COMMAND_CREATE_TEXTURE_3D);
+  stream.Add(SubImage(3, 5), COMMAND_TEXTURE_SUB_IMAGE_3D, texels, 5);
+  stream.Add(SubData(9, 3), COMMAND_BUFFER_SUB_DATA, texels, 3);
+  stream.Add(SubImage(3, 2), COMMAND_TEXTURE_SUB_IMAGE_3D, texels, 2);
+
+  RecordingAPI api;
+  CHECK(RunCommandStream(&api, stream.Data(), stream.Size()) == 4);
+  const std::vector<std::string> expected = {"CreateTexture3D 3",
+                                             "TextureSubImage3DBatch 3 x2",
+                                             "BufferSubDataBatch 9 x1"};
+  CHECK(api.calls == expected);
+  // inline data is referenced within the stream
+  CHECK(api.regions.size() == 2 && api.regions[0].width == 5 &&
+        memcmp(api.regions[0].data_ptr, texels, 5) == 0);
+  CHECK(api.ranges.size() == 1 && api.ranges[0].size == 3 &&
+        memcmp(api.ranges[0].data_ptr, texels, 3) == 0);
+}
+
+TEST(SkipsUnknownCommandTypes) {
+  StreamWriter stream;
+  DestroyTexture3DCommand destroy = {};
+  destroy.texture_id = 4;
+  // 0 and types past the last known one are unknown opcodes
+  stream.Add(destroy, 0);
+  stream.Add(destroy, COMMAND_DESTROY_TEXTURE_3D);
+  stream.Add(destroy, 0xFFFF);
+
+  RecordingAPI api;
+  CHECK(RunCommandStream(&api, stream.Data(), stream.Size()) == 1);
+  CHECK(api.calls == std::vector<std::string>{"DestroyTexture3D 4"});
+}
+
+TEST(RejectsInvalidHeaders) {
+  RecordingAPI api;
+  StreamWriter empty;
+  CHECK(RunCommandStream(&api, nullptr, 16) == 0);
+  CHECK(RunCommandStream(&api, empty.Data(), empty.Size() - 1) == 0);
+
+  StreamWriter magic;
+  magic.Bytes()[0] ^= 1;
+  CHECK(RunCommandStream(&api, magic.Data(), magic.Size()) == 0);
+
+  // more commands than fit into the stream
+  StreamWriter count;
+  count.SetCommandCount(1);
+  CHECK(RunCommandStream(&api, count.Data(), count.Size()) == 0);
+  CHECK(api.calls.empty());
+}
+
+TEST(RejectsLengthOverruns) {
+  const uint8_t texels[8] = {};
+  // offset of the first command's size within the stream
+  const size_t size_offset =
+      sizeof(CommandStreamHeader) + offsetof(CommandHeader, size);
+
+  // a valid create precedes the broken command, so a stream that is not
+  // rejected as a whole shows up as a CreateBuffer call
+  auto make = [&](uint32_t command_size) {
+    StreamWriter stream;
+    stream.Add(CreateBufferCommand(), COMMAND_CREATE_BUFFER);
+    stream.Add(SubData(1, 8), COMMAND_BUFFER_SUB_DATA, texels, 8);
+    memcpy(&stream.Bytes()[size_offset + sizeof(CreateBufferCommand)],
+           &command_size, sizeof(command_size));
+    return stream;
+  };
+
+  RecordingAPI api;
+  // past the end of the stream, not a multiple of 8, smaller than the
+  // command header and smaller than the command itself
+  for (uint32_t size : {56u, 64u, 0xFFFFFFF8u, 44u, 4u, 0u, 32u}) {
+    StreamWriter stream = make(size);
+    CHECK(RunCommandStream(&api, stream.Data(), stream.Size()) == 0);
+  }
+  // the size is valid, the stream is cut off
+  StreamWriter truncated = make(48);
+  CHECK(RunCommandStream(&api, truncated.Data(), truncated.Size() - 8) == 0);
+  CHECK(api.calls.empty());
+
+  // inline data that is larger than the command
+  StreamWriter sub_data;
+  sub_data.Add(SubData(1, 9), COMMAND_BUFFER_SUB_DATA, texels, 8);
+  CHECK(RunCommandStream(&api, sub_data.Data(), sub_data.Size()) == 0);
+  StreamWriter sub_image;
+  sub_image.Add(SubImage(1, 9), COMMAND_TEXTURE_SUB_IMAGE_3D, texels, 8);
+  CHECK(RunCommandStream(&api, sub_image.Data(), sub_image.Size()) == 0);
+  // width * height * depth overflows
+  TextureSubImage3DCommand huge = SubImage(1, 0x7FFFFFFF);
+  huge.height = 0x7FFFFFFF;
+  huge.depth = 0x7FFFFFFF;
+  StreamWriter overflow;
+  overflow.Add(huge, COMMAND_TEXTURE_SUB_IMAGE_3D, texels, 8);
+  CHECK(RunCommandStream(&api, overflow.Data(), overflow.Size()) == 0);
+  CHECK(api.calls.empty());
+
+  // the same stream with the correct size is executed
+  StreamWriter valid = make(48);
+  CHECK(RunCommandStream(&api, valid.Data(), valid.Size()) == 2);
+}
+
+TEST(RejectsRegionsOutsideTheTexture) {
+  const uint8_t texels[8] = {};
+  RecordingAPI api;
+  auto run = [&](TextureSubImage3DCommand upload) {
+    StreamWriter stream;
+    stream.Add(Create(1, 8), COMMAND_CREATE_TEXTURE_3D);
+    stream.Add(upload, COMMAND_TEXTURE_SUB_IMAGE_3D, texels, 8);
+    return RunCommandStream(&api, stream.Data(), stream.Size());
+  };
+
+  TextureSubImage3DCommand negative = SubImage(1, 4);
+  negative.xoffset = -1;
+  CHECK(run(negative) == 0);
+  negative = SubImage(1, 1);
+  negative.zoffset = -1;
+  CHECK(run(negative) == 0);
+  TextureSubImage3DCommand beyond = SubImage(1, 4);
+  beyond.xoffset = 5;
+  CHECK(run(beyond) == 0);
+  beyond = SubImage(1, 1);
+  beyond.yoffset = 1;
+  CHECK(run(beyond) == 0);
+  // offset + width overflows int32_t
+  beyond = SubImage(1, 8);
+  beyond.xoffset = 0x7FFFFFFF;
+  CHECK(run(beyond) == 0);
+  CHECK(api.calls.empty());
+
+  // a region that ends at the texture's border is valid
+  TextureSubImage3DCommand border = SubImage(1, 4);
+  border.xoffset = 4;
+  CHECK(run(border) == 2);
+
+  // the extent of a destroyed texture is unknown, its uploads are left to the
+  // backend
+  api.calls.clear();
+  StreamWriter stream;
+  DestroyTexture3DCommand destroy = {};
+  destroy.texture_id = 1;
+  stream.Add(Create(1, 2), COMMAND_CREATE_TEXTURE_3D);
+  stream.Add(destroy, COMMAND_DESTROY_TEXTURE_3D);
+  stream.Add(SubImage(1, 4), COMMAND_TEXTURE_SUB_IMAGE_3D, texels, 4);
+  CHECK(RunCommandStream(&api, stream.Data(), stream.Size()) == 3);
+}
+
+int main() { return RunTests(); }
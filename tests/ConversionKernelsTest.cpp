@@ -0,0 +1,275 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <limits>
+#include <vector>
+
+#include "ConversionKernels.hpp"
+#include "TestMain.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define TEST_F16C 1
+#include <immintrin.h>
+#endif
+
+static float FloatFromBits(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static bool IsHalfNaN(uint16_t half) {
+  return (half & 0x7C00) == 0x7C00 && (half & 0x3FF) != 0;
+}
+
+// FloatToHalf keeps the sign of NaNs and quiets them, but does not keep their
+// payload, so NaNs only have to agree on that
+static bool SameHalf(uint16_t a, uint16_t b) {
+  if (IsHalfNaN(a) || IsHalfNaN(b))
+    return IsHalfNaN(a) && IsHalfNaN(b) && (a & 0x8000) == (b & 0x8000) &&
+           (a & 0x200) != 0;
+  return a == b;
+}
+
+TEST(FloatToHalfEdgeCases) {
+  struct Case {
+    float value;
+    uint16_t half;
+  };
+  const Case cases[] = {
+      {0.0f, 0x0000},
+      {-0.0f, 0x8000},
+      {1.0f, 0x3C00},
+      {-2.0f, 0xC000},
+      {65504.0f, 0x7BFF},
+      // halfway between 65504 and 65536 rounds to even, i.e., infinity
+      {65520.0f, 0x7C00},
+      {65519.99f, 0x7BFF},
+      {1e6f, 0x7C00},
+      // ties round to even: 1 + 2^-11 is halfway between 1 and 1 + 2^-10
+      {1.0f + 1.0f / 2048.0f, 0x3C00},
+      {1.0f + 3.0f / 2048.0f, 0x3C02},
+      // smallest normal and the largest subnormal
+      {6.103515625e-05f, 0x0400},
+      {6.097555160522461e-05f, 0x03FF},
+      // smallest subnormal, half of it (ties to even: 0) and just above half
+      {5.960464477539063e-08f, 0x0001},
+      {2.9802322387695312e-08f, 0x0000},
+      {2.9802326e-08f, 0x0001},
+      // 1.5 * 2^-24 rounds up to 2 * 2^-24
+      {8.940696716308594e-08f, 0x0002},
+      // a subnormal rounding up into the smallest normal
+      {6.1e-05f, 0x03FF},
+      {6.1035e-05f, 0x0400},
+      // float subnormals underflow to zero
+      {FloatFromBits(0x00000001), 0x0000},
+      {FloatFromBits(0x80400000), 0x8000},
+      {std::numeric_limits<float>::infinity(), 0x7C00},
+      {-std::numeric_limits<float>::infinity(), 0xFC00},
+  };
+  for (const Case& c : cases) CHECK(FloatToHalf(c.value) == c.half);
+
+  const uint16_t nan = FloatToHalf(std::numeric_limits<float>::quiet_NaN());
+  CHECK(IsHalfNaN(nan) && (nan & 0x8000) == 0);
+  // signaling NaNs become quiet, the sign is kept
+  const uint16_t snan = FloatToHalf(FloatFromBits(0xFF800001));
+  CHECK(IsHalfNaN(snan) && (snan & 0x8000) != 0 && (snan & 0x200) != 0);
+}
+
+TEST(HalfRoundTrip) {
+  // every half that is not a NaN converts to a float and back unchanged
+  for (uint32_t half = 0; half <= 0xFFFF; ++half) {
+    if (IsHalfNaN(static_cast<uint16_t>(half))) {
+      CHECK(isnan(HalfToFloat(static_cast<uint16_t>(half))));
+      continue;
+    }
+    CHECK(FloatToHalf(HalfToFloat(static_cast<uint16_t>(half))) == half);
+  }
+}
+
+#if TEST_F16C
+__attribute__((target("f16c"))) static uint16_t FloatToHalfF16C(float value) {
+  const __m128i half =
+      _mm_cvtps_ph(_mm_set_ss(value), _MM_FROUND_TO_NEAREST_INT);
+  return static_cast<uint16_t>(_mm_extract_epi16(half, 0));
+}
+
+TEST(FloatToHalfMatchesF16C) {
+  if (!__builtin_cpu_supports("f16c")) {
+    printf("F16C is not supported, skipping the comparison\n");
+    return;
+  }
+  // all combinations of the upper 20 bits with a few patterns of the lower 12
+  // cover every exponent and half mantissa, and values below, at and above
+  // halfway between two halves (with even and odd lower neighbours)
+  const uint32_t low_bits[] = {0x000, 0x001, 0x7FF, 0x800, 0x801, 0xFFF};
+  uint32_t mismatches = 0;
+  for (uint32_t high = 0; high < (1u << 20); ++high) {
+    for (uint32_t low : low_bits) {
+      const uint32_t bits = (high << 12) | low;
+      const float value = FloatFromBits(bits);
+      if (!SameHalf(FloatToHalf(value), FloatToHalfF16C(value))) ++mismatches;
+    }
+  }
+  CHECK(mismatches == 0);
+}
+#endif  // #if TEST_F16C
+
+// element counts around the SIMD block sizes (8 to 32 texels), so that both
+// the SIMD kernels and the scalar tails run
+static const size_t kCounts[] = {0, 1, 7, 15, 16, 17, 31, 32, 33, 63, 100, 259};
+
+// byte offsets that leave the data misaligned for the SIMD loads and stores
+static const size_t kOffsets[] = {0, 1, 3};
+
+static float TestValue(size_t i) {
+  // includes values outside of the window and NaNs
+  if (i % 23 == 5) return std::numeric_limits<float>::quiet_NaN();
+  return static_cast<float>(i * 7919 % 1000) * 0.37f - 50.0f;
+}
+
+// the kernels write their output through unaligned pointers into a buffer
+// that is bigger than needed, so that writes past the end can be detected
+static uint8_t* Misaligned(std::vector<uint8_t>* buffer, size_t offset,
+                           size_t size) {
+  buffer->assign(offset + size + 64, 0xCD);
+  return buffer->data() + offset;
+}
+
+static bool Untouched(const std::vector<uint8_t>& buffer, size_t end) {
+  for (size_t i = end; i < buffer.size(); ++i)
+    if (buffer[i] != 0xCD) return false;
+  return true;
+}
+
+TEST(ConvertFloatToUnormMatchesScalar) {
+  std::vector<uint8_t> src_buffer, dst_buffer;
+  for (size_t offset : kOffsets) {
+    for (size_t count : kCounts) {
+      float* src = reinterpret_cast<float*>(
+          Misaligned(&src_buffer, offset, count * sizeof(float)));
+      for (size_t i = 0; i < count; ++i) {
+        const float value = TestValue(i);
+        memcpy(src + i, &value, sizeof(value));
+      }
+
+      // a single voxel is always converted by the scalar kernel
+      uint8_t* dst8 = Misaligned(&dst_buffer, offset, count);
+      ConvertFloatToUnorm8(src, count, -20.0f, 300.0f, dst8);
+      for (size_t i = 0; i < count; ++i) {
+        uint8_t expected;
+        ConvertFloatToUnorm8(src + i, 1, -20.0f, 300.0f, &expected);
+        CHECK(dst8[i] == expected);
+      }
+      CHECK(Untouched(dst_buffer, offset + count));
+
+      uint8_t* dst16 = Misaligned(&dst_buffer, offset, count * 2);
+      ConvertFloatToUnorm16(src, count, -20.0f, 300.0f,
+                            reinterpret_cast<uint16_t*>(dst16));
+      for (size_t i = 0; i < count; ++i) {
+        uint16_t expected, actual;
+        ConvertFloatToUnorm16(src + i, 1, -20.0f, 300.0f, &expected);
+        memcpy(&actual, dst16 + i * 2, sizeof(actual));
+        CHECK(actual == expected);
+      }
+      CHECK(Untouched(dst_buffer, offset + count * 2));
+
+      uint8_t* halves = Misaligned(&dst_buffer, offset, count * 2);
+      ConvertFloatToHalf(src, count, reinterpret_cast<uint16_t*>(halves));
+      for (size_t i = 0; i < count; ++i) {
+        uint16_t actual;
+        memcpy(&actual, halves + i * 2, sizeof(actual));
+        CHECK(SameHalf(actual, FloatToHalf(TestValue(i))));
+      }
+      CHECK(Untouched(dst_buffer, offset + count * 2));
+    }
+  }
+}
+
+TEST(Unpack12MatchesScalar) {
+  std::vector<uint8_t> src_buffer, dst_buffer;
+  for (size_t offset : kOffsets) {
+    for (size_t count : kCounts) {
+      // packed sources hold pairs of values, an odd count leaves half a
+      // triplet unused
+      const size_t src_size = (count + 1) / 2 * 3;
+      uint8_t* src = Misaligned(&src_buffer, offset, src_size);
+      for (size_t i = 0; i < src_size; ++i)
+        src[i] = static_cast<uint8_t>(i * 151 + 17);
+
+      for (bool to_8bit : {false, true}) {
+        const size_t texel_size = to_8bit ? 1 : 2;
+        uint8_t* dst = Misaligned(&dst_buffer, offset, count * texel_size);
+        Unpack12(src, count, to_8bit, dst);
+        for (size_t i = 0; i < count; ++i) {
+          const uint8_t* p = src + i / 2 * 3;
+          const uint16_t value = i % 2 ? (p[1] >> 4) | (p[2] << 4)
+                                       : p[0] | ((p[1] & 0x0F) << 8);
+          if (to_8bit) {
+            CHECK(dst[i] == value >> 4);
+          } else {
+            uint16_t actual;
+            memcpy(&actual, dst + i * 2, sizeof(actual));
+            CHECK(actual == value);
+          }
+        }
+        CHECK(Untouched(dst_buffer, offset + count * texel_size));
+      }
+    }
+  }
+}
+
+TEST(ByteSwap16MatchesScalar) {
+  std::vector<uint8_t> src_buffer, dst_buffer;
+  for (size_t offset : kOffsets) {
+    for (size_t count : kCounts) {
+      uint8_t* src = Misaligned(&src_buffer, offset, count * 2);
+      for (size_t i = 0; i < count * 2; ++i)
+        src[i] = static_cast<uint8_t>(i * 37 + 5);
+      uint8_t* dst = Misaligned(&dst_buffer, offset, count * 2);
+      ByteSwap16(reinterpret_cast<const uint16_t*>(src), count,
+                 reinterpret_cast<uint16_t*>(dst));
+      for (size_t i = 0; i < count; ++i)
+        CHECK(dst[i * 2] == src[i * 2 + 1] && dst[i * 2 + 1] == src[i * 2]);
+      CHECK(Untouched(dst_buffer, offset + count * 2));
+    }
+  }
+}
+
+TEST(InterleaveChannelsMatchesScalar) {
+  std::vector<uint8_t> channel_buffers[4], dst_buffer;
+  for (size_t channel_count : {2, 3, 4}) {
+    for (size_t channel_size : {1, 2}) {
+      for (size_t offset : kOffsets) {
+        for (size_t count : kCounts) {
+          const void* channels[4];
+          for (size_t c = 0; c < channel_count; ++c) {
+            // every channel is misaligned differently
+            uint8_t* channel = Misaligned(&channel_buffers[c], offset + c,
+                                          count * channel_size);
+            for (size_t i = 0; i < count * channel_size; ++i)
+              channel[i] = static_cast<uint8_t>(i * 31 + c * 101);
+            channels[c] = channel;
+          }
+          const size_t texel_size = channel_count * channel_size;
+          uint8_t* dst = Misaligned(&dst_buffer, offset, count * texel_size);
+          InterleaveChannels(channels, channel_count, channel_size, count,
+                             dst);
+          bool equal = true;
+          for (size_t i = 0; i < count; ++i)
+            for (size_t c = 0; c < channel_count; ++c)
+              equal &= memcmp(dst + i * texel_size + c * channel_size,
+                              static_cast<const uint8_t*>(channels[c]) +
+                                  i * channel_size,
+                              channel_size) == 0;
+          CHECK(equal);
+          CHECK(Untouched(dst_buffer, offset + count * texel_size));
+        }
+      }
+    }
+  }
+}
+
+int main() { return RunTests(); }
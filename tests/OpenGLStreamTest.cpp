@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+
+#include "TestMain.hpp"
+#include "TextureSubPluginAPI.hpp"
+
+// Smoke test of the OpenGL backend's stream buffer (the persistently mapped
+// PBO ring) on a surfaceless EGL context, e.g., Mesa's llvmpipe. Exits with
+// kSkipped if no OpenGL 4.4 context can be created
+
+static const int kSkipped = 77;
+
+extern TextureSubPluginAPI* CreateTextureSubPluginAPI_OpenGLCoreES(
+    UnityGfxRenderer apiType);
+
+static TextureSubPluginAPI* s_API = nullptr;
+
+static bool CreateContext() {
+  // the surfaceless platform needs neither a window system nor a GPU
+  EGLDisplay display = EGL_NO_DISPLAY;
+  auto get_platform_display =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+          eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  if (get_platform_display)
+    display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                   EGL_DEFAULT_DISPLAY, nullptr);
+  if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+    return false;
+  const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+  if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context") ||
+      !strstr(extensions, "EGL_KHR_no_config_context") ||
+      !eglBindAPI(EGL_OPENGL_API))
+    return false;
+  const EGLint attributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+                               4,
+                               EGL_CONTEXT_MINOR_VERSION,
+                               4,
+                               EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                               EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                               EGL_NONE};
+  EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR,
+                                        EGL_NO_CONTEXT, attributes);
+  return context != EGL_NO_CONTEXT &&
+         eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+}
+
+static std::vector<uint8_t> ReadTexture(uint32_t texture_id, size_t size,
+                                        GLenum format, GLenum type) {
+  std::vector<uint8_t> texels(size);
+  glFinish();
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glBindTexture(GL_TEXTURE_3D, static_cast<GLuint>(reinterpret_cast<size_t>(
+                                   s_API->RetrieveCreatedTexture3D(
+                                       texture_id))));
+  glGetTexImage(GL_TEXTURE_3D, 0, format, type, texels.data());
+  return texels;
+}
+
+TEST(UploadsWrapAroundTheRing) {
+  // four passes of 2 MB slabs over a 32 MB texture stream 128 MB through the
+  // 64 MB ring, so regions are reused while earlier uploads may still be in
+  // flight. Each pass overwrites the previous one
+  const int32_t size = 256;
+  const int32_t slab = 16;
+  s_API->CreateTexture3D(1, size, size, size, R16_UINT);
+  const size_t slice = static_cast<size_t>(size) * size;
+  std::vector<uint16_t> expected(slice * size);
+  std::vector<uint16_t> data(slice * slab);
+  for (int pass = 0; pass < 4; ++pass) {
+    for (int32_t z = 0; z < size; z += slab) {
+      for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint16_t>(pass * 10007 + z * 131 + i);
+        expected[z * slice + i] = data[i];
+      }
+      s_API->TextureSubImage3D(s_API->RetrieveCreatedTexture3D(1), 0, 0, z,
+                               size, size, slab, data.data(), 0, R16_UINT);
+    }
+  }
+  const std::vector<uint8_t> texels =
+      ReadTexture(1, expected.size() * sizeof(uint16_t), GL_RED,
+                  GL_UNSIGNED_SHORT);
+  CHECK(memcmp(texels.data(), expected.data(), texels.size()) == 0);
+  CHECK(glGetError() == GL_NO_ERROR);
+  s_API->DestroyTexture3D(1);
+}
+
+TEST(LargeUploadsBypassTheRing) {
+  // larger than the ring, read from client memory
+  const int32_t size = 416;
+  s_API->CreateTexture3D(2, size, size, size, R8_UINT);
+  std::vector<uint8_t> data(static_cast<size_t>(size) * size * size);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<uint8_t>(i * 7);
+  s_API->TextureSubImage3D(s_API->RetrieveCreatedTexture3D(2), 0, 0, 0, size,
+                           size, size, data.data(), 0, R8_UINT);
+  const std::vector<uint8_t> texels =
+      ReadTexture(2, data.size(), GL_RED, GL_UNSIGNED_BYTE);
+  CHECK(texels == data);
+  s_API->DestroyTexture3D(2);
+}
+
+TEST(ConvertsIntoTheRing) {
+  // converted while copying into the ring: float32 to R8 through the window
+  s_API->CreateTexture3D(3, 7, 5, 3, R8_UINT);
+  std::vector<float> data(7 * 5 * 3);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<float>(i % 2);
+  SourceDescriptor source = {};
+  source.encoding = SOURCE_ENCODING_FLOAT32;
+  source.window_center = 0.5f;
+  source.window_width = 1.0f;
+  s_API->TextureSubImage3DFromSource(s_API->RetrieveCreatedTexture3D(3), 0, 0,
+                                     0, 7, 5, 3, data.data(), 0, R8_UINT,
+                                     source);
+  const std::vector<uint8_t> texels =
+      ReadTexture(3, data.size(), GL_RED, GL_UNSIGNED_BYTE);
+  bool equal = true;
+  for (size_t i = 0; i < data.size(); ++i)
+    equal &= texels[i] == (i % 2 ? 255 : 0);
+  CHECK(equal);
+  s_API->DestroyTexture3D(3);
+}
+
+TEST(RestoresUnpackState) {
+  // the unpack state belongs to Unity
+  GLuint buffer;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 8);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 3);
+
+  s_API->CreateTexture3D(4, 4, 4, 4, R8_UINT);
+  const uint8_t data[64] = {};
+  s_API->TextureSubImage3D(s_API->RetrieveCreatedTexture3D(4), 0, 0, 0, 4, 4,
+                           4, const_cast<uint8_t*>(data), 0, R8_UINT);
+  GLint alignment, row_length, binding;
+  glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+  glGetIntegerv(GL_UNPACK_ROW_LENGTH, &row_length);
+  glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &binding);
+  CHECK(alignment == 8 && row_length == 3);
+  CHECK(binding == static_cast<GLint>(buffer));
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glDeleteBuffers(1, &buffer);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  s_API->DestroyTexture3D(4);
+}
+
+int main() {
+  if (!CreateContext()) {
+    printf("no surfaceless OpenGL 4.4 context - skipped\n");
+    return kSkipped;
+  }
+  s_API = CreateTextureSubPluginAPI_OpenGLCoreES(kUnityGfxRendererOpenGLCore);
+  s_API->ProcessDeviceEvent(kUnityGfxDeviceEventInitialize, nullptr);
+  const int result = RunTests();
+  s_API->ProcessDeviceEvent(kUnityGfxDeviceEventShutdown, nullptr);
+  delete s_API;
+  return result;
+}
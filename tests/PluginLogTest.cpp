@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PluginLog.hpp"
+#include "TestMain.hpp"
+
+// the log is global, so a single test runs the producers and checks what
+// reached IUnityLog
+
+static const int kProducers = 8;
+// distinct call sites per producer, each logs one message. Together they
+// exceed the ring, so some messages are dropped while the flusher runs
+static const int kSitesPerProducer = 256;
+// messages per producer on a call site shared by all producers
+static const int kSharedMessages = 10000;
+
+static std::mutex s_LinesMutex;
+static std::vector<std::string> s_Lines;
+
+static void UNITY_INTERFACE_API CaptureLog(UnityLogType, const char* message,
+                                           const char*, const int) {
+  std::lock_guard<std::mutex> lock(s_LinesMutex);
+  s_Lines.push_back(message);
+}
+
+static bool StartsWith(const std::string& text, const char* prefix) {
+  return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+TEST(ConcurrentProducers) {
+  IUnityLog log = {};
+  log.Log = CaptureLog;
+  StartPluginLog(&log);
+
+  // call sites stay registered, so they have to outlive the log
+  static std::vector<std::unique_ptr<LogSite>> sites;
+  for (int i = 0; i < kProducers * kSitesPerProducer; ++i)
+    sites.emplace_back(
+        new LogSite(kUnityLogTypeLog, "Distinct", __FILE__, __LINE__));
+  static LogSite shared(kUnityLogTypeWarning, "Shared", __FILE__, __LINE__);
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p]() {
+      for (int s = 0; s < kSitesPerProducer; ++s) {
+        const int site = p * kSitesPerProducer + s;
+        PluginLog(sites[site].get(), "message %d", site);
+        for (int i = 0; i < kSharedMessages / kSitesPerProducer; ++i)
+          PluginLog(&shared, "shared message of %d", p);
+      }
+    });
+  }
+  for (std::thread& producer : producers) producer.join();
+  StopPluginLog();
+
+  const int distinct = kProducers * kSitesPerProducer;
+  const uint64_t shared_count = static_cast<uint64_t>(kProducers) *
+                                (kSharedMessages / kSitesPerProducer) *
+                                kSitesPerProducer;
+  const LogCounters counters = GetPluginLogCounters();
+  CHECK(counters.messages == distinct + shared_count);
+  CHECK(counters.lines == s_Lines.size());
+  CHECK(shared.count.load() == shared_count);
+
+  // every distinct message either arrives intact or is reported as
+  // suppressed (dropped since the ring was full), never both or twice
+  std::vector<int> seen(distinct, 0);
+  uint64_t dropped_reports = 0;
+  uint64_t shared_lines = 0;
+  uint64_t shared_suppressed = 0;
+  for (const std::string& line : s_Lines) {
+    int site;
+    char tail;
+    const char* suffix = "similar messages suppressed";
+    if (sscanf(line.c_str(), "Distinct message %d%c", &site, &tail) == 1) {
+      CHECK(site >= 0 && site < distinct);
+      if (site >= 0 && site < distinct) ++seen[site];
+    } else if (StartsWith(line, "Distinct 1 similar messages suppressed: ")) {
+      ++dropped_reports;
+    } else if (StartsWith(line, "Shared shared message of ")) {
+      // a line may carry the messages suppressed since the previous one
+      ++shared_lines;
+      const size_t open = line.find(" (");
+      if (open != std::string::npos)
+        shared_suppressed += strtoull(line.c_str() + open + 2, nullptr, 10);
+    } else if (StartsWith(line, "Shared ") &&
+               line.find(suffix) != std::string::npos) {
+      shared_suppressed += strtoull(line.c_str() + 7, nullptr, 10);
+    } else {
+      fprintf(stderr, "unexpected line: %s\n", line.c_str());
+      CHECK(false);
+    }
+  }
+  uint64_t arrived = 0;
+  for (int count : seen) {
+    CHECK(count <= 1);
+    arrived += count;
+  }
+  CHECK(arrived + dropped_reports == static_cast<uint64_t>(distinct));
+  // the shared call site may have lost messages to the full ring as well
+  CHECK(dropped_reports <= counters.dropped);
+  CHECK(shared_lines >= 1);
+  CHECK(shared_lines + shared_suppressed == shared_count);
+  CHECK(counters.suppressed == shared.suppressed.load() + dropped_reports);
+}
+
+int main() { return RunTests(); }
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <vector>
+
+// Minimal test harness. Each test executable is a single translation unit
+// that registers its cases with TEST and returns RunTests() from main. CHECK
+// reports a failed expectation and keeps running the case
+
+struct TestCase {
+  const char* name;
+  void (*function)();
+};
+
+static std::vector<TestCase>& Tests() {
+  static std::vector<TestCase> tests;
+  return tests;
+}
+
+static int g_Failures = 0;
+
+struct TestRegistrar {
+  TestRegistrar(const char* name, void (*function)()) {
+    Tests().push_back({name, function});
+  }
+};
+
+#define TEST(name)                                    \
+  static void name();                                 \
+  static TestRegistrar name##_registrar(#name, name); \
+  static void name()
+
+#define CHECK(condition)                                               \
+  do {                                                                 \
+    if (!(condition)) {                                                \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+              #condition);                                             \
+      ++g_Failures;                                                    \
+    }                                                                  \
+  } while (0)
+
+static int RunTests() {
+  for (const TestCase& test : Tests()) {
+    const int failures = g_Failures;
+    test.function();
+    printf("[%s] %s\n", g_Failures == failures ? "PASS" : "FAIL", test.name);
+  }
+  return g_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "TestMain.hpp"
+#include "Tickets.hpp"
+
+static std::vector<uint64_t> s_Retired;
+static uint64_t s_Watermark = 0;
+
+static void UNITY_INTERFACE_API CaptureTickets(const uint64_t* tickets,
+                                               uint32_t count,
+                                               uint64_t completed_ticket) {
+  s_Retired.insert(s_Retired.end(), tickets, tickets + count);
+  s_Watermark = completed_ticket;
+}
+
+static bool Retired(uint64_t ticket) {
+  return std::find(s_Retired.begin(), s_Retired.end(), ticket) !=
+         s_Retired.end();
+}
+
+TEST(CompletesWithTheirFrame) {
+  TicketTracker tracker;
+  const uint64_t a = tracker.Acquire();
+  const uint64_t b = tracker.Acquire();
+  CHECK(a != 0 && b > a);
+  CHECK(tracker.GetStatus(a) == TICKET_STATUS_PENDING);
+  CHECK(tracker.GetStatus(b + 1) == TICKET_STATUS_UNKNOWN);
+  CHECK(tracker.GetStatus(0) == TICKET_STATUS_UNKNOWN);
+
+  tracker.Record(a, 10, false);
+  tracker.Record(b, 11, false);
+  tracker.Update(9);
+  CHECK(!tracker.IsComplete(a));
+  CHECK(tracker.GetCompleted() == a - 1);
+  tracker.Update(10);
+  CHECK(tracker.IsComplete(a) && !tracker.IsComplete(b));
+  CHECK(tracker.GetStatus(a) == TICKET_STATUS_COMPLETE);
+  CHECK(tracker.GetCompleted() == a);
+  tracker.Update(11);
+  CHECK(tracker.GetStatus(b) == TICKET_STATUS_COMPLETE);
+  CHECK(tracker.GetCompleted() == b);
+}
+
+TEST(RecordedOutOfOrder) {
+  TicketTracker tracker;
+  s_Retired.clear();
+  tracker.SetCallback(CaptureTickets);
+  const uint64_t a = tracker.Acquire();
+  const uint64_t b = tracker.Acquire();
+  const uint64_t c = tracker.Acquire();
+
+  // c and b were issued before a, so they complete first
+  tracker.Record(c, 1, false);
+  tracker.Record(b, 1, false);
+  tracker.Update(1);
+  CHECK(Retired(b) && Retired(c) && !Retired(a));
+  CHECK(tracker.IsComplete(c) && !tracker.IsComplete(a));
+  // the watermark waits for a
+  CHECK(s_Watermark == a - 1);
+  CHECK(tracker.GetCompleted() == a - 1);
+
+  tracker.Record(a, 2, true);
+  tracker.Update(1);
+  CHECK(Retired(a));
+  CHECK(s_Watermark == c);
+  CHECK(tracker.GetCompleted() == c);
+}
+
+TEST(AbandonedTicketsRetireAsFailed) {
+  TicketTracker tracker;
+  s_Retired.clear();
+  tracker.SetCallback(CaptureTickets);
+  const uint64_t a = tracker.Acquire();
+  const uint64_t b = tracker.Acquire();
+
+  tracker.Record(b, 5, false);
+  tracker.Abandon(a);
+  CHECK(tracker.IsComplete(a));
+  CHECK(tracker.GetStatus(a) == TICKET_STATUS_FAILED);
+  // the watermark is no longer held back by the abandoned ticket
+  CHECK(tracker.GetCompleted() == a);
+
+  // recorded tickets are not affected
+  tracker.Abandon(b);
+  CHECK(tracker.GetStatus(b) == TICKET_STATUS_PENDING);
+  tracker.Update(5);
+  CHECK(Retired(a) && Retired(b));
+  CHECK(tracker.GetStatus(b) == TICKET_STATUS_COMPLETE);
+  CHECK(s_Watermark == b);
+
+  // the render thread may still record an abandoned ticket
+  tracker.Record(a, 6, true);
+  CHECK(tracker.GetStatus(a) == TICKET_STATUS_FAILED);
+}
+
+TEST(FailedTicketsWaitForTheirFrame) {
+  TicketTracker tracker;
+  const uint64_t a = tracker.Acquire();
+  const uint64_t b = tracker.Acquire();
+
+  tracker.Record(a, 3, false, true);
+  tracker.Record(b, 3, true, true);
+  CHECK(tracker.GetStatus(a) == TICKET_STATUS_PENDING);
+  CHECK(tracker.GetStatus(b) == TICKET_STATUS_FAILED);
+  tracker.Update(3);
+  CHECK(tracker.IsComplete(a));
+  CHECK(tracker.GetStatus(a) == TICKET_STATUS_FAILED);
+  CHECK(tracker.GetCompleted() == b);
+}
+
+TEST(OldFailuresAreForgotten) {
+  TicketTracker tracker;
+  const uint64_t first = tracker.Acquire();
+  tracker.Abandon(first);
+  for (size_t i = 0; i < TicketTracker::kMaxFailedTickets; ++i)
+    tracker.Abandon(tracker.Acquire());
+  CHECK(tracker.GetStatus(first) == TICKET_STATUS_COMPLETE);
+  CHECK(tracker.GetStatus(first + 1) == TICKET_STATUS_FAILED);
+  CHECK(tracker.GetCompleted() == first + TicketTracker::kMaxFailedTickets);
+}
+
+int main() { return RunTests(); }
@@ -0,0 +1,211 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "TestMain.hpp"
+#include "VolumeContainer.hpp"
+
+// written to the working directory (the build directory under ctest)
+static const char* const kValidPath = "VolumeContainerTest_valid.vol";
+static const char* const kPatchedPath = "VolumeContainerTest_patched.vol";
+
+// byte offsets of the header fields (see ContainerHeader)
+static const size_t kVersionOffset = 4;
+static const size_t kLodCountOffset = 28;
+static const size_t kBrickCountOffset = 32;
+static const size_t kLodTableOffset = 40;
+static const size_t kBrickTableOffset = 48;
+static const size_t kFileSizeOffset = 56;
+
+static std::vector<uint8_t> ReadFile(const char* path) {
+  std::vector<uint8_t> bytes;
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) return bytes;
+  uint8_t buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    bytes.insert(bytes.end(), buffer, buffer + read);
+  fclose(file);
+  return bytes;
+}
+
+static void WriteFile(const char* path, const std::vector<uint8_t>& bytes) {
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) return;
+  if (!bytes.empty()) fwrite(bytes.data(), 1, bytes.size(), file);
+  fclose(file);
+}
+
+template <typename T>
+static T Get(const std::vector<uint8_t>& bytes, size_t offset) {
+  T value;
+  memcpy(&value, bytes.data() + offset, sizeof(value));
+  return value;
+}
+
+template <typename T>
+static void Set(std::vector<uint8_t>* bytes, size_t offset, T value) {
+  memcpy(bytes->data() + offset, &value, sizeof(value));
+}
+
+// 40x33x20 R8 volume with constant, bit packed and uncompressed bricks
+static std::vector<uint8_t> MakeVolume() {
+  std::vector<uint8_t> voxels(40 * 33 * 20);
+  for (size_t i = 0; i < voxels.size(); ++i) {
+    const size_t x = i % 40;
+    const size_t z = i / (40 * 33);
+    voxels[i] = z < 16 ? (x < 16 ? 7 : static_cast<uint8_t>(x % 5))
+                       : static_cast<uint8_t>(i * 31);
+  }
+  return voxels;
+}
+
+static bool WriteValidContainer() {
+  const std::vector<uint8_t> voxels = MakeVolume();
+  VolumeContainerOptions options = {};
+  options.brick_size = 16;
+  options.compress = 1;
+  return WriteVolumeContainer(kValidPath, voxels.data(), 40, 33, 20, R8_UINT,
+                              options);
+}
+
+static bool OpensPatched(const std::vector<uint8_t>& bytes) {
+  WriteFile(kPatchedPath, bytes);
+  VolumeContainerReader reader;
+  const bool opened = reader.Open(kPatchedPath);
+  // a rejected file leaves the reader empty
+  if (!opened)
+    CHECK(reader.Mapping() == nullptr && reader.Bricks() == nullptr &&
+          reader.Info().brick_count == 0);
+  return opened;
+}
+
+TEST(RoundTrip) {
+  CHECK(WriteValidContainer());
+  VolumeContainerReader reader;
+  CHECK(reader.Open(kValidPath));
+  if (reader.Mapping() == nullptr) return;
+  const VolumeContainerInfo& info = reader.Info();
+  CHECK(info.width == 40 && info.height == 33 && info.depth == 20);
+  CHECK(info.format == R8_UINT && info.brick_size == 16);
+  CHECK(info.lod_count > 1);
+
+  // every LOD 0 brick decodes to the voxels it covers
+  const std::vector<uint8_t> voxels = MakeVolume();
+  const VolumeContainerLod& lod = reader.Lods()[0];
+  bool codecs[3] = {};
+  for (uint32_t b = 0; b < lod.brick_count_x * lod.brick_count_y *
+                               lod.brick_count_z;
+       ++b) {
+    const uint32_t index = lod.first_brick + b;
+    const VolumeContainerBrick& brick = reader.Bricks()[index];
+    if (brick.codec < 3) codecs[brick.codec] = true;
+    std::vector<uint8_t> decoded(brick.raw_size);
+    CHECK(reader.DecodeBrick(index, decoded.data(), decoded.size()));
+    bool equal = true;
+    for (uint32_t z = 0; z < brick.depth; ++z)
+      for (uint32_t y = 0; y < brick.height; ++y)
+        for (uint32_t x = 0; x < brick.width; ++x)
+          equal &= decoded[(z * brick.height + y) * brick.width + x] ==
+                   voxels[((brick.z + z) * 33 + brick.y + y) * 40 + brick.x +
+                          x];
+    CHECK(equal);
+  }
+  CHECK(codecs[BRICK_CODEC_NONE] && codecs[BRICK_CODEC_CONSTANT] &&
+        codecs[BRICK_CODEC_BITPACK]);
+  CHECK(!reader.DecodeBrick(info.brick_count, nullptr, 0));
+}
+
+TEST(RejectsMissingFile) {
+  VolumeContainerReader reader;
+  CHECK(!reader.Open(nullptr));
+  CHECK(!reader.Open("VolumeContainerTest_missing.vol"));
+}
+
+TEST(RejectsTruncatedFiles) {
+  CHECK(WriteValidContainer());
+  const std::vector<uint8_t> valid = ReadFile(kValidPath);
+  CHECK(valid.size() > 64);
+  if (valid.size() <= 64) return;
+  // empty, a partial header, a bare header, and cut off within the brick
+  // data and within the tables
+  const size_t sizes[] = {0,
+                          1,
+                          63,
+                          64,
+                          valid.size() / 2,
+                          static_cast<size_t>(
+                              Get<uint64_t>(valid, kLodTableOffset)),
+                          valid.size() - 1};
+  for (size_t size : sizes)
+    CHECK(!OpensPatched(
+        std::vector<uint8_t>(valid.begin(), valid.begin() + size)));
+}
+
+TEST(RejectsOversizedHeaderFields) {
+  CHECK(WriteValidContainer());
+  const std::vector<uint8_t> valid = ReadFile(kValidPath);
+  if (valid.size() <= 64) return;
+  CHECK(OpensPatched(valid));
+
+  std::vector<uint8_t> bytes = valid;
+  Set<uint32_t>(&bytes, kVersionOffset,
+                Get<uint32_t>(valid, kVersionOffset) + 1);
+  CHECK(!OpensPatched(bytes));
+
+  // sizes and counts that reach past the end of the file (or overflow when
+  // multiplied with the entry size)
+  bytes = valid;
+  Set<uint64_t>(&bytes, kFileSizeOffset, valid.size() + 1);
+  CHECK(!OpensPatched(bytes));
+  for (uint32_t count : {0u, 0x10000000u, 0xFFFFFFFFu}) {
+    bytes = valid;
+    Set<uint32_t>(&bytes, kLodCountOffset, count);
+    CHECK(!OpensPatched(bytes));
+    bytes = valid;
+    Set<uint32_t>(&bytes, kBrickCountOffset, count);
+    CHECK(!OpensPatched(bytes));
+  }
+  const uint64_t offsets[] = {valid.size(), 0xFFFFFFFFFFFFFFF8ull};
+  for (size_t field : {kLodTableOffset, kBrickTableOffset}) {
+    for (uint64_t offset : offsets) {
+      bytes = valid;
+      Set<uint64_t>(&bytes, field, offset);
+      CHECK(!OpensPatched(bytes));
+    }
+  }
+}
+
+TEST(RejectsOversizedBricks) {
+  CHECK(WriteValidContainer());
+  const std::vector<uint8_t> valid = ReadFile(kValidPath);
+  if (valid.size() <= 64) return;
+  const size_t brick_table =
+      static_cast<size_t>(Get<uint64_t>(valid, kBrickTableOffset));
+  const size_t last =
+      brick_table + (Get<uint32_t>(valid, kBrickCountOffset) - 1) *
+                        sizeof(VolumeContainerBrick);
+  const size_t offset = last + offsetof(VolumeContainerBrick, offset);
+  const size_t stored_size =
+      last + offsetof(VolumeContainerBrick, stored_size);
+  const size_t width = last + offsetof(VolumeContainerBrick, width);
+
+  std::vector<uint8_t> bytes = valid;
+  Set<uint64_t>(&bytes, offset, valid.size());
+  CHECK(!OpensPatched(bytes));
+  bytes = valid;
+  Set<uint32_t>(&bytes, stored_size, 0xFFFFFFFFu);
+  CHECK(!OpensPatched(bytes));
+  bytes = valid;
+  Set<uint32_t>(&bytes, width, 0xFFFFFFFFu);
+  CHECK(!OpensPatched(bytes));
+}
+
+int main() {
+  const int result = RunTests();
+  remove(kValidPath);
+  remove(kPatchedPath);
+  return result;
+}
@@ -0,0 +1,485 @@
+#include <dlfcn.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "PluginLog.hpp"
+#include "TestMain.hpp"
+#include "TextureSubPluginAPI.hpp"
+
+// the plugin does not link to the Vulkan loader, neither does its test
+#define VK_NO_PROTOTYPES
+#include "IUnityGraphicsVulkan.h"
+
+// Compares the Vulkan backend's gradient compute pass (ComputeGradients) with
+// a CPU reference on the first Vulkan device, e.g., Mesa's lavapipe. The test
+// plays Unity's part: it owns the device and the frame's command buffer and
+// submits the frame whenever it waits for the GPU. Exits with kSkipped if no
+// Vulkan device can be created
+
+static const int kSkipped = 77;
+
+extern TextureSubPluginAPI* CreateTextureSubPluginAPI_Vulkan();
+
+#define TEST_VULKAN_FUNCTIONS(apply)               \
+  apply(vkCreateInstance);                         \
+  apply(vkDestroyInstance);                        \
+  apply(vkEnumeratePhysicalDevices);               \
+  apply(vkGetPhysicalDeviceQueueFamilyProperties); \
+  apply(vkGetPhysicalDeviceFeatures);              \
+  apply(vkGetPhysicalDeviceFormatProperties);      \
+  apply(vkCreateDevice);                           \
+  apply(vkDestroyDevice);                          \
+  apply(vkGetDeviceQueue);                         \
+  apply(vkDeviceWaitIdle);                         \
+  apply(vkCreateCommandPool);                      \
+  apply(vkDestroyCommandPool);                     \
+  apply(vkAllocateCommandBuffers);                 \
+  apply(vkBeginCommandBuffer);                     \
+  apply(vkEndCommandBuffer);                       \
+  apply(vkResetCommandBuffer);                     \
+  apply(vkQueueSubmit);                            \
+  apply(vkQueueWaitIdle)
+
+#define DEFINE_TEST_VULKAN_FUNCTION(fn) static PFN_##fn fn
+TEST_VULKAN_FUNCTIONS(DEFINE_TEST_VULKAN_FUNCTION);
+#undef DEFINE_TEST_VULKAN_FUNCTION
+
+static void* s_Loader = nullptr;
+static UnityVulkanInstance s_Instance = {};
+static VkCommandPool s_CommandPool = VK_NULL_HANDLE;
+static VkCommandBuffer s_CommandBuffer = VK_NULL_HANDLE;
+static bool s_Recording = false;
+// every frame before the current one has completed (see SubmitFrame)
+static unsigned long long s_Frame = 1;
+
+static IUnityGraphicsVulkan s_UnityVulkan = {};
+static IUnityInterfaces s_Interfaces = {};
+static TextureSubPluginAPI* s_API = nullptr;
+
+static UnityVulkanInstance UNITY_INTERFACE_API Instance() { return s_Instance; }
+
+static bool UNITY_INTERFACE_API
+CommandRecordingState(UnityVulkanRecordingState* state,
+                      UnityVulkanGraphicsQueueAccess) {
+  if (!s_Recording) {
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(s_CommandBuffer, &begin_info) != VK_SUCCESS)
+      return false;
+    s_Recording = true;
+  }
+  *state = UnityVulkanRecordingState{};
+  state->commandBuffer = s_CommandBuffer;
+  state->commandBufferLevel = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  state->currentFrameNumber = s_Frame;
+  state->safeFrameNumber = s_Frame - 1;
+  return true;
+}
+
+static void UNITY_INTERFACE_API
+ConfigureEvent(int, const UnityVulkanPluginEventConfig*) {}
+
+static void UNITY_INTERFACE_API EnsureOutsideRenderPass() {}
+
+static PFN_vkVoidFunction UNITY_INTERFACE_API
+InterceptVulkanAPI(const char*, PFN_vkVoidFunction) {
+  return nullptr;
+}
+
+static bool UNITY_INTERFACE_API AccessTexture(void*, const VkImageSubresource*,
+                                              VkImageLayout,
+                                              VkPipelineStageFlags,
+                                              VkAccessFlags,
+                                              UnityVulkanResourceAccessMode,
+                                              UnityVulkanImage*) {
+  return false;
+}
+
+// the backend only asks for the Vulkan interface
+static IUnityInterface* UNITY_INTERFACE_API GetInterface(UnityInterfaceGUID) {
+  return &s_UnityVulkan;
+}
+
+static IUnityInterface* UNITY_INTERFACE_API
+GetInterfaceSplit(unsigned long long, unsigned long long) {
+  return &s_UnityVulkan;
+}
+
+static bool CreateDevice() {
+  s_Loader = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+  if (!s_Loader) return false;
+  s_Instance.getInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(
+      dlsym(s_Loader, "vkGetInstanceProcAddr"));
+  if (!s_Instance.getInstanceProcAddr) return false;
+  vkCreateInstance = reinterpret_cast<PFN_vkCreateInstance>(
+      s_Instance.getInstanceProcAddr(VK_NULL_HANDLE, "vkCreateInstance"));
+  if (!vkCreateInstance) return false;
+
+  VkApplicationInfo application_info{};
+  application_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+  application_info.pApplicationName = "VulkanGradientsTest";
+  application_info.apiVersion = VK_API_VERSION_1_1;
+  VkInstanceCreateInfo instance_info{};
+  instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+  instance_info.pApplicationInfo = &application_info;
+  if (vkCreateInstance(&instance_info, nullptr, &s_Instance.instance) !=
+      VK_SUCCESS)
+    return false;
+#define LOAD_TEST_VULKAN_FUNCTION(fn)                            \
+  fn = reinterpret_cast<PFN_##fn>(                               \
+      s_Instance.getInstanceProcAddr(s_Instance.instance, #fn)); \
+  if (!fn) return false
+  TEST_VULKAN_FUNCTIONS(LOAD_TEST_VULKAN_FUNCTION);
+#undef LOAD_TEST_VULKAN_FUNCTION
+
+  // the first device with a queue for graphics and compute (like Unity's)
+  uint32_t device_count = 0;
+  vkEnumeratePhysicalDevices(s_Instance.instance, &device_count, nullptr);
+  std::vector<VkPhysicalDevice> devices(device_count);
+  vkEnumeratePhysicalDevices(s_Instance.instance, &device_count,
+                             devices.data());
+  const VkQueueFlags queue_flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+  for (uint32_t d = 0; d < device_count && !s_Instance.physicalDevice; ++d) {
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(devices[d], &family_count,
+                                             nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(devices[d], &family_count,
+                                             families.data());
+    for (uint32_t f = 0; f < family_count; ++f) {
+      if ((families[f].queueFlags & queue_flags) != queue_flags) continue;
+      s_Instance.physicalDevice = devices[d];
+      s_Instance.queueFamilyIndex = f;
+      break;
+    }
+  }
+  if (!s_Instance.physicalDevice) return false;
+
+  // RG16 storage images need the extended storage formats
+  VkPhysicalDeviceFeatures supported{};
+  vkGetPhysicalDeviceFeatures(s_Instance.physicalDevice, &supported);
+  VkPhysicalDeviceFeatures features{};
+  features.shaderStorageImageExtendedFormats =
+      supported.shaderStorageImageExtendedFormats;
+  const float priority = 1.0f;
+  VkDeviceQueueCreateInfo queue_info{};
+  queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+  queue_info.queueFamilyIndex = s_Instance.queueFamilyIndex;
+  queue_info.queueCount = 1;
+  queue_info.pQueuePriorities = &priority;
+  VkDeviceCreateInfo device_info{};
+  device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  device_info.queueCreateInfoCount = 1;
+  device_info.pQueueCreateInfos = &queue_info;
+  device_info.pEnabledFeatures = &features;
+  if (vkCreateDevice(s_Instance.physicalDevice, &device_info, nullptr,
+                     &s_Instance.device) != VK_SUCCESS)
+    return false;
+  vkGetDeviceQueue(s_Instance.device, s_Instance.queueFamilyIndex, 0,
+                   &s_Instance.graphicsQueue);
+
+  VkCommandPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  pool_info.queueFamilyIndex = s_Instance.queueFamilyIndex;
+  VkCommandBufferAllocateInfo allocate_info{};
+  allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandBufferCount = 1;
+  if (vkCreateCommandPool(s_Instance.device, &pool_info, nullptr,
+                          &s_CommandPool) != VK_SUCCESS)
+    return false;
+  allocate_info.commandPool = s_CommandPool;
+  if (vkAllocateCommandBuffers(s_Instance.device, &allocate_info,
+                               &s_CommandBuffer) != VK_SUCCESS)
+    return false;
+
+  s_UnityVulkan.InterceptVulkanAPI = InterceptVulkanAPI;
+  s_UnityVulkan.ConfigureEvent = ConfigureEvent;
+  s_UnityVulkan.Instance = Instance;
+  s_UnityVulkan.CommandRecordingState = CommandRecordingState;
+  s_UnityVulkan.AccessTexture = AccessTexture;
+  s_UnityVulkan.EnsureOutsideRenderPass = EnsureOutsideRenderPass;
+  s_Interfaces.GetInterface = GetInterface;
+  s_Interfaces.GetInterfaceSplit = GetInterfaceSplit;
+  return true;
+}
+
+static void DestroyDevice() {
+  if (s_Instance.device) {
+    vkDeviceWaitIdle(s_Instance.device);
+    // frees the command buffer, even if it is still recording
+    if (s_CommandPool)
+      vkDestroyCommandPool(s_Instance.device, s_CommandPool, nullptr);
+    vkDestroyDevice(s_Instance.device, nullptr);
+  }
+  if (s_Instance.instance && vkDestroyInstance)
+    vkDestroyInstance(s_Instance.instance, nullptr);
+  if (s_Loader) dlclose(s_Loader);
+}
+
+// executes the frame's commands and waits for them, like a frame that Unity
+// submitted and that has become safe
+static bool SubmitFrame() {
+  if (s_Recording) {
+    s_Recording = false;
+    if (vkEndCommandBuffer(s_CommandBuffer) != VK_SUCCESS) return false;
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &s_CommandBuffer;
+    if (vkQueueSubmit(s_Instance.graphicsQueue, 1, &submit_info,
+                      VK_NULL_HANDLE) != VK_SUCCESS ||
+        vkQueueWaitIdle(s_Instance.graphicsQueue) != VK_SUCCESS)
+      return false;
+    vkResetCommandBuffer(s_CommandBuffer, 0);
+  }
+  ++s_Frame;
+  return true;
+}
+
+static bool SupportsStorage(Format format) {
+  VkFormatProperties properties{};
+  vkGetPhysicalDeviceFormatProperties(
+      s_Instance.physicalDevice,
+      format == RG16_UINT ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R8G8B8A8_UNORM,
+      &properties);
+  return (properties.optimalTilingFeatures &
+          VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+}
+
+// reads a whole texture back (tightly packed, x-fastest), or returns nothing
+// if the readback did not complete
+static std::vector<uint8_t> ReadTexture(uint32_t texture_id,
+                                        const int32_t extent[3]) {
+  const uint32_t readback_id = 1;
+  s_API->ReadbackTexture3D(texture_id, readback_id, 0, 0, 0, extent[0],
+                           extent[1], extent[2]);
+  std::vector<uint8_t> texels;
+  // the copy completes once the frame it was recorded in is safe
+  for (int frame = 0; frame < 4 && texels.empty(); ++frame) {
+    if (!SubmitFrame()) break;
+    s_API->ProcessReadbacks();
+    const void* data = nullptr;
+    uint64_t size = 0;
+    if (s_API->GetReadback(readback_id, &data, &size) ==
+        READBACK_STATUS_READY) {
+      const uint8_t* bytes = static_cast<const uint8_t*>(data);
+      texels.assign(bytes, bytes + size);
+    }
+  }
+  s_API->ReleaseReadback(readback_id);
+  return texels;
+}
+
+// a small volume whose extent is not a multiple of the 4^3 work groups
+static const int32_t kExtent[3] = {11, 9, 7};
+
+static size_t VoxelIndex(int32_t x, int32_t y, int32_t z) {
+  return (static_cast<size_t>(z) * kExtent[1] + y) * kExtent[0] + x;
+}
+
+static std::vector<uint8_t> MakeVolume(uint32_t seed) {
+  std::vector<uint8_t> volume(VoxelIndex(0, 0, kExtent[2]));
+  for (int32_t z = 0; z < kExtent[2]; ++z)
+    for (int32_t y = 0; y < kExtent[1]; ++y)
+      for (int32_t x = 0; x < kExtent[0]; ++x)
+        volume[VoxelIndex(x, y, z)] = static_cast<uint8_t>(
+            (x * 37 + y * y * 11 + z * 53 + x * y * z * 7 + seed) % 251);
+  return volume;
+}
+
+// the reference of Gradients.comp: voxels outside of the volume repeat its
+// border and R8 volumes are sampled as normalized values
+static float Fetch(const std::vector<uint8_t>& volume, int32_t x, int32_t y,
+                   int32_t z) {
+  x = std::min(std::max(x, 0), kExtent[0] - 1);
+  y = std::min(std::max(y, 0), kExtent[1] - 1);
+  z = std::min(std::max(z, 0), kExtent[2] - 1);
+  return volume[VoxelIndex(x, y, z)] / 255.0f;
+}
+
+static void Gradient(const std::vector<uint8_t>& volume, int32_t x, int32_t y,
+                     int32_t z, float n[3], float* magnitude) {
+  const float g[3] = {
+      0.5f * (Fetch(volume, x + 1, y, z) - Fetch(volume, x - 1, y, z)),
+      0.5f * (Fetch(volume, x, y + 1, z) - Fetch(volume, x, y - 1, z)),
+      0.5f * (Fetch(volume, x, y, z + 1) - Fetch(volume, x, y, z - 1))};
+  *magnitude = sqrtf(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+  for (int a = 0; a < 3; ++a)
+    n[a] = *magnitude > 0.0f ? g[a] / *magnitude : 0.0f;
+}
+
+static int32_t Unorm(float value, float max_value) {
+  return static_cast<int32_t>(
+      lrintf(std::min(std::max(value, 0.0f), 1.0f) * max_value));
+}
+
+// expected texel of an RGBA8_UINT gradient texture
+static void ExpectedRGBA8(const std::vector<uint8_t>& volume, int32_t x,
+                          int32_t y, int32_t z, float magnitude_scale,
+                          int32_t texel[4]) {
+  float n[3], magnitude;
+  Gradient(volume, x, y, z, n, &magnitude);
+  for (int a = 0; a < 3; ++a) texel[a] = Unorm(n[a] * 0.5f + 0.5f, 255.0f);
+  texel[3] = Unorm(magnitude * magnitude_scale, 255.0f);
+}
+
+// expected texel of an RG16_UINT gradient texture (octahedral encoding)
+static void ExpectedRG16(const std::vector<uint8_t>& volume, int32_t x,
+                         int32_t y, int32_t z, int32_t texel[2]) {
+  float n[3], magnitude;
+  Gradient(volume, x, y, z, n, &magnitude);
+  float e[2] = {0.5f, 0.5f};
+  if (magnitude > 0.0f) {
+    const float sum = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    const float o[3] = {n[0] / sum, n[1] / sum, n[2] / sum};
+    e[0] = o[0];
+    e[1] = o[1];
+    if (o[2] < 0.0f) {
+      e[0] = (1.0f - fabsf(o[1])) * (o[0] >= 0.0f ? 1.0f : -1.0f);
+      e[1] = (1.0f - fabsf(o[0])) * (o[1] >= 0.0f ? 1.0f : -1.0f);
+    }
+    e[0] = e[0] * 0.5f + 0.5f;
+    e[1] = e[1] * 0.5f + 0.5f;
+  }
+  texel[0] = Unorm(e[0], 65535.0f);
+  texel[1] = Unorm(e[1], 65535.0f);
+}
+
+// largest difference between a channel of a texel read back and its
+// reference
+static int32_t MaxDifference(const std::vector<uint8_t>& texels,
+                             const std::vector<uint8_t>& volume, Format format,
+                             float magnitude_scale) {
+  int32_t difference = 0;
+  for (int32_t z = 0; z < kExtent[2]; ++z) {
+    for (int32_t y = 0; y < kExtent[1]; ++y) {
+      for (int32_t x = 0; x < kExtent[0]; ++x) {
+        const uint8_t* texel = texels.data() + VoxelIndex(x, y, z) * 4;
+        int32_t expected[4], actual[4];
+        int channels = 4;
+        if (format == RG16_UINT) {
+          ExpectedRG16(volume, x, y, z, expected);
+          channels = 2;
+          for (int c = 0; c < 2; ++c)
+            actual[c] = texel[c * 2] | (texel[c * 2 + 1] << 8);
+        } else {
+          ExpectedRGBA8(volume, x, y, z, magnitude_scale, expected);
+          for (int c = 0; c < 4; ++c) actual[c] = texel[c];
+        }
+        for (int c = 0; c < channels; ++c)
+          difference = std::max(difference, abs(actual[c] - expected[c]));
+      }
+    }
+  }
+  return difference;
+}
+
+static void CheckGradients(Format format, uint32_t volume_id,
+                           uint32_t gradients_id) {
+  if (!SupportsStorage(format)) {
+    printf("format %d cannot be a storage image - skipped\n", format);
+    return;
+  }
+  const uint64_t errors = GetThreadErrorCount();
+  const float magnitude_scale = 4.0f;
+  // the GPU may round the conversions to UNORM differently, and its lengths
+  // and divisions are less precise, which the octahedral encoding amplifies
+  const int32_t tolerance = format == RG16_UINT ? 4 : 1;
+  std::vector<uint8_t> volume = MakeVolume(0);
+  s_API->CreateTexture3D(volume_id, kExtent[0], kExtent[1], kExtent[2],
+                         R8_UINT);
+  s_API->TextureSubImage3DByID(volume_id, 0, 0, 0, kExtent[0], kExtent[1],
+                               kExtent[2], volume.data(), 0, R8_UINT, nullptr,
+                               UPLOAD_FLAG_NONE);
+  s_API->ComputeGradients(volume_id, gradients_id, format, magnitude_scale,
+                          nullptr, 0);
+  std::vector<uint8_t> texels = ReadTexture(gradients_id, kExtent);
+  CHECK(texels.size() == volume.size() * 4);
+  if (texels.size() == volume.size() * 4)
+    CHECK(MaxDifference(texels, volume, format, magnitude_scale) <= tolerance);
+
+  // a box only updates the voxels whose differences read it: the box grown
+  // by one voxel. The others keep the gradients of the previous volume
+  const TextureBox box = {4, 3, 2, 3, 2, 2};
+  std::vector<uint8_t> updated = MakeVolume(101);
+  std::vector<uint8_t> region(box.width * box.height * box.depth);
+  for (uint32_t z = 0; z < box.depth; ++z)
+    for (uint32_t y = 0; y < box.height; ++y)
+      for (uint32_t x = 0; x < box.width; ++x)
+        region[(z * box.height + y) * box.width + x] =
+            updated[VoxelIndex(box.x + x, box.y + y, box.z + z)];
+  std::vector<uint8_t> expected_volume = volume;
+  for (int32_t z = box.z; z < box.z + static_cast<int32_t>(box.depth); ++z)
+    for (int32_t y = box.y; y < box.y + static_cast<int32_t>(box.height); ++y)
+      for (int32_t x = box.x; x < box.x + static_cast<int32_t>(box.width); ++x)
+        expected_volume[VoxelIndex(x, y, z)] = updated[VoxelIndex(x, y, z)];
+  s_API->TextureSubImage3DByID(volume_id, box.x, box.y, box.z, box.width,
+                               box.height, box.depth, region.data(), 0,
+                               R8_UINT, nullptr, UPLOAD_FLAG_NONE);
+  s_API->ComputeGradients(volume_id, gradients_id, format, magnitude_scale,
+                          &box, 1);
+  std::vector<uint8_t> boxed = ReadTexture(gradients_id, kExtent);
+  CHECK(boxed.size() == texels.size());
+  if (boxed.size() == texels.size() && !texels.empty()) {
+    // the grown box is recomputed from the updated volume, everything else
+    // keeps the previous gradients
+    bool outside_kept = true;
+    std::vector<uint8_t> reference = texels;
+    for (int32_t z = 0; z < kExtent[2]; ++z) {
+      for (int32_t y = 0; y < kExtent[1]; ++y) {
+        for (int32_t x = 0; x < kExtent[0]; ++x) {
+          const bool grown =
+              x >= box.x - 1 && x <= box.x + static_cast<int32_t>(box.width) &&
+              y >= box.y - 1 &&
+              y <= box.y + static_cast<int32_t>(box.height) &&
+              z >= box.z - 1 && z <= box.z + static_cast<int32_t>(box.depth);
+          const size_t i = VoxelIndex(x, y, z) * 4;
+          if (grown)
+            std::copy(boxed.begin() + i, boxed.begin() + i + 4,
+                      reference.begin() + i);
+          else
+            outside_kept &= std::equal(boxed.begin() + i,
+                                       boxed.begin() + i + 4,
+                                       texels.begin() + i);
+        }
+      }
+    }
+    CHECK(outside_kept);
+    // the differences outside of the grown box do not read the box, so the
+    // previous gradients are those of the updated volume there
+    CHECK(MaxDifference(reference, expected_volume, format,
+                        magnitude_scale) <= tolerance);
+  }
+
+  s_API->DestroyTexture3D(gradients_id);
+  s_API->DestroyTexture3D(volume_id);
+  SubmitFrame();
+  CHECK(GetThreadErrorCount() == errors);
+}
+
+TEST(GradientsRGBA8) { CheckGradients(RGBA8_UINT, 1, 2); }
+
+TEST(GradientsRG16) { CheckGradients(RG16_UINT, 3, 4); }
+
+int main() {
+  if (!CreateDevice()) {
+    printf("no Vulkan device with a graphics and compute queue - skipped\n");
+    DestroyDevice();
+    return kSkipped;
+  }
+  s_API = CreateTextureSubPluginAPI_Vulkan();
+  s_API->ProcessDeviceEvent(kUnityGfxDeviceEventInitialize, &s_Interfaces);
+  const int result = RunTests();
+  SubmitFrame();
+  s_API->ProcessDeviceEvent(kUnityGfxDeviceEventShutdown, &s_Interfaces);
+  delete s_API;
+  DestroyDevice();
+  return result;
+}